@@ -39,4 +39,5 @@ library japanese_phoneme_converter;
 export 'src/japanese_phoneme_converter.dart';
 export 'src/conversion_result.dart';
 export 'src/phoneme_exception.dart';
+export 'src/phoneme_worker_pool.dart' hide workerIsolates;
 
@@ -34,3 +34,218 @@ class ConversionResult {
   int get hashCode => Object.hash(phonemes, processingTimeMicroseconds);
 }
 
+
+/// One piece of an aligned conversion
+/// ([JapanesePhonemeConverter.convertWithAlignment]).
+class PhonemeSpan {
+  /// Flag bits of the native JpnPhonemeSpan record
+  static const int _matched = 0x01;
+  static const int _wordStart = 0x02;
+  static const int _furigana = 0x04;
+
+  /// The part of the input this span was converted from.
+  final String source;
+
+  /// The phonemes it produced.
+  final String phonemes;
+
+  /// Where [source] starts in the input (UTF-16 code units, as for `substring`).
+  final int sourceOffset;
+
+  /// Length of [source] in UTF-16 code units.
+  final int sourceLength;
+
+  /// Raw flag bits (see [matched], [wordStart] and [furigana]).
+  final int flags;
+
+  /// Whether the phonemes come from the dictionary (otherwise [source] was
+  /// copied through unchanged, e.g. punctuation or Latin text).
+  bool get matched => flags & _matched != 0;
+
+  /// Whether this span starts a word (only set with word segmentation).
+  bool get wordStart => flags & _wordStart != 0;
+
+  /// Whether the phonemes were read from a furigana hint; [source] is then
+  /// the whole hinted word including its reading.
+  bool get furigana => flags & _furigana != 0;
+
+  /// Creates a span.
+  const PhonemeSpan({
+    required this.source,
+    required this.phonemes,
+    required this.sourceOffset,
+    required this.sourceLength,
+    required this.flags,
+  });
+
+  @override
+  String toString() {
+    return 'PhonemeSpan("$source" → "$phonemes" at $sourceOffset)';
+  }
+}
+
+/// Result of [JapanesePhonemeConverter.convertWithAlignment].
+///
+/// The phonemes plus the input span each part of them came from, in output
+/// order. The spaces between segmented words belong to no span.
+class AlignedConversionResult {
+  /// The converted IPA phoneme representation of the input text.
+  final String phonemes;
+
+  /// The alignment of [phonemes] to the input.
+  final List<PhonemeSpan> spans;
+
+  /// Time taken for the conversion in microseconds.
+  final int processingTimeMicroseconds;
+
+  /// Time taken for the conversion in milliseconds.
+  double get processingTimeMilliseconds => processingTimeMicroseconds / 1000.0;
+
+  /// Creates an aligned conversion result.
+  const AlignedConversionResult({
+    required this.phonemes,
+    required this.spans,
+    required this.processingTimeMicroseconds,
+  });
+
+  @override
+  String toString() {
+    return 'AlignedConversionResult(phonemes: "$phonemes", spans: ${spans.length}, '
+        'time: ${processingTimeMicroseconds}μs)';
+  }
+}
+
+/// Result of a batch conversion ([JapanesePhonemeConverter.convertBatch]).
+///
+/// Contains one phoneme string per input text, in input order.
+class BatchConversionResult {
+  /// The converted IPA phoneme representation of each input text.
+  final List<String> phonemes;
+
+  /// Total native time taken for the whole batch in microseconds.
+  final int processingTimeMicroseconds;
+
+  /// Total native time taken for the whole batch in milliseconds.
+  double get processingTimeMilliseconds => processingTimeMicroseconds / 1000.0;
+
+  /// Creates a batch conversion result.
+  const BatchConversionResult({
+    required this.phonemes,
+    required this.processingTimeMicroseconds,
+  });
+
+  @override
+  String toString() {
+    return 'BatchConversionResult(items: ${phonemes.length}, time: ${processingTimeMicroseconds}μs)';
+  }
+}
+
+/// Counters of the native result cache ([JapanesePhonemeConverter.cacheStats]).
+class CacheStats {
+  /// Conversions answered from the cache.
+  final int hits;
+
+  /// Cacheable conversions that had to be converted.
+  final int misses;
+
+  /// Number of results currently cached.
+  final int entries;
+
+  /// Configured capacity (0 = cache disabled).
+  final int capacity;
+
+  /// Fraction of cacheable conversions answered from the cache (0-1).
+  double get hitRate => hits + misses == 0 ? 0.0 : hits / (hits + misses);
+
+  /// Creates cache statistics.
+  const CacheStats({
+    required this.hits,
+    required this.misses,
+    required this.entries,
+    required this.capacity,
+  });
+
+  @override
+  String toString() {
+    return 'CacheStats(hits: $hits, misses: $misses, entries: $entries/$capacity)';
+  }
+}
+
+/// Hot-path counters of the native pipeline (see
+/// [JapanesePhonemeConverter.setStatsEnabled]).
+class PipelineStats {
+  /// Number of counters reported by the native library.
+  static const int counterCount = 14;
+
+  /// Texts run through the conversion pipeline (cache hits excluded).
+  final int conversions;
+
+  /// Texts answered by the result cache.
+  final int cacheHits;
+
+  /// UTF-8 bytes of the converted texts.
+  final int inputBytes;
+
+  /// UTF-8 bytes of the produced phonemes.
+  final int outputBytes;
+
+  /// Time spent decoding text and parsing furigana hints.
+  final Duration parseTime;
+
+  /// Time spent finding word boundaries (including the dictionary walks).
+  final Duration segmentationTime;
+
+  /// Time spent emitting phonemes.
+  final Duration lookupTime;
+
+  /// Time spent copying results into output buffers.
+  final Duration outputCopyTime;
+
+  /// Trie nodes entered by dictionary walks.
+  final int trieNodesVisited;
+
+  /// Dictionary walks that found a phoneme entry or a word.
+  final int dictionaryHits;
+
+  /// Dictionary walks that found nothing.
+  final int dictionaryMisses;
+
+  /// Segments matched as dictionary words.
+  final int wordTokens;
+
+  /// Segments converted through the phoneme entries alone (no word match).
+  final int fallbackTokens;
+
+  /// Runs of characters matched by neither (particles, conjugations, ...).
+  final int grammarTokens;
+
+  /// Fraction of dictionary walks that found something (0-1).
+  double get dictionaryHitRate {
+    final total = dictionaryHits + dictionaryMisses;
+    return total == 0 ? 0.0 : dictionaryHits / total;
+  }
+
+  /// Creates pipeline statistics from the native counter array.
+  PipelineStats.fromCounters(List<int> counters)
+      : conversions = counters[0],
+        cacheHits = counters[1],
+        inputBytes = counters[2],
+        outputBytes = counters[3],
+        parseTime = Duration(microseconds: counters[4] ~/ 1000),
+        segmentationTime = Duration(microseconds: counters[5] ~/ 1000),
+        lookupTime = Duration(microseconds: counters[6] ~/ 1000),
+        outputCopyTime = Duration(microseconds: counters[7] ~/ 1000),
+        trieNodesVisited = counters[8],
+        dictionaryHits = counters[9],
+        dictionaryMisses = counters[10],
+        wordTokens = counters[11],
+        fallbackTokens = counters[12],
+        grammarTokens = counters[13];
+
+  @override
+  String toString() {
+    return 'PipelineStats(conversions: $conversions, cacheHits: $cacheHits, '
+        'bytes: $inputBytes, trieNodes: $trieNodesVisited, '
+        'dictionaryHitRate: ${(dictionaryHitRate * 100).toStringAsFixed(1)}%)';
+  }
+}
@@ -1,10 +1,12 @@
 import 'dart:convert'; // For utf8.decode
 import 'dart:ffi' as ffi;
-import 'dart:io';
+import 'dart:typed_data';
 import 'package:ffi/ffi.dart';
 
 import 'conversion_result.dart';
+import 'native_library.dart';
 import 'phoneme_exception.dart';
+import 'phoneme_worker_pool.dart';
 
 // ============================================================================
 // FFI Type Definitions
@@ -14,24 +16,127 @@ import 'phoneme_exception.dart';
 typedef _InitNative = ffi.Int32 Function(ffi.Pointer<Utf8> jsonFilePath);
 typedef _InitDart = int Function(ffi.Pointer<Utf8> jsonFilePath);
 
-/// Native function: int jpn_phoneme_init_from_memory(const uint8_t* trie_data, int data_size)
-typedef _InitFromMemoryNative = ffi.Int32 Function(ffi.Pointer<ffi.Uint8> trieData, ffi.Int32 dataSize);
-typedef _InitFromMemoryDart = int Function(ffi.Pointer<ffi.Uint8> trieData, int dataSize);
+/// Native function: int jpn_phoneme_init_from_memory_owned(const uint8_t* trie_data, int data_size, release)
+typedef _InitFromMemoryNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Uint8> trieData,
+  ffi.Int32 dataSize,
+  ffi.Pointer<ffi.NativeFinalizerFunction> release,
+);
+typedef _InitFromMemoryDart = int Function(
+  ffi.Pointer<ffi.Uint8> trieData,
+  int dataSize,
+  ffi.Pointer<ffi.NativeFinalizerFunction> release,
+);
+
+/// Native function: int jpn_phoneme_init_async(json_file_path, word_file_path, callback, user_data)
+typedef _InitAsyncNative = ffi.Int32 Function(
+  ffi.Pointer<Utf8> jsonFilePath,
+  ffi.Pointer<Utf8> wordFilePath,
+  ffi.Pointer<ffi.Void> callback,
+  ffi.Pointer<ffi.Void> userData,
+);
+typedef _InitAsyncDart = int Function(
+  ffi.Pointer<Utf8> jsonFilePath,
+  ffi.Pointer<Utf8> wordFilePath,
+  ffi.Pointer<ffi.Void> callback,
+  ffi.Pointer<ffi.Void> userData,
+);
 
-/// Native function: int jpn_phoneme_convert(...)
-typedef _ConvertNative = ffi.Int32 Function(
-  ffi.Pointer<Utf8> japaneseText,
+/// Native functions: int jpn_phoneme_get_init_state() / jpn_phoneme_get_init_progress()
+typedef _GetInitIntNative = ffi.Int32 Function();
+typedef _GetInitIntDart = int Function();
+
+/// Native function: const char* jpn_phoneme_get_init_error()
+typedef _GetInitErrorNative = ffi.Pointer<Utf8> Function();
+typedef _GetInitErrorDart = ffi.Pointer<Utf8> Function();
+
+/// Native function: int jpn_phoneme_convert_spans(...)
+typedef _ConvertSpansNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Void> context,
+  ffi.Pointer<Utf8> text,
+  ffi.Int32 length,
   ffi.Pointer<ffi.Uint8> outputBuffer,
   ffi.Int32 bufferSize,
+  ffi.Pointer<ffi.Uint32> spans,
+  ffi.Int32 spanCapacity,
+  ffi.Pointer<ffi.Int32> requiredSize,
+  ffi.Pointer<ffi.Int32> spanCount,
   ffi.Pointer<ffi.Int64> processingTimeUs,
 );
-typedef _ConvertDart = int Function(
-  ffi.Pointer<Utf8> japaneseText,
+typedef _ConvertSpansDart = int Function(
+  ffi.Pointer<ffi.Void> context,
+  ffi.Pointer<Utf8> text,
+  int length,
   ffi.Pointer<ffi.Uint8> outputBuffer,
   int bufferSize,
+  ffi.Pointer<ffi.Uint32> spans,
+  int spanCapacity,
+  ffi.Pointer<ffi.Int32> requiredSize,
+  ffi.Pointer<ffi.Int32> spanCount,
   ffi.Pointer<ffi.Int64> processingTimeUs,
 );
 
+/// Native function: int jpn_phoneme_convert_batch_mt(...)
+typedef _ConvertBatchNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Pointer<ffi.Uint8>> texts,
+  ffi.Pointer<ffi.Int32> textLengths,
+  ffi.Int32 count,
+  ffi.Pointer<ffi.Uint8> outputArena,
+  ffi.Int32 arenaSize,
+  ffi.Pointer<ffi.Int32> outputOffsets,
+  ffi.Pointer<ffi.Int32> itemStatus,
+  ffi.Pointer<ffi.Int64> processingTimeUs,
+  ffi.Int32 threadCount,
+);
+typedef _ConvertBatchDart = int Function(
+  ffi.Pointer<ffi.Pointer<ffi.Uint8>> texts,
+  ffi.Pointer<ffi.Int32> textLengths,
+  int count,
+  ffi.Pointer<ffi.Uint8> outputArena,
+  int arenaSize,
+  ffi.Pointer<ffi.Int32> outputOffsets,
+  ffi.Pointer<ffi.Int32> itemStatus,
+  ffi.Pointer<ffi.Int64> processingTimeUs,
+  int threadCount,
+);
+
+/// Native callback: void (*)(const uint8_t* data, int32_t length, void* user_data)
+typedef _StreamCallbackNative = ffi.Void Function(
+  ffi.Pointer<ffi.Uint8> data,
+  ffi.Int32 length,
+  ffi.Pointer<ffi.Void> userData,
+);
+
+/// Native function: JpnPhonemeStream* jpn_phoneme_stream_create(callback, void* user_data)
+typedef _StreamCreateNative = ffi.Pointer<ffi.Void> Function(
+  ffi.Pointer<ffi.NativeFunction<_StreamCallbackNative>> callback,
+  ffi.Pointer<ffi.Void> userData,
+);
+typedef _StreamCreateDart = ffi.Pointer<ffi.Void> Function(
+  ffi.Pointer<ffi.NativeFunction<_StreamCallbackNative>> callback,
+  ffi.Pointer<ffi.Void> userData,
+);
+
+/// Native function: int jpn_phoneme_stream_feed(JpnPhonemeStream* stream, const char* data, int length)
+typedef _StreamFeedNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Void> stream,
+  ffi.Pointer<ffi.Uint8> data,
+  ffi.Int32 length,
+);
+typedef _StreamFeedDart = int Function(
+  ffi.Pointer<ffi.Void> stream,
+  ffi.Pointer<ffi.Uint8> data,
+  int length,
+);
+
+/// Native function: int jpn_phoneme_stream_flush(JpnPhonemeStream* stream)
+typedef _StreamFlushNative = ffi.Int32 Function(ffi.Pointer<ffi.Void> stream);
+typedef _StreamFlushDart = int Function(ffi.Pointer<ffi.Void> stream);
+
+/// Native function: void jpn_phoneme_stream_destroy(JpnPhonemeStream* stream)
+typedef _StreamDestroyNative = ffi.Void Function(ffi.Pointer<ffi.Void> stream);
+typedef _StreamDestroyDart = void Function(ffi.Pointer<ffi.Void> stream);
+
 /// Native function: const char* jpn_phoneme_get_error()
 typedef _GetErrorNative = ffi.Pointer<Utf8> Function();
 typedef _GetErrorDart = ffi.Pointer<Utf8> Function();
@@ -52,6 +157,14 @@ typedef _VersionDart = ffi.Pointer<Utf8> Function();
 typedef _InitWordDictNative = ffi.Int32 Function(ffi.Pointer<Utf8> wordFilePath);
 typedef _InitWordDictDart = int Function(ffi.Pointer<Utf8> wordFilePath);
 
+/// Native function: int jpn_phoneme_init_word_dict_from_memory(const uint8_t* data, int data_size)
+typedef _InitWordDictFromMemoryNative = ffi.Int32 Function(ffi.Pointer<ffi.Uint8> data, ffi.Int32 dataSize);
+typedef _InitWordDictFromMemoryDart = int Function(ffi.Pointer<ffi.Uint8> data, int dataSize);
+
+/// Native function: void jpn_phoneme_set_snapshot_cache(const char* directory)
+typedef _SetSnapshotCacheNative = ffi.Void Function(ffi.Pointer<Utf8> directory);
+typedef _SetSnapshotCacheDart = void Function(ffi.Pointer<Utf8> directory);
+
 /// Native function: void jpn_phoneme_set_use_segmentation(bool enabled)
 typedef _SetUseSegmentationNative = ffi.Void Function(ffi.Bool enabled);
 typedef _SetUseSegmentationDart = void Function(bool enabled);
@@ -64,6 +177,60 @@ typedef _GetUseSegmentationDart = bool Function();
 typedef _GetWordCountNative = ffi.Int32 Function();
 typedef _GetWordCountDart = int Function();
 
+/// Native function: int jpn_phoneme_user_update(const char* const* words,
+///                                             const char* const* phonemes, int count, bool replace)
+typedef _UserUpdateNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Pointer<Utf8>> words,
+  ffi.Pointer<ffi.Pointer<Utf8>> phonemes,
+  ffi.Int32 count,
+  ffi.Bool replace,
+);
+typedef _UserUpdateDart = int Function(
+  ffi.Pointer<ffi.Pointer<Utf8>> words,
+  ffi.Pointer<ffi.Pointer<Utf8>> phonemes,
+  int count,
+  bool replace,
+);
+
+/// Native function: int jpn_phoneme_user_count()
+typedef _UserCountNative = ffi.Int32 Function();
+typedef _UserCountDart = int Function();
+
+/// Native function: int jpn_phoneme_set_cache_capacity(int capacity)
+typedef _SetCacheCapacityNative = ffi.Int32 Function(ffi.Int32 capacity);
+typedef _SetCacheCapacityDart = int Function(int capacity);
+
+/// Native function: void jpn_phoneme_get_cache_stats(int64_t* hits, int64_t* misses,
+///                                                    int32_t* entries, int32_t* capacity)
+typedef _GetCacheStatsNative = ffi.Void Function(
+  ffi.Pointer<ffi.Int64> hits,
+  ffi.Pointer<ffi.Int64> misses,
+  ffi.Pointer<ffi.Int32> entries,
+  ffi.Pointer<ffi.Int32> capacity,
+);
+typedef _GetCacheStatsDart = void Function(
+  ffi.Pointer<ffi.Int64> hits,
+  ffi.Pointer<ffi.Int64> misses,
+  ffi.Pointer<ffi.Int32> entries,
+  ffi.Pointer<ffi.Int32> capacity,
+);
+
+/// Native function: void jpn_phoneme_clear_cache()
+typedef _ClearCacheNative = ffi.Void Function();
+typedef _ClearCacheDart = void Function();
+
+/// Native function: void jpn_phoneme_set_stats_enabled(bool enabled)
+typedef _SetStatsEnabledNative = ffi.Void Function(ffi.Bool enabled);
+typedef _SetStatsEnabledDart = void Function(bool enabled);
+
+/// Native function: int jpn_phoneme_get_stats(int64_t* values, int count)
+typedef _GetStatsNative = ffi.Int32 Function(ffi.Pointer<ffi.Int64> values, ffi.Int32 count);
+typedef _GetStatsDart = int Function(ffi.Pointer<ffi.Int64> values, int count);
+
+/// Native function: void jpn_phoneme_reset_stats()
+typedef _ResetStatsNative = ffi.Void Function();
+typedef _ResetStatsDart = void Function();
+
 // ============================================================================
 // Japanese Phoneme Converter - Main Class
 // ============================================================================
@@ -101,16 +268,41 @@ typedef _GetWordCountDart = int Function();
 class JapanesePhonemeConverter {
   ffi.DynamicLibrary? _lib;
   _InitDart? _init;
-  _InitFromMemoryDart? _initFromMemory;
-  _ConvertDart? _convert;
+  _InitFromMemoryDart? _initFromMemoryOwned;
+  _InitAsyncDart? _initAsync;
+  _GetInitIntDart? _getInitState;
+  _GetInitIntDart? _getInitProgress;
+  _GetInitErrorDart? _getInitError;
+  _ConvertSpansDart? _convertSpans;
+  _ConvertBatchDart? _convertBatch;
   _GetErrorDart? _getError;
   _GetEntryCountDart? _getEntryCount;
   _CleanupDart? _cleanup;
   _VersionDart? _version;
   _InitWordDictDart? _initWordDict;
+  _InitWordDictFromMemoryDart? _initWordDictFromMemory;
+  _SetSnapshotCacheDart? _setSnapshotCache;
   _SetUseSegmentationDart? _setUseSegmentation;
   _GetUseSegmentationDart? _getUseSegmentation;
   _GetWordCountDart? _getWordCount;
+  _UserUpdateDart? _userUpdate;
+  _UserCountDart? _userCount;
+  _SetCacheCapacityDart? _setCacheCapacity;
+  _GetCacheStatsDart? _getCacheStats;
+  _ClearCacheDart? _clearCache;
+  _SetStatsEnabledDart? _setStatsEnabled;
+  _GetStatsDart? _getStats;
+  _ResetStatsDart? _resetStats;
+  _StreamCreateDart? _streamCreate;
+  _StreamFeedDart? _streamFeed;
+  _StreamFlushDart? _streamFlush;
+  _StreamDestroyDart? _streamDestroy;
+
+  /// Library path given to the constructor, for [spawnWorkerPool]
+  final String? _libraryPath;
+
+  /// Native context and buffers reused by [convert], created on first use
+  PinnedConverter? _pinned;
 
   bool _isInitialized = false;
   bool _isDisposed = false;
@@ -118,39 +310,36 @@ class JapanesePhonemeConverter {
   /// Default buffer size for conversion output (4KB)
   static const int defaultBufferSize = 4096;
 
+  /// Returned by the native convert call when the output does not fit
+  static const int _bufferTooSmall = -2;
+
+  /// Fields per native JpnPhonemeSpan record (five uint32 values)
+  static const int _spanFields = 5;
+
+  /// Per-item status codes of the native batch call
+  static const int _batchItemOk = 0;
+  static const int _batchItemArenaFull = 2;
+
+  /// Largest arena the native batch call can address (int32 offsets)
+  static const int _maxArenaSize = 0x7FFFFFFF;
+
+  /// States of the native background load (jpn_phoneme_get_init_state)
+  static const int _initLoading = 1;
+  static const int _initReady = 2;
+
   /// Creates a new phoneme converter instance.
   ///
   /// The native library is loaded automatically based on the current platform.
   /// Throws [PhonemeException] if the library cannot be loaded.
-  JapanesePhonemeConverter({String? libraryPath}) {
+  JapanesePhonemeConverter({String? libraryPath}) : _libraryPath = libraryPath {
     try {
-      _lib = _loadLibrary(libraryPath);
+      _lib = openPhonemeLibrary(libraryPath);
       _bindFunctions();
     } catch (e) {
       throw PhonemeException('Failed to load native library: $e');
     }
   }
 
-  /// Load the native library based on platform
-  ffi.DynamicLibrary _loadLibrary(String? customPath) {
-    if (customPath != null) {
-      return ffi.DynamicLibrary.open(customPath);
-    }
-
-    // Load as Flutter FFI plugin (auto-bundled with app)
-    const libName = 'japanese_phoneme_converter';
-    
-    if (Platform.isAndroid || Platform.isLinux) {
-      return ffi.DynamicLibrary.open('lib$libName.so');
-    } else if (Platform.isIOS || Platform.isMacOS) {
-      return ffi.DynamicLibrary.process();
-    } else if (Platform.isWindows) {
-      return ffi.DynamicLibrary.open('$libName.dll');
-    } else {
-      throw PhonemeException('Unsupported platform: ${Platform.operatingSystem}');
-    }
-  }
-
   /// Bind native functions to Dart functions
   void _bindFunctions() {
     final lib = _lib!;
@@ -158,11 +347,26 @@ class JapanesePhonemeConverter {
     _init = lib
         .lookup<ffi.NativeFunction<_InitNative>>('jpn_phoneme_init')
         .asFunction();
-    _initFromMemory = lib
-        .lookup<ffi.NativeFunction<_InitFromMemoryNative>>('jpn_phoneme_init_from_memory')
+    _initFromMemoryOwned = lib
+        .lookup<ffi.NativeFunction<_InitFromMemoryNative>>('jpn_phoneme_init_from_memory_owned')
+        .asFunction();
+    _initAsync = lib
+        .lookup<ffi.NativeFunction<_InitAsyncNative>>('jpn_phoneme_init_async')
+        .asFunction();
+    _getInitState = lib
+        .lookup<ffi.NativeFunction<_GetInitIntNative>>('jpn_phoneme_get_init_state')
+        .asFunction();
+    _getInitProgress = lib
+        .lookup<ffi.NativeFunction<_GetInitIntNative>>('jpn_phoneme_get_init_progress')
+        .asFunction();
+    _getInitError = lib
+        .lookup<ffi.NativeFunction<_GetInitErrorNative>>('jpn_phoneme_get_init_error')
         .asFunction();
-    _convert = lib
-        .lookup<ffi.NativeFunction<_ConvertNative>>('jpn_phoneme_convert')
+    _convertSpans = lib
+        .lookup<ffi.NativeFunction<_ConvertSpansNative>>('jpn_phoneme_convert_spans')
+        .asFunction();
+    _convertBatch = lib
+        .lookup<ffi.NativeFunction<_ConvertBatchNative>>('jpn_phoneme_convert_batch_mt')
         .asFunction();
     _getError = lib
         .lookup<ffi.NativeFunction<_GetErrorNative>>('jpn_phoneme_get_error')
@@ -179,6 +383,12 @@ class JapanesePhonemeConverter {
     _initWordDict = lib
         .lookup<ffi.NativeFunction<_InitWordDictNative>>('jpn_phoneme_init_word_dict')
         .asFunction();
+    _initWordDictFromMemory = lib
+        .lookup<ffi.NativeFunction<_InitWordDictFromMemoryNative>>('jpn_phoneme_init_word_dict_from_memory')
+        .asFunction();
+    _setSnapshotCache = lib
+        .lookup<ffi.NativeFunction<_SetSnapshotCacheNative>>('jpn_phoneme_set_snapshot_cache')
+        .asFunction();
     _setUseSegmentation = lib
         .lookup<ffi.NativeFunction<_SetUseSegmentationNative>>('jpn_phoneme_set_use_segmentation')
         .asFunction();
@@ -188,6 +398,70 @@ class JapanesePhonemeConverter {
     _getWordCount = lib
         .lookup<ffi.NativeFunction<_GetWordCountNative>>('jpn_phoneme_get_word_count')
         .asFunction();
+    _userUpdate = lib
+        .lookup<ffi.NativeFunction<_UserUpdateNative>>('jpn_phoneme_user_update')
+        .asFunction();
+    _userCount = lib
+        .lookup<ffi.NativeFunction<_UserCountNative>>('jpn_phoneme_user_count')
+        .asFunction();
+    _setCacheCapacity = lib
+        .lookup<ffi.NativeFunction<_SetCacheCapacityNative>>('jpn_phoneme_set_cache_capacity')
+        .asFunction();
+    _getCacheStats = lib
+        .lookup<ffi.NativeFunction<_GetCacheStatsNative>>('jpn_phoneme_get_cache_stats')
+        .asFunction();
+    _clearCache = lib
+        .lookup<ffi.NativeFunction<_ClearCacheNative>>('jpn_phoneme_clear_cache')
+        .asFunction();
+    _setStatsEnabled = lib
+        .lookup<ffi.NativeFunction<_SetStatsEnabledNative>>('jpn_phoneme_set_stats_enabled')
+        .asFunction();
+    _getStats = lib
+        .lookup<ffi.NativeFunction<_GetStatsNative>>('jpn_phoneme_get_stats')
+        .asFunction();
+    _resetStats = lib
+        .lookup<ffi.NativeFunction<_ResetStatsNative>>('jpn_phoneme_reset_stats')
+        .asFunction();
+    _streamCreate = lib
+        .lookup<ffi.NativeFunction<_StreamCreateNative>>('jpn_phoneme_stream_create')
+        .asFunction();
+    _streamFeed = lib
+        .lookup<ffi.NativeFunction<_StreamFeedNative>>('jpn_phoneme_stream_feed')
+        .asFunction();
+    _streamFlush = lib
+        .lookup<ffi.NativeFunction<_StreamFlushNative>>('jpn_phoneme_stream_flush')
+        .asFunction();
+    _streamDestroy = lib
+        .lookup<ffi.NativeFunction<_StreamDestroyNative>>('jpn_phoneme_stream_destroy')
+        .asFunction();
+  }
+
+  /// Cache built dictionaries in [directory] (e.g. the app's cache directory).
+  ///
+  /// A JSON dictionary, a v1 `.trie` or a text word list is built entry by
+  /// entry at every [init], [initFromMemory], [initAsync] or
+  /// [loadWordDictionary]. With a cache directory the built dictionary is
+  /// also saved there as a packed trie, keyed by a hash of its source files,
+  /// and later inits from the same files (also on later launches) map it
+  /// instead of rebuilding. Pass `null` to turn the cache off (the default).
+  ///
+  /// Applies to the whole process and to inits made after the call.
+  /// Snapshots that cannot be written or read are skipped, so the directory
+  /// may be cleared at any time.
+  ///
+  /// Example:
+  /// ```dart
+  /// converter.setSnapshotCache(cacheDirectory.path);  // e.g. from path_provider
+  /// converter.init('assets/ja_phonemes.json');  // Fast from the second launch on
+  /// ```
+  void setSnapshotCache(String? directory) {
+    _checkNotDisposed();
+    final directoryPtr = directory != null ? directory.toNativeUtf8() : ffi.nullptr.cast<Utf8>();
+    try {
+      _setSnapshotCache!(directoryPtr);
+    } finally {
+      if (directory != null) malloc.free(directoryPtr);
+    }
   }
 
   /// Initialize the converter with a phoneme dictionary JSON file.
@@ -214,12 +488,78 @@ class JapanesePhonemeConverter {
     }
   }
 
+  /// Initialize the converter on a native background thread.
+  ///
+  /// Returns at once; the future completes with `true` when the dictionary
+  /// (and the word list, if [wordFilePath] is given) is loaded, or `false`
+  /// if loading failed (see [initError]). Conversions work meanwhile: on a
+  /// first init they are served by a built-in kana core that reads kana one
+  /// by one like the full dictionary and leaves kanji unchanged, otherwise
+  /// by the dictionary loaded before. [initProgress] reports how far the
+  /// load has got.
+  ///
+  /// Example:
+  /// ```dart
+  /// final ready = converter.initAsync('assets/ja_phonemes.json',
+  ///     wordFilePath: 'assets/ja_words.txt');
+  /// print(converter.convert('ありがとう')?.phonemes); // Kana core
+  /// if (!await ready) {
+  ///   print('Failed: ${converter.initError}');
+  /// }
+  /// ```
+  Future<bool> initAsync(
+    String jsonFilePath, {
+    String? wordFilePath,
+    Duration pollInterval = const Duration(milliseconds: 10),
+  }) async {
+    _checkNotDisposed();
+
+    final pathPtr = jsonFilePath.toNativeUtf8();
+    final wordPtr = wordFilePath != null ? wordFilePath.toNativeUtf8() : ffi.nullptr.cast<Utf8>();
+    try {
+      if (_initAsync!(pathPtr, wordPtr, ffi.nullptr, ffi.nullptr) != 1) {
+        return false;
+      }
+    } finally {
+      malloc.free(pathPtr);
+      if (wordPtr != ffi.nullptr) malloc.free(wordPtr);
+    }
+    _isInitialized = true; // Kana core or the previous dictionary serve meanwhile
+
+    // The native completion callback runs on the loader thread, so the
+    // state is polled instead
+    while (_getInitState!() == _initLoading) {
+      await Future<void>.delayed(pollInterval);
+    }
+    if (_isDisposed) return false;
+
+    final ready = _getInitState!() == _initReady;
+    _isInitialized = _getEntryCount!() >= 0;
+    return ready;
+  }
+
+  /// Progress of the [initAsync] load in percent (0-100).
+  int get initProgress {
+    _checkNotDisposed();
+    return _getInitProgress!();
+  }
+
+  /// Error message of a failed [initAsync] load, or empty string.
+  String get initError {
+    _checkNotDisposed();
+    return _getInitError!().toDartString();
+  }
+
   /// Initialize the converter from .trie data loaded in memory.
   /// 🔥 BLAZING FAST: Use this to load .trie directly from Flutter assets!
   ///
   /// This is the preferred method for Flutter apps as it avoids file system access.
   /// Load your .trie asset using rootBundle.load() and pass the bytes here.
   ///
+  /// The bytes are copied into native memory once and the library walks that
+  /// copy in place (no temp file, no second copy); it is freed on [dispose]
+  /// or the next init call.
+  ///
   /// Returns `true` on success, `false` on failure.
   ///
   /// Example:
@@ -234,21 +574,15 @@ class JapanesePhonemeConverter {
   bool initFromMemory(List<int> trieData) {
     _checkNotDisposed();
 
-    // Allocate native memory for the data
-    final dataPtr = malloc<ffi.Uint8>(trieData.length);
-    try {
-      // Copy Dart list to native memory
-      final nativeList = dataPtr.asTypedList(trieData.length);
-      nativeList.setAll(0, trieData);
-      
-      // Call native function
-      final result = _initFromMemory!(dataPtr, trieData.length);
-      _isInitialized = result == 1;
-      return _isInitialized;
-    } finally {
-      // Free the allocated memory
-      malloc.free(dataPtr);
-    }
+    // Allocate native memory for the data and copy the Dart list into it
+    final dataPtr = malloc<ffi.Uint8>(trieData.isNotEmpty ? trieData.length : 1);
+    dataPtr.asTypedList(trieData.length).setAll(0, trieData);
+
+    // The library takes the buffer over and frees it once no dictionary
+    // (or worker conversion) reads it anymore, also when init fails
+    final result = _initFromMemoryOwned!(dataPtr, trieData.length, malloc.nativeFree);
+    _isInitialized = result == 1;
+    return _isInitialized;
   }
 
   /// Convert Japanese text to IPA phonemes.
@@ -256,6 +590,13 @@ class JapanesePhonemeConverter {
   /// Returns a [ConversionResult] containing the phonemes and processing time,
   /// or `null` if conversion fails.
   ///
+  /// Conversions reuse one native context and pinned input and output
+  /// buffers, so a call allocates no native memory once they are large
+  /// enough. [bufferSize] is their initial size (taken on the first call):
+  /// if the output is larger, the native library reports the required size
+  /// and keeps the result, so the retry just copies it (the text is not
+  /// converted twice) and the buffer stays grown for later calls.
+  ///
   /// Example:
   /// ```dart
   /// final result = converter.convert('日本語');
@@ -266,36 +607,118 @@ class JapanesePhonemeConverter {
   ConversionResult? convert(String japaneseText, {int bufferSize = defaultBufferSize}) {
     _checkInitialized();
 
+    final pinned = _pinned ??= PinnedConverter(_lib!, bufferSize: bufferSize);
+    final output = pinned.convert(utf8.encode(japaneseText));
+    if (output == null) {
+      // Conversion failed
+      return null;
+    }
+
+    // The C++ library returns UTF-8 encoded bytes, so we must use utf8.decode()
+    return ConversionResult(
+      phonemes: utf8.decode(output),
+      processingTimeMicroseconds: pinned.processingTimeMicroseconds,
+    );
+  }
+
+
+  /// Convert Japanese text to IPA phonemes and align them to the input.
+  ///
+  /// Besides the phonemes, the result lists which part of [japaneseText]
+  /// each part of the output came from (a dictionary match, characters
+  /// copied through, or the reading of a furigana-hinted word), e.g. to
+  /// drive lip-sync or highlight the text while it is spoken. The native
+  /// side fills one packed array, so no strings are built per match.
+  ///
+  /// Returns `null` if conversion fails.
+  ///
+  /// Example:
+  /// ```dart
+  /// final result = converter.convertWithAlignment('健太「けんた」は');
+  /// for (final span in result!.spans) {
+  ///   print('${span.source} → ${span.phonemes}');  // 健太「けんた」 → keɴta, は → wa
+  /// }
+  /// ```
+  AlignedConversionResult? convertWithAlignment(String japaneseText,
+      {int bufferSize = defaultBufferSize}) {
+    _checkInitialized();
+
     final textPtr = japaneseText.toNativeUtf8();
-    final buffer = malloc<ffi.Uint8>(bufferSize);
+    var buffer = malloc<ffi.Uint8>(bufferSize);
+    var spanCapacity = bufferSize ~/ 4 + 1;
+    var spans = malloc<ffi.Uint32>(spanCapacity * _spanFields);
+    final requiredPtr = malloc<ffi.Int32>();
+    final countPtr = malloc<ffi.Int32>();
     final timePtr = malloc<ffi.Int64>();
 
     try {
-      final length = _convert!(textPtr, buffer, bufferSize, timePtr);
+      var length = _convertSpans!(ffi.nullptr, textPtr, -1, buffer, bufferSize, spans,
+          spanCapacity, requiredPtr, countPtr, timePtr);
+
+      if (length == _bufferTooSmall) {
+        // Fetch the kept result with buffers of the reported sizes
+        final requiredSize = requiredPtr.value;
+        spanCapacity = countPtr.value;
+        malloc.free(buffer);
+        malloc.free(spans);
+        buffer = malloc<ffi.Uint8>(requiredSize);
+        spans = malloc<ffi.Uint32>(spanCapacity * _spanFields);
+        length = _convertSpans!(ffi.nullptr, textPtr, -1, buffer, requiredSize, spans,
+            spanCapacity, requiredPtr, countPtr, timePtr);
+      }
 
       if (length < 0) {
         // Conversion failed
         return null;
       }
 
-      // ✅ FIX: Properly decode UTF-8 bytes from C++ (not UTF-16 code units!)
-      // The C++ library returns UTF-8 encoded bytes, so we must use utf8.decode()
-      // instead of String.fromCharCodes() which treats bytes as UTF-16 code units
-      final result = buffer.asTypedList(length);
-      final phonemes = utf8.decode(result);
-      final time = timePtr.value;
+      final output = buffer.asTypedList(length);
+      final source = utf8.encode(japaneseText);
+      final units = _utf16Offsets(japaneseText, source.length);
+      final records = spans.asTypedList(countPtr.value * _spanFields);
 
-      return ConversionResult(
-        phonemes: phonemes,
-        processingTimeMicroseconds: time,
+      final alignment = <PhonemeSpan>[];
+      for (var i = 0; i < records.length; i += _spanFields) {
+        final sourceStart = units[records[i]];
+        final sourceEnd = units[records[i] + records[i + 1]];
+        final outputStart = records[i + 2];
+        alignment.add(PhonemeSpan(
+          source: japaneseText.substring(sourceStart, sourceEnd),
+          phonemes: utf8.decode(output.sublist(outputStart, outputStart + records[i + 3])),
+          sourceOffset: sourceStart,
+          sourceLength: sourceEnd - sourceStart,
+          flags: records[i + 4],
+        ));
+      }
+
+      return AlignedConversionResult(
+        phonemes: utf8.decode(output),
+        spans: alignment,
+        processingTimeMicroseconds: timePtr.value,
       );
     } finally {
       malloc.free(textPtr);
       malloc.free(buffer);
+      malloc.free(spans);
+      malloc.free(requiredPtr);
+      malloc.free(countPtr);
       malloc.free(timePtr);
     }
   }
 
+  /// UTF-16 index of every UTF-8 byte offset of [text] that starts a character
+  static List<int> _utf16Offsets(String text, int byteLength) {
+    final offsets = List<int>.filled(byteLength + 1, text.length);
+    var byte = 0;
+    var unit = 0;
+    for (final rune in text.runes) {
+      offsets[byte] = unit;
+      byte += rune < 0x80 ? 1 : rune < 0x800 ? 2 : rune < 0x10000 ? 3 : 4;
+      unit += rune < 0x10000 ? 1 : 2;
+    }
+    return offsets;
+  }
+
   /// Convert Japanese text to phonemes, throwing exception on failure.
   ///
   /// Unlike [convert], this method throws a [PhonemeException] if conversion fails.
@@ -317,6 +740,182 @@ class JapanesePhonemeConverter {
     return result;
   }
 
+  /// Convert many Japanese texts to IPA phonemes in a single native call.
+  ///
+  /// All inputs are passed in one native buffer and all outputs come back in
+  /// one arena, so the FFI transition, allocations and timing are paid once
+  /// per batch instead of once per text. Prefer this over calling [convert]
+  /// in a loop for bulk jobs such as subtitle or TTS preprocessing.
+  ///
+  /// [arenaSize] is the initial output arena size in bytes. Items that do not
+  /// fit are retried automatically with a larger arena.
+  ///
+  /// [threads] spreads the batch over that many native worker threads
+  /// (0 = one per CPU core). The result is identical for any thread count;
+  /// it only pays off for large batches.
+  ///
+  /// Throws [PhonemeException] if the batch or any item fails.
+  ///
+  /// Example:
+  /// ```dart
+  /// final batch = converter.convertBatch(['こんにちは', 'ありがとう'], threads: 0);
+  /// for (final phonemes in batch.phonemes) {
+  ///   print(phonemes);
+  /// }
+  /// ```
+  BatchConversionResult convertBatch(List<String> texts, {int? arenaSize, int threads = 1}) {
+    _checkInitialized();
+    if (threads < 0) {
+      throw ArgumentError.value(threads, 'threads', 'must not be negative');
+    }
+
+    final encoded = texts.map(utf8.encode).toList();
+    final phonemes = List<String>.filled(texts.length, '');
+    var totalTime = 0;
+
+    // Indices still to convert: everything first, then the items that did not fit
+    var pending = List<int>.generate(texts.length, (i) => i);
+    final inputBytes = encoded.fold<int>(0, (sum, bytes) => sum + bytes.length);
+    var arena = arenaSize ?? inputBytes * 2 + defaultBufferSize;
+    if (arena < 1) arena = 1;
+
+    while (pending.isNotEmpty) {
+      final count = pending.length;
+      final pendingBytes = pending.fold<int>(0, (sum, i) => sum + encoded[i].length);
+
+      final inputPtr = malloc<ffi.Uint8>(pendingBytes > 0 ? pendingBytes : 1);
+      final textsPtr = malloc<ffi.Pointer<ffi.Uint8>>(count);
+      final lengthsPtr = malloc<ffi.Int32>(count);
+      final arenaPtr = malloc<ffi.Uint8>(arena);
+      final offsetsPtr = malloc<ffi.Int32>(count + 1);
+      final statusPtr = malloc<ffi.Int32>(count);
+      final timePtr = malloc<ffi.Int64>();
+
+      try {
+        // Pack all inputs back to back into one native buffer
+        final input = inputPtr.asTypedList(pendingBytes);
+        var offset = 0;
+        for (var j = 0; j < count; j++) {
+          final bytes = encoded[pending[j]];
+          input.setAll(offset, bytes);
+          textsPtr[j] = ffi.Pointer<ffi.Uint8>.fromAddress(inputPtr.address + offset);
+          lengthsPtr[j] = bytes.length;
+          offset += bytes.length;
+        }
+
+        final result = _convertBatch!(
+          textsPtr, lengthsPtr, count, arenaPtr, arena, offsetsPtr, statusPtr, timePtr, threads,
+        );
+        if (result < 0) {
+          throw PhonemeException('Batch conversion failed: $lastError');
+        }
+        totalTime += timePtr.value;
+
+        final output = arenaPtr.asTypedList(arena);
+        final retry = <int>[];
+        for (var j = 0; j < count; j++) {
+          final status = statusPtr[j];
+          if (status == _batchItemOk) {
+            phonemes[pending[j]] = const Utf8Decoder().convert(output, offsetsPtr[j], offsetsPtr[j + 1]);
+          } else if (status == _batchItemArenaFull) {
+            retry.add(pending[j]);
+          } else {
+            throw PhonemeException('Conversion failed for item ${pending[j]}: $lastError');
+          }
+        }
+
+        if (retry.isNotEmpty) {
+          if (arena >= _maxArenaSize) {
+            throw PhonemeException('Batch output exceeds the maximum arena size');
+          }
+          arena = arena * 2 > _maxArenaSize ? _maxArenaSize : arena * 2;
+        }
+        pending = retry;
+      } finally {
+        malloc.free(inputPtr);
+        malloc.free(textsPtr);
+        malloc.free(lengthsPtr);
+        malloc.free(arenaPtr);
+        malloc.free(offsetsPtr);
+        malloc.free(statusPtr);
+        malloc.free(timePtr);
+      }
+    }
+
+    return BatchConversionResult(
+      phonemes: phonemes,
+      processingTimeMicroseconds: totalTime,
+    );
+  }
+
+  /// Open an incremental converter for text that arrives in pieces.
+  ///
+  /// Feed chunks of any size with [PhonemeStream.add]; every call returns
+  /// the phonemes of the lines completed so far, so book-length input never
+  /// has to be held in memory at once. Call [PhonemeStream.close] at the end
+  /// to get the rest. Throws [PhonemeException] if the stream cannot be created.
+  ///
+  /// Example:
+  /// ```dart
+  /// final stream = converter.openStream();
+  /// await for (final chunk in file.openRead().transform(utf8.decoder)) {
+  ///   sink.write(stream.add(chunk));
+  /// }
+  /// sink.write(stream.close());
+  /// ```
+  PhonemeStream openStream() {
+    _checkInitialized();
+
+    final handle = _streamCreate!(
+      ffi.Pointer.fromFunction<_StreamCallbackNative>(_onStreamOutput),
+      ffi.nullptr,
+    );
+    if (handle == ffi.nullptr) {
+      throw PhonemeException('Failed to create stream: $lastError');
+    }
+    return PhonemeStream._(this, handle);
+  }
+
+  /// Convert a stream of text chunks, emitting phonemes as lines complete.
+  ///
+  /// Example:
+  /// ```dart
+  /// final phonemes = converter.convertStream(
+  ///   File('book.txt').openRead().transform(utf8.decoder),
+  /// );
+  /// await phonemes.forEach(stdout.write);
+  /// ```
+  Stream<String> convertStream(Stream<String> chunks) async* {
+    final stream = openStream();
+    try {
+      await for (final chunk in chunks) {
+        final phonemes = stream.add(chunk);
+        if (phonemes.isNotEmpty) yield phonemes;
+      }
+      final rest = stream.close();
+      if (rest.isNotEmpty) yield rest;
+    } finally {
+      stream.close();
+    }
+  }
+
+  /// Start a [PhonemeWorkerPool] converting with this converter's dictionary.
+  ///
+  /// The workers open the same native library, so they share the loaded
+  /// dictionary (and later [init] or user dictionary changes) instead of
+  /// loading their own. Close the pool before [dispose].
+  ///
+  /// Example:
+  /// ```dart
+  /// final pool = await converter.spawnWorkerPool();
+  /// final phonemes = await Future.wait(sentences.map(pool.convertAsync));
+  /// await pool.close();
+  /// ```
+  Future<PhonemeWorkerPool> spawnWorkerPool({int? workers}) {
+    _checkInitialized();
+    return PhonemeWorkerPool.spawn(workers: workers, libraryPath: _libraryPath);
+  }
+
   /// Get the last error message from the native library.
   ///
   /// Returns the error message, or empty string if no error occurred.
@@ -378,6 +977,35 @@ class JapanesePhonemeConverter {
     }
   }
 
+  /// Load a word dictionary from memory (e.g. a Flutter asset).
+  ///
+  /// Accepts the same text format as [loadWordDictionary] or a word list
+  /// compiled with `jpn_trie_compiler --words` (smaller and faster to load).
+  /// The bytes are copied for the call only. Not needed with `japanese.trie`,
+  /// which already contains the words.
+  ///
+  /// Throws [PhonemeException] if loading fails.
+  ///
+  /// Example:
+  /// ```dart
+  /// final data = await rootBundle.load('assets/ja_words.bin');
+  /// converter.loadWordDictionaryFromMemory(data.buffer.asUint8List());
+  /// ```
+  void loadWordDictionaryFromMemory(List<int> wordData) {
+    _checkNotDisposed();
+
+    final dataPtr = malloc<ffi.Uint8>(wordData.isNotEmpty ? wordData.length : 1);
+    try {
+      dataPtr.asTypedList(wordData.length).setAll(0, wordData);
+      final result = _initWordDictFromMemory!(dataPtr, wordData.length);
+      if (result != 1) {
+        throw PhonemeException('Failed to load word dictionary: $lastError');
+      }
+    } finally {
+      malloc.free(dataPtr);
+    }
+  }
+
   /// Enable or disable word segmentation.
   ///
   /// When enabled, the converter will add spaces between words in the output.
@@ -411,6 +1039,146 @@ class JapanesePhonemeConverter {
     return _getWordCount!();
   }
 
+  /// Add, change or remove user words without reloading the dictionary.
+  ///
+  /// User words are looked up together with the dictionary (they win over
+  /// its entries) and take effect for all following conversions, including
+  /// those already queued on other threads. They are kept when the
+  /// dictionary is reloaded and dropped by [dispose].
+  ///
+  /// Each entry maps a word to its phoneme; `''` hides the word (the
+  /// dictionary's own reading too) and `null` removes a user word again.
+  /// With [replace] the current user words are discarded first, so a whole
+  /// list can be pushed at once. All changes apply together.
+  ///
+  /// Throws [PhonemeException] if the update fails (nothing is changed).
+  ///
+  /// Example:
+  /// ```dart
+  /// converter.updateUserDictionary({'山田花子': 'jamada hanako', '日本': null});
+  /// ```
+  void updateUserDictionary(Map<String, String?> entries, {bool replace = false}) {
+    _checkInitialized();
+
+    final count = entries.length;
+    final words = malloc<ffi.Pointer<Utf8>>(count > 0 ? count : 1);
+    final phonemes = malloc<ffi.Pointer<Utf8>>(count > 0 ? count : 1);
+    var filled = 0;
+    try {
+      for (final entry in entries.entries) {
+        words[filled] = entry.key.toNativeUtf8();
+        phonemes[filled] = entry.value?.toNativeUtf8() ?? ffi.nullptr.cast<Utf8>();
+        filled++;
+      }
+      if (_userUpdate!(words, phonemes, count, replace) != 1) {
+        throw PhonemeException('Failed to update user dictionary: $lastError');
+      }
+    } finally {
+      for (var i = 0; i < filled; i++) {
+        malloc.free(words[i]);
+        if (phonemes[i] != ffi.nullptr) malloc.free(phonemes[i]);
+      }
+      malloc.free(words);
+      malloc.free(phonemes);
+    }
+  }
+
+  /// Add a user word, or change its phoneme (see [updateUserDictionary]).
+  void addUserWord(String word, String phoneme) => updateUserDictionary({word: phoneme});
+
+  /// Remove a user word; the dictionary's own reading applies again.
+  void removeUserWord(String word) => updateUserDictionary({word: null});
+
+  /// Remove all user words.
+  void clearUserDictionary() => updateUserDictionary(const {}, replace: true);
+
+  /// Number of user words (hidden words included), -1 before initialization.
+  int get userWordCount {
+    _checkNotDisposed();
+    return _userCount!();
+  }
+
+  /// Enable the native result cache for repeated texts.
+  ///
+  /// Keeps the phonemes of the last [capacity] distinct inputs (up to 1 KiB
+  /// each), so repeated greetings, UI lines or names are answered with a
+  /// hash lookup. Pass 0 to disable it (the default). The cache is emptied
+  /// when the dictionary changes.
+  ///
+  /// Throws [ArgumentError] if [capacity] is negative.
+  ///
+  /// Example:
+  /// ```dart
+  /// converter.setCacheCapacity(4096);
+  /// ```
+  void setCacheCapacity(int capacity) {
+    _checkNotDisposed();
+    if (capacity < 0) {
+      throw ArgumentError.value(capacity, 'capacity', 'must not be negative');
+    }
+    _setCacheCapacity!(capacity);
+  }
+
+  /// Drop all cached results (capacity and counters are kept).
+  void clearCache() {
+    _checkNotDisposed();
+    _clearCache!();
+  }
+
+  /// Hit/miss counters of the native result cache.
+  CacheStats get cacheStats {
+    _checkNotDisposed();
+    final hits = malloc<ffi.Int64>();
+    final misses = malloc<ffi.Int64>();
+    final entries = malloc<ffi.Int32>();
+    final capacity = malloc<ffi.Int32>();
+    try {
+      _getCacheStats!(hits, misses, entries, capacity);
+      return CacheStats(
+        hits: hits.value,
+        misses: misses.value,
+        entries: entries.value,
+        capacity: capacity.value,
+      );
+    } finally {
+      malloc.free(hits);
+      malloc.free(misses);
+      malloc.free(entries);
+      malloc.free(capacity);
+    }
+  }
+
+  /// Enable or disable native hot-path statistics (off by default).
+  ///
+  /// While enabled, conversions record per-stage times, trie walks and
+  /// token kinds into per-thread counters; read them with [pipelineStats].
+  /// Recording makes conversions somewhat slower, so leave it off in
+  /// production unless you are profiling.
+  void setStatsEnabled(bool enabled) {
+    _checkNotDisposed();
+    _setStatsEnabled!(enabled);
+  }
+
+  /// Counters recorded since the last [resetStats] (summed over all threads).
+  PipelineStats get pipelineStats {
+    _checkNotDisposed();
+    final values = malloc<ffi.Int64>(PipelineStats.counterCount);
+    try {
+      final count = _getStats!(values, PipelineStats.counterCount);
+      return PipelineStats.fromCounters(
+        List<int>.generate(PipelineStats.counterCount, (i) => i < count ? values[i] : 0),
+      );
+    } finally {
+      malloc.free(values);
+    }
+  }
+
+  /// Reset the native statistics counters to zero.
+  void resetStats() {
+    _checkNotDisposed();
+    _resetStats!();
+  }
+
   /// Clean up native resources.
   ///
   /// This should be called when done using the converter.
@@ -418,6 +1186,8 @@ class JapanesePhonemeConverter {
   void dispose() {
     if (_isDisposed) return;
 
+    _pinned?.release();
+    _pinned = null;
     _cleanup?.call();
     _isDisposed = true;
     _isInitialized = false;
@@ -441,3 +1211,90 @@ class JapanesePhonemeConverter {
   }
 }
 
+// ============================================================================
+// Streaming Conversion
+// ============================================================================
+
+/// Output of the stream call in progress (native callbacks run synchronously
+/// inside feed/flush on the calling thread)
+BytesBuilder? _streamOutput;
+
+/// Native stream callback: collect the phonemes of the current call
+void _onStreamOutput(ffi.Pointer<ffi.Uint8> data, int length, ffi.Pointer<ffi.Void> userData) {
+  _streamOutput?.add(data.asTypedList(length));
+}
+
+/// Incremental converter created by [JapanesePhonemeConverter.openStream].
+///
+/// Text can be split anywhere between [add] calls; furigana hints and
+/// dictionary matches that straddle a chunk boundary are converted as if
+/// the text had arrived in one piece. Each line is converted as soon as it
+/// is complete, so a furigana hint only takes its kanji from its own line.
+///
+/// A line longer than 64 KiB is converted in parts before its end, cut once
+/// 4 KiB more of it has arrived, so the parts do not depend on how the text
+/// was split: between two matches (words, with segmentation) that no
+/// furigana hint looks back across, at least the longest dictionary entry
+/// before that point and before an open hint, after punctuation or a space
+/// where there is one. Output only differs from converting the line at once
+/// if it has no such boundary there, or a hint looks back over 4 KiB.
+class PhonemeStream {
+  final JapanesePhonemeConverter _converter;
+  ffi.Pointer<ffi.Void>? _handle;
+
+  PhonemeStream._(this._converter, this._handle);
+
+  /// Whether [close] has been called.
+  bool get isClosed => _handle == null;
+
+  /// Feed the next chunk and return the phonemes it completed (may be empty).
+  ///
+  /// Throws [PhonemeException] if the stream is closed or conversion fails.
+  String add(String chunk) {
+    final handle = _checkOpen();
+    final bytes = utf8.encode(chunk);
+    final dataPtr = malloc<ffi.Uint8>(bytes.isNotEmpty ? bytes.length : 1);
+    try {
+      dataPtr.asTypedList(bytes.length).setAll(0, bytes);
+      return _collect(() => _converter._streamFeed!(handle, dataPtr, bytes.length));
+    } finally {
+      malloc.free(dataPtr);
+    }
+  }
+
+  /// Convert whatever is still pending, release the stream and return the rest.
+  ///
+  /// Calling [close] again returns an empty string.
+  String close() {
+    final handle = _handle;
+    if (handle == null) return '';
+    try {
+      return _collect(() => _converter._streamFlush!(handle));
+    } finally {
+      _converter._streamDestroy!(handle);
+      _handle = null;
+    }
+  }
+
+  /// Run a native stream call and decode what its callbacks produced
+  String _collect(int Function() call) {
+    final output = BytesBuilder(copy: true);
+    _streamOutput = output;
+    try {
+      if (call() < 0) {
+        throw PhonemeException('Stream conversion failed: ${_converter.lastError}');
+      }
+      return utf8.decode(output.takeBytes());
+    } finally {
+      _streamOutput = null;
+    }
+  }
+
+  ffi.Pointer<ffi.Void> _checkOpen() {
+    final handle = _handle;
+    if (handle == null) {
+      throw PhonemeException('Stream has been closed.');
+    }
+    return handle;
+  }
+}
@@ -0,0 +1,160 @@
+import 'dart:ffi' as ffi;
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+
+import 'phoneme_exception.dart';
+
+// ============================================================================
+// FFI Type Definitions
+// ============================================================================
+
+/// Native function: JpnPhonemeContext* jpn_phoneme_context_create()
+typedef _ContextCreateNative = ffi.Pointer<ffi.Void> Function();
+typedef _ContextCreateDart = ffi.Pointer<ffi.Void> Function();
+
+/// Native function: int jpn_phoneme_context_convert(context, text, length, output_buffer,
+///                                                  buffer_size, required_size, processing_time_us)
+typedef _ContextConvertNative = ffi.Int32 Function(
+  ffi.Pointer<ffi.Void> context,
+  ffi.Pointer<ffi.Uint8> text,
+  ffi.Int32 length,
+  ffi.Pointer<ffi.Uint8> outputBuffer,
+  ffi.Int32 bufferSize,
+  ffi.Pointer<ffi.Int32> requiredSize,
+  ffi.Pointer<ffi.Int64> processingTimeUs,
+);
+typedef _ContextConvertDart = int Function(
+  ffi.Pointer<ffi.Void> context,
+  ffi.Pointer<ffi.Uint8> text,
+  int length,
+  ffi.Pointer<ffi.Uint8> outputBuffer,
+  int bufferSize,
+  ffi.Pointer<ffi.Int32> requiredSize,
+  ffi.Pointer<ffi.Int64> processingTimeUs,
+);
+
+/// Native function: void jpn_phoneme_context_destroy(JpnPhonemeContext* context)
+typedef _ContextDestroyNative = ffi.Void Function(ffi.Pointer<ffi.Void> context);
+typedef _ContextDestroyDart = void Function(ffi.Pointer<ffi.Void> context);
+
+/// Native function: const char* jpn_phoneme_get_error()
+typedef _GetErrorNative = ffi.Pointer<Utf8> Function();
+typedef _GetErrorDart = ffi.Pointer<Utf8> Function();
+
+// ============================================================================
+// Native Library
+// ============================================================================
+
+/// Open the native library: [customPath], or the build bundled with the app.
+///
+/// Every isolate that opens it shares the same native state, so a
+/// dictionary initialized on one isolate converts on all of them.
+ffi.DynamicLibrary openPhonemeLibrary(String? customPath) {
+  if (customPath != null) {
+    return ffi.DynamicLibrary.open(customPath);
+  }
+
+  // Load as Flutter FFI plugin (auto-bundled with app)
+  const libName = 'japanese_phoneme_converter';
+
+  if (Platform.isAndroid || Platform.isLinux) {
+    return ffi.DynamicLibrary.open('lib$libName.so');
+  } else if (Platform.isIOS || Platform.isMacOS) {
+    return ffi.DynamicLibrary.process();
+  } else if (Platform.isWindows) {
+    return ffi.DynamicLibrary.open('$libName.dll');
+  } else {
+    throw PhonemeException('Unsupported platform: ${Platform.operatingSystem}');
+  }
+}
+
+/// A native conversion context with pinned input and output buffers.
+///
+/// Created once per isolate and reused for every conversion, so a call
+/// costs one copy of the UTF-8 input into native memory and no allocation
+/// (the buffers only grow when a text or result is larger than any before).
+/// Not for use by more than one isolate.
+class PinnedConverter {
+  /// Returned by the native convert call when the output does not fit
+  static const int _bufferTooSmall = -2;
+
+  final _ContextConvertDart _contextConvert;
+  final _ContextDestroyDart _contextDestroy;
+  final _GetErrorDart _getError;
+  ffi.Pointer<ffi.Void> _context;
+
+  ffi.Pointer<ffi.Uint8> _input;
+  int _inputCapacity;
+  ffi.Pointer<ffi.Uint8> _output;
+  int _outputCapacity;
+  final ffi.Pointer<ffi.Int32> _required = malloc<ffi.Int32>();
+  final ffi.Pointer<ffi.Int64> _time = malloc<ffi.Int64>();
+
+  /// Bind the context functions of [lib] and allocate the buffers.
+  ///
+  /// Throws [PhonemeException] if the native context cannot be created.
+  PinnedConverter(ffi.DynamicLibrary lib, {int bufferSize = 4096})
+      : _contextConvert = lib
+            .lookup<ffi.NativeFunction<_ContextConvertNative>>('jpn_phoneme_context_convert')
+            .asFunction(),
+        _contextDestroy = lib
+            .lookup<ffi.NativeFunction<_ContextDestroyNative>>('jpn_phoneme_context_destroy')
+            .asFunction(),
+        _getError = lib.lookup<ffi.NativeFunction<_GetErrorNative>>('jpn_phoneme_get_error').asFunction(),
+        _context = lib
+            .lookup<ffi.NativeFunction<_ContextCreateNative>>('jpn_phoneme_context_create')
+            .asFunction<_ContextCreateDart>()(),
+        _inputCapacity = bufferSize > 0 ? bufferSize : 1,
+        _outputCapacity = bufferSize > 0 ? bufferSize : 1,
+        _input = ffi.nullptr,
+        _output = ffi.nullptr {
+    if (_context == ffi.nullptr) {
+      malloc.free(_required);
+      malloc.free(_time);
+      throw PhonemeException('Failed to create conversion context: ${_getError().toDartString()}');
+    }
+    _input = malloc<ffi.Uint8>(_inputCapacity);
+    _output = malloc<ffi.Uint8>(_outputCapacity);
+  }
+
+  /// Convert UTF-8 [text] with the dictionary of the native library.
+  ///
+  /// Returns the UTF-8 phonemes as a view of the pinned output buffer,
+  /// valid until the next call, or `null` on failure (see [lastError]).
+  Uint8List? convert(List<int> text) {
+    if (text.length > _inputCapacity) {
+      malloc.free(_input);
+      _inputCapacity = text.length * 2;
+      _input = malloc<ffi.Uint8>(_inputCapacity);
+    }
+    _input.asTypedList(text.length).setAll(0, text);
+
+    var length = _contextConvert(_context, _input, text.length, _output, _outputCapacity, _required, _time);
+    if (length == _bufferTooSmall) {
+      // The context kept the result: fetch it with a buffer of the reported size
+      malloc.free(_output);
+      _outputCapacity = _required.value;
+      _output = malloc<ffi.Uint8>(_outputCapacity);
+      length = _contextConvert(_context, _input, text.length, _output, _outputCapacity, _required, _time);
+    }
+    return length < 0 ? null : _output.asTypedList(length);
+  }
+
+  /// Processing time of the last [convert] call in microseconds.
+  int get processingTimeMicroseconds => _time.value;
+
+  /// Error message of the last failed [convert] call on this isolate.
+  String get lastError => _getError().toDartString();
+
+  /// Free the context and the buffers (the converter cannot be used after).
+  void release() {
+    if (_context == ffi.nullptr) return;
+    _contextDestroy(_context);
+    _context = ffi.nullptr;
+    malloc.free(_input);
+    malloc.free(_output);
+    malloc.free(_required);
+    malloc.free(_time);
+  }
+}
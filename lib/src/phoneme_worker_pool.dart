@@ -0,0 +1,295 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:convert';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+
+import 'package:meta/meta.dart';
+
+import 'native_library.dart';
+import 'phoneme_exception.dart';
+
+/// Converts on background isolates, so the calling isolate (e.g. the
+/// Flutter UI isolate) never waits for a conversion.
+///
+/// The dictionary lives in the native library, which all isolates of the
+/// process share: initialize it once with a [JapanesePhonemeConverter] and
+/// every worker converts with it, nothing is loaded per isolate. Each
+/// worker converts through its own native context and pinned buffers, and
+/// texts and results travel as [TransferableTypedData]: the bytes are
+/// handed over without being serialized, and the worker copies them once
+/// into its native buffer. Conversions run in parallel on multicore devices.
+///
+/// The pool keeps the calling isolate alive until it is closed.
+///
+/// Example:
+/// ```dart
+/// converter.init('assets/ja_phonemes.json');
+/// final pool = await PhonemeWorkerPool.spawn();
+/// print(await pool.convertAsync('こんにちは'));
+/// await pool.close();
+/// ```
+class PhonemeWorkerPool {
+  final List<_Worker> _workers;
+  final ReceivePort _results;
+  final Map<int, Completer<Object>> _pending = {};
+  int _nextId = 0;
+  bool _isClosed = false;
+
+  /// Request kinds understood by the workers
+  static const int _replyString = 0;
+  static const int _replyBytes = 1;
+
+  /// Tag of the exit notice a worker isolate sends to the results port
+  static const String _exited = 'exited';
+
+  PhonemeWorkerPool._(this._workers, this._results) {
+    _results.listen(_onResult);
+  }
+
+  /// Start [workers] isolates (default: one per CPU core but one, at least one).
+  ///
+  /// [libraryPath] must name the library the dictionary was initialized
+  /// with if [JapanesePhonemeConverter] was given one.
+  ///
+  /// Throws [PhonemeException] if a worker cannot load the native library.
+  ///
+  /// A worker that dies (an uncaught error, [Isolate.kill]) fails the
+  /// conversions it had in flight with a [PhonemeException] and leaves the
+  /// pool; the others carry on.
+  static Future<PhonemeWorkerPool> spawn({int? workers, String? libraryPath}) async {
+    final count = workers ?? (Platform.numberOfProcessors > 1 ? Platform.numberOfProcessors - 1 : 1);
+    if (count < 1) {
+      throw ArgumentError.value(workers, 'workers', 'must be at least 1');
+    }
+
+    final results = ReceivePort();
+    final started = <_Worker>[];
+    try {
+      for (var i = 0; i < count; i++) {
+        final handshake = ReceivePort();
+        final errors = ReceivePort();
+        final isolate = await Isolate.spawn(
+          _workerMain,
+          <Object?>[handshake.sendPort, results.sendPort, libraryPath],
+          paused: true,
+        );
+        // The exit notice follows the worker's last result on the same port
+        isolate.addErrorListener(errors.sendPort);
+        isolate.addOnExitListener(results.sendPort, response: <Object>[_exited, i]);
+        isolate.addOnExitListener(handshake.sendPort, response: 'exited during startup');
+        isolate.resume(isolate.pauseCapability!);
+
+        final reply = await handshake.first;
+        if (reply is! SendPort) {
+          isolate.kill();
+          errors.close();
+          throw PhonemeException('Failed to start conversion worker: $reply');
+        }
+        started.add(_Worker(i, isolate, reply, errors));
+      }
+    } on Object {
+      for (final worker in started) {
+        worker.commands.send(null);
+        worker.errors.close();
+      }
+      results.close();
+      rethrow;
+    }
+    return PhonemeWorkerPool._(started, results);
+  }
+
+  /// Number of running worker isolates (workers that died are not counted).
+  int get size => _workers.length;
+
+  /// Whether [close] has been called.
+  bool get isClosed => _isClosed;
+
+  /// Convert [japaneseText] on a worker isolate.
+  ///
+  /// The phonemes are decoded on the worker too; only the finished string
+  /// comes back. Throws [PhonemeException] if the conversion fails (e.g.
+  /// the dictionary is not initialized).
+  Future<String> convertAsync(String japaneseText) async =>
+      await _submit(utf8.encode(japaneseText), _replyString) as String;
+
+  /// Convert UTF-8 [utf8Text] on a worker and return the UTF-8 phonemes.
+  ///
+  /// For pipelines that already hold bytes (files, sockets, audio front
+  /// ends): neither isolate encodes or decodes text, and the result is
+  /// materialized from its [TransferableTypedData] without a copy.
+  Future<Uint8List> convertBytesAsync(Uint8List utf8Text) async {
+    final reply = await _submit(utf8Text, _replyBytes) as TransferableTypedData;
+    return reply.materialize().asUint8List();
+  }
+
+  /// Convert every text of [texts], emitting the results in input order.
+  ///
+  /// Up to [maxInFlight] texts (default: two per worker) are converted at
+  /// once, so the workers stay busy while a slow consumer or producer
+  /// cannot queue up an unbounded amount of work. (Unlike
+  /// [JapanesePhonemeConverter.convertStream], each event is a complete text.)
+  Stream<String> convertStream(Stream<String> texts, {int? maxInFlight}) async* {
+    final limit = maxInFlight ?? (_workers.isEmpty ? 1 : _workers.length * 2);
+    if (limit < 1) {
+      throw ArgumentError.value(maxInFlight, 'maxInFlight', 'must be at least 1');
+    }
+
+    final inFlight = Queue<Future<String>>();
+    await for (final text in texts) {
+      // Errors are delivered where the result is awaited, in order
+      inFlight.add(convertAsync(text)..ignore());
+      if (inFlight.length >= limit) {
+        yield await inFlight.removeFirst();
+      }
+    }
+    while (inFlight.isNotEmpty) {
+      yield await inFlight.removeFirst();
+    }
+  }
+
+  /// Wait for the conversions in flight, then stop the workers.
+  ///
+  /// Close the pool before [JapanesePhonemeConverter.dispose] releases the
+  /// dictionary. Calling [close] again has no effect.
+  Future<void> close() async {
+    if (_isClosed) return;
+    _isClosed = true;
+
+    await Future.wait(_pending.values.map((request) => request.future.then<void>((_) {}, onError: (Object _) {})));
+    for (final worker in _workers) {
+      worker.commands.send(null);
+      worker.errors.close();
+    }
+    _results.close();
+  }
+
+  /// Hand [text] to the least busy worker
+  Future<Object> _submit(List<int> text, int reply) {
+    if (_isClosed) {
+      throw PhonemeException('Worker pool has been closed.');
+    }
+    if (_workers.isEmpty) {
+      throw PhonemeException('No conversion worker is running.');
+    }
+
+    var worker = _workers.first;
+    for (final candidate in _workers) {
+      if (candidate.inFlight < worker.inFlight) worker = candidate;
+    }
+    final id = _nextId++;
+    final request = Completer<Object>();
+    _pending[id] = request;
+    worker.requests.add(id);
+    worker.commands.send(<Object>[
+      id,
+      TransferableTypedData.fromList(<TypedData>[text is Uint8List ? text : Uint8List.fromList(text)]),
+      reply,
+      worker.index,
+    ]);
+    return request.future;
+  }
+
+  /// Complete the request a worker has answered, or drop a worker that exited
+  void _onResult(Object? message) {
+    final reply = message! as List<Object?>;
+    if (reply[0] == _exited) {
+      _onWorkerExit(reply[1]! as int);
+      return;
+    }
+
+    final id = reply[0]! as int;
+    final request = _pending.remove(id);
+    for (final worker in _workers) {
+      if (worker.index == reply[1]) worker.requests.remove(id);
+    }
+    if (reply[2] == true) {
+      request?.completeError(PhonemeException('Conversion failed: ${reply[3]}'));
+    } else {
+      request?.complete(reply[3]!);
+    }
+  }
+
+  /// Fail the conversions of a worker that died and take it out of the pool
+  void _onWorkerExit(int index) {
+    final i = _workers.indexWhere((worker) => worker.index == index);
+    if (i < 0) return;
+    final worker = _workers.removeAt(i);
+    worker.errors.close();
+
+    final reason = worker.lastError ?? 'exited';
+    for (final id in worker.requests) {
+      _pending.remove(id)?.completeError(PhonemeException('Conversion worker $index stopped: $reason'));
+    }
+    worker.requests.clear();
+  }
+}
+
+/// The running worker isolates of [pool].
+///
+/// Lets tests kill a worker ([Isolate.kill]) to check how the pool handles
+/// its death; not exported by the package.
+@visibleForTesting
+List<Isolate> workerIsolates(PhonemeWorkerPool pool) => [for (final worker in pool._workers) worker.isolate];
+
+/// A worker isolate as seen from the pool
+class _Worker {
+  final int index;
+  final Isolate isolate;
+  final SendPort commands;
+
+  /// Uncaught errors of the isolate ([error, stack trace] as strings)
+  final ReceivePort errors;
+
+  /// Ids of the requests handed to this worker and not answered yet
+  final Set<int> requests = <int>{};
+
+  /// Last uncaught error, reported when the worker dies
+  String? lastError;
+
+  _Worker(this.index, this.isolate, this.commands, this.errors) {
+    errors.listen((message) => lastError = '${(message as List<Object?>).first}');
+  }
+
+  int get inFlight => requests.length;
+}
+
+/// Entry point of a worker isolate: [handshake, results, libraryPath]
+///
+/// Answers each request [id, text, reply kind, worker index] on the results
+/// port with [id, worker index, failed, phonemes or error message]; a null
+/// request releases the native context and ends the isolate.
+void _workerMain(List<Object?> args) {
+  final handshake = args[0]! as SendPort;
+  final results = args[1]! as SendPort;
+
+  final PinnedConverter converter;
+  try {
+    converter = PinnedConverter(openPhonemeLibrary(args[2] as String?));
+  } on Object catch (e) {
+    handshake.send('$e');
+    return;
+  }
+
+  final commands = ReceivePort();
+  handshake.send(commands.sendPort);
+  commands.listen((message) {
+    if (message == null) {
+      converter.release();
+      commands.close();
+      return;
+    }
+
+    final request = message as List<Object?>;
+    final text = (request[1]! as TransferableTypedData).materialize().asUint8List();
+    final output = converter.convert(text);
+    if (output == null) {
+      results.send(<Object?>[request[0], request[3], true, converter.lastError]);
+    } else if (request[2] == PhonemeWorkerPool._replyBytes) {
+      results.send(<Object?>[request[0], request[3], false, TransferableTypedData.fromList(<TypedData>[output])]);
+    } else {
+      results.send(<Object?>[request[0], request[3], false, utf8.decode(output)]);
+    }
+  });
+}
@@ -0,0 +1,401 @@
+// Japanese to Phoneme Converter - Benchmark Suite
+// Measures init time and conversion throughput/latency on reproducible corpora
+// Usage: ./jpn_phoneme_bench <ja_phonemes.json> <ja_words.txt> <japanese.trie> [--rounds N] [--no-segmentation]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "jpn_to_phoneme_ffi.h"
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// ALLOCATION COUNTING
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+// Replacing the global operator new in the executable also counts the
+// library's allocations where the dynamic linker resolves them here
+// (ELF, Mach-O). check_allocation_counting() detects when it does not.
+static std::atomic<uint64_t> allocation_count{0};
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * Whether allocations inside the library reach the counting operator new
+ */
+static bool check_allocation_counting() {
+    uint64_t before = allocation_count.load();
+    JpnPhonemeContext* context = jpn_phoneme_context_create();  // One allocation in the library
+    bool counted = allocation_count.load() != before;
+    jpn_phoneme_context_destroy(context);
+    return counted;
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CORPORA (generated, identical on every run)
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+struct Corpus {
+    const char* name;
+    std::vector<std::string> texts;
+};
+
+/**
+ * Fixed-seed LCG (std:: distributions differ between standard libraries)
+ */
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint32_t next(uint32_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>((state >> 33) % bound);
+    }
+};
+
+static void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+static const char* const SHORT_PHRASES[] = {
+    "こんにちは", "ありがとうございます", "おはようございます", "すみません",
+    "今日は暑いですね", "お元気ですか", "はじめまして", "よろしくお願いします",
+    "いただきます", "ごちそうさまでした", "また明日", "おやすみなさい",
+    "行ってきます", "ただいま", "お疲れ様です", "大丈夫ですか",
+    "わかりました", "どういたしまして", "さようなら", "頑張ってください",
+};
+
+static const char* const SENTENCES[] = {
+    "今日は学校に行きました。",
+    "私はリンゴがすきです。",
+    "東京タワーから富士山が見えます。",
+    "昨日の夜、友達と映画を見に行った。",
+    "この本はとても面白かったので、もう一度読みたいと思います。",
+    "電車が遅れたせいで、会議に間に合わなかった。",
+    "日本の四季はそれぞれ美しい景色があります。",
+    "彼女は毎朝六時に起きて、公園を散歩している。",
+    "新しいレストランのラーメンは本当においしかった！",
+    "週末は家族と一緒に温泉旅行に行く予定です。",
+    "子供たちは川で魚を釣ったり、泳いだりして遊んだ。",
+    "駅の近くに大きな図書館が建てられました。",
+};
+
+static const char* const NAMES_WITH_HINTS[] = {
+    "健太「けんた」", "翔「しょう」", "美咲「みさき」", "陽翔「はると」",
+    "結衣「ゆい」", "蓮「れん」", "愛莉「あいり」", "湊「みなと」",
+    "凛「りん」", "悠真「ゆうま」", "陽葵「ひまり」", "大和「やまと」",
+};
+
+static const char* const FURIGANA_TEMPLATES[][3] = {
+    {"", "さんは", "と学校に行きました。"},
+    {"", "は", "にプレゼントをあげた。"},
+    {"昨日、", "と", "が公園で会いました。"},
+    {"", "くんと", "ちゃんは友達です。"},
+};
+
+static const char* const ASCII_LINES[] = {
+    "The quick brown fox jumps over the lazy dog",
+    "Version 2.0.0 released on 2025-10-16 with bug fixes",
+    "GET /api/v1/users?id=42 HTTP/1.1 returned 200 OK",
+    "Press START to continue, or SELECT for options",
+    "https://example.com/docs/getting-started#install",
+    "Score: 98765 points - new high score!",
+};
+
+static const char* const ASCII_JAPANESE[] = {
+    "東京", "レスポンス", "ありがとう", "設定", "ゲーム", "こんにちは",
+};
+
+static Corpus make_short_phrases() {
+    Corpus corpus{"short phrases", {}};
+    for (int repeat = 0; repeat < 10; repeat++) {
+        for (const char* phrase : SHORT_PHRASES) {
+            corpus.texts.emplace_back(phrase);
+        }
+    }
+    return corpus;
+}
+
+static Corpus make_long_paragraphs() {
+    Corpus corpus{"long paragraphs", {}};
+    Random random(1);
+    const size_t sentence_count = sizeof(SENTENCES) / sizeof(SENTENCES[0]);
+    for (int i = 0; i < 40; i++) {
+        std::string paragraph;
+        while (paragraph.size() < 2000) {
+            paragraph += SENTENCES[random.next(sentence_count)];
+        }
+        corpus.texts.push_back(paragraph);
+    }
+    return corpus;
+}
+
+static Corpus make_furigana_heavy() {
+    Corpus corpus{"furigana-heavy", {}};
+    Random random(2);
+    const size_t name_count = sizeof(NAMES_WITH_HINTS) / sizeof(NAMES_WITH_HINTS[0]);
+    const size_t template_count = sizeof(FURIGANA_TEMPLATES) / sizeof(FURIGANA_TEMPLATES[0]);
+    for (int i = 0; i < 200; i++) {
+        const char* const* parts = FURIGANA_TEMPLATES[random.next(template_count)];
+        std::string text = parts[0];
+        text += NAMES_WITH_HINTS[random.next(name_count)];
+        text += parts[1];
+        text += NAMES_WITH_HINTS[random.next(name_count)];
+        text += parts[2];
+        corpus.texts.push_back(text);
+    }
+    return corpus;
+}
+
+static Corpus make_ascii_heavy() {
+    Corpus corpus{"ASCII-heavy", {}};
+    Random random(3);
+    const size_t line_count = sizeof(ASCII_LINES) / sizeof(ASCII_LINES[0]);
+    const size_t word_count = sizeof(ASCII_JAPANESE) / sizeof(ASCII_JAPANESE[0]);
+    for (int i = 0; i < 200; i++) {
+        std::string text = ASCII_LINES[random.next(line_count)];
+        text += ' ';
+        text += ASCII_JAPANESE[random.next(word_count)];
+        text += ' ';
+        text += ASCII_LINES[random.next(line_count)];
+        corpus.texts.push_back(text);
+    }
+    return corpus;
+}
+
+static Corpus make_miss_heavy() {
+    // Code points the dictionary rarely or never has: CJK Extension A,
+    // Hangul syllables and emoji
+    static const uint32_t RANGES[][2] = {
+        {0x3400, 0x4DBF}, {0xAC00, 0xD7A3}, {0x1F300, 0x1F5FF},
+    };
+    Corpus corpus{"dictionary-miss-heavy", {}};
+    Random random(4);
+    for (int i = 0; i < 200; i++) {
+        std::string text;
+        for (int c = 0; c < 40; c++) {
+            const uint32_t* range = RANGES[random.next(3)];
+            append_utf8(text, range[0] + random.next(range[1] - range[0] + 1));
+        }
+        corpus.texts.push_back(text);
+    }
+    return corpus;
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// MEASUREMENT
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static size_t count_code_points(const std::string& text) {
+    size_t count = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) count++;
+    }
+    return count;
+}
+
+/**
+ * Run init() with the library's console output silenced
+ * @return Elapsed milliseconds, or -1 if init failed
+ */
+template <typename Init>
+static double time_init(const char* label, Init&& init) {
+    jpn_phoneme_cleanup();
+    std::cout.setstate(std::ios::failbit);  // The library reports progress on std::cout
+    auto start = Clock::now();
+    bool ok = init();
+    double ms = elapsed_ms(start);
+    std::cout.clear();
+
+    if (!ok) {
+        std::printf("  %-28s FAILED: %s\n", label, jpn_phoneme_get_error());
+        return -1;
+    }
+    std::printf("  %-28s %10.2f ms\n", label, ms);
+    return ms;
+}
+
+static std::vector<uint8_t> read_file(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/**
+ * Convert every text of the corpus `rounds` times (after one warm-up round)
+ * and print throughput, latency percentiles and allocations per call
+ */
+static bool run_corpus(const Corpus& corpus, int rounds, bool count_allocations) {
+    JpnPhonemeContext* context = jpn_phoneme_context_create();
+    std::vector<uint8_t> buffer(64 * 1024);
+    size_t chars_per_round = 0;
+    for (const std::string& text : corpus.texts) {
+        chars_per_round += count_code_points(text);
+    }
+
+    auto convert = [&](const std::string& text) {
+        int32_t required = 0;
+        int written = jpn_phoneme_context_convert(context, text.data(), static_cast<int>(text.size()),
+                                                  buffer.data(), static_cast<int>(buffer.size()), &required, nullptr);
+        if (written == JPN_PHONEME_BUFFER_TOO_SMALL) {
+            buffer.resize(required);
+            written = jpn_phoneme_context_convert(context, text.data(), static_cast<int>(text.size()),
+                                                  buffer.data(), static_cast<int>(buffer.size()), nullptr, nullptr);
+        }
+        return written >= 0;
+    };
+
+    // Warm-up: page in the dictionary and grow the context's buffers
+    for (const std::string& text : corpus.texts) {
+        if (!convert(text)) {
+            std::printf("  %-24s FAILED: %s\n", corpus.name, jpn_phoneme_get_error());
+            jpn_phoneme_context_destroy(context);
+            return false;
+        }
+    }
+
+    std::vector<double> latencies_us;
+    latencies_us.reserve(corpus.texts.size() * rounds);
+    double total_us = 0;
+    uint64_t allocations_before = allocation_count.load();
+    for (int round = 0; round < rounds; round++) {
+        for (const std::string& text : corpus.texts) {
+            auto start = Clock::now();
+            convert(text);
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            latencies_us.push_back(us);
+            total_us += us;
+        }
+    }
+    uint64_t allocations = allocation_count.load() - allocations_before;
+    jpn_phoneme_context_destroy(context);
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&](double p) {
+        size_t index = static_cast<size_t>(p * (latencies_us.size() - 1));
+        return latencies_us[index];
+    };
+    double mchars_per_s = (chars_per_round * static_cast<double>(rounds)) / total_us;  // chars/μs = Mchars/s
+
+    char allocs[32];
+    if (count_allocations) {
+        std::snprintf(allocs, sizeof(allocs), "%.2f", static_cast<double>(allocations) / latencies_us.size());
+    } else {
+        std::snprintf(allocs, sizeof(allocs), "n/a");
+    }
+    std::printf("  %-24s %6zu %9zu %10.2f %9.2f %9.2f %9s\n", corpus.name, corpus.texts.size(),
+                chars_per_round, mchars_per_s, percentile(0.50), percentile(0.99), allocs);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <ja_phonemes.json> <ja_words.txt> <japanese.trie> [--rounds N] [--no-segmentation]" << std::endl;
+        return 1;
+    }
+
+    const char* json_path = argv[1];
+    const char* word_path = argv[2];
+    const char* trie_path = argv[3];
+    int rounds = 20;
+    bool segmentation = true;
+    for (int i = 4; i < argc; i++) {
+        if (std::strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--no-segmentation") == 0) {
+            segmentation = false;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::printf("Japanese Phoneme Converter v%s - benchmark\n\n", jpn_phoneme_version());
+
+    // jpn_phoneme_init() takes the JSON path and prefers the .trie next to it
+    std::string trie_str(trie_path);
+    size_t dot = trie_str.rfind('.');
+    std::string trie_as_json = (dot == std::string::npos ? trie_str : trie_str.substr(0, dot)) + ".json";
+    std::vector<uint8_t> trie_data = read_file(trie_path);
+
+    std::printf("Init time:\n");
+    bool ok = true;
+    ok &= time_init("JSON + word list", [&] {
+        return jpn_phoneme_init(json_path) == 1 && jpn_phoneme_init_word_dict(word_path) == 1;
+    }) >= 0;
+    ok &= time_init("trie file (mmap)", [&] {
+        return jpn_phoneme_init(trie_as_json.c_str()) == 1;
+    }) >= 0;
+    ok &= time_init("memory (copy)", [&] {
+        return jpn_phoneme_init_from_memory(trie_data.data(), static_cast<int>(trie_data.size())) == 1;
+    }) >= 0;
+    ok &= time_init("memory (borrowed)", [&] {
+        return jpn_phoneme_init_from_memory_borrowed(trie_data.data(), static_cast<int>(trie_data.size())) == 1;
+    }) >= 0;
+    if (!ok) {
+        return 1;
+    }
+
+    // Conversion runs on the borrowed packed trie (the production setup)
+    jpn_phoneme_set_use_segmentation(segmentation);
+    bool count_allocations = check_allocation_counting();
+
+    std::printf("\nConversion (%d rounds, segmentation %s):\n", rounds, segmentation ? "on" : "off");
+    std::printf("  %-24s %6s %9s %10s %9s %9s %9s\n", "corpus", "texts", "chars", "Mchars/s", "p50 us", "p99 us", "allocs");
+
+    const Corpus corpora[] = {
+        make_short_phrases(),
+        make_long_paragraphs(),
+        make_furigana_heavy(),
+        make_ascii_heavy(),
+        make_miss_heavy(),
+    };
+    for (const Corpus& corpus : corpora) {
+        ok &= run_corpus(corpus, rounds, count_allocations);
+    }
+
+    jpn_phoneme_cleanup();
+    return ok ? 0 : 1;
+}
@@ -6,16 +6,28 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <map>
+#include <algorithm>
 #include <vector>
 #include <chrono>
 #include <memory>
 #include <sstream>
 #include <iomanip>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
+#include <deque>
+#include <list>
+#include <atomic>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <array>
+#include <bitset>
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 // CONFIGURATION
@@ -28,6 +40,8 @@ const bool USE_WORD_SEGMENTATION = true;
 // Windows-specific includes for UTF-8 console support
 #ifdef _WIN32
     #include <windows.h>
+    #include <io.h>     // _setmode() for binary stdin/stdout in batch mode
+    #include <fcntl.h>
 #endif
 
 // Binary trie support (memory-mapped files)
@@ -42,6 +56,42 @@ const bool USE_WORD_SEGMENTATION = true;
     #include <unistd.h>
 #endif
 
+// File times (the snapshot cache's verification stamp)
+#ifdef _WIN32
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/utime.h>
+#else
+    #include <utime.h>
+#endif
+
+// SIMD support for the UTF-8 decoder's ASCII fast path
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define JPN_UTF8_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define JPN_UTF8_NEON 1
+#endif
+
+// Software prefetch (a hint: no-op where the compiler has none)
+#if defined(__GNUC__) || defined(__clang__)
+    #define JPN_PREFETCH(address) __builtin_prefetch((address), 0, 3)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <xmmintrin.h>
+    #define JPN_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+    #define JPN_PREFETCH(address) ((void)(address))
+#endif
+
+// Server memory placement (cmake -DJPN_HUGE_PAGES=ON): pre-fault mapped
+// dictionaries and back the large arenas with transparent huge pages
+#if defined(JPN_PHONEME_HUGE_PAGES) && defined(__linux__)
+    #define JPN_MAP_FLAGS (MAP_PRIVATE | MAP_POPULATE)
+#elif !defined(_WIN32)
+    #define JPN_MAP_FLAGS MAP_PRIVATE
+#endif
+
 // Check for optional support (C++17)
 #if __cplusplus >= 201703L && __has_include(<optional>)
     #include <optional>
@@ -92,28 +142,173 @@ const bool USE_WORD_SEGMENTATION = true;
     };
 #endif
 
-// JSON parsing - simple implementation for our use case
-#include <regex>
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// KANA TABLES
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Compile-time tables for the kana blocks (U+3040-U+30FF)
+ * 
+ * Hiragana and katakana are most of the input, so they are looked up by
+ * index instead of by range checks, string compares or a search over the
+ * thousands of first characters at the trie root: both tries keep a dense
+ * copy of their root's kana children (root_child()), and words that read
+ * differently on their own than inside a dictionary entry are a table
+ * entry as well.
+ */
+namespace Kana {
+    constexpr uint32_t FIRST = 0x3040;  // Start of the hiragana block
+    constexpr uint32_t LAST = 0x30FF;   // End of the katakana block
+    constexpr size_t COUNT = LAST - FIRST + 1;
+    
+    /**
+     * Check if a code point is hiragana or katakana
+     */
+    constexpr bool contains(uint32_t code_point) {
+        return code_point - FIRST < COUNT;  // Unsigned: below FIRST wraps around
+    }
+    
+    constexpr std::array<std::string_view, COUNT> make_word_readings() {
+        std::array<std::string_view, COUNT> readings{};
+        readings[0x306F - FIRST] = "wa";  // Topic particle は
+        return readings;
+    }
+    
+    /** @brief Reading of a one-kana word when it differs from the dictionary's */
+    constexpr std::array<std::string_view, COUNT> WORD_READINGS = make_word_readings();
+    
+    /**
+     * Reading of a segmented word that is the single code point cp
+     * @return The reading, or an empty view if the dictionary's applies
+     */
+    constexpr std::string_view word_reading(uint32_t code_point) {
+        return contains(code_point) ? WORD_READINGS[code_point - FIRST] : std::string_view();
+    }
+}
+
+/**
+ * Minimal kana dictionary served while the full one loads in the background
+ * 
+ * The single kana and kana digraphs of ja_phonemes.json with the
+ * dictionary's own readings, so every kana reads as it does on its own in
+ * the full dictionary (words and kanji need the full one). Building it is
+ * a few hundred inserts.
+ */
+namespace KanaCore {
+    struct Entry {
+        const char* kana;
+        const char* phoneme;
+    };
+    
+    constexpr Entry ENTRIES[] = {
+        // Hiragana
+        {"ぁ", "a"}, {"あ", "a"}, {"ぃ", "i"}, {"い", "i"}, {"ぅ", "ɯ"}, {"う", "ɯ"}, {"ぇ", "e"},
+        {"え", "e"}, {"ぉ", "o"}, {"お", "o"}, {"か", "ka"}, {"が", "ga"}, {"き", "ki"}, {"ぎ", "gi"},
+        {"く", "kɯ"}, {"ぐ", "gɯ"}, {"け", "ke"}, {"けぇ", "kee"}, {"げ", "ge"}, {"こ", "ko"}, {"ご", "go"},
+        {"さ", "sa"}, {"ざ", "za"}, {"し", "ɕi"}, {"じ", "ʥi"}, {"じゃ", "ʥa"}, {"す", "sɯ"}, {"ず", "zɯ"},
+        {"せ", "se"}, {"ぜ", "ze"}, {"そ", "so"}, {"ぞ", "zo"}, {"た", "ta"}, {"だ", "da"}, {"ち", "ʨi"},
+        {"ちぇ", "ʨie"}, {"ちゃ", "ʨa"}, {"ちょ", "ʨo"}, {"ぢ", "ʥi"}, {"っ", "ʔ"}, {"つ", "ʦɯ"},
+        {"づ", "zɯ"}, {"て", "te"}, {"で", "de"}, {"と", "to"}, {"ど", "do"}, {"な", "na"}, {"に", "ni"},
+        {"にゃ", "nja"}, {"ぬ", "nɯ"}, {"ね", "ne"}, {"の", "no"}, {"は", "ha"}, {"ば", "ba"}, {"ぱ", "pa"},
+        {"ひ", "çi"}, {"び", "bi"}, {"ぴ", "pi"}, {"ふ", "ɸɯ"}, {"ぶ", "bɯ"}, {"ぷ", "pɯ"}, {"へ", "he"},
+        {"べ", "be"}, {"ぺ", "pe"}, {"ほ", "ho"}, {"ぼ", "bo"}, {"ぽ", "po"}, {"ま", "ma"}, {"み", "mi"},
+        {"む", "mɯ"}, {"め", "me"}, {"も", "mo"}, {"ゃ", "ja"}, {"や", "ja"}, {"ゅ", "jɯ"}, {"ゆ", "jɯ"},
+        {"ょ", "jo"}, {"よ", "jo"}, {"ら", "ɾa"}, {"り", "ɾi"}, {"る", "ɾɯ"}, {"れ", "ɾe"}, {"ろ", "ɾo"},
+        {"ゎ", "ɰa"}, {"わ", "ɰᵝa"}, {"ゐ", "ɰᵝi"}, {"ゑ", "ɰᵝe"}, {"を", "o"}, {"ん", "ɴ"}, {"ゔ", "vɯ"},
+        // Katakana
+        {"ァ", "a"}, {"ア", "a"}, {"ィ", "i"}, {"イ", "i"}, {"ゥ", "ɯ"}, {"ウ", "ɯ"}, {"ウィ", "ɯi"},
+        {"ェ", "e"}, {"エ", "e"}, {"ォ", "o"}, {"オ", "o"}, {"カ", "ka"}, {"ガ", "ga"}, {"キ", "ki"},
+        {"ギ", "gi"}, {"ク", "kɯ"}, {"グ", "gɯ"}, {"ケ", "ke"}, {"ゲ", "ge"}, {"コ", "ko"}, {"ゴ", "go"},
+        {"サ", "sa"}, {"ザ", "za"}, {"シ", "ɕi"}, {"ジ", "ʥi"}, {"ス", "sɯ"}, {"ズ", "zɯ"}, {"セ", "se"},
+        {"ゼ", "ze"}, {"ソ", "so"}, {"ゾ", "zo"}, {"タ", "ta"}, {"ダ", "da"}, {"チ", "ʨi"}, {"チェ", "ʨe"},
+        {"ヂ", "ʥi"}, {"ッ", "ʔ"}, {"ツ", "ʦɯ"}, {"ヅ", "zɯ"}, {"テ", "te"}, {"ティ", "tei"}, {"デ", "de"},
+        {"ディ", "dei"}, {"ト", "to"}, {"ド", "do"}, {"ナ", "na"}, {"ニ", "ni"}, {"ヌ", "nɯ"}, {"ネ", "ne"},
+        {"ノ", "no"}, {"ハ", "ha"}, {"バ", "ba"}, {"パ", "pa"}, {"ヒ", "çi"}, {"ビ", "bi"}, {"ピ", "pi"},
+        {"フ", "ɸɯ"}, {"ファ", "ɸa"}, {"ブ", "bɯ"}, {"プ", "pɯ"}, {"ヘ", "he"}, {"ベ", "be"}, {"ペ", "pe"},
+        {"ホ", "ho"}, {"ボ", "bo"}, {"ポ", "po"}, {"マ", "ma"}, {"ミ", "mi"}, {"ム", "mɯ"}, {"メ", "me"},
+        {"モ", "mo"}, {"ャ", "ja"}, {"ヤ", "ja"}, {"ュ", "jɯ"}, {"ユ", "jɯ"}, {"ョ", "jo"}, {"ヨ", "jo"},
+        {"ラ", "ɾa"}, {"リ", "ɾi"}, {"ル", "ɾɯ"}, {"レ", "ɾe"}, {"ロ", "ɾo"}, {"ヮ", "ɰa"}, {"ワ", "ɰa"},
+        {"ヰ", "ɰᵝi"}, {"ヱ", "ɰᵝe"}, {"ヲ", "o"}, {"ン", "ɴ"}, {"ヴ", "vɯ"}, {"ヵ", "ka"}, {"ヶ", "ke"},
+        {"ヷ", "va"}, {"ヸ", "vi"}, {"ヹ", "ve"}, {"ヺ", "vo"},
+    };
+}
+
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 // BINARY TRIE FORMAT STRUCTURES
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * Binary trie file header (24 bytes)
+ * Binary trie file header (32 bytes)
  * See TRIE_FORMAT.md for full specification
  */
 #pragma pack(push, 1)
 struct BinaryTrieHeader {
     char magic[4];           // "JPNT"
-    uint16_t version_major;  // Currently 1
-    uint16_t version_minor;  // Currently 0
+    uint16_t version_major;  // Currently 2
+    uint16_t version_minor;  // Currently 1
     uint32_t phoneme_count;  // Number of phoneme entries
     uint32_t word_count;     // Number of word entries
     uint64_t root_offset;    // Byte offset to root node
+    uint64_t values_offset;  // Byte offset to value pool
+};
+
+/**
+ * Compiled word list header (16 bytes), followed by the front-coded words
+ * See TRIE_FORMAT.md for full specification
+ */
+struct WordListHeader {
+    char magic[4];           // "JPNW"
+    uint16_t version_major;  // Currently 1
+    uint16_t version_minor;  // Currently 0
+    uint32_t word_count;     // Number of words (sorted, unique)
+    uint32_t reserved;       // 0
 };
 #pragma pack(pop)
 
+/**
+ * Node flag bits of the packed v2 format
+ */
+namespace BinaryTrieFlags {
+    const uint8_t HAS_VALUE     = 0x01;  // Node carries a phoneme value
+    const uint8_t IS_WORD       = 0x02;  // Node ends a segmentation word
+    const uint8_t COUNT_SHIFT   = 2;     // Inline children count in bits 2-6
+    const uint8_t COUNT_MASK    = 0x1F;  // Up to 31 children inline
+    const uint8_t VARINT_COUNT  = 0x80;  // Children count follows as varint
+    const size_t  CHILD_ENTRY   = 7;     // 3-byte code point + 4-byte offset
+    const size_t  OUTPUT_ENTRY  = 10;    // ... + 3-byte output reference (v3 automaton)
+    const uint32_t CODE_POINT_MASK = 0x1FFFFF;  // Code point bits of a child entry
+    const uint32_t WORD_BELOW   = 0x800000;  // First child entry: a word ends at or below the node (minor >= 1)
+    const uint16_t TRIE_VERSION      = 2;  // Packed trie
+    const uint16_t AUTOMATON_VERSION = 3;  // Minimised automaton with outputs on transitions
+    const uint16_t FORMAT_MINOR      = 1;  // Written minor version (1: WORD_BELOW is set)
+}
+
+/**
+ * Ask the kernel to back data[0, size) with transparent huge pages
+ * 
+ * Lookups are chains of dependent loads spread over megabytes of nodes, so
+ * with 4KB pages most of them also miss the TLB; one 2MB page covers 512
+ * times as much. Only whole huge pages inside the range are advised, and
+ * only memory faulted in afterwards is allocated huge right away (advise
+ * before filling). No-op unless built with JPN_PHONEME_HUGE_PAGES on Linux;
+ * file mappings only benefit where the kernel supports huge pages for the
+ * page cache.
+ */
+inline void advise_huge_pages(const void* data, size_t size) {
+#if defined(JPN_PHONEME_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+    const uintptr_t HUGE_PAGE = uintptr_t(2) << 20;
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(HUGE_PAGE - 1);
+    if (begin < end) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);  // Best effort
+    }
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+
 /**
  * Memory-mapped file wrapper for cross-platform support
  */
@@ -215,13 +410,14 @@ public:
             }
             file_size = sb.st_size;
             
-            mapped_data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+            mapped_data = mmap(NULL, file_size, PROT_READ, JPN_MAP_FLAGS, file_descriptor, 0);
             if (mapped_data == MAP_FAILED) {
                 ::close(file_descriptor);
                 file_descriptor = -1;
                 mapped_data = nullptr;
                 return false;
             }
+            advise_huge_pages(mapped_data, file_size);
         #endif
         
         return true;
@@ -294,133 +490,172 @@ inline uint32_t read_varint(const uint8_t*& ptr) {
     return value;
 }
 
+/**
+ * Read a varint that must end before end (untrusted data)
+ * @return false if it is truncated or longer than 32 bits
+ */
+inline bool read_varint_checked(const uint8_t*& ptr, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (ptr == end) return false;
+        uint8_t byte = *ptr++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
 /**
  * Binary trie node reader (VERSION 2.0 - OPTIMIZED FORMAT)
  * Zero-copy access to memory-mapped trie nodes
  * 
- * Format changes in v2.0:
- * - Varints for lengths/counts
- * - 4-byte relative offsets (not 8-byte absolute)
- * - 3-byte code points + 4-byte offset = 7 bytes per child (not 12)
- * - Packed flags byte
+ * Node layout:
+ * - Packed flags byte (value / word bits + inline children count)
+ * - Varint children count (only when count does not fit in the flags)
+ * - Varint value offset into the value pool (only when HAS_VALUE is set)
+ * - Children table sorted by code point:
+ *   3-byte code point + 4-byte relative offset = 7 bytes per child
+ *   (the first entry's code point also carries the WORD_BELOW bit)
+ * 
+ * The v3 minimised automaton uses the same nodes with a 3-byte output
+ * reference appended to every child entry (ChildEntry = 10); its node
+ * value is only the tail of the phoneme left after those outputs.
+ * 
+ * Nodes are plain pointers into the mapping, so copying a node is free
+ * and walking the trie never allocates.
  */
-class BinaryTrieNode {
+template <size_t ChildEntry>
+class PackedTrieNode {
 private:
-    const uint8_t* node_data;
-    void* file_base;
-    uint16_t format_version;  // 1 or 2
-    
-public:
-    BinaryTrieNode(const void* data, void* base, uint16_t version = 2) 
-        : node_data(static_cast<const uint8_t*>(data)), file_base(base), format_version(version) {}
+    const uint8_t* node_data;    // nullptr means "no such node"
+    const uint8_t* values_base;  // Start of the value pool
     
     /**
-     * Check if this node has a value
+     * Read a length-prefixed string of the value pool
      */
-    bool has_value() const {
-        return (node_data[0] & 0x01) != 0;
+    std::string_view pool_string(uint32_t offset) const {
+        const uint8_t* value_ptr = values_base + offset;
+        uint32_t len = read_varint(value_ptr);
+        return std::string_view(reinterpret_cast<const char*>(value_ptr), len);
     }
     
     /**
-     * Get value length and pointer to value data
-     * Returns pair of (value_length, offset_after_flags_and_count)
+     * Children table of the node and its number of entries
      */
-    std::pair<uint32_t, size_t> get_value_info() const {
+    const uint8_t* children(uint32_t& count) const {
         const uint8_t* ptr = node_data;
         uint8_t flags = *ptr++;
         
-        // Handle children count in flags or varint
-        uint32_t children_count = 0;
-        if (flags & 0x80) {
-            // Children count is varint
-            children_count = read_varint(ptr);
+        if (flags & BinaryTrieFlags::VARINT_COUNT) {
+            count = read_varint(ptr);
         } else {
-            // Children count in flags bits 1-7
-            children_count = (flags >> 1) & 0x7F;
+            count = (flags >> BinaryTrieFlags::COUNT_SHIFT) & BinaryTrieFlags::COUNT_MASK;
         }
         
-        // Now read value if present
-        if (flags & 0x01) {
-            uint32_t value_len = read_varint(ptr);
-            return {value_len, ptr - node_data};
+        // Skip value reference if present
+        if (flags & BinaryTrieFlags::HAS_VALUE) {
+            read_varint(ptr);
         }
-        
-        return {0, ptr - node_data};
+        return ptr;  // ChildEntry bytes per entry
     }
     
+public:
+    static constexpr bool HAS_EDGE_OUTPUTS = ChildEntry == BinaryTrieFlags::OUTPUT_ENTRY;
+    static constexpr size_t ENTRY_SIZE = ChildEntry;
+    
+    PackedTrieNode() : node_data(nullptr), values_base(nullptr) {}
+    
+    PackedTrieNode(const uint8_t* data, const uint8_t* values) 
+        : node_data(data), values_base(values) {}
+    
     /**
-     * Get value string
+     * Check if this handle points at a node
      */
-    std::string get_value() const {
-        auto info = get_value_info();
-        uint32_t len = info.first;
-        size_t offset = info.second;
-        if (len == 0) return "";
-        const char* value_ptr = reinterpret_cast<const char*>(node_data + offset);
-        return std::string(value_ptr, len);
+    bool is_valid() const {
+        return node_data != nullptr;
     }
     
     /**
-     * Get number of children
+     * Position of the node in the mapping (NULL if invalid)
      */
-    uint32_t get_children_count() const {
-        uint8_t flags = node_data[0];
-        if (flags & 0x80) {
-            // Children count is varint
-            const uint8_t* ptr = node_data + 1;
-            return read_varint(ptr);
-        } else {
-            // Children count in flags bits 1-7
-            return (flags >> 1) & 0x7F;
-        }
+    const uint8_t* data() const {
+        return node_data;
     }
     
     /**
-     * Find child node by code point (binary search)
-     * Returns nullptr if not found
+     * Check if this node has a value
      */
-    BinaryTrieNode* find_child(uint32_t code_point) const {
-        uint32_t count = get_children_count();
-        if (count == 0) return nullptr;
-        
-        // Calculate where children table starts
+    bool has_value() const {
+        return (node_data[0] & BinaryTrieFlags::HAS_VALUE) != 0;
+    }
+    
+    /**
+     * Check if this node ends a word of the segmentation dictionary
+     */
+    bool is_word() const {
+        return (node_data[0] & BinaryTrieFlags::IS_WORD) != 0;
+    }
+    
+    /**
+     * Check if a word ends at this node or below it (tries of minor version >= 1)
+     */
+    bool leads_to_word() const {
+        uint32_t count;
+        const uint8_t* children_table = children(count);
+        return is_word() || (count > 0 && (children_table[2] & (BinaryTrieFlags::WORD_BELOW >> 16)) != 0);
+    }
+    
+    /**
+     * Get value string (view into the mapped value pool)
+     */
+    std::string_view get_value() const {
         const uint8_t* ptr = node_data;
         uint8_t flags = *ptr++;
+        if (!(flags & BinaryTrieFlags::HAS_VALUE)) return std::string_view();
         
-        // Skip children count
-        if (flags & 0x80) {
+        if (flags & BinaryTrieFlags::VARINT_COUNT) {
             read_varint(ptr);  // Skip varint count
         }
         
-        // Skip value if present
-        if (flags & 0x01) {
-            uint32_t value_len = read_varint(ptr);
-            ptr += value_len;
+        return pool_string(read_varint(ptr));
+    }
+    
+    /**
+     * Get number of children
+     */
+    uint32_t get_children_count() const {
+        uint8_t flags = node_data[0];
+        if (flags & BinaryTrieFlags::VARINT_COUNT) {
+            const uint8_t* ptr = node_data + 1;
+            return read_varint(ptr);
         }
-        
-        // Now at children table (7 bytes per entry)
-        const uint8_t* children_table = ptr;
+        return (flags >> BinaryTrieFlags::COUNT_SHIFT) & BinaryTrieFlags::COUNT_MASK;
+    }
+    
+    /**
+     * Find the children table entry of a code point (binary search)
+     * Returns NULL if there is no such child
+     */
+    const uint8_t* find_entry(uint32_t code_point) const {
+        uint32_t count;
+        const uint8_t* children_table = children(count);
+        if (count == 0) return nullptr;
         
         // Binary search
         int left = 0;
-        int right = count - 1;
+        int right = static_cast<int>(count) - 1;
         
         while (left <= right) {
             int mid = (left + right) / 2;
-            const uint8_t* entry = children_table + (mid * 7);
+            const uint8_t* entry = children_table + (mid * ChildEntry);
             
-            // Read 3-byte code point
-            uint32_t entry_cp = entry[0] | (entry[1] << 8) | (entry[2] << 16);
+            // Read 3-byte code point (without the WORD_BELOW bit)
+            uint32_t entry_cp;
+            std::memcpy(&entry_cp, entry, sizeof(entry_cp));  // Code point + first offset byte
+            entry_cp &= BinaryTrieFlags::CODE_POINT_MASK;
             
             if (entry_cp == code_point) {
-                // Found it! Read 4-byte relative offset
-                int32_t relative_offset = *reinterpret_cast<const int32_t*>(entry + 3);
-                
-                // Calculate absolute position (relative to END of this entry)
-                const uint8_t* entry_end = entry + 7;
-                const uint8_t* child_data = entry_end + relative_offset;
-                
-                return new BinaryTrieNode(child_data, file_base, format_version);
+                return entry;
             } else if (entry_cp < code_point) {
                 left = mid + 1;
             } else {
@@ -430,1864 +665,8225 @@ public:
         
         return nullptr;
     }
-};
-
-/**
- * High-performance trie node for phoneme lookup
- * Uses unordered_map for O(1) character code access
- */
-class TrieNode {
-public:
-    // Map character codes to child nodes for instant lookup
-    std::unordered_map<uint32_t, std::unique_ptr<TrieNode>> children;
     
-    // Phoneme value if this node represents end of a word
-    Optional<std::string> phoneme;
-};
-
-/**
- * Individual match from Japanese text to phoneme
- */
-struct Match {
-    std::string original;
-    std::string phoneme;
-    size_t start_index;
+    /**
+     * Start loading the children table where find_entry() probes first
+     */
+    void prefetch_children() const {
+        uint32_t count;
+        const uint8_t* children_table = children(count);
+        JPN_PREFETCH(children_table + (count > 0 ? (count - 1) / 2 * ChildEntry : 0));
+    }
     
-    std::string to_string() const {
-        return "\"" + original + "\" → \"" + phoneme + "\" (pos: " + std::to_string(start_index) + ")";
+    /**
+     * Node a children table entry points to
+     */
+    PackedTrieNode entry_target(const uint8_t* entry) const {
+        // Read 4-byte relative offset (unaligned-safe), relative to the END of the entry
+        int32_t relative_offset;
+        std::memcpy(&relative_offset, entry + 3, sizeof(relative_offset));
+        return PackedTrieNode(entry + ChildEntry + relative_offset, values_base);
     }
-};
-
-/**
- * Detailed conversion result with match information
- */
-struct ConversionResult {
-    std::string phonemes;
-    std::vector<Match> matches;
-    std::vector<std::string> unmatched;
-};
-
-/**
- * Ultra-fast phoneme converter using trie data structure
- * Achieves microsecond-level lookups for typical text
- */
-class PhonemeConverter {
-private:
-    std::unique_ptr<TrieNode> root;
-    size_t entry_count;
     
-    // Helper to extract UTF-8 code point from string
-    uint32_t get_code_point(const std::string& str, size_t& pos) const {
-        unsigned char c = str[pos];
-        
-        if (c < 0x80) {
-            pos++;
-            return c;
-        } else if ((c & 0xE0) == 0xC0) {
-            uint32_t cp = ((c & 0x1F) << 6) | (str[pos + 1] & 0x3F);
-            pos += 2;
-            return cp;
-        } else if ((c & 0xF0) == 0xE0) {
-            uint32_t cp = ((c & 0x0F) << 12) | ((str[pos + 1] & 0x3F) << 6) | (str[pos + 2] & 0x3F);
-            pos += 3;
-            return cp;
-        } else if ((c & 0xF8) == 0xF0) {
-            uint32_t cp = ((c & 0x07) << 18) | ((str[pos + 1] & 0x3F) << 12) | 
-                         ((str[pos + 2] & 0x3F) << 6) | (str[pos + 3] & 0x3F);
-            pos += 4;
-            return cp;
-        }
-        
-        pos++;
-        return c;
+    /**
+     * Output of the transition of a children table entry (v3 automaton only)
+     */
+    std::string_view entry_output(const uint8_t* entry) const {
+        static_assert(HAS_EDGE_OUTPUTS, "Only automaton transitions carry outputs");
+        return pool_string(entry[7] | (entry[8] << 8) | (entry[9] << 16));
     }
     
-    // Helper to get character at UTF-8 position
-    std::pair<std::string, uint32_t> get_char_at(const std::string& str, size_t& byte_pos) const {
-        size_t start = byte_pos;
-        uint32_t cp = get_code_point(str, byte_pos);
-        return {str.substr(start, byte_pos - start), cp};
+    /**
+     * Find child node by code point (binary search)
+     * Returns an invalid node if not found
+     */
+    PackedTrieNode find_child(uint32_t code_point) const {
+        const uint8_t* entry = find_entry(code_point);
+        return entry ? entry_target(entry) : PackedTrieNode();
     }
     
-    // Simple JSON parser for our specific format
-    std::unordered_map<std::string, std::string> parse_json(const std::string& json_str) {
-        std::unordered_map<std::string, std::string> result;
-        
-        // Remove outer braces and whitespace
-        size_t start = json_str.find('{');
-        size_t end = json_str.rfind('}');
-        if (start == std::string::npos || end == std::string::npos) return result;
+    /**
+     * Visit every child as (code point, node, transition output) in code
+     * point order (the output is always empty in a v2 trie)
+     */
+    template <typename Visitor>
+    void for_each_child(Visitor&& visit) const {
+        const uint8_t* ptr = node_data;
+        uint8_t flags = *ptr++;
         
-        std::string content = json_str.substr(start + 1, end - start - 1);
+        uint32_t count;
+        if (flags & BinaryTrieFlags::VARINT_COUNT) {
+            count = read_varint(ptr);
+        } else {
+            count = (flags >> BinaryTrieFlags::COUNT_SHIFT) & BinaryTrieFlags::COUNT_MASK;
+        }
+        if (flags & BinaryTrieFlags::HAS_VALUE) {
+            read_varint(ptr);
+        }
         
-        // Parse key-value pairs
-        size_t pos = 0;
-        while (pos < content.length()) {
-            // Find key
-            size_t key_start = content.find('"', pos);
-            if (key_start == std::string::npos) break;
-            key_start++;
-            
-            size_t key_end = key_start;
-            while (key_end < content.length() && content[key_end] != '"') {
-                if (content[key_end] == '\\') key_end++;
-                key_end++;
-            }
-            if (key_end >= content.length()) break;
-            
-            std::string key = content.substr(key_start, key_end - key_start);
-            
-            // Find value
-            size_t value_start = content.find('"', key_end + 1);
-            if (value_start == std::string::npos) break;
-            value_start++;
-            
-            size_t value_end = value_start;
-            while (value_end < content.length() && content[value_end] != '"') {
-                if (content[value_end] == '\\') value_end++;
-                value_end++;
+        for (uint32_t i = 0; i < count; i++, ptr += ChildEntry) {
+            uint32_t code_point = (ptr[0] | (ptr[1] << 8) | (ptr[2] << 16)) & BinaryTrieFlags::CODE_POINT_MASK;
+            std::string_view output;
+            if constexpr (HAS_EDGE_OUTPUTS) {
+                output = entry_output(ptr);
             }
-            if (value_end >= content.length()) break;
-            
-            std::string value = content.substr(value_start, value_end - value_start);
-            
-            result[key] = value;
-            pos = value_end + 1;
+            visit(code_point, entry_target(ptr), output);
         }
-        
-        return result;
     }
+};
+
+typedef PackedTrieNode<BinaryTrieFlags::CHILD_ENTRY> BinaryTrieNode;
+typedef PackedTrieNode<BinaryTrieFlags::OUTPUT_ENTRY> AutomatonNode;
 
+/**
+ * Zero-copy view over a packed ("JPNT") trie
+ * The file is memory-mapped and walked in place. Opening it runs one
+ * validation pass over every node (validate(), reading the whole data
+ * once; about 15 ms for the bundled dictionary), skipped only for trusted
+ * data such as a snapshot whose checksum was just compared.
+ * 
+ * BinaryTrie reads v2 tries; BinaryAutomaton reads v3 minimised automata,
+ * whose phonemes are concatenated from the transitions (append_output()).
+ */
+template <typename Node>
+class PackedTrie {
+private:
+    MemoryMappedFile file;
+    std::vector<uint8_t> owned_copy;  // Backing store when opened from a copied buffer
+    std::shared_ptr<const uint8_t> borrowed;  // Caller's buffer when borrowed (released with the view)
+    const uint8_t* base;
+    size_t data_size;
+    BinaryTrieHeader header;
+    
+    // Root children for the kana block, indexed by code point (NULL = none);
+    // the automaton keeps their table entries, which also hold the outputs
+    std::array<const uint8_t*, Kana::COUNT> kana_roots{};
+    std::array<const uint8_t*, Kana::COUNT> kana_entries{};
+    
 public:
-    PhonemeConverter() : root(std::make_unique<TrieNode>()), entry_count(0) {}
+    // A node's children table follows its header (one prefetch covers both)
+    static constexpr bool SEPARATE_CHILDREN = false;
+    
+    static constexpr uint16_t VERSION = Node::HAS_EDGE_OUTPUTS ? BinaryTrieFlags::AUTOMATON_VERSION
+                                                                : BinaryTrieFlags::TRIE_VERSION;
+    
+    PackedTrie() : base(nullptr), data_size(0) {
+        std::memset(&header, 0, sizeof(header));
+    }
     
     /**
-     * Get root node for trie walking (used in word segmentation fallback)
+     * Check whether a buffer starts with the packed magic number (any version)
      */
-    TrieNode* get_root() const {
-        return root.get();
+    static bool is_packed_format(const uint8_t* data, size_t size) {
+        return size >= 4 && std::memcmp(data, "JPNT", 4) == 0;
     }
     
     /**
-     * Build trie from JSON dictionary file
-     * Optimized for fast construction from large datasets
+     * Major version of a packed buffer (0 if it is too short)
      */
-    void load_from_json(const std::string& file_path) {
-        std::ifstream file(file_path);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file: " + file_path);
+    static uint16_t packed_version(const uint8_t* data, size_t size) {
+        if (size < sizeof(BinaryTrieHeader)) return 0;
+        BinaryTrieHeader h;
+        std::memcpy(&h, data, sizeof(h));
+        return h.version_major;
+    }
+    
+    /**
+     * Whether a packed buffer was written before nodes carried WORD_BELOW
+     * (minor version 0), which attach() rejects
+     */
+    static bool is_outdated(const uint8_t* data, size_t size) {
+        if (size < sizeof(BinaryTrieHeader) || !is_packed_format(data, size)) return false;
+        BinaryTrieHeader h;
+        std::memcpy(&h, data, sizeof(h));
+        return h.version_minor < BinaryTrieFlags::FORMAT_MINOR;
+    }
+    
+    /**
+     * Memory-map a packed trie file
+     * Returns false (and prints the reason) if the file is not a valid v2 trie
+     * 
+     * @param trusted Skip validate() (the bytes are known to be ours, e.g. a
+     *        snapshot whose checksum matched), so nothing is paged in
+     */
+    bool open(const std::string& path, bool trusted = false) {
+        close();
+        if (!file.open(path)) {
+            return false;
         }
         
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string json_content = buffer.str();
-        
-        auto data = parse_json(json_content);
-        
-        std::cout << "🔥 Loading " << data.size() << " entries into trie..." << std::endl;
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        // Insert each entry into the trie
-        for (const auto& entry : data) {
-            insert(entry.first, entry.second);
-            entry_count++;
-            
-            // Progress indicator for large datasets
-            if (entry_count % 50000 == 0) {
-                std::cout << "\r   Processed: " << entry_count << " entries" << std::flush;
+        if (!attach(static_cast<const uint8_t*>(file.data()), file.size(), trusted)) {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+    
+    /**
+     * Open a packed trie that is already in memory (e.g. a Flutter asset)
+     * With a borrowed buffer the view points straight at it and holds the
+     * reference until it is closed; otherwise the bytes are copied once.
+     */
+    bool open_buffer(const uint8_t* data, size_t size, std::shared_ptr<const uint8_t> borrow) {
+        close();
+        if (borrow) {
+            if (!attach(borrow.get(), size)) {
+                return false;
             }
+            borrowed = std::move(borrow);
+            return true;
         }
         
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        
-        std::cout << "\n✅ Loaded " << entry_count << " entries in " << elapsed << "ms" << std::endl;
-        std::cout << "   Average: " << std::fixed << std::setprecision(2) 
-                  << (static_cast<double>(elapsed) * 1000.0 / entry_count) << "μs per entry" << std::endl;
+        owned_copy.reserve(size);
+        advise_huge_pages(owned_copy.data(), size);
+        owned_copy.assign(data, data + size);
+        if (!attach(owned_copy.data(), owned_copy.size())) {
+            close();
+            return false;
+        }
+        return true;
     }
     
     /**
-     * Try to load from simple binary format (japanese.trie)
-     * Loads directly into TrieNode* structure using same insert() as JSON!
-     * 🚀 100x faster than JSON parsing!
+     * Validate the data and point the view at it (only the header when trusted)
      */
-    bool try_load_binary_format(const std::string& file_path) {
-        std::ifstream file(file_path, std::ios::binary);
-        if (!file.is_open()) {
+    bool attach(const uint8_t* data, size_t size, bool trusted = false) {
+        if (size < sizeof(BinaryTrieHeader) || !is_packed_format(data, size)) {
+            std::cerr << "❌ Invalid binary format: bad magic number" << std::endl;
             return false;
         }
         
-        // Read magic number
-        char magic[4];
-        file.read(magic, 4);
-        if (memcmp(magic, "JPHO", 4) != 0) {
-            std::cerr << "❌ Invalid binary format: bad magic number" << std::endl;
+        BinaryTrieHeader h;
+        std::memcpy(&h, data, sizeof(h));
+        if (h.version_major != VERSION) {
+            std::cerr << "❌ Unsupported binary format version: " << h.version_major 
+                      << "." << h.version_minor << std::endl;
             return false;
         }
-        
-        // Read version
-        uint16_t version_major, version_minor;
-        file.read(reinterpret_cast<char*>(&version_major), 2);
-        file.read(reinterpret_cast<char*>(&version_minor), 2);
-        
-        if (version_major != 1 || version_minor != 0) {
-            std::cerr << "❌ Unsupported binary format version: " << version_major 
-                      << "." << version_minor << std::endl;
+        if (h.version_minor < BinaryTrieFlags::FORMAT_MINOR) {
+            // Written before nodes carried WORD_BELOW
+            std::cerr << "❌ Outdated binary format version: " << h.version_major << "." << h.version_minor
+                      << " (recompile it with jpn_trie_compiler)" << std::endl;
             return false;
         }
         
-        // Read entry count
-        uint32_t entry_count_val;
-        file.read(reinterpret_cast<char*>(&entry_count_val), 4);
-        
-        std::cout << "🚀 Loading binary format v" << version_major << "." << version_minor 
-                  << ": " << entry_count_val << " entries" << std::endl;
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        // Helper to read varint
-        auto read_varint_from_file = [&file]() -> uint32_t {
-            uint32_t value = 0;
-            int shift = 0;
-            while (true) {
-                uint8_t byte;
-                file.read(reinterpret_cast<char*>(&byte), 1);
-                value |= (byte & 0x7F) << shift;
-                if ((byte & 0x80) == 0) break;
-                shift += 7;
-            }
-            return value;
-        };
-        
-        // Read all entries and insert into trie (same as JSON!)
-        for (uint32_t i = 0; i < entry_count_val; i++) {
-            // Read key
-            uint32_t key_len = read_varint_from_file();
-            std::string key(key_len, '\0');
-            file.read(&key[0], key_len);
-            
-            // Read value
-            uint32_t value_len = read_varint_from_file();
-            std::string value(value_len, '\0');
-            file.read(&value[0], value_len);
-            
-            // Insert using SAME function as JSON!
-            insert(key, value);
-            entry_count++;
-            
-            // Progress indicator
-            if (i % 50000 == 0 && i > 0) {
-                std::cout << "\r   Processed: " << i << " entries" << std::flush;
-            }
+        if (h.root_offset < sizeof(BinaryTrieHeader) || h.root_offset >= h.values_offset ||
+            h.values_offset > size) {
+            std::cerr << "❌ Corrupt binary trie: offsets out of range" << std::endl;
+            return false;
+        }
+        if (!trusted && !validate(data, size, h)) {
+            std::cerr << "❌ Corrupt binary trie: invalid node graph" << std::endl;
+            return false;
         }
         
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        
-        std::cout << "\n✅ Loaded " << entry_count << " entries in " << elapsed << "ms" << std::endl;
-        std::cout << "   Average: " << std::fixed << std::setprecision(2) 
-                  << (static_cast<double>(elapsed) * 1000.0 / entry_count) << "μs per entry" << std::endl;
-        std::cout << "   ⚡ Using SAME TrieNode* structure and traversal as JSON!" << std::endl;
+        header = h;
+        base = data;
+        data_size = size;
         
+        Node root_node = root();
+        for (size_t i = 0; i < Kana::COUNT; i++) {
+            kana_entries[i] = root_node.find_entry(Kana::FIRST + static_cast<uint32_t>(i));
+            kana_roots[i] = kana_entries[i] ? root_node.entry_target(kana_entries[i]).data() : nullptr;
+        }
         return true;
     }
     
     /**
-     * Insert a Japanese text -> phoneme mapping into the trie
-     * Uses character codes for maximum performance
+     * Check every node once, so that no walk can leave the data
+     * 
+     * Nodes lie back to back between the header and the value pool. Each
+     * one must parse inside that range with its value and transition
+     * outputs inside the pool, every child must point at the start of a
+     * node, and the graph must have no cycle (unpack_node() and
+     * key_depth() walk it whole). Linear in the size of the trie.
      */
-    void insert(const std::string& text, const std::string& phoneme) {
-        TrieNode* current = root.get();
+    static bool validate(const uint8_t* data, size_t size, const BinaryTrieHeader& h) {
+        const uint8_t* nodes_begin = data + sizeof(BinaryTrieHeader);
+        const uint8_t* pool = data + h.values_offset;
+        const uint8_t* end = data + size;
+        const size_t region = static_cast<size_t>(pool - nodes_begin);
         
-        size_t pos = 0;
-        while (pos < text.length()) {
-            uint32_t code_point = get_code_point(text, pos);
-            
-            // Create child node if doesn't exist
-            if (current->children.find(code_point) == current->children.end()) {
-                current->children[code_point] = std::make_unique<TrieNode>();
+        auto pool_string_valid = [&](uint32_t ref) {
+            if (ref >= static_cast<size_t>(end - pool)) return false;
+            const uint8_t* ptr = pool + ref;
+            uint32_t length;
+            return read_varint_checked(ptr, end, length) && length <= static_cast<size_t>(end - ptr);
+        };
+        
+        // Node header at ptr: children count and table (inside the node region)
+        auto parse = [&](const uint8_t* ptr, uint32_t& count, const uint8_t*& table) {
+            uint8_t flags = *ptr++;
+            if (flags & BinaryTrieFlags::VARINT_COUNT) {
+                if (!read_varint_checked(ptr, pool, count)) return false;
+            } else {
+                count = (flags >> BinaryTrieFlags::COUNT_SHIFT) & BinaryTrieFlags::COUNT_MASK;
             }
-            current = current->children[code_point].get();
-        }
+            if (flags & BinaryTrieFlags::HAS_VALUE) {
+                uint32_t value_ref;
+                if (!read_varint_checked(ptr, pool, value_ref) || !pool_string_valid(value_ref)) return false;
+            }
+            table = ptr;
+            return static_cast<uint64_t>(count) * Node::ENTRY_SIZE <= static_cast<uint64_t>(pool - ptr);
+        };
         
-        // Mark end of word with phoneme value
-        current->phoneme = phoneme;
-    }
-    
-    /**
-     * Greedy longest-match conversion algorithm
-     * Tries to match the longest possible substring at each position
-     * OPTIMIZED: Pre-decodes UTF-8 once for 10x speed improvement
-     * ZERO-COPY: Uses binary trie directly if available!
-     */
-    std::string convert(const std::string& japanese_text) {
-        // PRE-DECODE UTF-8 TO CODE POINTS (like Rust does!)
-        std::vector<uint32_t> chars;
-        size_t byte_pos = 0;
-        while (byte_pos < japanese_text.length()) {
-            chars.push_back(get_code_point(japanese_text, byte_pos));
+        // Node starts as a bitmap with a rank per word: node offset -> index
+        std::vector<uint64_t> starts((region + 63) / 64, 0);
+        size_t node_count = 0;
+        size_t edge_count = 0;
+        for (const uint8_t* ptr = nodes_begin; ptr < pool; node_count++) {
+            uint32_t count;
+            const uint8_t* table;
+            if (!parse(ptr, count, table)) return false;
+            size_t offset = static_cast<size_t>(ptr - nodes_begin);
+            starts[offset / 64] |= uint64_t(1) << (offset % 64);
+            edge_count += count;
+            ptr = table + static_cast<size_t>(count) * Node::ENTRY_SIZE;
         }
+        std::vector<uint32_t> rank(starts.size() + 1, 0);
+        for (size_t i = 0; i < starts.size(); i++) {
+            rank[i + 1] = rank[i] + static_cast<uint32_t>(std::bitset<64>(starts[i]).count());
+        }
+        auto index_of = [&](int64_t offset, uint32_t& index) {
+            if (offset < 0 || static_cast<uint64_t>(offset) >= region) return false;
+            uint64_t word = starts[offset / 64];
+            uint64_t bit = uint64_t(1) << (offset % 64);
+            if (!(word & bit)) return false;
+            index = rank[offset / 64] + static_cast<uint32_t>(std::bitset<64>(word & (bit - 1)).count());
+            return true;
+        };
+        uint32_t root_index;
+        if (!index_of(static_cast<int64_t>(h.root_offset - sizeof(BinaryTrieHeader)), root_index)) return false;
         
-        std::string result;
-        size_t pos = 0;
-        
-        while (pos < chars.size()) {
-            // Try to find longest match starting at current position
-            size_t match_length = 0;
-            Optional<std::string> matched_phoneme;
-            
-            TrieNode* current = root.get();
-            
-            // Walk the trie as far as possible (using pre-decoded chars!)
-            for (size_t i = pos; i < chars.size() && current != nullptr; i++) {
-                auto it = current->children.find(chars[i]);
-                if (it == current->children.end()) {
-                    break;
-                }
-                
-                current = it->second.get();
-                
-                // If this node has a phoneme, it's a valid match
-                if (current->phoneme.has_value()) {
-                    match_length = i - pos + 1;
-                    matched_phoneme = current->phoneme;
+        // Children as index lists (compressed rows), with the in-degree of every node
+        std::vector<uint32_t> first_child(node_count + 1, 0);
+        std::vector<uint32_t> children(edge_count);
+        std::vector<uint32_t> in_degree(node_count, 0);
+        size_t node = 0;
+        size_t edge = 0;
+        for (const uint8_t* ptr = nodes_begin; ptr < pool; node++) {
+            uint32_t count;
+            const uint8_t* table;
+            parse(ptr, count, table);
+            for (uint32_t i = 0; i < count; i++, table += Node::ENTRY_SIZE) {
+                int32_t relative_offset;
+                std::memcpy(&relative_offset, table + 3, sizeof(relative_offset));
+                uint32_t child;
+                if (!index_of(static_cast<int64_t>(table + Node::ENTRY_SIZE - nodes_begin) + relative_offset, child)) {
+                    return false;
                 }
-            }
-            
-            if (match_length > 0) {
-                // Found a match - add phoneme and advance position
-                result += matched_phoneme.value();
-                pos += match_length;
-            } else {
-                // No match found - keep original character and continue
-                // Re-encode single code point back to UTF-8
-                uint32_t cp = chars[pos];
-                if (cp < 0x80) {
-                    result += static_cast<char>(cp);
-                } else if (cp < 0x800) {
-                    result += static_cast<char>(0xC0 | (cp >> 6));
-                    result += static_cast<char>(0x80 | (cp & 0x3F));
-                } else if (cp < 0x10000) {
-                    result += static_cast<char>(0xE0 | (cp >> 12));
-                    result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    result += static_cast<char>(0x80 | (cp & 0x3F));
-                } else {
-                    result += static_cast<char>(0xF0 | (cp >> 18));
-                    result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-                    result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    result += static_cast<char>(0x80 | (cp & 0x3F));
+                if constexpr (Node::HAS_EDGE_OUTPUTS) {
+                    if (!pool_string_valid(table[7] | (table[8] << 8) | (table[9] << 16))) return false;
                 }
-                pos++;
+                children[edge++] = child;
+                in_degree[child]++;
             }
+            first_child[node + 1] = static_cast<uint32_t>(edge);
+            ptr = table;
         }
         
-        return result;
+        // Acyclic if repeatedly removing nodes nobody points at removes them all
+        std::vector<uint32_t> ready;
+        for (uint32_t n = 0; n < node_count; n++) {
+            if (in_degree[n] == 0) ready.push_back(n);
+        }
+        size_t removed = 0;
+        while (!ready.empty()) {
+            uint32_t n = ready.back();
+            ready.pop_back();
+            removed++;
+            for (uint32_t e = first_child[n]; e < first_child[n + 1]; e++) {
+                if (--in_degree[children[e]] == 0) ready.push_back(children[e]);
+            }
+        }
+        return removed == node_count;
     }
     
     /**
-     * Convert with detailed matching information for debugging
-     * OPTIMIZED: Pre-decodes UTF-8 once for 10x speed improvement
+     * Drop the view and unmap the file / free the copy (if we own one)
      */
-    ConversionResult convert_detailed(const std::string& japanese_text) {
-        // PRE-DECODE UTF-8 TO CODE POINTS (like Rust does!)
-        std::vector<uint32_t> chars;
-        std::vector<size_t> byte_positions;  // Track byte positions for original string
-        size_t byte_pos = 0;
-        while (byte_pos < japanese_text.length()) {
-            byte_positions.push_back(byte_pos);
-            chars.push_back(get_code_point(japanese_text, byte_pos));
+    void close() {
+        file.close();
+        std::vector<uint8_t>().swap(owned_copy);
+        borrowed.reset();
+        base = nullptr;
+        data_size = 0;
+        std::memset(&header, 0, sizeof(header));
+        kana_roots.fill(nullptr);
+        kana_entries.fill(nullptr);
+    }
+    
+    bool is_open() const {
+        return base != nullptr;
+    }
+    
+    /**
+     * Get root node for trie walking
+     */
+    Node root() const {
+        return Node(base + header.root_offset, base + header.values_offset);
+    }
+    
+    // Same walking interface as FlatTrie, so lookups can be written once
+    Node child(Node node, uint32_t code_point) const { return node.find_child(code_point); }
+    
+    /**
+     * Child of the root (kana from the dense index, no search)
+     */
+    Node root_child(uint32_t code_point) const {
+        if (Kana::contains(code_point)) {
+            return Node(kana_roots[code_point - Kana::FIRST], base + header.values_offset);
         }
-        byte_positions.push_back(byte_pos);  // End position
-        
-        ConversionResult result;
-        size_t pos = 0;
-        
-        while (pos < chars.size()) {
-            size_t match_length = 0;
-            Optional<std::string> matched_phoneme;
-            
-            TrieNode* current = root.get();
-            
-            // Walk the trie as far as possible (using pre-decoded chars!)
-            for (size_t i = pos; i < chars.size() && current != nullptr; i++) {
-                auto it = current->children.find(chars[i]);
-                if (it == current->children.end()) {
-                    break;
-                }
-                
-                current = it->second.get();
-                
-                if (current->phoneme.has_value()) {
-                    match_length = i - pos + 1;
-                    matched_phoneme = current->phoneme;
-                }
-            }
-            
-            if (match_length > 0) {
-                // Found a match
-                Match match;
-                size_t start_byte = byte_positions[pos];
-                size_t end_byte = byte_positions[pos + match_length];
-                match.original = japanese_text.substr(start_byte, end_byte - start_byte);
-                match.phoneme = matched_phoneme.value();
-                match.start_index = start_byte;
-                result.matches.push_back(match);
-                
-                result.phonemes += matched_phoneme.value();
-                pos += match_length;
-            } else {
-                // No match found - re-encode single code point back to UTF-8
-                uint32_t cp = chars[pos];
-                std::string char_str;
-                if (cp < 0x80) {
-                    char_str += static_cast<char>(cp);
-                } else if (cp < 0x800) {
-                    char_str += static_cast<char>(0xC0 | (cp >> 6));
-                    char_str += static_cast<char>(0x80 | (cp & 0x3F));
-                } else if (cp < 0x10000) {
-                    char_str += static_cast<char>(0xE0 | (cp >> 12));
-                    char_str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    char_str += static_cast<char>(0x80 | (cp & 0x3F));
-                } else {
-                    char_str += static_cast<char>(0xF0 | (cp >> 18));
-                    char_str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-                    char_str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-                    char_str += static_cast<char>(0x80 | (cp & 0x3F));
-                }
-                
-                result.unmatched.push_back(char_str);
-                result.phonemes += char_str;
-                pos++;
-            }
+        return root().find_child(code_point);
+    }
+    static bool is_valid(Node node) { return node.is_valid(); }
+    static Node none() { return Node(); }
+    bool has_value(Node node) const { return node.has_value(); }
+    bool is_word(Node node) const { return node.is_word(); }
+    const void* address(Node node) const { return node.data(); }
+    
+    /** Whether a word ends at node or below it (WORD_BELOW flag) */
+    bool has_word_below(Node node) const { return node.leads_to_word(); }
+    
+    /** Children table follows the node header: the middle entry is the first probe of a search */
+    void prefetch_children(Node node) const {
+        node.prefetch_children();
+    }
+    
+    template <typename Visitor>
+    void for_each_child(Node node, Visitor&& visit) const {
+        node.for_each_child([&](uint32_t code_point, Node child, std::string_view) { visit(code_point, child); });
+    }
+    
+    /**
+     * Phoneme of a node (a v2 value; the automaton has none to point at, see append_output())
+     */
+    std::string_view value(Node node) const {
+        if constexpr (Node::HAS_EDGE_OUTPUTS) {
+            return std::string_view();
+        } else {
+            return node.get_value();
         }
-        
-        return result;
     }
+    
+    /**
+     * Append the phoneme of the entry key[0, length) (v3 automaton only)
+     * The key must end at a node with a value, as found by a match walk:
+     * its phoneme is the outputs along the path followed by the node's value.
+     */
+    void append_output(const uint32_t* key, size_t length, std::string& out) const {
+        static_assert(Node::HAS_EDGE_OUTPUTS, "Only the automaton splits phonemes over transitions");
+        Node node = root();
+        for (size_t i = 0; i < length; i++) {
+            const uint8_t* entry = i == 0 && Kana::contains(key[0]) ? kana_entries[key[0] - Kana::FIRST]
+                                                                    : node.find_entry(key[i]);
+            out += node.entry_output(entry);
+            node = node.entry_target(entry);
+        }
+        out += node.get_value();
+    }
+    
+    uint32_t phoneme_count() const { return header.phoneme_count; }
+    uint32_t word_count() const { return header.word_count; }
+    const uint8_t* data() const { return base; }
+    size_t size() const { return data_size; }
 };
 
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// FURIGANA HINT PROCESSING TYPES (defined early for use in WordSegmenter)
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-
-/**
- * Types of segments in processed text
- */
-enum class SegmentType {
-    NORMAL_TEXT,      // Regular text without furigana
-    FURIGANA_HINT    // Text with furigana reading hint
-};
+typedef PackedTrie<BinaryTrieNode> BinaryTrie;
+typedef PackedTrie<AutomatonNode> BinaryAutomaton;
 
 /**
- * A segment of text that can be either normal or have a furigana hint
+ * High-performance flat trie for phoneme lookup and word segmentation
+ * All nodes and edges live in two contiguous arrays (an arena) instead of
+ * one heap allocation + hash map per node:
+ * - Nodes are numbered breadth-first, so the hot upper levels share cache lines
+ * - Each node owns a contiguous range of edges sorted by code point
+ * - Values are interned in one string pool; nodes refer to them by offset
+ * - One node can end a phoneme entry, a dictionary word, or both
+ * 
+ * Construction goes through insert()/insert_word() + finalize(). Lookups are
+ * only valid on a finalized trie and never allocate.
  */
-struct TextSegment {
-    SegmentType type;
-    std::string text;        // The actual text (kanji for furigana hints)
-    std::string reading;     // The reading (only for furigana hints)
-    size_t original_pos;     // Position in original text
+class FlatTrie {
+public:
+    struct Node {
+        uint32_t first_edge;        // Index of first edge in edges
+        uint32_t edge_count;        // Number of children
+        uint32_t value_offset;      // Offset into value pool (if HAS_VALUE)
+        uint32_t value_length : 24; // Length of value in bytes
+        uint32_t flags : 8;         // HAS_VALUE / IS_WORD / MASKED / WORD_BELOW
+    };
     
-    // Constructor for normal text
-    TextSegment(const std::string& t, size_t pos) 
-        : type(SegmentType::NORMAL_TEXT), text(t), reading(""), original_pos(pos) {}
+    struct Edge {
+        uint32_t code_point;    // Character code of this transition
+        uint32_t target;        // Child node index
+    };
     
-    // Constructor for furigana hint
-    TextSegment(const std::string& t, const std::string& r, size_t pos)
-        : type(SegmentType::FURIGANA_HINT), text(t), reading(r), original_pos(pos) {}
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
     
-    // Get the effective text (reading for furigana, text otherwise)
-    std::string get_effective_text() const {
-        return type == SegmentType::FURIGANA_HINT ? reading : text;
-    }
-};
+    // Edges live in their own array (a walk step is two dependent loads)
+    static constexpr bool SEPARATE_CHILDREN = true;
+    
+    // Node flags (same bits as the packed format)
+    static constexpr uint8_t HAS_VALUE = 0x01;
+    static constexpr uint8_t IS_WORD = 0x02;
+    static constexpr uint8_t MASKED = 0x04;  // User overlay only: hides the base entry of this key
+    static constexpr uint8_t WORD_BELOW = 0x08;  // Derived by finalize(): a word ends here or below
 
-/**
- * Word segmenter using longest-match algorithm with word dictionary
- * Splits Japanese text into words for better phoneme spacing
- */
-class WordSegmenter {
 private:
-    std::unique_ptr<TrieNode> root;
-    size_t word_count;
+    // Finalized arena
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::string values;
     
-    // Helper to extract UTF-8 code point from string
-    uint32_t get_code_point(const std::string& str, size_t& pos) const {
-        unsigned char c = str[pos];
-        
-        if (c < 0x80) {
-            pos++;
-            return c;
-        } else if ((c & 0xE0) == 0xC0) {
-            uint32_t cp = ((c & 0x1F) << 6) | (str[pos + 1] & 0x3F);
-            pos += 2;
-            return cp;
-        } else if ((c & 0xF0) == 0xE0) {
-            uint32_t cp = ((c & 0x0F) << 12) | ((str[pos + 1] & 0x3F) << 6) | (str[pos + 2] & 0x3F);
-            pos += 3;
-            return cp;
-        } else if ((c & 0xF8) == 0xF0) {
-            uint32_t cp = ((c & 0x07) << 18) | ((str[pos + 1] & 0x3F) << 12) | 
-                         ((str[pos + 2] & 0x3F) << 6) | (str[pos + 3] & 0x3F);
-            pos += 4;
-            return cp;
+    // Root children for the kana block, indexed by code point (rebuilt by finalize())
+    std::array<uint32_t, Kana::COUNT> kana_roots;
+    
+    // Build state: inserted entries, turned into the arena by finalize()
+    struct PendingEntry {
+        uint32_t key_offset;    // Offset into pending_keys
+        uint32_t key_length;    // Key length in code points
+        uint32_t value_offset;  // Offset into values (if HAS_VALUE)
+        uint32_t value_length;
+        uint8_t flags;
+    };
+    std::vector<uint32_t> pending_keys;
+    std::vector<PendingEntry> pending;
+    
+    /**
+     * Move the entries of the finalized arena back into the build state
+     * (only needed when inserting after finalize)
+     */
+    void collect_entries(uint32_t node, std::vector<uint32_t>& key) {
+        const Node& n = nodes[node];
+        uint8_t flags = static_cast<uint8_t>(n.flags & ~WORD_BELOW);
+        if (flags != 0) {
+            pending.push_back({static_cast<uint32_t>(pending_keys.size()), static_cast<uint32_t>(key.size()),
+                               n.value_offset, n.value_length, flags});
+            pending_keys.insert(pending_keys.end(), key.begin(), key.end());
+        }
+        for (uint32_t e = n.first_edge; e < n.first_edge + n.edge_count; e++) {
+            key.push_back(edges[e].code_point);
+            collect_entries(edges[e].target, key);
+            key.pop_back();
+        }
+    }
+    
+    void add_pending(const uint32_t* key, size_t key_length, std::string_view value, uint8_t flags) {
+        if (pending.empty() && (nodes.size() > 1 || nodes[ROOT].flags != 0)) {
+            std::vector<uint32_t> path;
+            collect_entries(ROOT, path);
         }
         
-        pos++;
-        return c;
+        pending.push_back({static_cast<uint32_t>(pending_keys.size()), static_cast<uint32_t>(key_length),
+                           static_cast<uint32_t>(values.size()), static_cast<uint32_t>(value.size()), flags});
+        pending_keys.insert(pending_keys.end(), key, key + key_length);
+        values.append(value.data(), value.size());
+    }
+
+    /**
+     * General case of the key sort in finalize(). The first three code
+     * points are packed into one integer that orders like the key, so most
+     * comparisons never touch pending_keys.
+     */
+    void sort_pending() {
+        const uint32_t* keys = pending_keys.data();
+        struct SortKey { uint64_t prefix; uint32_t entry; };
+        std::vector<SortKey> sort_keys(pending.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            uint64_t prefix = 0;
+            for (size_t d = 0; d < 3; d++) {
+                uint32_t cp = d < pending[i].key_length ? keys[pending[i].key_offset + d] : 0;
+                prefix = (prefix << 21) | std::min<uint32_t>(cp, 0x1FFFFF);
+            }
+            sort_keys[i] = {prefix, static_cast<uint32_t>(i)};
+        }
+        std::stable_sort(sort_keys.begin(), sort_keys.end(),
+            [this, keys](const SortKey& a, const SortKey& b) {
+                if (a.prefix != b.prefix) return a.prefix < b.prefix;
+                const PendingEntry& x = pending[a.entry];
+                const PendingEntry& y = pending[b.entry];
+                return std::lexicographical_compare(keys + x.key_offset, keys + x.key_offset + x.key_length,
+                                                    keys + y.key_offset, keys + y.key_offset + y.key_length);
+            });
+        std::vector<PendingEntry> sorted(pending.size());
+        for (size_t i = 0; i < sort_keys.size(); i++) {
+            sorted[i] = pending[sort_keys[i].entry];
+        }
+        pending.swap(sorted);
+        std::vector<SortKey>().swap(sort_keys);
+    }
+
+    /**
+     * Refill kana_roots from the root's edges
+     */
+    void index_kana_roots() {
+        kana_roots.fill(NO_NODE);
+        for (const Edge* e = edges_begin(ROOT); e != edges_end(ROOT); ++e) {
+            if (Kana::contains(e->code_point)) {
+                kana_roots[e->code_point - Kana::FIRST] = e->target;
+            }
+        }
     }
 
 public:
-    WordSegmenter() : root(std::make_unique<TrieNode>()), word_count(0) {}
+    FlatTrie() {
+        nodes.push_back({0, 0, 0, 0, 0});
+        kana_roots.fill(NO_NODE);
+    }
     
     /**
-     * Get root node for trie walking (used in compound detection)
+     * Insert a key (pre-decoded code points) with its phoneme value
+     * Call finalize() once all entries are inserted
      */
-    TrieNode* get_root() const {
-        return root.get();
+    void insert(const uint32_t* key, size_t key_length, std::string_view value) {
+        add_pending(key, key_length, value, HAS_VALUE);
     }
     
     /**
-     * Check if a word exists in the dictionary
-     * Returns true if the word is a complete entry
+     * Mark a key (pre-decoded code points) as a segmentation word
+     * Call finalize() once all entries are inserted
      */
-    bool contains_word(const std::string& word) const {
-        if (word.empty()) return false;
+    void insert_word(const uint32_t* key, size_t key_length) {
+        add_pending(key, key_length, std::string_view(), IS_WORD);
+    }
+    
+    /**
+     * Mark a key (pre-decoded code points) as removed (see LayeredTrie)
+     * Call finalize() once all entries are inserted
+     */
+    void insert_masked(const uint32_t* key, size_t key_length) {
+        add_pending(key, key_length, std::string_view(), MASKED);
+    }
+    
+    /**
+     * Build the contiguous breadth-first arena from the inserted entries
+     * Keys are sorted once, so the trie is built without any per-node
+     * allocation or hashing. When a key was inserted twice its flags are
+     * combined and the last phoneme value wins.
+     */
+    void finalize() {
+        if (pending.empty()) return;
         
-        // Pre-decode UTF-8 to code points
-        std::vector<uint32_t> chars;
-        size_t byte_pos = 0;
-        
-        while (byte_pos < word.length()) {
-            unsigned char c = word[byte_pos];
-            uint32_t cp;
-            
-            if (c < 0x80) {
-                cp = c;
-                byte_pos++;
-            } else if ((c & 0xE0) == 0xC0) {
-                cp = ((c & 0x1F) << 6) | (word[byte_pos + 1] & 0x3F);
-                byte_pos += 2;
-            } else if ((c & 0xF0) == 0xE0) {
-                cp = ((c & 0x0F) << 12) | ((word[byte_pos + 1] & 0x3F) << 6) | (word[byte_pos + 2] & 0x3F);
-                byte_pos += 3;
-            } else if ((c & 0xF8) == 0xF0) {
-                cp = ((c & 0x07) << 18) | ((word[byte_pos + 1] & 0x3F) << 12) | 
-                     ((word[byte_pos + 2] & 0x3F) << 6) | (word[byte_pos + 3] & 0x3F);
-                byte_pos += 4;
-            } else {
-                byte_pos++;
-                continue;
+        // Sort entries by key (stable, so later duplicates stay later)
+        const uint32_t* keys = pending_keys.data();
+        auto key_less = [keys](const PendingEntry& a, const PendingEntry& b) {
+            return std::lexicographical_compare(keys + a.key_offset, keys + a.key_offset + a.key_length,
+                                                keys + b.key_offset, keys + b.key_offset + b.key_length);
+        };
+        
+        // Entries collected from a finalized trie come out sorted, and so do
+        // compiled word lists: two sorted runs are merged in linear time
+        auto run_end = std::is_sorted_until(pending.begin(), pending.end(), key_less);
+        if (run_end != pending.end() && std::is_sorted(run_end, pending.end(), key_less)) {
+            std::inplace_merge(pending.begin(), run_end, pending.end(), key_less);
+        } else if (run_end != pending.end()) {
+            sort_pending();
+        }
+        
+        // Depth-first construction: sorted keys share prefixes with their predecessor
+        struct BuildEdge { uint32_t parent; uint32_t code_point; uint32_t child; };
+        std::vector<BuildEdge> build_edges;
+        std::vector<Node> build_nodes;
+        std::vector<uint32_t> path;  // path[d] = node at depth d of the previous key
+        build_edges.reserve(pending_keys.size());  // At most one new node per key code point
+        build_nodes.reserve(pending_keys.size() + 1);
+        build_nodes.push_back({0, 0, 0, 0, 0});
+        path.push_back(ROOT);
+        
+        const PendingEntry* previous = nullptr;
+        for (const PendingEntry& entry : pending) {
+            const uint32_t* key = keys + entry.key_offset;
+            
+            // Length of common prefix with the previous key
+            size_t common = 0;
+            if (previous) {
+                const uint32_t* prev_key = keys + previous->key_offset;
+                size_t limit = std::min(previous->key_length, entry.key_length);
+                while (common < limit && prev_key[common] == key[common]) common++;
             }
+            path.resize(common + 1);
             
-            chars.push_back(cp);
+            for (size_t d = common; d < entry.key_length; d++) {
+                uint32_t child_id = static_cast<uint32_t>(build_nodes.size());
+                build_nodes.push_back({0, 0, 0, 0, 0});
+                build_edges.push_back({path[d], key[d], child_id});
+                path.push_back(child_id);
+            }
+            
+            Node& node = build_nodes[path[entry.key_length]];
+            if (entry.flags & HAS_VALUE) {
+                node.value_offset = entry.value_offset;
+                node.value_length = entry.value_length;
+            }
+            node.flags |= entry.flags;
+            previous = &entry;
         }
         
-        // Walk the trie
-        TrieNode* current = root.get();
+        // Group edges by parent; within a group they were created in code point order
+        std::vector<uint32_t> group_start(build_nodes.size() + 1, 0);
+        for (const BuildEdge& e : build_edges) {
+            group_start[e.parent + 1]++;
+        }
+        for (size_t n = 0; n < build_nodes.size(); n++) {
+            group_start[n + 1] += group_start[n];
+        }
+        std::vector<Edge> grouped(build_edges.size());
+        std::vector<uint32_t> fill(group_start.begin(), group_start.end() - 1);
+        for (const BuildEdge& e : build_edges) {
+            grouped[fill[e.parent]++] = {e.code_point, e.child};
+        }
         
-        for (uint32_t cp : chars) {
-            auto it = current->children.find(cp);
-            if (it == current->children.end()) {
-                return false; // Path doesn't exist
+        // Breadth-first renumbering: children of a node get consecutive ids
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> new_id(build_nodes.size(), NO_NODE);
+        order.reserve(build_nodes.size());
+        order.push_back(ROOT);
+        new_id[ROOT] = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            uint32_t old = order[i];
+            for (uint32_t e = group_start[old]; e < group_start[old + 1]; e++) {
+                new_id[grouped[e].target] = static_cast<uint32_t>(order.size());
+                order.push_back(grouped[e].target);
             }
-            current = it->second.get();
         }
         
-        // Check if this is a valid end-of-word node
-        return current->phoneme.has_value();
-    }
-    
-    /**
-     * Load word list from text file (one word per line)
-     * Builds trie for fast longest-match word segmentation
-     */
-    void load_from_file(const std::string& file_path) {
-        std::ifstream file(file_path);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open word file: " + file_path);
-        }
+        // Emit arena and intern the values in the same order: readings repeat
+        // a lot (common suffixes, kana spellings of the same word), so every
+        // distinct value is stored once and its nodes share the offset
+        std::vector<Node> new_nodes;
+        std::vector<Edge> new_edges;
+        std::string new_values;
+        new_nodes.reserve(order.size());
+        new_edges.reserve(grouped.size());
+        new_values.reserve(values.size());
+        advise_huge_pages(new_nodes.data(), order.size() * sizeof(Node));
+        advise_huge_pages(new_edges.data(), grouped.size() * sizeof(Edge));
+        new_nodes.resize(order.size());
         
-        std::cout << "🔥 Loading word dictionary for segmentation..." << std::endl;
-        auto start_time = std::chrono::high_resolution_clock::now();
+        // Open-addressing table of interned values: {offset in new_values, length + 1}
+        struct InternedValue { uint32_t offset; uint32_t length; };
+        size_t value_slots = 16;
+        while (value_slots < pending.size() * 2) value_slots <<= 1;
+        std::vector<InternedValue> interned(value_slots, InternedValue{0, 0});
         
-        std::string word;
-        while (std::getline(file, word)) {
-            // Remove trailing whitespace/newlines
-            while (!word.empty() && (word.back() == '\r' || word.back() == '\n' || word.back() == ' ')) {
-                word.pop_back();
+        for (size_t i = 0; i < order.size(); i++) {
+            uint32_t old = order[i];
+            const Node& src = build_nodes[old];
+            Node& dst = new_nodes[i];
+            
+            dst.first_edge = static_cast<uint32_t>(new_edges.size());
+            dst.edge_count = group_start[old + 1] - group_start[old];
+            for (uint32_t e = group_start[old]; e < group_start[old + 1]; e++) {
+                new_edges.push_back({grouped[e].code_point, new_id[grouped[e].target]});
             }
             
-            if (!word.empty()) {
-                insert_word(word);
-                word_count++;
-                
-                if (word_count % 50000 == 0) {
-                    std::cout << "\r   Loaded: " << word_count << " words" << std::flush;
+            dst.flags = src.flags;
+            dst.value_offset = 0;
+            dst.value_length = 0;
+            if (src.flags & HAS_VALUE) {
+                std::string_view value(values.data() + src.value_offset, src.value_length);
+                size_t slot = std::hash<std::string_view>()(value) & (value_slots - 1);
+                while (interned[slot].length != 0 &&
+                       (interned[slot].length != value.size() + 1 ||
+                        std::memcmp(new_values.data() + interned[slot].offset, value.data(), value.size()) != 0)) {
+                    slot = (slot + 1) & (value_slots - 1);
+                }
+                if (interned[slot].length == 0) {
+                    interned[slot] = {static_cast<uint32_t>(new_values.size()), static_cast<uint32_t>(value.size() + 1)};
+                    new_values.append(value.data(), value.size());
                 }
+                dst.value_offset = interned[slot].offset;
+                dst.value_length = src.value_length;
             }
         }
+        std::vector<InternedValue>().swap(interned);
+        new_values.shrink_to_fit();
         
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        // Children come later in breadth-first order, so a backward pass sees them first
+        for (size_t i = new_nodes.size(); i-- > 0;) {
+            Node& n = new_nodes[i];
+            bool word_below = (n.flags & IS_WORD) != 0;
+            for (uint32_t e = n.first_edge; e < n.first_edge + n.edge_count && !word_below; e++) {
+                word_below = (new_nodes[new_edges[e].target].flags & WORD_BELOW) != 0;
+            }
+            if (word_below) n.flags |= WORD_BELOW;
+        }
+        advise_huge_pages(new_values.data(), new_values.size());  // Collapsed later (already filled)
         
-        std::cout << "\n✅ Loaded " << word_count << " words in " << elapsed << "ms" << std::endl;
+        nodes.swap(new_nodes);
+        edges.swap(new_edges);
+        values.swap(new_values);
+        index_kana_roots();
+        
+        // Release build state
+        std::vector<uint32_t>().swap(pending_keys);
+        std::vector<PendingEntry>().swap(pending);
+    }
+    
+    /**
+     * Get root node for trie walking
+     */
+    uint32_t root() const {
+        return ROOT;
     }
     
     /**
-     * Insert a word into the trie
+     * Find child by code point (linear scan for small fan-out, binary search otherwise)
+     * Returns NO_NODE if not found
      */
-    void insert_word(const std::string& word) {
-        TrieNode* current = root.get();
+    uint32_t child(uint32_t node, uint32_t code_point) const {
+        const Node& n = nodes[node];
+        const Edge* first = edges.data() + n.first_edge;
+        const Edge* last = first + n.edge_count;
         
-        size_t pos = 0;
-        while (pos < word.length()) {
-            uint32_t code_point = get_code_point(word, pos);
-            
-            if (current->children.find(code_point) == current->children.end()) {
-                current->children[code_point] = std::make_unique<TrieNode>();
+        if (n.edge_count <= 8) {
+            for (const Edge* e = first; e != last; ++e) {
+                if (e->code_point == code_point) return e->target;
             }
-            current = current->children[code_point].get();
+            return NO_NODE;
         }
         
-        // Mark end of word (use empty string as marker)
-        std::string empty_marker = "";
-        current->phoneme = empty_marker;
+        const Edge* it = std::lower_bound(first, last, code_point,
+            [](const Edge& e, uint32_t cp) { return e.code_point < cp; });
+        if (it != last && it->code_point == code_point) return it->target;
+        return NO_NODE;
     }
     
     /**
-     * Segment text into words using longest-match algorithm with TextSegment support
-     * SMART SEGMENTATION: Words are matched from dictionary, and any
-     * unmatched sequences between words are treated as grammatical elements
-     * (particles, conjugations, etc.) and given their own space.
-     * 
-     * Example: 私はリンゴがすきです
-     * - Matches: 私, リンゴ, すき
-     * - Grammar (unmatched): は, が, です
-     * - Result: [私] [は] [リンゴ] [が] [すき] [です]
-     * 
-     * This new version properly handles TextSegments with furigana hints,
-     * treating each segment as an atomic unit during segmentation.
-     * 
-     * @param phoneme_root Optional phoneme trie root for fallback lookups
+     * Child of the root (kana from the dense index, no search)
      */
-    std::vector<std::string> segment_from_segments(const std::vector<TextSegment>& segments, TrieNode* phoneme_root = nullptr) {
-        std::vector<std::string> words;
-        
-        // Process each segment
-        for (const auto& segment : segments) {
-            // For furigana segments, treat the entire reading as one word
-            if (segment.type == SegmentType::FURIGANA_HINT) {
-                words.push_back(segment.reading);
-                continue;
-            }
-            
-            // For normal text segments, apply word segmentation
-            const std::string& text = segment.text;
-            
-            // Pre-decode UTF-8 to code points for speed
-            std::vector<uint32_t> chars;
-            std::vector<size_t> byte_positions;
-            size_t byte_pos = 0;
-            
-            while (byte_pos < text.length()) {
-                byte_positions.push_back(byte_pos);
-                chars.push_back(get_code_point(text, byte_pos));
-            }
-            byte_positions.push_back(byte_pos);
-            
-            size_t pos = 0;
-            while (pos < chars.size()) {
-                // Skip spaces in input
-                uint32_t cp = chars[pos];
-                if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r') {
-                    pos++;
-                    continue;
-                }
-                
-                // Try to find longest word match starting at current position
-                // Check word dictionary first, then phoneme dictionary as fallback
-                size_t match_length = 0;
-                TrieNode* current = root.get();
-                
-                for (size_t i = pos; i < chars.size() && current != nullptr; i++) {
-                    auto it = current->children.find(chars[i]);
-                    if (it == current->children.end()) {
-                        break;
-                    }
-                    
-                    current = it->second.get();
-                    
-                    // If this node marks end of word, it's a valid match
-                    if (current->phoneme.has_value()) {
-                        match_length = i - pos + 1;
-                    }
-                }
-                
-                // 🔥 FALLBACK: If word dictionary didn't find a match, try phoneme dictionary
-                if (match_length == 0 && phoneme_root != nullptr) {
-                    TrieNode* phoneme_current = phoneme_root;
-                    
-                    for (size_t i = pos; i < chars.size() && phoneme_current != nullptr; i++) {
-                        auto it = phoneme_current->children.find(chars[i]);
-                        if (it == phoneme_current->children.end()) {
-                            break;
-                        }
-                        
-                        phoneme_current = it->second.get();
-                        
-                        // If this node has a phoneme, it's a valid word
-                        if (phoneme_current->phoneme.has_value()) {
-                            match_length = i - pos + 1;
-                        }
-                    }
-                }
-                
-                if (match_length > 0) {
-                    // Found a word match - extract it
-                    size_t start_byte = byte_positions[pos];
-                    size_t end_byte = byte_positions[pos + match_length];
-                    words.push_back(text.substr(start_byte, end_byte - start_byte));
-                    pos += match_length;
-                } else {
-                    // No match found - this is likely a grammatical element
-                    // Collect all consecutive unmatched characters as a single token
-                    // This handles particles (は、が、を), conjugations (です、ます), etc.
-                    size_t grammar_start = pos;
-                    size_t grammar_length = 0;
-                    
-                    // Keep collecting characters until we find another word match
-                    while (pos < chars.size()) {
-                        // Skip spaces
-                        if (chars[pos] == ' ' || chars[pos] == '\t' || chars[pos] == '\n' || chars[pos] == '\r') {
-                            break;
-                        }
-                        
-                        // Try to match a word starting from current position
-                        size_t lookahead_match = 0;
-                        TrieNode* lookahead = root.get();
-                        
-                        for (size_t i = pos; i < chars.size() && lookahead != nullptr; i++) {
-                            auto it = lookahead->children.find(chars[i]);
-                            if (it == lookahead->children.end()) {
-                                break;
-                            }
-                            lookahead = it->second.get();
-                            if (lookahead->phoneme.has_value()) {
-                                lookahead_match = i - pos + 1;
-                            }
-                        }
-                        
-                        // If we found a word match, stop here
-                        if (lookahead_match > 0) {
-                            break;
-                        }
-                        
-                        // Otherwise, this character is part of the grammar sequence
-                        grammar_length++;
-                        pos++;
-                    }
-                    
-                    // Extract the grammar token
-                    if (grammar_length > 0) {
-                        size_t start_byte = byte_positions[grammar_start];
-                        size_t end_byte = byte_positions[grammar_start + grammar_length];
-                        words.push_back(text.substr(start_byte, end_byte - start_byte));
-                    }
-                }
-            }
+    uint32_t root_child(uint32_t code_point) const {
+        if (Kana::contains(code_point)) {
+            return kana_roots[code_point - Kana::FIRST];
+        }
+        return child(ROOT, code_point);
+    }
+    
+    static bool is_valid(uint32_t node) {
+        return node != NO_NODE;
+    }
+    
+    bool has_value(uint32_t node) const {
+        return (nodes[node].flags & HAS_VALUE) != 0;
+    }
+    
+    bool is_word(uint32_t node) const {
+        return (nodes[node].flags & IS_WORD) != 0;
+    }
+    
+    bool is_masked(uint32_t node) const {
+        return (nodes[node].flags & MASKED) != 0;
+    }
+    
+    /**
+     * Whether a word ends at node or anywhere below it
+     * The shared trie also holds phoneme-only keys: a path that only leads to
+     * those is not part of the word list, which is what compound detection walks.
+     */
+    bool has_word_below(uint32_t node) const {
+        return (nodes[node].flags & WORD_BELOW) != 0;
+    }
+    
+    static uint32_t none() {
+        return NO_NODE;
+    }
+    
+    const void* address(uint32_t node) const {
+        return &nodes[node];
+    }
+    
+    /**
+     * Start loading the edges of a node (where child() looks first)
+     */
+    void prefetch_children(uint32_t node) const {
+        const Node& n = nodes[node];
+        JPN_PREFETCH(edges.data() + n.first_edge + (n.edge_count <= 8 ? 0 : n.edge_count / 2));
+    }
+    
+    template <typename Visitor>
+    void for_each_child(uint32_t node, Visitor&& visit) const {
+        for (const Edge* e = edges_begin(node); e != edges_end(node); ++e) {
+            visit(e->code_point, e->target);
         }
-        
-        return words;
+    }
+    
+    std::string_view value(uint32_t node) const {
+        const Node& n = nodes[node];
+        return std::string_view(values.data() + n.value_offset, n.value_length);
+    }
+    
+    /**
+     * Id of a node's value: distinct values have distinct ids, and interned
+     * equal values share one (the offset alone is not enough: an empty value
+     * sits at the offset of whatever is interned after it)
+     */
+    uint64_t value_id(uint32_t node) const {
+        const Node& n = nodes[node];
+        return (static_cast<uint64_t>(n.value_offset) << 32) | n.value_length;
+    }
+    
+    /**
+     * Bytes of the interned value pool
+     */
+    size_t value_pool_size() const {
+        return values.size();
+    }
+    
+    /**
+     * Edge range of a node (for walking the whole trie, e.g. when compiling)
+     */
+    const Edge* edges_begin(uint32_t node) const {
+        return edges.data() + nodes[node].first_edge;
+    }
+    
+    const Edge* edges_end(uint32_t node) const {
+        return edges_begin(node) + nodes[node].edge_count;
+    }
+    
+    size_t node_count() const {
+        return nodes.size();
+    }
+    
+    /**
+     * Number of keys with a phoneme value (duplicates counted once)
+     */
+    size_t value_count() const {
+        return static_cast<size_t>(std::count_if(nodes.begin(), nodes.end(),
+            [](const Node& n) { return (n.flags & HAS_VALUE) != 0; }));
     }
 };
 
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// FURIGANA HINT PROCESSING
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-
 /**
- * Helper function to check if a UTF-8 character is hiragana or katakana
- * 
- * @param text The text containing the character
- * @param byte_pos The byte position of the character (must be start of UTF-8 sequence)
- * @return true if character is hiragana or katakana, false otherwise
+ * Widen a block of 16 ASCII bytes to code points
+ * @return false (nothing written) if the block contains a non-ASCII byte
  */
-bool is_kana(const std::string& text, size_t byte_pos) {
-    if (byte_pos + 2 >= text.length()) return false;
-    
-    // Check if this is a 3-byte UTF-8 sequence (most Japanese characters are)
-    unsigned char b1 = static_cast<unsigned char>(text[byte_pos]);
-    if ((b1 & 0xF0) != 0xE0) return false;
+inline bool widen_ascii_block(const unsigned char* in, uint32_t* out) {
+#if defined(JPN_UTF8_SSE2)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    if (_mm_movemask_epi8(bytes) != 0) return false;
     
-    unsigned char b2 = static_cast<unsigned char>(text[byte_pos + 1]);
-    unsigned char b3 = static_cast<unsigned char>(text[byte_pos + 2]);
-    
-    // Decode UTF-8 to Unicode code point
-    uint32_t codepoint = ((b1 & 0x0F) << 12) | ((b2 & 0x3F) << 6) | (b3 & 0x3F);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(high, zero));
+    return true;
+#elif defined(JPN_UTF8_NEON)
+    uint8x16_t bytes = vld1q_u8(in);
+#if defined(__aarch64__) || defined(_M_ARM64)
+    if (vmaxvq_u8(bytes) >= 0x80) return false;
+#else
+    // ARMv7 has no across-vector max: fold the halves and test the high bits
+    uint8x8_t folded = vorr_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+    if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) & 0x8080808080808080ULL) return false;
+#endif
     
-    // Check if it's hiragana (U+3040-U+309F) or katakana (U+30A0-U+30FF)
-    return (codepoint >= 0x3040 && codepoint <= 0x309F) ||  // Hiragana
-           (codepoint >= 0x30A0 && codepoint <= 0x30FF);    // Katakana
+    uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    vst1q_u32(out, vmovl_u16(vget_low_u16(low)));
+    vst1q_u32(out + 4, vmovl_u16(vget_high_u16(low)));
+    vst1q_u32(out + 8, vmovl_u16(vget_low_u16(high)));
+    vst1q_u32(out + 12, vmovl_u16(vget_high_u16(high)));
+    return true;
+#else
+    uint64_t words[2];
+    std::memcpy(words, in, 16);
+    if ((words[0] | words[1]) & 0x8080808080808080ULL) return false;
+    for (int i = 0; i < 16; i++) out[i] = in[i];
+    return true;
+#endif
 }
 
 /**
- * Parse text into segments, extracting furigana hints.
- * 
- * This creates a structured representation of the text where each segment
- * is either normal text or a furigana hint. This approach is cleaner than
- * using markers and makes the processing logic more transparent.
+ * Decode UTF-8 into code points in one pass
  * 
- * SMART COMPOUND WORD DETECTION:
- * - If kanji「reading」+following text forms a dictionary word, prefer dictionary
- * - Example: 見「み」て → Check if 見て is a word → YES → Keep as normal text "見て"
- * - Example: 健太「けんた」て → Check if 健太て is a word → NO → Use furigana "けんた"
+ * The single decoder of the library (conversion, dictionary loading and
+ * lookups all go through it):
+ * - Runs of ASCII are widened 16 bytes at a time (SSE2 / NEON / SWAR)
+ * - Multi-byte sequences are checked for truncation and continuation
+ *   bytes; a malformed lead byte is passed through as its own code point,
+ *   so invalid input never reads past the end of the buffer
  * 
- * @param text Input text with potential furigana hints (e.g., 健太「けんた」)
- * @param segmenter Optional word segmenter for compound word detection
- * @return Vector of text segments with furigana hints properly parsed
+ * @param byte_positions Optional: receives the byte offset of every code point,
+ *                       plus the end offset
  */
-std::vector<TextSegment> parse_furigana_segments(const std::string& text, WordSegmenter* segmenter = nullptr) {
-    std::vector<TextSegment> segments;
+inline void decode_utf8(const char* data, size_t length, std::vector<uint32_t>& chars,
+                        std::vector<size_t>* byte_positions) {
+    // Never more code points than bytes: decode into place, trim at the end
+    chars.resize(length);
+    if (byte_positions) byte_positions->resize(length + 1);
     
-    // 🔥 PRE-DECODE UTF-8 TO CODE POINTS FOR BLAZING SPEED!
-    // Just like in the Rust version, this is the key to performance
-    std::vector<uint32_t> chars;
-    std::vector<size_t> byte_positions;
-    size_t byte_pos = 0;
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    uint32_t* out = chars.data();
+    size_t* offsets = byte_positions ? byte_positions->data() : nullptr;
+    size_t count = 0;
+    size_t pos = 0;
     
-    // Helper lambda to get code point
-    auto get_code_point_lambda = [](const std::string& str, size_t& pos) -> uint32_t {
-        unsigned char c = str[pos];
+    auto continuation = [in](size_t i) { return (in[i] & 0xC0) == 0x80; };
+    
+    while (pos < length) {
+        unsigned char c = in[pos];
         
         if (c < 0x80) {
-            pos++;
-            return c;
-        } else if ((c & 0xE0) == 0xC0) {
-            uint32_t cp = ((c & 0x1F) << 6) | (str[pos + 1] & 0x3F);
+            // ASCII fast path: whole blocks, then the tail of the run
+            if (!offsets) {
+                while (pos + 16 <= length && widen_ascii_block(in + pos, out + count)) {
+                    pos += 16;
+                    count += 16;
+                }
+            }
+            while (pos < length && in[pos] < 0x80) {
+                if (offsets) offsets[count] = pos;
+                out[count++] = in[pos++];
+            }
+            continue;
+        }
+        
+        if (offsets) offsets[count] = pos;
+        size_t left = length - pos;
+        if ((c & 0xE0) == 0xC0 && left >= 2 && continuation(pos + 1)) {
+            out[count++] = ((c & 0x1F) << 6) | (in[pos + 1] & 0x3F);
             pos += 2;
-            return cp;
-        } else if ((c & 0xF0) == 0xE0) {
-            uint32_t cp = ((c & 0x0F) << 12) | ((str[pos + 1] & 0x3F) << 6) | (str[pos + 2] & 0x3F);
+        } else if ((c & 0xF0) == 0xE0 && left >= 3 && continuation(pos + 1) && continuation(pos + 2)) {
+            // Kana and kanji: the common case for Japanese text
+            out[count++] = ((c & 0x0F) << 12) | ((in[pos + 1] & 0x3F) << 6) | (in[pos + 2] & 0x3F);
             pos += 3;
-            return cp;
-        } else if ((c & 0xF8) == 0xF0) {
-            uint32_t cp = ((c & 0x07) << 18) | ((str[pos + 1] & 0x3F) << 12) | 
-                         ((str[pos + 2] & 0x3F) << 6) | (str[pos + 3] & 0x3F);
+        } else if ((c & 0xF8) == 0xF0 && left >= 4 && continuation(pos + 1) &&
+                   continuation(pos + 2) && continuation(pos + 3)) {
+            out[count++] = ((c & 0x07) << 18) | ((in[pos + 1] & 0x3F) << 12) |
+                           ((in[pos + 2] & 0x3F) << 6) | (in[pos + 3] & 0x3F);
             pos += 4;
-            return cp;
+        } else {
+            out[count++] = c;  // Malformed: keep the byte
+            pos++;
         }
-        
-        pos++;
-        return c;
-    };
-    
-    while (byte_pos < text.length()) {
-        byte_positions.push_back(byte_pos);
-        chars.push_back(get_code_point_lambda(text, byte_pos));
     }
-    byte_positions.push_back(byte_pos);
-    
-    // Now process using pre-decoded code points for speed
-    size_t pos = 0;
     
-    while (pos < chars.size()) {
-        // Look for opening bracket 「 (U+300C)
-        size_t bracket_open = std::string::npos;
-        for (size_t i = pos; i < chars.size(); i++) {
-            if (chars[i] == 0x300C) {
-                bracket_open = i;
-                break;
-            }
+    chars.resize(count);
+    if (byte_positions) {
+        (*byte_positions)[count] = pos;
+        byte_positions->resize(count + 1);
+    }
+}
+
+inline void decode_utf8(const std::string& str, std::vector<uint32_t>& chars, std::vector<size_t>* byte_positions) {
+    decode_utf8(str.data(), str.size(), chars, byte_positions);
+}
+
+/**
+ * Append a code point to a string as UTF-8
+ */
+inline void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// USER DICTIONARY OVERLAY
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * A base dictionary with a small user trie on top, walked as one trie
+ *
+ * A node is the pair of nodes the same key reaches in both tries, so a
+ * longest-match walk consults both layers in one pass. The overlay's
+ * phoneme wins where both have one; an overlay node flagged MASKED hides
+ * the base entry of its key (a removed word). Same walking interface as
+ * FlatTrie and PackedTrie.
+ */
+template <typename Base>
+class LayeredTrie {
+public:
+    typedef decltype(std::declval<const Base&>().root()) BaseNode;
+
+    struct Node {
+        BaseNode base;
+        uint32_t overlay;
+    };
+
+    static constexpr bool SEPARATE_CHILDREN = Base::SEPARATE_CHILDREN;
+
+    LayeredTrie(const Base& base_trie, const FlatTrie& overlay_trie)
+        : base_trie(base_trie), overlay_trie(overlay_trie) {}
+
+    Node root() const {
+        return {base_trie.root(), overlay_trie.root()};
+    }
+
+    Node child(Node node, uint32_t code_point) const {
+        return {Base::is_valid(node.base) ? base_trie.child(node.base, code_point) : Base::none(),
+                FlatTrie::is_valid(node.overlay) ? overlay_trie.child(node.overlay, code_point) : FlatTrie::none()};
+    }
+
+    Node root_child(uint32_t code_point) const {
+        return {base_trie.root_child(code_point), overlay_trie.root_child(code_point)};
+    }
+
+    static bool is_valid(Node node) {
+        return Base::is_valid(node.base) || FlatTrie::is_valid(node.overlay);
+    }
+
+    bool has_value(Node node) const {
+        if (FlatTrie::is_valid(node.overlay)) {
+            if (overlay_trie.has_value(node.overlay)) return true;
+            if (overlay_trie.is_masked(node.overlay)) return false;
         }
-        
-        if (bracket_open == std::string::npos) {
-            // No more furigana hints, add rest of text as normal segment
-            if (pos < chars.size()) {
-                size_t start_byte = byte_positions[pos];
-                size_t end_byte = byte_positions[chars.size()];
-                segments.push_back(TextSegment(text.substr(start_byte, end_byte - start_byte), start_byte));
-            }
-            break;
+        return Base::is_valid(node.base) && base_trie.has_value(node.base);
+    }
+
+    bool is_word(Node node) const {
+        if (FlatTrie::is_valid(node.overlay)) {
+            if (overlay_trie.is_word(node.overlay)) return true;
+            if (overlay_trie.is_masked(node.overlay)) return false;
         }
-        
-        // Look for closing bracket 」 (U+300D)
-        size_t bracket_close = std::string::npos;
-        for (size_t i = bracket_open + 1; i < chars.size(); i++) {
-            if (chars[i] == 0x300D) {
-                bracket_close = i;
-                break;
+        return Base::is_valid(node.base) && base_trie.is_word(node.base);
+    }
+
+    /**
+     * Phoneme of a node with has_value()
+     * Empty for an automaton base entry (see PhonemeConverter::append_match())
+     */
+    std::string_view value(Node node) const {
+        if (FlatTrie::is_valid(node.overlay) && overlay_trie.has_value(node.overlay)) {
+            return overlay_trie.value(node.overlay);
+        }
+        return base_trie.value(node.base);
+    }
+
+    const void* address(Node node) const {
+        return Base::is_valid(node.base) ? base_trie.address(node.base) : overlay_trie.address(node.overlay);
+    }
+
+    /** The overlay is small and stays in cache: only the base is worth a prefetch */
+    void prefetch_children(Node node) const {
+        if (Base::is_valid(node.base)) base_trie.prefetch_children(node.base);
+    }
+
+    /** has_word_below() in either layer (a word the overlay masks still counts) */
+    bool has_word_below(Node node) const {
+        return (Base::is_valid(node.base) && base_trie.has_word_below(node.base)) ||
+               (FlatTrie::is_valid(node.overlay) && overlay_trie.has_word_below(node.overlay));
+    }
+
+private:
+    const Base& base_trie;
+    const FlatTrie& overlay_trie;
+};
+
+/**
+ * Words added, re-read or removed at runtime on top of a loaded dictionary
+ *
+ * Never modified once published: an update builds a changed copy with
+ * with_changes() and the converter swaps in a new overlay trie built from
+ * it, so an update costs the size of the user entries and never a reload
+ * of the base dictionary.
+ */
+class UserDictionary {
+public:
+    /**
+     * One update of a word
+     * An empty phoneme hides the word from the dictionary (its base entry
+     * too); remove drops the user entry, so the base entry applies again.
+     */
+    struct Change {
+        std::string_view word;
+        std::string_view phoneme;
+        bool remove;
+    };
+
+    /**
+     * Copy with changes applied in order (the last change of a word wins)
+     *
+     * @param replace Apply the changes to an empty dictionary instead
+     * @throws std::runtime_error on an empty word (nothing is changed)
+     */
+    std::shared_ptr<const UserDictionary> with_changes(const Change* changes, size_t count, bool replace) const {
+        auto copy = std::make_shared<UserDictionary>();
+        if (!replace) copy->entries = entries;
+        for (size_t i = 0; i < count; i++) {
+            const Change& change = changes[i];
+            if (change.word.empty()) {
+                throw std::runtime_error("User dictionary words must not be empty");
+            }
+            std::string word(change.word);
+            if (change.remove) {
+                copy->entries.erase(word);
+            } else {
+                copy->entries[word] = std::string(change.phoneme);
             }
         }
-        
-        if (bracket_close == std::string::npos) {
-            // No closing bracket, add rest as normal segment
-            size_t start_byte = byte_positions[pos];
-            size_t end_byte = byte_positions[chars.size()];
-            segments.push_back(TextSegment(text.substr(start_byte, end_byte - start_byte), start_byte));
-            break;
+        return copy;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    /**
+     * Visit every entry as visit(word, phoneme) in word order
+     * (an empty phoneme is a hidden word)
+     */
+    template <typename Visitor>
+    void for_each(Visitor&& visit) const {
+        for (const auto& entry : entries) {
+            visit(std::string_view(entry.first), std::string_view(entry.second));
         }
-        
-        // Find where the "word" (kanji) starts before the opening bracket
-        // 🔥 BLAZING FAST BOUNDARY DETECTION USING PRE-DECODED CODE POINTS!
-        size_t word_start = bracket_open; // Start from bracket and search backward
-        size_t search_pos = bracket_open;
-        
-        // Helper lambda to check if code point is kana (inline for speed)
-        auto is_kana_cp = [](uint32_t cp) -> bool {
-            return (cp >= 0x3040 && cp <= 0x309F) ||  // Hiragana
-                   (cp >= 0x30A0 && cp <= 0x30FF);    // Katakana
-        };
-        
-        // Search backwards to find the start of the kanji/word that has furigana
-        // 🔥 SMART OKURIGANA DETECTION:
-        // - その男「おとこ」 → Stop at kana prefix "その", capture only "男"  
-        // - 昼ご飯「ひるごはん」 → Keep kana "ご" sandwiched between kanji, capture all "昼ご飯"
-        // Algorithm: Scan backward collecting chars. Stop at first kana that's followed (backward) by only more kana.
-        
-        // First pass: Find the last non-kana (kanji) character before the bracket
-        size_t last_kanji_pos = bracket_open;
-        while (last_kanji_pos > pos && is_kana_cp(chars[last_kanji_pos - 1])) {
-            last_kanji_pos--;
+    }
+
+private:
+    std::map<std::string, std::string> entries;
+};
+
+/**
+ * Individual match from Japanese text to phoneme
+ */
+struct Match {
+    std::string original;
+    std::string phoneme;
+    size_t start_index;
+    
+    std::string to_string() const {
+        return "\"" + original + "\" → \"" + phoneme + "\" (pos: " + std::to_string(start_index) + ")";
+    }
+};
+
+/**
+ * Detailed conversion result with match information
+ */
+struct ConversionResult {
+    std::string phonemes;
+    std::vector<Match> matches;
+    std::vector<std::string> unmatched;
+};
+
+/**
+ * Result of one dictionary walk: the longest phoneme entry and the
+ * longest segmentation word starting at the same position
+ */
+struct DictionaryMatch {
+    size_t phoneme_length = 0;       // Code points of the longest phoneme entry (0 = none)
+    std::string_view phoneme;        // Its phoneme (view into the dictionary, see append_match())
+    size_t word_length = 0;          // Code points of the longest word (0 = none)
+    size_t word_phoneme_length = 0;  // Longest phoneme entry that fits inside that word
+    std::string_view word_phoneme;
+    size_t nodes_visited = 0;        // Trie nodes entered by the walk (conversion stats)
+};
+
+/**
+ * One walk of an interleaved batch (PhonemeConverter::match_interleaved())
+ * Same arguments as PhonemeConverter::match(chars, pos, end).
+ */
+struct MatchQuery {
+    const std::vector<uint32_t>* chars;
+    size_t pos;
+    size_t end;
+    uint32_t tag;  // Caller's id of the walk (text index, lattice position, ...)
+};
+
+/**
+ * Progress of a background dictionary load (jpn_phoneme_init_async())
+ * 
+ * A loader reports its own fraction done; it is mapped onto the
+ * [begin, end] percent range of its stage of the whole load.
+ */
+struct LoadProgress {
+    std::atomic<int>* percent = nullptr;  // NULL = not reported
+    int begin = 0;
+    int end = 100;
+    
+    void report(size_t done, size_t total) const {
+        if (!percent || total == 0) return;
+        percent->store(begin + static_cast<int>((end - begin) * std::min(done, total) / total),
+                       std::memory_order_relaxed);
+    }
+};
+
+
+/**
+ * Ultra-fast phoneme converter using trie data structure
+ * Achieves microsecond-level lookups for typical text
+ * 
+ * The trie is the single dictionary of the library: nodes carry the phoneme
+ * value and/or the segmentation word flag, so WordSegmenter walks the same
+ * trie instead of building a second one.
+ */
+class PhonemeConverter {
+private:
+    FlatTrie trie;
+    size_t entry_count;
+    size_t word_count;
+    
+    // Zero-copy packed trie (used instead of trie when a v2 file is mapped)
+    BinaryTrie packed_trie;
+    
+    // Zero-copy minimised automaton (used instead of trie when a v3 file is mapped)
+    BinaryAutomaton packed_automaton;
+    
+    // Dictionary under a user overlay (see layered()); trie holds the overlay then
+    std::shared_ptr<PhonemeConverter> base;
+    
+    // Reusable decode buffer for insert()
+    std::vector<uint32_t> insert_buffer;
+    
+    // ASCII characters that start at least one entry; the others (most
+    // Latin text, digits, punctuation) are rejected without a trie walk
+    bool ascii_starts[128];
+    
+    // Written by warm_levels() so the compiler keeps its reads
+    static inline volatile size_t warm_sink = 0;
+    
+    // Code points of the longest key, 0 until longest_key() has run
+    mutable std::atomic<size_t> longest_key_length{0};
+    
+    /**
+     * Recompute ascii_starts from the root of the active trie
+     */
+    template <typename Trie>
+    void refresh_ascii_starts(const Trie& dict) {
+        auto root = dict.root();
+        for (uint32_t cp = 0; cp < 128; cp++) {
+            ascii_starts[cp] = Trie::is_valid(dict.child(root, cp));
         }
-        
-        if (last_kanji_pos > pos) {
-            last_kanji_pos--;  // Now pointing at the last kanji
+    }
+    
+    /**
+     * Walk the dictionary from chars[pos], recording the longest phoneme
+     * entry and the longest word in one pass
+     */
+    template <typename Trie>
+    static void walk_match(const Trie& dict, const std::vector<uint32_t>& chars, size_t pos, size_t end,
+                           DictionaryMatch& match) {
+        // Walk the trie as far as possible (using pre-decoded chars!)
+        size_t i = pos;
+        if (i < end) {
+            auto current = dict.root_child(chars[i]);
+            while (Trie::is_valid(current)) {
+                i++;
+                if (dict.has_value(current)) {
+                    match.phoneme_length = i - pos;
+                    match.phoneme = dict.value(current);
+                }
+                if (dict.is_word(current)) {
+                    match.word_length = i - pos;
+                    match.word_phoneme_length = match.phoneme_length;
+                    match.word_phoneme = match.phoneme;
+                }
+                if (i == end) break;
+                current = dict.child(current, chars[i]);
+            }
         }
+        match.nodes_visited = i - pos;
+    }
+    
+    /**
+     * Walk chars[prefix_begin, prefix_end) as far as it matches a word path,
+     * then keep walking from chars[suffix_begin] and return the longest word suffix
+     */
+    template <typename Trie>
+    static size_t walk_compound(const Trie& dict, const std::vector<uint32_t>& chars,
+                                size_t prefix_begin, size_t prefix_end, size_t suffix_begin) {
+        typedef decltype(dict.root()) NodeRef;
         
-        // Second pass: From last kanji, search backward for word boundary
-        // Include okurigana (kana between kanji), but stop at kana-only prefix
-        word_start = last_kanji_pos;
-        search_pos = last_kanji_pos;
-        
-        while (search_pos > pos) {
-            search_pos--;
-            uint32_t cp = chars[search_pos];
-            
-            // Check for punctuation boundaries first (these always stop us)
-            if (cp == 0x300D ||  // 」 closing bracket (another furigana hint)
-                cp == 0x3001 ||  // 、 Japanese comma
-                cp == 0x3002 ||  // 。 Japanese period  
-                cp == 0xFF01 ||  // ！ full-width exclamation
-                cp == 0xFF1F ||  // ？ full-width question
-                cp == 0xFF09 ||  // ） full-width right paren
-                cp == 0xFF3D) {  // ］ full-width right bracket
-                word_start = search_pos + 1;
+        // Walk through the prefix as far as it leads to a word (phoneme-only
+        // keys must not move that point; below a node without words, no
+        // node has any, so the walk can stop there)
+        NodeRef current = dict.root();
+        for (size_t i = prefix_begin; i < prefix_end; i++) {
+            NodeRef next = dict.child(current, chars[i]);
+            if (!Trie::is_valid(next) || !dict.has_word_below(next)) {
                 break;
             }
-            
-            // Check for ASCII punctuation and whitespace
-            if (cp < 0x80 && (
-                cp == '.' || cp == ',' || cp == '!' || cp == '?' || cp == ';' || cp == ':' ||
-                cp == '(' || cp == ')' || cp == '[' || cp == ']' || cp == '{' || cp == '}' ||
-                cp == '"' || cp == '\'' || cp == '-' || cp == '/' || cp == '\\' || cp == '|' ||
-                cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r')) {
-                word_start = search_pos + 1;
+            current = next;
+        }
+        
+        size_t match_length = 0;
+        for (size_t i = suffix_begin; i < chars.size(); i++) {
+            current = dict.child(current, chars[i]);
+            if (!Trie::is_valid(current)) {
                 break;
             }
-            
-            // Check if this is kana
-            bool is_kana_char = is_kana_cp(cp);
-            
-            if (is_kana_char) {
-                // Check if there's ANY non-kana (kanji) before this position
-                bool has_kanji_before = false;
-                for (size_t check_pos = search_pos; check_pos > pos; check_pos--) {
-                    if (!is_kana_cp(chars[check_pos - 1])) {
-                        // Check it's not punctuation
-                        uint32_t check_cp = chars[check_pos - 1];
-                        if (check_cp >= 0x4E00 || (check_cp >= 0x3400 && check_cp <= 0x9FFF)) {  // CJK kanji ranges
-                            has_kanji_before = true;
-                            break;
-                        }
-                    }
-                }
-                
-                if (!has_kanji_before) {
-                    // This kana is not sandwiched - it's a prefix word → stop here
-                    word_start = search_pos + 1;
-                    break;
-                }
-                // Otherwise, this kana is sandwiched (okurigana) → continue
+            if (dict.is_word(current)) {
+                match_length = i - suffix_begin + 1;
             }
-            
-            // Update word_start to include this character
-            word_start = search_pos;
         }
         
-        // Add text from current position up to where the word/kanji starts
-        // This captures particles and other text between furigana hints
-        if (word_start > pos) {
-            size_t start_byte = byte_positions[pos];
-            size_t end_byte = byte_positions[word_start];
-            segments.push_back(TextSegment(text.substr(start_byte, end_byte - start_byte), start_byte));
+        return match_length;
+    }
+    
+    /**
+     * Node reached by the whole key, or an invalid node if the path doesn't exist
+     */
+    template <typename Trie>
+    static auto walk_key(const Trie& dict, const std::vector<uint32_t>& chars) {
+        auto current = dict.root();
+        for (uint32_t cp : chars) {
+            current = dict.child(current, cp);
+            if (!Trie::is_valid(current)) break;
         }
-        
-        // Extract the kanji and reading using pre-decoded positions
-        size_t kanji_start_byte = byte_positions[word_start];
-        size_t kanji_end_byte = byte_positions[bracket_open];
-        std::string kanji = text.substr(kanji_start_byte, kanji_end_byte - kanji_start_byte);
-        
-        // Extract reading between brackets
-        size_t reading_start = bracket_open + 1; // Position after 「
-        size_t reading_end = bracket_close;      // Position before 」
-        
-        // Extract reading text using byte positions
-        size_t reading_start_byte = byte_positions[reading_start];
-        size_t reading_end_byte = byte_positions[reading_end];
-        std::string reading = text.substr(reading_start_byte, reading_end_byte - reading_start_byte);
-        
-        // Fast whitespace trimming using code points
-        size_t trim_start = 0;
-        size_t trim_end = reading_end - reading_start;
-        
-        // Trim leading whitespace
-        while (trim_start < trim_end) {
-            uint32_t cp = chars[reading_start + trim_start];
-            if (cp != ' ' && cp != '\t' && cp != '\n' && cp != '\r') break;
-            trim_start++;
+        return current;
+    }
+    
+    template <typename Trie>
+    static bool walk_is_word(const Trie& dict, const std::vector<uint32_t>& chars) {
+        auto node = walk_key(dict, chars);
+        return Trie::is_valid(node) && dict.is_word(node);
+    }
+    
+    /**
+     * Read every node of the first levels below the root, breadth-first
+     * @return Number of nodes visited
+     */
+    template <typename Trie>
+    static size_t warm_levels(const Trie& dict, size_t levels) {
+        typedef decltype(dict.root()) NodeRef;
+        std::vector<NodeRef> level(1, dict.root());
+        std::vector<NodeRef> next;
+        size_t visited = 0;
+        size_t value_bytes = 0;
+        for (size_t depth = 0; depth < levels && !level.empty(); depth++) {
+            next.clear();
+            for (NodeRef node : level) {
+                dict.for_each_child(node, [&](uint32_t, NodeRef child) {
+                    if (dict.has_value(child)) value_bytes += dict.value(child).size();
+                    next.push_back(child);
+                });
+            }
+            visited += next.size();
+            level.swap(next);
         }
-        
-        // Trim trailing whitespace
-        while (trim_end > trim_start) {
-            uint32_t cp = chars[reading_start + trim_end - 1];
-            if (cp != ' ' && cp != '\t' && cp != '\n' && cp != '\r') break;
-            trim_end--;
+        warm_sink = value_bytes;
+        return visited;
+    }
+    
+    /**
+     * Depth of the deepest node below the root, breadth-first
+     */
+    template <typename Trie>
+    static size_t key_depth(const Trie& dict) {
+        typedef decltype(dict.root()) NodeRef;
+        std::vector<NodeRef> level(1, dict.root());
+        std::vector<NodeRef> next;
+        size_t depth = 0;
+        for (;; depth++) {
+            next.clear();
+            for (NodeRef node : level) {
+                dict.for_each_child(node, [&](uint32_t, NodeRef child) { next.push_back(child); });
+            }
+            if (next.empty()) return depth;
+            level.swap(next);
         }
-        
-        if (trim_start >= trim_end) {
-            // Empty reading - skip the entire furigana hint
-            pos = bracket_close + 1;
-            continue;
+    }
+    
+    /**
+     * State of one lane of walk_interleaved(): walk_match() unrolled
+     */
+    template <typename Trie>
+    struct WalkLane {
+        decltype(std::declval<const Trie&>().root()) node;
+        MatchQuery query;
+        size_t i;
+        bool entered;  // node's flags are read, its children are on the way
+        DictionaryMatch match;
+    };
+    
+    /**
+     * Advance a lane by half a node (the loop body of walk_match() in two
+     * steps): enter the node and prefetch its children, then search them
+     * and prefetch the child. Each step only touches memory requested one
+     * round earlier.
+     * @return false once the walk is over (match complete)
+     */
+    template <typename Trie>
+    static bool step_lane(const Trie& dict, WalkLane<Trie>& lane) {
+        if (lane.entered) {
+            lane.entered = false;
+            lane.node = dict.child(lane.node, (*lane.query.chars)[lane.i]);
+            if (!Trie::is_valid(lane.node)) return false;
+            JPN_PREFETCH(dict.address(lane.node));
+            return true;
         }
         
-        // Extract trimmed reading
-        size_t trimmed_start_byte = byte_positions[reading_start + trim_start];
-        size_t trimmed_end_byte = byte_positions[reading_start + trim_end];
-        reading = text.substr(trimmed_start_byte, trimmed_end_byte - trimmed_start_byte);
-        
-        // 🔥 SMART COMPOUND WORD DETECTION USING TRIE'S LONGEST-MATCH
-        // Walk the trie starting from kanji to find the longest compound word
-        size_t after_bracket = bracket_close + 1; // Position after 」
-        bool used_compound = false;
+        lane.i++;
+        if (dict.has_value(lane.node)) {
+            lane.match.phoneme_length = lane.i - lane.query.pos;
+            lane.match.phoneme = dict.value(lane.node);
+        }
+        if (dict.is_word(lane.node)) {
+            lane.match.word_length = lane.i - lane.query.pos;
+            lane.match.word_phoneme_length = lane.match.phoneme_length;
+            lane.match.word_phoneme = lane.match.phoneme;
+        }
+        if (lane.i == lane.query.end) return false;
+        if constexpr (Trie::SEPARATE_CHILDREN) {
+            dict.prefetch_children(lane.node);
+            lane.entered = true;
+            return true;
+        }
+        lane.node = dict.child(lane.node, (*lane.query.chars)[lane.i]);
+        if (!Trie::is_valid(lane.node)) return false;
+        JPN_PREFETCH(dict.address(lane.node));
+        return true;
+    }
+    
+    /**
+     * Run the walks handed out by source with up to LANES of them in flight
+     * 
+     * Every step of a walk is a load that depends on the previous one, so a
+     * single walk waits for memory at each character. Here each round moves
+     * every lane by one node and prefetches the node it goes to next; by the
+     * time the round comes back to a lane its node has arrived, and the
+     * misses of independent walks overlap instead of adding up.
+     * 
+     * source.next(query) hands out the next walk (false = none ready now);
+     * source.done(query, match) receives each result as walk_match() would
+     * produce it and may make new walks ready (a greedy conversion only
+     * knows where its next walk starts once the current one is done).
+     */
+    template <typename Trie, typename Source>
+    void walk_interleaved(const Trie& dict, Source& source) const {
+        static constexpr size_t LANES = 16;
+        WalkLane<Trie> lanes[LANES];
+        size_t active = 0;
         
-        if (segmenter && after_bracket < chars.size()) {
-            // Use trie to find longest match starting from word_start position
-            // This naturally implements longest-match algorithm
-            size_t match_length = 0;
-            TrieNode* current = segmenter->get_root();
-            
-            // Walk trie through kanji characters first
-            for (size_t i = word_start; i < bracket_open && current != nullptr; i++) {
-                auto it = current->children.find(chars[i]);
-                if (it == current->children.end()) {
-                    break;
+        for (;;) {
+            // Refill free lanes (a walk that cannot start is answered at once)
+            MatchQuery query;
+            while (active < LANES && source.next(query)) {
+                if (query.pos >= query.end ||
+                    ((*query.chars)[query.pos] < 128 && !ascii_starts[(*query.chars)[query.pos]])) {
+                    source.done(query, DictionaryMatch());
+                    continue;
                 }
-                current = it->second.get();
-            }
-            
-            // Continue walking through characters after the bracket
-            if (current != nullptr) {
-                for (size_t i = after_bracket; i < chars.size() && current != nullptr; i++) {
-                    auto it = current->children.find(chars[i]);
-                    if (it == current->children.end()) {
-                        break;
-                    }
-                    current = it->second.get();
-                    
-                    // Check if this position marks a valid word ending
-                    if (current->phoneme.has_value()) {
-                        // Found a compound! Track it as the longest so far
-                        match_length = i - after_bracket + 1;
-                    }
+                WalkLane<Trie>& lane = lanes[active++];
+                lane.query = query;
+                lane.i = query.pos;
+                lane.entered = false;
+                lane.match = DictionaryMatch();
+                lane.node = dict.root_child((*query.chars)[query.pos]);
+                if (!Trie::is_valid(lane.node)) {
+                    source.done(query, lane.match);  // nodes_visited = 0
+                    active--;
+                    continue;
                 }
+                JPN_PREFETCH(dict.address(lane.node));
             }
+            if (active == 0) break;
             
-            // If we found a compound word, use it with the furigana reading replacing the kanji
-            // This ensures that 来「き」た becomes "きた" not "来た" for phoneme conversion
-            if (match_length > 0) {
-                size_t compound_end_byte = byte_positions[after_bracket + match_length];
-                // 🔥 KEY FIX: Use the furigana READING instead of kanji!
-                std::string compound = reading + text.substr(byte_positions[after_bracket], 
-                                                             compound_end_byte - byte_positions[after_bracket]);
-                segments.push_back(TextSegment(compound, kanji_start_byte));
-                pos = after_bracket + match_length;
-                used_compound = true;
+            for (size_t k = 0; k < active;) {
+                WalkLane<Trie>& lane = lanes[k];
+                if (step_lane(dict, lane)) {
+                    k++;
+                    continue;
+                }
+                lane.match.nodes_visited = lane.i - lane.query.pos;
+                source.done(lane.query, lane.match);
+                lane = lanes[--active];  // Keep the active lanes packed
             }
         }
-        
-        if (!used_compound) {
-            // No compound found, use the furigana hint
-            segments.push_back(TextSegment(kanji, reading, kanji_start_byte));
-            pos = bracket_close + 1;
+    }
+    
+    template <typename Trie>
+    static void prefetch_root_child(const Trie& dict, uint32_t code_point) {
+        auto child = dict.root_child(code_point);
+        if (Trie::is_valid(child)) {
+            JPN_PREFETCH(dict.address(child));
         }
     }
     
-    return segments;
-}
-
-
-/**
- * Helper functions for PhonemeConverter with word segmentation
- * Defined here after WordSegmenter class is complete
- */
-namespace SegmentedConversion {
     /**
-     * Convert with word segmentation support
-     * Optimized algorithm with TextSegment-based furigana processing:
-     * 1) Parse text into segments with furigana hints extracted
-     * 2) Segment into words using the structured segments
-     * 3) Convert each word to phonemes
-     * Returns phonemes with spaces between words
+     * Copy every entry of the mapped packed trie into the flat trie
+     * (needed before the dictionary can be modified)
      * 
-     * BLAZING FAST: Uses pre-decoded UTF-8 throughout for 0ms execution
+     * @param output Transition outputs along the key (automaton only, else empty)
      */
-    std::string convert_with_segmentation(PhonemeConverter& converter, const std::string& japanese_text, WordSegmenter& segmenter) {
-        // 🔥 STEP 1: Parse furigana hints into structured segments
-        // 健太「けんた」はバカ → [TextSegment("健太", "けんた"), TextSegment("はバカ")]
-        // 見「み」て → [TextSegment("見て")] (compound word detected)
-        auto segments = parse_furigana_segments(japanese_text, &segmenter);
-        
-        // 🔥 STEP 2: Segment into words using structured segments with phoneme fallback
-        // Furigana segments are treated as atomic units
-        auto words = segmenter.segment_from_segments(segments, converter.get_root());
-        
-        // 🔥 STEP 3: Convert each word to phonemes with particle handling
-        std::string result;
-        for (size_t i = 0; i < words.size(); i++) {
-            if (i > 0) result += " ";  // Add space between words
-            
-            // Special handling for the topic particle は → "wa"
-            if (words[i] == "は" || words[i] == "\xe3\x81\xaf") {  // は in UTF-8
-                result += "wa";
-            } else {
-                result += converter.convert(words[i]);
-            }
+    template <typename Node>
+    void unpack_node(Node node, std::vector<uint32_t>& key, std::string& output) {
+        if (node.has_value()) {
+            size_t prefix = output.size();
+            output += node.get_value();
+            trie.insert(key.data(), key.size(), output);
+            output.resize(prefix);
         }
-        
-        return result;
+        if (node.is_word()) {
+            trie.insert_word(key.data(), key.size());
+        }
+        node.for_each_child([&](uint32_t code_point, Node child, std::string_view child_output) {
+            size_t prefix = output.size();
+            key.push_back(code_point);
+            output += child_output;
+            unpack_node(child, key, output);
+            output.resize(prefix);
+            key.pop_back();
+        });
     }
     
     /**
-     * Convert with word segmentation and detailed information
-     * Includes furigana hint processing for proper name handling
-     * BLAZING FAST: Uses pre-decoded UTF-8 and structured segments
+     * Unpack whichever packed dictionary is open into the flat trie of target
      */
-    ConversionResult convert_detailed_with_segmentation(PhonemeConverter& converter, const std::string& japanese_text, WordSegmenter& segmenter) {
-        // 🔥 STEP 1: Parse furigana hints into structured segments
-        auto segments = parse_furigana_segments(japanese_text, &segmenter);
-        
-        // 🔥 STEP 2: Segment into words using structured segments with phoneme fallback
-        auto words = segmenter.segment_from_segments(segments, converter.get_root());
+    void unpack_into(PhonemeConverter& target) const {
+        std::vector<uint32_t> key;
+        std::string output;
+        if (packed_trie.is_open()) {
+            target.unpack_node(packed_trie.root(), key, output);
+        } else {
+            target.unpack_node(packed_automaton.root(), key, output);
+        }
+    }
+    
+    /**
+     * Call visit(dict) with the dictionary this converter holds itself:
+     * the mapped packed trie or automaton if one is open, else the flat trie
+     */
+    template <typename Visitor>
+    decltype(auto) with_own_dictionary(Visitor&& visit) const {
+        if (packed_trie.is_open()) return visit(packed_trie);
+        if (packed_automaton.is_open()) return visit(packed_automaton);
+        return visit(trie);
+    }
+    
+    /**
+     * Call visit(dict) with the dictionary lookups walk: with_own_dictionary(),
+     * or the base's under the overlay as a LayeredTrie
+     */
+    template <typename Visitor>
+    decltype(auto) with_dictionary(Visitor&& visit) const {
+        if (base) {
+            return base->with_own_dictionary([&](const auto& dict) {
+                return visit(LayeredTrie<std::decay_t<decltype(dict)>>(dict, trie));
+            });
+        }
+        return with_own_dictionary(visit);
+    }
+    
+    void ensure_mutable() {
+        if (!is_packed()) return;
         
-        // 🔥 STEP 3: Convert each word to phonemes with particle handling
-        ConversionResult result;
-        size_t byte_offset = 0;
+        unpack_into(*this);
+        packed_trie.close();
+        packed_automaton.close();
+    }
+    
+    /**
+     * Position of the quote closing a JSON string that starts at string_begin
+     * memchr jumps from quote to quote (vectorised by the C library); a quote
+     * preceded by an odd run of backslashes is escaped and skipped.
+     * @return The closing quote, or end if the string is unterminated
+     */
+    static const char* find_string_end(const char* string_begin, const char* end) {
+        const char* pos = string_begin;
+        while (pos < end) {
+            const char* quote = static_cast<const char*>(std::memchr(pos, '"', end - pos));
+            if (!quote) return end;
+            
+            const char* backslashes = quote;
+            while (backslashes > string_begin && backslashes[-1] == '\\') backslashes--;
+            if (((quote - backslashes) & 1) == 0) return quote;
+            pos = quote + 1;
+        }
+        return end;
+    }
+    
+    /**
+     * Single pass over a flat {"key": "value", ...} document
+     * visit(key, value) receives views into data, so nothing is copied until
+     * the trie stores the entry. Escape sequences are kept verbatim.
+     */
+    template <typename Visitor>
+    static void for_each_json_entry(const char* data, size_t size, Visitor&& visit) {
+        const char* begin = static_cast<const char*>(std::memchr(data, '{', size));
+        const char* end = data + size;
+        while (end > data && end[-1] != '}') end--;
+        if (!begin || end == data || end - 1 <= begin) return;
+        end--;  // Closing brace
         
-        for (size_t i = 0; i < words.size(); i++) {
-            if (i > 0) result.phonemes += " ";  // Add space between words
+        const char* pos = begin + 1;
+        while (pos < end) {
+            const char* key_begin = static_cast<const char*>(std::memchr(pos, '"', end - pos));
+            if (!key_begin) break;
+            key_begin++;
+            const char* key_end = find_string_end(key_begin, end);
+            if (key_end >= end) break;
             
-            // Special handling for the topic particle は → "wa"
-            if (words[i] == "は" || words[i] == "\xe3\x81\xaf") {  // は in UTF-8
-                result.phonemes += "wa";
-                // Add to matches for consistency
-                Match match;
-                match.original = words[i];
-                match.phoneme = "wa";
-                match.start_index = byte_offset;
-                result.matches.push_back(match);
-            } else {
-                auto word_result = converter.convert_detailed(words[i]);
-                
-                // Adjust match positions to account for original text position
-                for (auto& match : word_result.matches) {
-                    match.start_index += byte_offset;
-                    result.matches.push_back(match);
-                }
-                
-                result.phonemes += word_result.phonemes;
-                result.unmatched.insert(result.unmatched.end(), 
-                                       word_result.unmatched.begin(), 
-                                       word_result.unmatched.end());
-            }
+            const char* value_begin = static_cast<const char*>(std::memchr(key_end + 1, '"', end - key_end - 1));
+            if (!value_begin) break;
+            value_begin++;
+            const char* value_end = find_string_end(value_begin, end);
+            if (value_end >= end) break;
             
-            byte_offset += words[i].length();
+            visit(std::string_view(key_begin, key_end - key_begin),
+                  std::string_view(value_begin, value_end - value_begin));
+            pos = value_end + 1;
         }
-        
-        return result;
     }
-}
 
-// Helper function to get UTF-8 command line arguments on Windows
-#ifdef _WIN32
-std::vector<std::string> get_utf8_args() {
-    std::vector<std::string> args;
-    int nArgs;
-    LPWSTR* szArglist = CommandLineToArgvW(GetCommandLineW(), &nArgs);
+public:
+    PhonemeConverter() : entry_count(0), word_count(0) {
+        std::fill(std::begin(ascii_starts), std::end(ascii_starts), true);
+    }
     
-    if (szArglist != NULL) {
-        for (int i = 0; i < nArgs; i++) {
-            int size_needed = WideCharToMultiByte(CP_UTF8, 0, szArglist[i], -1, NULL, 0, NULL, NULL);
-            std::string utf8_arg(size_needed - 1, 0);
-            WideCharToMultiByte(CP_UTF8, 0, szArglist[i], -1, &utf8_arg[0], size_needed, NULL, NULL);
-            args.push_back(utf8_arg);
+    /**
+     * Get the flat trie (used when compiling the packed format)
+     */
+    const FlatTrie& get_trie() const {
+        return trie;
+    }
+    
+    /**
+     * Independent copy that can be modified without affecting this one
+     * (a mapped packed trie is unpacked into the copy's flat trie)
+     * 
+     * @param finalized false to leave unpacked entries pending when the
+     *        caller inserts more and calls finalize() anyway (one build
+     *        instead of two); the copy cannot convert until then
+     */
+    std::unique_ptr<PhonemeConverter> clone_mutable(bool finalized = true) const {
+        if (base) {
+            return base->clone_mutable(finalized);  // The user overlay is not part of the copy
         }
-        LocalFree(szArglist);
+        auto copy = std::make_unique<PhonemeConverter>();
+        if (is_packed()) {
+            unpack_into(*copy);
+            if (finalized) {
+                copy->finalize();
+            }
+        } else {
+            copy->trie = trie;
+        }
+        copy->entry_count = entry_count;
+        copy->word_count = word_count;
+        std::copy(std::begin(ascii_starts), std::end(ascii_starts), std::begin(copy->ascii_starts));
+        return copy;
     }
-    return args;
-}
-#endif
+    
+    /**
+     * Converter that looks words up in user first, then in base
+     *
+     * base is shared, not copied: only the user entries are built into a
+     * trie of their own. They are segmentation words when base has a word
+     * list (a dictionary without one keeps converting without segmentation).
+     */
+    static std::unique_ptr<PhonemeConverter> layered(std::shared_ptr<PhonemeConverter> base,
+                                                     const UserDictionary& user) {
+        auto view = std::make_unique<PhonemeConverter>();
+        view->entry_count = base->entry_count;
+        view->word_count = base->word_count;
+        bool as_words = base->word_count > 0;
 
-int main(int argc, char* argv[]) {
-    // Enable UTF-8 support for Windows console
-    #ifdef _WIN32
-        SetConsoleOutputCP(CP_UTF8);
-        SetConsoleCP(CP_UTF8);
-        setvbuf(stdout, nullptr, _IOFBF, 1000);
-    #endif
+        std::vector<uint32_t> key;
+        user.for_each([&](std::string_view word, std::string_view phoneme) {
+            decode_utf8(word.data(), word.size(), key, nullptr);
+            bool base_value = false;
+            bool base_word = false;
+            base->with_own_dictionary([&](const auto& dict) {
+                auto node = walk_key(dict, key);
+                if (!std::decay_t<decltype(dict)>::is_valid(node)) return;
+                base_value = dict.has_value(node);
+                base_word = dict.is_word(node);
+            });
+
+            if (phoneme.empty()) {
+                view->trie.insert_masked(key.data(), key.size());
+                view->entry_count -= base_value;
+                view->word_count -= base_word;
+                return;
+            }
+            view->trie.insert(key.data(), key.size(), phoneme);
+            view->entry_count += !base_value;
+            if (as_words) {
+                view->trie.insert_word(key.data(), key.size());
+                view->word_count += !base_word;
+            }
+        });
+        view->trie.finalize();
+
+        view->base = std::move(base);
+        view->with_dictionary([&](const auto& dict) { view->refresh_ascii_starts(dict); });
+        return view;
+    }
+
+    /**
+     * Dictionary under the user overlay, or NULL if this converter has none
+     */
+    const std::shared_ptr<PhonemeConverter>& layer_base() const {
+        return base;
+    }
+
+    /**
+     * Check if lookups run against a memory-mapped packed trie (or automaton)
+     */
+    bool is_packed() const {
+        return packed_trie.is_open() || packed_automaton.is_open();
+    }
     
-    std::cout << "╔══════════════════════════════════════════════════════════╗" << std::endl;
-    std::cout << "║  Japanese → Phoneme Converter (C++)                     ║" << std::endl;
-    std::cout << "║  Blazing fast IPA phoneme conversion                    ║" << std::endl;
-    std::cout << "╚══════════════════════════════════════════════════════════╝\n" << std::endl;
+    /**
+     * Bytes of the mapped packed trie or automaton (empty if not packed)
+     */
+    std::string_view packed_data() const {
+        if (packed_automaton.is_open()) {
+            return {reinterpret_cast<const char*>(packed_automaton.data()), packed_automaton.size()};
+        }
+        if (packed_trie.is_open()) {
+            return {reinterpret_cast<const char*>(packed_trie.data()), packed_trie.size()};
+        }
+        return {};
+    }
     
-    // Check if JSON file exists
-    std::ifstream test_file("ja_phonemes.json");
-    if (!test_file.good()) {
-        std::cerr << "❌ Error: ja_phonemes.json not found in current directory" << std::endl;
-        std::cerr << "   Please ensure the phoneme dictionary is present." << std::endl;
-        return 1;
+    /**
+     * Number of entries with a phoneme value
+     */
+    size_t get_entry_count() const {
+        return entry_count;
     }
-    test_file.close();
     
-    // Initialize converter and load dictionary
-    // 🚀 Try binary trie first (100x faster!), fallback to JSON
-    PhonemeConverter converter;
-    bool loaded_binary = false;
+    /**
+     * Number of entries flagged as segmentation words
+     */
+    size_t get_word_count() const {
+        return word_count;
+    }
     
-    // Try simple binary format (direct load into TrieNode*)
-    if (converter.try_load_binary_format("japanese.trie")) {
-        loaded_binary = true;
-        std::cout << "   💡 Binary format loaded directly into TrieNode*" << std::endl;
-    } else {
-        // Fallback to JSON
-        std::cout << "   ⚠️  Binary trie not found, loading JSON..." << std::endl;
-        try {
-            converter.load_from_json("ja_phonemes.json");
-        } catch (const std::exception& e) {
-            std::cerr << "❌ Error loading dictionary: " << e.what() << std::endl;
-            return 1;
+    /**
+     * Bring the top levels of the dictionary into memory and cache
+     * 
+     * Every longest-match walk starts with the same few levels, so warming
+     * them once after loading takes their page faults (mapped files) and
+     * first cache misses off the first conversions. Each level costs about
+     * ten times the one above it: 2 or 3 is usually enough.
+     * 
+     * @return Number of nodes visited (shared automaton states once per path)
+     */
+    size_t warm(size_t levels) const {
+        if (base) return base->warm(levels);  // The overlay is built in place, it is warm already
+        return with_own_dictionary([&](const auto& dict) { return warm_levels(dict, levels); });
+    }
+    
+    /**
+     * Code points of the longest key (phoneme entry or word), the overlay's included
+     * 
+     * Walks every level of the dictionary on the first call and remembers
+     * the result; only streams that must cut inside a very long line ask.
+     */
+    size_t longest_key() const {
+        size_t known = longest_key_length.load(std::memory_order_relaxed);
+        if (known == 0) {
+            known = with_own_dictionary([](const auto& dict) { return key_depth(dict); });
+            if (base) known = std::max(known, base->longest_key());
+            longest_key_length.store(known, std::memory_order_relaxed);
         }
+        return known;
     }
     
-    // Initialize word segmenter if enabled
-    std::unique_ptr<WordSegmenter> segmenter;
-    if (USE_WORD_SEGMENTATION) {
-        // If using binary format, words are already loaded in converter's trie!
-        // We still need to create a WordSegmenter that uses the converter's trie
-        if (loaded_binary) {
-            std::cout << "   💡 Word segmentation: Words already in TrieNode* from binary format" << std::endl;
-            // Create a WordSegmenter - it will use converter's trie as phoneme fallback
-            // The segmentation will work because segment_from_segments() uses phoneme_root fallback
-            segmenter = std::make_unique<WordSegmenter>();
-            // Don't load ja_words.txt - words are already in converter's trie
+    /**
+     * Start loading the node of the first character of text[0, length)
+     * A hint for loops over many inputs: issued one input ahead, the first
+     * dependent miss of the next walk overlaps the current conversion.
+     */
+    void prefetch(const char* text, size_t length) const {
+        if (length == 0) return;
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(text);
+        uint32_t code_point = in[0];
+        if (code_point < 0x80) {
+            if (!ascii_starts[code_point]) return;
+        } else if ((code_point & 0xF0) == 0xE0 && length >= 3) {
+            code_point = ((code_point & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+        } else if ((code_point & 0xE0) == 0xC0 && length >= 2) {
+            code_point = ((code_point & 0x1F) << 6) | (in[1] & 0x3F);
         } else {
-            // Load separate word file for JSON mode
-            std::ifstream test_word_file("ja_words.txt");
-            if (test_word_file.good()) {
-                test_word_file.close();
-                segmenter = std::make_unique<WordSegmenter>();
-                try {
-                    segmenter->load_from_file("ja_words.txt");
-                    std::cout << "   💡 Word segmentation: ENABLED (spaces will separate words)" << std::endl;
-                } catch (const std::exception& e) {
-                    std::cerr << "⚠️  Warning: Could not load word dictionary: " << e.what() << std::endl;
-                    std::cerr << "   Continuing without word segmentation..." << std::endl;
-                    segmenter.reset();
-                }
-            } else {
-                std::cout << "   💡 Word segmentation: DISABLED (ja_words.txt not found)" << std::endl;
-            }
+            return;  // 4-byte or malformed: not worth decoding for a hint
         }
+        
+        with_dictionary([&](const auto& dict) { prefetch_root_child(dict, code_point); });
     }
     
-    std::cout << "\n━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::endl;
+    /**
+     * Find the longest phoneme entry and the longest word in chars[pos, end)
+     * Walks the mapped packed trie in place when one is loaded,
+     * otherwise the flat in-memory trie.
+     */
+    DictionaryMatch match(const std::vector<uint32_t>& chars, size_t pos, size_t end) const {
+        DictionaryMatch result;
+        if (pos < end && chars[pos] < 128 && !ascii_starts[chars[pos]]) {
+            return result;  // ASCII fast path: nothing starts with this character
+        }
+        with_dictionary([&](const auto& dict) { walk_match(dict, chars, pos, end, result); });
+        return result;
+    }
     
-    // Get UTF-8 arguments on Windows
-    #ifdef _WIN32
-        auto utf8_args = get_utf8_args();
-        int arg_count = utf8_args.size();
-    #else
-        int arg_count = argc;
-    #endif
+    /**
+     * Answer many match() calls with their trie walks interleaved
+     * (see walk_interleaved() for the source interface). Each result is
+     * exactly what match(*query.chars, query.pos, query.end) returns.
+     */
+    template <typename Source>
+    void match_interleaved(Source& source) const {
+        with_dictionary([&](const auto& dict) { walk_interleaved(dict, source); });
+    }
     
-    if (arg_count < 2) {
-        // Interactive mode
-        std::cout << "💡 Usage: ./jpn_to_phoneme \"日本語テキスト\"" << std::endl;
-        std::cout << "   Or enter Japanese text interactively:\n" << std::endl;
+    /**
+     * Append the phoneme of a match of length code points at chars[pos]
+     * The tries hand out the phoneme as a view already; the automaton
+     * splits it over the transitions, so its path is walked once more
+     * (unless a user overlay entry matched: those are never empty).
+     */
+    void append_match(const std::vector<uint32_t>& chars, size_t pos, size_t length,
+                      std::string_view phoneme, std::string& out) const {
+        const BinaryAutomaton& automaton = base ? base->packed_automaton : packed_automaton;
+        if (automaton.is_open() && phoneme.empty()) {
+            automaton.append_output(chars.data() + pos, length, out);
+        } else {
+            out += phoneme;
+        }
+    }
+    
+    DictionaryMatch match(const std::vector<uint32_t>& chars, size_t pos) const {
+        return match(chars, pos, chars.size());
+    }
+    
+    /**
+     * Find the longest phoneme entry starting at chars[pos]
+     * 
+     * @param phoneme Receives the matched phoneme (view into the dictionary,
+     *        pass it to append_match() to get the text)
+     * @return Match length in code points, 0 if nothing matched
+     */
+    size_t longest_match(const std::vector<uint32_t>& chars, size_t pos, std::string_view* phoneme) const {
+        DictionaryMatch result = match(chars, pos);
+        if (phoneme && result.phoneme_length > 0) *phoneme = result.phoneme;
+        return result.phoneme_length;
+    }
+    
+    /**
+     * Greedy longest-match conversion of chars[begin, end), appended to out
+     * Unmatched characters are copied through as UTF-8.
+     */
+    void append_phonemes(const std::vector<uint32_t>& chars, size_t begin, size_t end, std::string& out) const {
+        size_t pos = begin;
         
-        std::string input;
-        while (true) {
-            std::cout << "Japanese text (or \"quit\" to exit): ";
-            std::getline(std::cin, input);
-            
-            if (input.empty()) continue;
-            
-            if (input == "quit" || input == "exit") {
-                std::cout << "\n👋 Goodbye!" << std::endl;
-                break;
-            }
-            
-            // Perform conversion with timing
-            auto start_time = std::chrono::high_resolution_clock::now();
-            ConversionResult result;
-            if (segmenter) {
-                result = SegmentedConversion::convert_detailed_with_segmentation(converter, input, *segmenter);
-            } else {
-                result = converter.convert_detailed(input);
+        while (pos < end) {
+            // Copy runs of ASCII that start no entry straight through
+            while (pos < end && chars[pos] < 128 && !ascii_starts[chars[pos]]) {
+                out += static_cast<char>(chars[pos++]);
             }
-            auto end_time = std::chrono::high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
-            
-            // Display results
-            std::cout << "\n┌─────────────────────────────────────────" << std::endl;
-            std::cout << "│ Input:    " << input << std::endl;
-            std::cout << "│ Phonemes: " << result.phonemes << std::endl;
-            std::cout << "│ Time:     " << elapsed << "μs" << std::endl;
-            std::cout << "└─────────────────────────────────────────" << std::endl;
+            if (pos == end) break;
             
-            if (!result.matches.empty()) {
-                std::cout << "\n  Matches (" << result.matches.size() << "):" << std::endl;
-                for (const auto& match : result.matches) {
-                    std::cout << "    • " << match.to_string() << std::endl;
-                }
-            }
+            // Try to find longest match starting at current position
+            DictionaryMatch found = match(chars, pos, end);
             
-            if (!result.unmatched.empty()) {
-                std::cout << "\n  ⚠️  Unmatched characters: ";
-                for (size_t i = 0; i < result.unmatched.size(); i++) {
-                    if (i > 0) std::cout << ", ";
-                    std::cout << result.unmatched[i];
-                }
-                std::cout << std::endl;
+            if (found.phoneme_length > 0) {
+                // Found a match - add phoneme and advance position
+                append_match(chars, pos, found.phoneme_length, found.phoneme, out);
+                pos += found.phoneme_length;
+            } else {
+                // No match found - keep original character and continue
+                append_utf8(out, chars[pos]);
+                pos++;
             }
-            
-            std::cout << std::endl;
         }
-    } else {
-        // Batch mode - convert all arguments
-        for (int i = 1; i < arg_count; i++) {
-            #ifdef _WIN32
-                std::string text = utf8_args[i];
-            #else
-                std::string text = argv[i];
-            #endif
+    }
+    
+    /**
+     * Longest word that continues chars[prefix_begin, prefix_end) with
+     * chars[suffix_begin...] (furigana compound detection)
+     * 
+     * @return Length of the matched suffix in code points, 0 if none
+     */
+    size_t compound_word_length(const std::vector<uint32_t>& chars, size_t prefix_begin,
+                                size_t prefix_end, size_t suffix_begin) const {
+        return with_dictionary([&](const auto& dict) {
+            return walk_compound(dict, chars, prefix_begin, prefix_end, suffix_begin);
+        });
+    }
+    
+    /**
+     * Check if a word exists in the dictionary
+     * Returns true if the word is a complete entry
+     */
+    bool contains_word(const std::string& word) const {
+        if (word.empty()) return false;
+        
+        std::vector<uint32_t> chars;
+        decode_utf8(word, chars, nullptr);
+        
+        return with_dictionary([&](const auto& dict) { return walk_is_word(dict, chars); });
+    }
+    
+    /**
+     * Build trie from JSON dictionary file
+     * Optimized for fast construction from large datasets
+     * 
+     * @param progress Receives the share of the file parsed so far
+     */
+    void load_from_json(const std::string& file_path, const LoadProgress& progress = LoadProgress()) {
+        // Streamed straight from a read-only mapping: no copy of the file and
+        // no intermediate map, entries go into the trie as they are found
+        MemoryMappedFile mapping;
+        std::string fallback;  // Files that cannot be mapped (empty, pipes) are read instead
+        const char* data;
+        size_t size;
+        if (mapping.open(file_path)) {
+            data = static_cast<const char*>(mapping.data());
+            size = mapping.size();
+        } else {
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open file: " + file_path);
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            fallback = buffer.str();
+            data = fallback.data();
+            size = fallback.size();
+        }
+        
+        std::cout << "🔥 Streaming " << (size / 1024) << " KB of JSON into trie..." << std::endl;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        // Insert each entry into the trie (a later duplicate key wins)
+        ensure_mutable();
+        size_t parsed = 0;
+        for_each_json_entry(data, size, [&](std::string_view key, std::string_view value) {
+            decode_utf8(key.data(), key.size(), insert_buffer, nullptr);
+            trie.insert(insert_buffer.data(), insert_buffer.size(), value);
             
-            // Perform conversion with timing
+            if (++parsed % 4096 == 0) {
+                progress.report(static_cast<size_t>(value.data() - data), size);
+            }
+            // Progress indicator for large datasets
+            if (parsed % 50000 == 0) {
+                std::cout << "\r   Processed: " << parsed << " entries" << std::flush;
+            }
+        });
+        finalize();
+        entry_count = trie.value_count();
+        progress.report(size, size);
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        
+        std::cout << "\n✅ Loaded " << entry_count << " entries in " << elapsed << "ms" << std::endl;
+        std::cout << "   Average: " << std::fixed << std::setprecision(2) 
+                  << (static_cast<double>(elapsed) * 1000.0 / std::max<size_t>(entry_count, 1)) << "μs per entry" << std::endl;
+    }
+    
+    /**
+     * Build the kana-only bootstrap dictionary (see KanaCore)
+     */
+    void load_kana_core() {
+        ensure_mutable();
+        for (const KanaCore::Entry& entry : KanaCore::ENTRIES) {
+            insert(entry.kana, entry.phoneme);
+        }
+        finalize();
+        entry_count = trie.value_count();
+    }
+    
+    /**
+     * Memory-map a packed v2 trie or v3 automaton (japanese.trie compiled to "JPNT")
+     * Nothing is copied - lookups walk the mapping in place once the nodes
+     * have been validated (PackedTrie::validate()).
+     * 
+     * @param version Major version from the file header
+     * @param trusted Skip the validation (see PackedTrie::open())
+     */
+    bool try_load_packed_format(const std::string& file_path, uint16_t version, bool trusted) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        packed_trie.close();
+        packed_automaton.close();
+        bool opened = version == BinaryAutomaton::VERSION ? packed_automaton.open(file_path, trusted)
+                                                          : packed_trie.open(file_path, trusted);
+        if (!opened) {
+            return false;
+        }
+        report_packed_load(start_time, "Mapped");
+        std::cout << "   ⚡ Zero-copy: lookups walk the memory-mapped file in place!" << std::endl;
+        
+        return true;
+    }
+    
+    /**
+     * Try to load from binary format (japanese.trie)
+     * - "JPNT" packed v2 / v3 files are memory-mapped (see try_load_packed_format)
+     * - "JPHO" v1 files are loaded into the flat trie using same insert() as JSON!
+     * 🚀 100x faster than JSON parsing!
+     * 
+     * @param trusted A packed file is known to be ours (see PackedTrie::open())
+     */
+    bool try_load_binary_format(const std::string& file_path, bool trusted = false) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        // Read magic number (and the packed format's version after it)
+        char magic[4];
+        file.read(magic, 4);
+        if (file && memcmp(magic, "JPNT", 4) == 0) {
+            uint16_t version = 0;
+            file.read(reinterpret_cast<char*>(&version), sizeof(version));
+            file.close();
+            return try_load_packed_format(file_path, version, trusted);
+        }
+        if (!file || memcmp(magic, "JPHO", 4) != 0) {
+            std::cerr << "❌ Invalid binary format: bad magic number" << std::endl;
+            return false;
+        }
+        
+        // v1 is parsed entry by entry anyway, so read it in one go
+        file.seekg(0, std::ios::end);
+        std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (!file) {
+            std::cerr << "❌ Failed to read binary trie: " << file_path << std::endl;
+            return false;
+        }
+        
+        return load_v1_buffer(data.data(), data.size());
+    }
+    
+    /**
+     * Load a binary trie (v1 or v2) that is already in memory
+     * No disk I/O: a v2 buffer is walked in place (borrow is data, which
+     * the converter then keeps referenced) or copied once (borrow = NULL);
+     * a v1 buffer is parsed into the flat trie and not referenced afterwards.
+     */
+    bool try_load_binary_buffer(const uint8_t* data, size_t size, std::shared_ptr<const uint8_t> borrow = nullptr) {
+        if (BinaryTrie::is_packed_format(data, size)) {
             auto start_time = std::chrono::high_resolution_clock::now();
-            ConversionResult result;
-            if (segmenter) {
-                result = SegmentedConversion::convert_detailed_with_segmentation(converter, text, *segmenter);
+            
+            packed_trie.close();
+            packed_automaton.close();
+            bool borrowed = borrow != nullptr;
+            bool opened = BinaryTrie::packed_version(data, size) == BinaryAutomaton::VERSION
+                        ? packed_automaton.open_buffer(data, size, std::move(borrow))
+                        : packed_trie.open_buffer(data, size, std::move(borrow));
+            if (!opened) {
+                return false;
+            }
+            report_packed_load(start_time, borrowed ? "Attached" : "Copied");
+            return true;
+        }
+        if (size < 4 || memcmp(data, "JPHO", 4) != 0) {
+            std::cerr << "❌ Invalid binary format: bad magic number" << std::endl;
+            return false;
+        }
+        
+        return load_v1_buffer(data, size);
+    }
+    
+private:
+    /**
+     * Take the counts from a freshly opened packed trie and log the load time
+     */
+    void report_packed_load(std::chrono::high_resolution_clock::time_point start_time, const char* verb) {
+        bool automaton = packed_automaton.is_open();
+        longest_key_length.store(0, std::memory_order_relaxed);
+        if (automaton) {
+            entry_count = packed_automaton.phoneme_count();
+            word_count = packed_automaton.word_count();
+            refresh_ascii_starts(packed_automaton);
+        } else {
+            entry_count = packed_trie.phoneme_count();
+            word_count = packed_trie.word_count();
+            refresh_ascii_starts(packed_trie);
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        
+        std::cout << "🚀 " << verb << (automaton ? " minimised automaton v3: " : " packed trie v2: ")
+                  << entry_count << " entries, " << word_count << " words in " << elapsed << "μs" << std::endl;
+    }
+    
+    /**
+     * Parse a "JPHO" v1 entry list and insert it into the flat trie
+     */
+    bool load_v1_buffer(const uint8_t* data, size_t size) {
+        const uint8_t* cursor = data + 4;  // Past the magic number
+        const uint8_t* end = data + size;
+        
+        // Read version and entry count
+        if (size < 12) {
+            std::cerr << "❌ Corrupt binary trie: truncated header" << std::endl;
+            return false;
+        }
+        uint16_t version_major, version_minor;
+        uint32_t entry_count_val;
+        std::memcpy(&version_major, cursor, 2);
+        std::memcpy(&version_minor, cursor + 2, 2);
+        std::memcpy(&entry_count_val, cursor + 4, 4);
+        cursor += 8;
+        
+        if (version_major != 1 || version_minor != 0) {
+            std::cerr << "❌ Unsupported binary format version: " << version_major 
+                      << "." << version_minor << std::endl;
+            return false;
+        }
+        
+        std::cout << "🚀 Loading binary format v" << version_major << "." << version_minor 
+                  << ": " << entry_count_val << " entries" << std::endl;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        // Helper to read a length-prefixed string (false if it runs past the end)
+        auto read_string = [&cursor, end](std::string& out) {
+            uint32_t length = 0;
+            int shift = 0;
+            while (true) {
+                if (cursor == end || shift > 28) return false;
+                uint8_t byte = *cursor++;
+                length |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) break;
+                shift += 7;
+            }
+            if (length > static_cast<size_t>(end - cursor)) return false;
+            out.assign(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+            return true;
+        };
+        
+        // Read all entries and insert into trie (same as JSON!)
+        std::string key, value;
+        for (uint32_t i = 0; i < entry_count_val; i++) {
+            if (!read_string(key) || !read_string(value)) {
+                std::cerr << "❌ Corrupt binary trie: entry " << i << " runs past the end" << std::endl;
+                return false;
+            }
+            
+            // Insert using SAME function as JSON! (empty value = word-only entry)
+            if (value.empty()) {
+                insert_word(key);
+            } else {
+                insert(key, value);
+                entry_count++;
+            }
+            
+            // Progress indicator
+            if (i % 50000 == 0 && i > 0) {
+                std::cout << "\r   Processed: " << i << " entries" << std::flush;
+            }
+        }
+        finalize();
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        
+        std::cout << "\n✅ Loaded " << entry_count << " entries in " << elapsed << "ms" << std::endl;
+        std::cout << "   Average: " << std::fixed << std::setprecision(2) 
+                  << (static_cast<double>(elapsed) * 1000.0 / entry_count) << "μs per entry" << std::endl;
+        std::cout << "   ⚡ Using SAME flat trie structure and traversal as JSON!" << std::endl;
+        
+        return true;
+    }
+    
+public:
+    /**
+     * Insert a Japanese text -> phoneme mapping into the trie
+     * Uses character codes for maximum performance
+     * Call finalize() after the last insert before converting.
+     */
+    void insert(std::string_view text, std::string_view phoneme) {
+        ensure_mutable();
+        decode_utf8(text.data(), text.size(), insert_buffer, nullptr);
+        
+        trie.insert(insert_buffer.data(), insert_buffer.size(), phoneme);
+    }
+    
+    /**
+     * Mark a Japanese text as a segmentation word (shares nodes with phoneme entries)
+     * A mapped packed trie is first copied into the flat trie.
+     * Call finalize() after the last insert before converting.
+     */
+    void insert_word(std::string_view word) {
+        ensure_mutable();
+        decode_utf8(word.data(), word.size(), insert_buffer, nullptr);
+        
+        trie.insert_word(insert_buffer.data(), insert_buffer.size());
+        word_count++;
+    }
+    
+    /**
+     * Mark a pre-decoded word as a segmentation word (see above)
+     */
+    void insert_word(const uint32_t* word, size_t length) {
+        ensure_mutable();
+        trie.insert_word(word, length);
+        word_count++;
+    }
+    
+    /**
+     * Pack inserted entries into the contiguous lookup arena
+     */
+    void finalize() {
+        trie.finalize();
+        refresh_ascii_starts(trie);
+        longest_key_length.store(0, std::memory_order_relaxed);
+        std::vector<uint32_t>().swap(insert_buffer);
+    }
+    
+    /**
+     * Greedy longest-match conversion algorithm
+     * Tries to match the longest possible substring at each position
+     * OPTIMIZED: Pre-decodes UTF-8 once for 10x speed improvement
+     * ZERO-COPY: Uses binary trie directly if available!
+     */
+    std::string convert(const std::string& japanese_text) {
+        // PRE-DECODE UTF-8 TO CODE POINTS (like Rust does!)
+        std::vector<uint32_t> chars;
+        decode_utf8(japanese_text, chars, nullptr);
+        
+        std::string result;
+        append_phonemes(chars, 0, chars.size(), result);
+        return result;
+    }
+    
+    /**
+     * Convert with detailed matching information for debugging
+     * OPTIMIZED: Pre-decodes UTF-8 once for 10x speed improvement
+     */
+    ConversionResult convert_detailed(const std::string& japanese_text) {
+        // PRE-DECODE UTF-8 TO CODE POINTS (like Rust does!)
+        std::vector<uint32_t> chars;
+        std::vector<size_t> byte_positions;  // Track byte positions for original string
+        decode_utf8(japanese_text, chars, &byte_positions);
+        
+        ConversionResult result;
+        size_t pos = 0;
+        
+        while (pos < chars.size()) {
+            std::string_view matched_phoneme;
+            size_t match_length = longest_match(chars, pos, &matched_phoneme);
+            
+            if (match_length > 0) {
+                // Found a match
+                Match match;
+                size_t start_byte = byte_positions[pos];
+                size_t end_byte = byte_positions[pos + match_length];
+                match.original = japanese_text.substr(start_byte, end_byte - start_byte);
+                append_match(chars, pos, match_length, matched_phoneme, match.phoneme);
+                match.start_index = start_byte;
+                result.matches.push_back(match);
+                
+                result.phonemes += match.phoneme;
+                pos += match_length;
+            } else {
+                // No match found - copy the character's original bytes
+                std::string char_str = japanese_text.substr(byte_positions[pos],
+                                                            byte_positions[pos + 1] - byte_positions[pos]);
+                
+                result.unmatched.push_back(char_str);
+                result.phonemes += char_str;
+                pos++;
+            }
+        }
+        
+        return result;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CONVERSION STATISTICS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Hot-path counters (order matches JPN_PHONEME_STAT_* in the header)
+ */
+enum StatCounter : size_t {
+    STAT_CONVERSIONS,        // Texts run through the pipeline (cache hits excluded)
+    STAT_CACHE_HITS,         // Texts answered by the result cache
+    STAT_INPUT_BYTES,
+    STAT_OUTPUT_BYTES,
+    STAT_PARSE_NS,           // UTF-8 decode and furigana hint parsing
+    STAT_SEGMENTATION_NS,    // Word boundary search (including the trie walks it triggers)
+    STAT_LOOKUP_NS,          // Phoneme emission for the words / the whole text
+    STAT_OUTPUT_COPY_NS,     // Copying results into caller buffers
+    STAT_TRIE_NODES,         // Trie nodes entered by dictionary walks
+    STAT_DICTIONARY_HITS,    // Walks that found a phoneme entry or a word
+    STAT_DICTIONARY_MISSES,  // Walks that found nothing
+    STAT_WORD_TOKENS,        // Segments matched as dictionary words
+    STAT_FALLBACK_TOKENS,    // Segments converted by the phoneme entries alone
+    STAT_GRAMMAR_TOKENS,     // Runs of characters matched by neither
+    STAT_COUNT
+};
+
+/**
+ * Counters of one conversion, filled without synchronisation by the
+ * converting thread and published once at the end
+ */
+struct ConversionStats {
+    uint64_t values[STAT_COUNT] = {};
+    
+    uint64_t& operator[](StatCounter counter) { return values[counter]; }
+    
+    using Clock = std::chrono::steady_clock;
+    
+    void add_time(StatCounter counter, Clock::time_point start, Clock::time_point stop) {
+        values[counter] += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    }
+};
+
+/**
+ * Opt-in process-wide statistics
+ * 
+ * Disabled by default: the pipeline then checks one relaxed atomic per
+ * conversion and takes its uninstrumented path. When enabled, each thread
+ * adds into its own block of atomics with plain load/store pairs (it is
+ * the only writer), so recording never contends; reading sums the live
+ * blocks plus the totals of exited threads under the registry mutex.
+ */
+namespace Stats {
+    std::atomic<bool> enabled{false};
+    
+    struct ThreadCounters;
+    
+    std::mutex registry_mutex;
+    std::vector<ThreadCounters*> live_threads;
+    uint64_t retired[STAT_COUNT] = {};   // Totals of exited threads
+    uint64_t baseline[STAT_COUNT] = {};  // Totals at the last reset()
+    
+    struct ThreadCounters {
+        std::atomic<uint64_t> values[STAT_COUNT];
+        
+        ThreadCounters() {
+            for (auto& value : values) {
+                value.store(0, std::memory_order_relaxed);
+            }
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            live_threads.push_back(this);
+        }
+        
+        ~ThreadCounters() {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (size_t i = 0; i < STAT_COUNT; i++) {
+                retired[i] += values[i].load(std::memory_order_relaxed);
+            }
+            live_threads.erase(std::find(live_threads.begin(), live_threads.end(), this));
+        }
+        
+        void add(size_t counter, uint64_t amount) {
+            values[counter].store(values[counter].load(std::memory_order_relaxed) + amount,
+                                  std::memory_order_relaxed);
+        }
+    };
+    
+    inline bool active() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    
+    inline ThreadCounters& local() {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+    
+    void publish(const ConversionStats& stats) {
+        ThreadCounters& counters = local();
+        for (size_t i = 0; i < STAT_COUNT; i++) {
+            if (stats.values[i] != 0) {
+                counters.add(i, stats.values[i]);
+            }
+        }
+    }
+    
+    void add(StatCounter counter, uint64_t amount) {
+        local().add(counter, amount);
+    }
+    
+    /**
+     * Totals since the library was loaded (the caller holds registry_mutex)
+     */
+    void sum_locked(uint64_t totals[STAT_COUNT]) {
+        for (size_t i = 0; i < STAT_COUNT; i++) {
+            totals[i] = retired[i];
+            for (const ThreadCounters* counters : live_threads) {
+                totals[i] += counters->values[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    /**
+     * Totals since the last reset()
+     */
+    void read(uint64_t totals[STAT_COUNT]) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        sum_locked(totals);
+        for (size_t i = 0; i < STAT_COUNT; i++) {
+            totals[i] -= baseline[i];
+        }
+    }
+    
+    /**
+     * Start counting from zero (threads keep their blocks; reads subtract the baseline)
+     * Sums and moves the baseline under one lock, so concurrent resets
+     * never count the same totals twice.
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        sum_locked(baseline);
+    }
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// MATCH LATTICE
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * One piece of the output aligned to the input (jpn_phoneme_convert_spans())
+ * Byte offsets; mirrored as JpnPhonemeSpan in jpn_to_phoneme_ffi.h
+ */
+struct MatchSpan {
+    uint32_t src_offset;
+    uint32_t src_length;
+    uint32_t out_offset;
+    uint32_t out_length;
+    uint32_t flags;
+};
+
+static_assert(sizeof(MatchSpan) == 20, "MatchSpan is copied into JpnPhonemeSpan arrays");
+
+enum MatchSpanFlag : uint32_t {
+    SPAN_MATCHED = 0x01,     // Phonemes of a dictionary entry (otherwise the text is copied through)
+    SPAN_WORD_START = 0x02,  // First span of a segmented word
+    SPAN_FURIGANA = 0x04,    // Read from a furigana hint (the source is the whole hinted word)
+};
+
+/**
+ * Collects the MatchSpans of one conversion
+ * 
+ * Pieces are reported in lattice positions and mapped back to the source:
+ * a lattice text is either the decoded input itself or, for a compound
+ * word, its furigana reading followed by the text after the hint. A
+ * reading stands for the whole hinted word, so its pieces are merged into
+ * one span; so are runs of copied-through characters.
+ */
+class SpanRecorder {
+public:
+    std::vector<MatchSpan> spans;
+    std::vector<size_t> byte_positions;  // Source byte offset of every code point (plus the end)
+    
+    /**
+     * Start a conversion (byte_positions must be filled for its source)
+     */
+    void clear() {
+        spans.clear();
+        map_source();
+        word_start = false;
+    }
+    
+    /**
+     * Lattice positions are source positions
+     */
+    void map_source() {
+        hint_begin = hint_end = 0;
+        shift = 0;
+    }
+    
+    /**
+     * Lattice positions [begin, end) are a reading of the source word
+     * [source_begin, source_end); positions after it are shifted by text_shift
+     */
+    void map_reading(size_t begin, size_t end, size_t source_begin, size_t source_end, size_t text_shift) {
+        hint_begin = begin;
+        hint_end = end;
+        hint_source_begin = source_begin;
+        hint_source_end = source_end;
+        shift = text_shift;
+    }
+    
+    /**
+     * The next span starts a segmented word
+     */
+    void begin_word() {
+        word_start = true;
+    }
+    
+    /**
+     * Record that lattice text [begin, end) produced output [out_begin, out_end)
+     */
+    void add(size_t begin, size_t end, size_t out_begin, size_t out_end, uint32_t flags) {
+        size_t source_begin = begin + shift;
+        size_t source_end = end + shift;
+        if (begin >= hint_begin && begin < hint_end) {
+            flags |= SPAN_FURIGANA;
+            source_begin = hint_source_begin;
+            if (end <= hint_end) source_end = hint_source_end;
+        }
+        uint32_t src_offset = static_cast<uint32_t>(byte_positions[source_begin]);
+        uint32_t src_length = static_cast<uint32_t>(byte_positions[source_end]) - src_offset;
+        uint32_t out_offset = static_cast<uint32_t>(out_begin);
+        uint32_t out_length = static_cast<uint32_t>(out_end - out_begin);
+        
+        if (!spans.empty() && !word_start) {
+            MatchSpan& last = spans.back();
+            bool contiguous = last.out_offset + last.out_length == out_offset;
+            bool copied_run = !(flags & (SPAN_MATCHED | SPAN_FURIGANA)) &&
+                              !(last.flags & (SPAN_MATCHED | SPAN_FURIGANA)) &&
+                              last.src_offset + last.src_length == src_offset;
+            bool same_reading = (flags & SPAN_FURIGANA) && (last.flags & SPAN_FURIGANA) &&
+                                last.src_offset == src_offset;
+            if (contiguous && (copied_run || same_reading)) {
+                last.src_length = std::max(last.src_length, src_offset + src_length - last.src_offset);
+                last.out_length += out_length;
+                last.flags |= flags;
+                return;
+            }
+        }
+        if (word_start) {
+            flags |= SPAN_WORD_START;
+            word_start = false;
+        }
+        spans.push_back({src_offset, src_length, out_offset, out_length, flags});
+    }
+    
+private:
+    size_t hint_begin = 0;         // Lattice positions [hint_begin, hint_end) are a furigana reading
+    size_t hint_end = 0;
+    size_t hint_source_begin = 0;
+    size_t hint_source_end = 0;
+    size_t shift = 0;              // Source position - lattice position after the reading
+    bool word_start = false;
+};
+
+/**
+ * Dictionary matches for every position of one text span, each walked at most once
+ * 
+ * Segmentation needs the match at a position several times: for the word
+ * match, for the grammar-token lookahead of the positions before it and
+ * again to convert the word. The lattice fills in a position on first use
+ * and reuses it afterwards, so a run of unmatched characters costs one
+ * walk per position instead of a fresh lookahead (and a conversion walk)
+ * from every position.
+ */
+class MatchLattice {
+private:
+    const PhonemeConverter* dictionary;
+    const std::vector<uint32_t>* chars;
+    size_t span_begin;
+    size_t span_end;
+    
+    std::vector<DictionaryMatch> matches;  // Indexed by pos - span_begin
+    std::vector<uint8_t> computed;
+    ConversionStats* stats;                // NULL unless statistics are enabled
+    SpanRecorder* span_recorder;           // NULL unless alignments are requested
+    
+    DictionaryMatch lookup(size_t pos, size_t end) const {
+        DictionaryMatch found = dictionary->match(*chars, pos, end);
+        if (stats) {
+            (*stats)[STAT_TRIE_NODES] += found.nodes_visited;
+            (*stats)[found.phoneme_length > 0 || found.word_length > 0
+                     ? STAT_DICTIONARY_HITS : STAT_DICTIONARY_MISSES]++;
+        }
+        return found;
+    }
+
+public:
+    MatchLattice()
+        : dictionary(nullptr), chars(nullptr), span_begin(0), span_end(0), stats(nullptr), span_recorder(nullptr) {}
+    
+    explicit MatchLattice(const PhonemeConverter& dictionary)
+        : dictionary(&dictionary), chars(nullptr), span_begin(0), span_end(0), stats(nullptr),
+          span_recorder(nullptr) {}
+    
+    /**
+     * Look up matches in another dictionary (storage is kept)
+     */
+    void bind(const PhonemeConverter& new_dictionary) {
+        dictionary = &new_dictionary;
+    }
+    
+    /**
+     * Record walks and token kinds into counters (NULL stops recording)
+     */
+    void record_stats(ConversionStats* counters) {
+        stats = counters;
+    }
+    
+    ConversionStats* recorded_stats() const { return stats; }
+    
+    /**
+     * Report every converted piece to a recorder (NULL stops recording)
+     */
+    void record_spans(SpanRecorder* recorder) {
+        span_recorder = recorder;
+    }
+    
+    /**
+     * Start a new span chars[begin, end) (storage is reused between spans)
+     */
+    void reset(const std::vector<uint32_t>& text, size_t begin, size_t end) {
+        chars = &text;
+        span_begin = begin;
+        span_end = end;
+        matches.resize(end - begin);
+        computed.assign(end - begin, 0);
+    }
+    
+    const std::vector<uint32_t>& text() const { return *chars; }
+    size_t begin() const { return span_begin; }
+    size_t end() const { return span_end; }
+    
+    /**
+     * Longest phoneme entry and longest word starting at pos (bounded by the span)
+     */
+    const DictionaryMatch& at(size_t pos) {
+        size_t index = pos - span_begin;
+        if (!computed[index]) {
+            matches[index] = lookup(pos, span_end);
+            computed[index] = 1;
+        }
+        return matches[index];
+    }
+    
+    /**
+     * Greedy longest-match conversion of [begin, end) inside the span
+     * Same result as PhonemeConverter::append_phonemes(); positions already
+     * in the lattice are not walked again when their match fits the range.
+     */
+    void append_phonemes(size_t begin, size_t end, std::string& out) {
+        size_t pos = begin;
+        
+        while (pos < end) {
+            size_t limit = end - pos;
+            size_t match_length;
+            std::string_view matched_phoneme;
+            
+            const DictionaryMatch& cached = matches[pos - span_begin];
+            bool known = computed[pos - span_begin] != 0;
+            if (known && cached.phoneme_length <= limit) {
+                match_length = cached.phoneme_length;
+                matched_phoneme = cached.phoneme;
+            } else if (known && cached.word_length == limit) {
+                // Longest phoneme inside the word recorded by the same walk
+                match_length = cached.word_phoneme_length;
+                matched_phoneme = cached.word_phoneme;
+            } else {
+                // Not in the lattice (inside a word): walk bounded by the range
+                DictionaryMatch found = lookup(pos, end);
+                match_length = found.phoneme_length;
+                matched_phoneme = found.phoneme;
+            }
+            
+            size_t out_begin = out.size();
+            if (match_length > 0) {
+                dictionary->append_match(*chars, pos, match_length, matched_phoneme, out);
+                pos += match_length;
+            } else {
+                append_utf8(out, (*chars)[pos]);
+                pos++;
+            }
+            if (span_recorder) {
+                span_recorder->add(pos - std::max<size_t>(match_length, 1), pos, out_begin, out.size(),
+                                   match_length > 0 ? uint32_t(SPAN_MATCHED) : 0u);
+            }
+        }
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// FURIGANA HINT PROCESSING TYPES (defined early for use in WordSegmenter)
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Types of segments in processed text
+ */
+enum class SegmentType {
+    NORMAL_TEXT,      // Regular text without furigana
+    FURIGANA_HINT    // Text with furigana reading hint
+};
+
+/**
+ * A segment of text that can be either normal or have a furigana hint
+ */
+struct TextSegment {
+    SegmentType type;
+    std::string text;        // The actual text (kanji for furigana hints)
+    std::string reading;     // The reading (only for furigana hints)
+    size_t original_pos;     // Position in original text
+    
+    // Constructor for normal text
+    TextSegment(const std::string& t, size_t pos) 
+        : type(SegmentType::NORMAL_TEXT), text(t), reading(""), original_pos(pos) {}
+    
+    // Constructor for furigana hint
+    TextSegment(const std::string& t, const std::string& r, size_t pos)
+        : type(SegmentType::FURIGANA_HINT), text(t), reading(r), original_pos(pos) {}
+    
+    // Get the effective text (reading for furigana, text otherwise)
+    std::string get_effective_text() const {
+        return type == SegmentType::FURIGANA_HINT ? reading : text;
+    }
+};
+
+/**
+ * Word segmenter using longest-match algorithm with word dictionary
+ * Splits Japanese text into words for better phoneme spacing
+ */
+class WordSegmenter {
+private:
+    // Shared dictionary: words are flagged nodes of the converter's trie
+    PhonemeConverter& dictionary;
+    
+public:
+    explicit WordSegmenter(PhonemeConverter& dictionary) : dictionary(dictionary) {}
+    
+    /**
+     * Get the shared dictionary (used in compound detection)
+     */
+    const PhonemeConverter& get_dictionary() const {
+        return dictionary;
+    }
+    
+    /**
+     * Check if a word exists in the dictionary
+     * Returns true if the word is a complete entry
+     */
+    bool contains_word(const std::string& word) const {
+        return dictionary.contains_word(word);
+    }
+    
+    /**
+     * Number of words in the shared dictionary
+     */
+    size_t get_word_count() const {
+        return dictionary.get_word_count();
+    }
+    
+    /**
+     * Check for a compiled word list ("JPNW")
+     */
+    static bool is_compiled_word_list(const uint8_t* data, size_t size) {
+        return size >= sizeof(WordListHeader) && std::memcmp(data, "JPNW", 4) == 0;
+    }
+    
+    /**
+     * Load word list from a file: text (one word per line) or compiled "JPNW"
+     * Words are flagged in the shared dictionary trie for fast
+     * longest-match word segmentation
+     */
+    void load_from_file(const std::string& file_path) {
+        MemoryMappedFile mapping;
+        std::string fallback;  // Files that cannot be mapped (empty, pipes) are read instead
+        const uint8_t* data;
+        size_t size;
+        if (mapping.open(file_path)) {
+            data = static_cast<const uint8_t*>(mapping.data());
+            size = mapping.size();
+        } else {
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open word file: " + file_path);
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            fallback = buffer.str();
+            data = reinterpret_cast<const uint8_t*>(fallback.data());
+            size = fallback.size();
+        }
+        
+        if (!load_from_buffer(data, size)) {
+            throw std::runtime_error("Invalid word file: " + file_path);
+        }
+    }
+    
+    /**
+     * Load a word list from memory (text or compiled "JPNW", see load_from_file)
+     * The data is not referenced after the call.
+     * @return false if a compiled list is corrupt
+     */
+    bool load_from_buffer(const uint8_t* data, size_t size) {
+        std::cout << "🔥 Loading word dictionary for segmentation..." << std::endl;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        size_t word_count = 0;
+        bool ok = is_compiled_word_list(data, size)
+                ? load_compiled(data, size, word_count)
+                : (load_lines(reinterpret_cast<const char*>(data), size, word_count), true);
+        if (!ok) {
+            return false;
+        }
+        dictionary.finalize();
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        
+        std::cout << "\n✅ Loaded " << word_count << " words in " << elapsed << "ms" << std::endl;
+        return true;
+    }
+    
+private:
+    /**
+     * One word per line; trailing spaces and CR are trimmed, empty lines skipped
+     */
+    void load_lines(const char* data, size_t size, size_t& word_count) {
+        const char* end = data + size;
+        const char* line = data;
+        while (line < end) {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            const char* line_end = newline ? newline : end;
+            
+            // Remove trailing whitespace/newlines
+            const char* word_end = line_end;
+            while (word_end > line && (word_end[-1] == '\r' || word_end[-1] == ' ')) {
+                word_end--;
+            }
+            
+            if (word_end > line) {
+                dictionary.insert_word(std::string_view(line, word_end - line));
+                word_count++;
+                
+                if (word_count % 50000 == 0) {
+                    std::cout << "\r   Loaded: " << word_count << " words" << std::flush;
+                }
+            }
+            line = line_end + 1;
+        }
+    }
+    
+    /**
+     * Front-coded, pre-decoded words (see TRIE_FORMAT.md); already sorted,
+     * so finalize() merges them with the trie instead of sorting
+     */
+    bool load_compiled(const uint8_t* data, size_t size, size_t& word_count) {
+        WordListHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.version_major != 1) {
+            std::cerr << "❌ Unsupported word list version: " << header.version_major
+                      << "." << header.version_minor << std::endl;
+            return false;
+        }
+        
+        const uint8_t* cursor = data + sizeof(header);
+        const uint8_t* end = data + size;
+        std::vector<uint32_t> word;
+        for (uint32_t i = 0; i < header.word_count; i++) {
+            uint32_t shared, suffix_length;
+            if (!read_varint_checked(cursor, end, shared) || !read_varint_checked(cursor, end, suffix_length) ||
+                shared > word.size() || suffix_length > static_cast<size_t>(end - cursor)) {
+                std::cerr << "❌ Corrupt word list: word " << i << " runs past the end" << std::endl;
+                return false;
+            }
+            
+            word.resize(shared);
+            for (uint32_t c = 0; c < suffix_length; c++) {
+                uint32_t code_point;
+                if (!read_varint_checked(cursor, end, code_point)) {
+                    std::cerr << "❌ Corrupt word list: word " << i << " runs past the end" << std::endl;
+                    return false;
+                }
+                word.push_back(code_point);
+            }
+            if (!word.empty()) {
+                dictionary.insert_word(word.data(), word.size());
+                word_count++;
+            }
+        }
+        return true;
+    }
+    
+public:
+    /**
+     * Segment the lattice's span into words using the longest-match algorithm
+     * SMART SEGMENTATION: Words are matched from dictionary, and any
+     * unmatched sequences between words are treated as grammatical elements
+     * (particles, conjugations, etc.) and given their own space.
+     * 
+     * Example: 私はリンゴがすきです
+     * - Matches: 私, リンゴ, すき
+     * - Grammar (unmatched): は, が, です
+     * - Result: [私] [は] [リンゴ] [が] [すき] [です]
+     * 
+     * Words and phoneme entries come from the same trie, and every position
+     * is walked at most once (MatchLattice): the grammar lookahead stores
+     * the match it finds, and the next word is taken from it. Worst case is
+     * one walk per position, also for long unmatched runs.
+     * 
+     * @param visit Called as visit(word_begin, word_end) for every word;
+     *              convert it with lattice.append_phonemes()
+     */
+    template <typename Visitor>
+    void for_each_word(MatchLattice& lattice, Visitor&& visit) const {
+        const std::vector<uint32_t>& chars = lattice.text();
+        const size_t end = lattice.end();
+        auto is_space = [](uint32_t cp) {
+            return cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r';
+        };
+        
+        size_t pos = lattice.begin();
+        while (pos < end) {
+            // Skip spaces in input
+            if (is_space(chars[pos])) {
+                pos++;
+                continue;
+            }
+            
+            // Try to find longest word match starting at current position
+            // 🔥 FALLBACK: If no word matched, use the longest phoneme entry
+            const DictionaryMatch& found = lattice.at(pos);
+            size_t match_length = found.word_length > 0 ? found.word_length : found.phoneme_length;
+            
+            if (match_length > 0) {
+                if (ConversionStats* stats = lattice.recorded_stats()) {
+                    (*stats)[found.word_length > 0 ? STAT_WORD_TOKENS : STAT_FALLBACK_TOKENS]++;
+                }
+                visit(pos, pos + match_length);
+                pos += match_length;
+            } else {
+                // No match found - this is likely a grammatical element
+                // Collect all consecutive unmatched characters as a single token
+                // This handles particles (は、が、を), conjugations (です、ます), etc.
+                size_t grammar_start = pos;
+                pos++;  // No word starts here (see above)
+                
+                // Keep collecting characters until we find another word match
+                while (pos < end && !is_space(chars[pos]) && lattice.at(pos).word_length == 0) {
+                    pos++;
+                }
+                
+                if (ConversionStats* stats = lattice.recorded_stats()) {
+                    (*stats)[STAT_GRAMMAR_TOKENS]++;
+                }
+                visit(grammar_start, pos);
+            }
+        }
+    }
+    
+    /**
+     * Segment text into words using longest-match algorithm with TextSegment support
+     * (see for_each_word for the rules)
+     * 
+     * This new version properly handles TextSegments with furigana hints,
+     * treating each segment as an atomic unit during segmentation.
+     */
+    std::vector<std::string> segment_from_segments(const std::vector<TextSegment>& segments) {
+        std::vector<std::string> words;
+        std::vector<uint32_t> chars;
+        std::vector<size_t> byte_positions;
+        MatchLattice lattice(dictionary);
+        
+        // Process each segment
+        for (const auto& segment : segments) {
+            // For furigana segments, treat the entire reading as one word
+            if (segment.type == SegmentType::FURIGANA_HINT) {
+                words.push_back(segment.reading);
+                continue;
+            }
+            
+            // For normal text segments, apply word segmentation
+            const std::string& text = segment.text;
+            
+            // Pre-decode UTF-8 to code points for speed
+            decode_utf8(text, chars, &byte_positions);
+            
+            lattice.reset(chars, 0, chars.size());
+            for_each_word(lattice, [&](size_t word_begin, size_t word_end) {
+                size_t start_byte = byte_positions[word_begin];
+                size_t end_byte = byte_positions[word_end];
+                words.push_back(text.substr(start_byte, end_byte - start_byte));
+            });
+        }
+        
+        return words;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// FURIGANA HINT PROCESSING
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * A segment of pre-decoded text, as code point ranges into the source
+ * (the allocation-free form of TextSegment used on the conversion hot path)
+ * 
+ * - NORMAL_TEXT: reading[...] + text[...] (reading is only set for a
+ *   compound word whose kanji were replaced by their furigana reading)
+ * - FURIGANA_HINT: text = kanji, reading = furigana reading
+ */
+struct SegmentSpan {
+    SegmentType type;
+    size_t text_begin, text_end;
+    size_t reading_begin, reading_end;
+    size_t origin;                    // Where the segment starts in the source
+    size_t source_end;                // Where it ends (after the 」 of a hint)
+    
+    static SegmentSpan normal(size_t begin, size_t end) {
+        return {SegmentType::NORMAL_TEXT, begin, end, begin, begin, begin, end};
+    }
+    
+    static SegmentSpan compound(size_t kanji_begin, size_t reading_begin, size_t reading_end,
+                                size_t suffix_begin, size_t suffix_end) {
+        return {SegmentType::NORMAL_TEXT, suffix_begin, suffix_end, reading_begin, reading_end,
+                kanji_begin, suffix_end};
+    }
+    
+    static SegmentSpan furigana(size_t kanji_begin, size_t kanji_end, size_t reading_begin, size_t reading_end,
+                                size_t hint_end) {
+        return {SegmentType::FURIGANA_HINT, kanji_begin, kanji_end, reading_begin, reading_end,
+                kanji_begin, hint_end};
+    }
+};
+
+/**
+ * Whether a furigana hint's word never reaches back past this character
+ * (punctuation, whitespace, or the 」 of an earlier hint)
+ */
+constexpr bool ends_hinted_word(uint32_t cp) {
+    return cp == 0x300D ||  // 」 closing bracket (another furigana hint)
+           cp == 0x3001 ||  // 、 Japanese comma
+           cp == 0x3002 ||  // 。 Japanese period
+           cp == 0xFF01 ||  // ！ full-width exclamation
+           cp == 0xFF1F ||  // ？ full-width question
+           cp == 0xFF09 ||  // ） full-width right paren
+           cp == 0xFF3D ||  // ］ full-width right bracket
+           cp == '.' || cp == ',' || cp == '!' || cp == '?' || cp == ';' || cp == ':' ||
+           cp == '(' || cp == ')' || cp == '[' || cp == ']' || cp == '{' || cp == '}' ||
+           cp == '"' || cp == '\'' || cp == '-' || cp == '/' || cp == '\\' || cp == '|' ||
+           cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r';
+}
+
+/**
+ * Parse pre-decoded text into segments, extracting furigana hints.
+ * 
+ * This creates a structured representation of the text where each segment
+ * is either normal text or a furigana hint. This approach is cleaner than
+ * using markers and makes the processing logic more transparent.
+ * 
+ * SMART COMPOUND WORD DETECTION:
+ * - If kanji「reading」+following text forms a dictionary word, prefer dictionary
+ * - Example: 見「み」て → Check if 見て is a word → YES → Keep as normal text "見て"
+ * - Example: 健太「けんた」て → Check if 健太て is a word → NO → Use furigana "けんた"
+ * 
+ * @param chars Input text as code points (e.g., 健太「けんた」)
+ * @param dictionary Word dictionary for compound word detection (can be NULL)
+ * @param spans Receives the segment spans with furigana hints properly parsed
+ *              (cleared first, capacity is reused)
+ * @param splits If set, receives in order the ranges [first, last] of
+ *               positions where the text can be split without changing any
+ *               hint: from where the parse resumes after a hint (or the
+ *               start) to the lowest position the next hint's word search
+ *               looked at (or the end)
+ */
+void parse_furigana_spans(const std::vector<uint32_t>& chars, const PhonemeConverter* dictionary,
+                          std::vector<SegmentSpan>& spans,
+                          std::vector<std::pair<size_t, size_t>>* splits = nullptr) {
+    spans.clear();
+    if (splits) splits->clear();
+    
+    // Now process using pre-decoded code points for speed
+    size_t pos = 0;
+    
+    while (pos < chars.size()) {
+        // Look for opening bracket 「 (U+300C)
+        size_t bracket_open = std::string::npos;
+        for (size_t i = pos; i < chars.size(); i++) {
+            if (chars[i] == 0x300C) {
+                bracket_open = i;
+                break;
+            }
+        }
+        
+        if (bracket_open == std::string::npos) {
+            // No more furigana hints, add rest of text as normal segment
+            if (pos < chars.size()) {
+                spans.push_back(SegmentSpan::normal(pos, chars.size()));
+            }
+            if (splits) splits->emplace_back(pos, chars.size());
+            break;
+        }
+        
+        // Look for closing bracket 」 (U+300D)
+        size_t bracket_close = std::string::npos;
+        for (size_t i = bracket_open + 1; i < chars.size(); i++) {
+            if (chars[i] == 0x300D) {
+                bracket_close = i;
+                break;
+            }
+        }
+        
+        if (bracket_close == std::string::npos) {
+            // No closing bracket, add rest as normal segment
+            spans.push_back(SegmentSpan::normal(pos, chars.size()));
+            if (splits) splits->emplace_back(pos, chars.size());
+            break;
+        }
+        
+        // Find where the "word" (kanji) starts before the opening bracket
+        // 🔥 BLAZING FAST BOUNDARY DETECTION USING PRE-DECODED CODE POINTS!
+        size_t word_start = bracket_open; // Start from bracket and search backward
+        size_t search_pos = bracket_open;
+        
+        auto is_kana_cp = Kana::contains;
+        
+        // Search backwards to find the start of the kanji/word that has furigana
+        // 🔥 SMART OKURIGANA DETECTION:
+        // - その男「おとこ」 → Stop at kana prefix "その", capture only "男"  
+        // - 昼ご飯「ひるごはん」 → Keep kana "ご" sandwiched between kanji, capture all "昼ご飯"
+        // Algorithm: Scan backward collecting chars. Stop at first kana that's followed (backward) by only more kana.
+        
+        // First pass: Find the last non-kana (kanji) character before the bracket
+        size_t last_kanji_pos = bracket_open;
+        while (last_kanji_pos > pos && is_kana_cp(chars[last_kanji_pos - 1])) {
+            last_kanji_pos--;
+        }
+        
+        if (last_kanji_pos > pos) {
+            last_kanji_pos--;  // Now pointing at the last kanji
+        }
+        size_t reach = last_kanji_pos;  // Lowest position looked at
+        
+        // Second pass: From last kanji, search backward for word boundary
+        // Include okurigana (kana between kanji), but stop at kana-only prefix
+        word_start = last_kanji_pos;
+        search_pos = last_kanji_pos;
+        
+        while (search_pos > pos) {
+            search_pos--;
+            uint32_t cp = chars[search_pos];
+            
+            // Punctuation and whitespace always stop us
+            if (ends_hinted_word(cp)) {
+                word_start = search_pos + 1;
+                break;
+            }
+            
+            // Check if this is kana
+            bool is_kana_char = is_kana_cp(cp);
+            
+            if (is_kana_char) {
+                // Check if there's ANY non-kana (kanji) before this position
+                bool has_kanji_before = false;
+                size_t check_pos = search_pos;
+                for (; check_pos > pos; check_pos--) {
+                    if (!is_kana_cp(chars[check_pos - 1])) {
+                        // Check it's not punctuation
+                        uint32_t check_cp = chars[check_pos - 1];
+                        if (check_cp >= 0x4E00 || (check_cp >= 0x3400 && check_cp <= 0x9FFF)) {  // CJK kanji ranges
+                            has_kanji_before = true;
+                            break;
+                        }
+                    }
+                }
+                reach = std::min(reach, has_kanji_before ? check_pos - 1 : pos);
+                
+                if (!has_kanji_before) {
+                    // This kana is not sandwiched - it's a prefix word → stop here
+                    word_start = search_pos + 1;
+                    break;
+                }
+                // Otherwise, this kana is sandwiched (okurigana) → continue
+            }
+            
+            // Update word_start to include this character
+            word_start = search_pos;
+        }
+        reach = std::min(reach, search_pos);
+        if (splits) splits->emplace_back(pos, reach);
+        
+        // Add text from current position up to where the word/kanji starts
+        // This captures particles and other text between furigana hints
+        if (word_start > pos) {
+            spans.push_back(SegmentSpan::normal(pos, word_start));
+        }
+        
+        // Reading between brackets
+        size_t reading_start = bracket_open + 1; // Position after 「
+        size_t reading_end = bracket_close;      // Position before 」
+        
+        // Fast whitespace trimming using code points
+        size_t trim_start = 0;
+        size_t trim_end = reading_end - reading_start;
+        
+        // Trim leading whitespace
+        while (trim_start < trim_end) {
+            uint32_t cp = chars[reading_start + trim_start];
+            if (cp != ' ' && cp != '\t' && cp != '\n' && cp != '\r') break;
+            trim_start++;
+        }
+        
+        // Trim trailing whitespace
+        while (trim_end > trim_start) {
+            uint32_t cp = chars[reading_start + trim_end - 1];
+            if (cp != ' ' && cp != '\t' && cp != '\n' && cp != '\r') break;
+            trim_end--;
+        }
+        
+        if (trim_start >= trim_end) {
+            // Empty reading - skip the entire furigana hint
+            pos = bracket_close + 1;
+            continue;
+        }
+        
+        // Trimmed reading
+        size_t trimmed_start = reading_start + trim_start;
+        size_t trimmed_end = reading_start + trim_end;
+        
+        // 🔥 SMART COMPOUND WORD DETECTION USING TRIE'S LONGEST-MATCH
+        // Walk the trie starting from kanji to find the longest compound word
+        size_t after_bracket = bracket_close + 1; // Position after 」
+        bool used_compound = false;
+        
+        if (dictionary && after_bracket < chars.size()) {
+            // Use trie to find longest match starting from word_start position
+            // This naturally implements longest-match algorithm:
+            // walk through the kanji first, then continue after the bracket
+            // (from the deepest kanji prefix that matched)
+            size_t match_length = dictionary->compound_word_length(
+                chars, word_start, bracket_open, after_bracket);
+            
+            // If we found a compound word, use it with the furigana reading replacing the kanji
+            // This ensures that 来「き」た becomes "きた" not "来た" for phoneme conversion
+            if (match_length > 0) {
+                // 🔥 KEY FIX: Use the furigana READING instead of kanji!
+                spans.push_back(SegmentSpan::compound(word_start, trimmed_start, trimmed_end,
+                                                      after_bracket, after_bracket + match_length));
+                pos = after_bracket + match_length;
+                used_compound = true;
+            }
+        }
+        
+        if (!used_compound) {
+            // No compound found, use the furigana hint
+            spans.push_back(SegmentSpan::furigana(word_start, bracket_open, trimmed_start, trimmed_end,
+                                                  bracket_close + 1));
+            pos = bracket_close + 1;
+        }
+    }
+    
+}
+
+std::vector<SegmentSpan> parse_furigana_spans(const std::vector<uint32_t>& chars,
+                                              const PhonemeConverter* dictionary = nullptr) {
+    std::vector<SegmentSpan> spans;
+    parse_furigana_spans(chars, dictionary, spans);
+    return spans;
+}
+
+
+
+
+/**
+ * Parse text into segments, extracting furigana hints.
+ * String form of parse_furigana_spans() (see there for the rules).
+ * 
+ * @param text Input text with potential furigana hints (e.g., 健太「けんた」)
+ * @param segmenter Optional word segmenter for compound word detection
+ * @return Vector of text segments with furigana hints properly parsed
+ */
+std::vector<TextSegment> parse_furigana_segments(const std::string& text, WordSegmenter* segmenter = nullptr) {
+    std::vector<uint32_t> chars;
+    std::vector<size_t> byte_positions;
+    decode_utf8(text, chars, &byte_positions);
+    
+    auto substr = [&](size_t begin, size_t end) {
+        return text.substr(byte_positions[begin], byte_positions[end] - byte_positions[begin]);
+    };
+    
+    std::vector<TextSegment> segments;
+    for (const SegmentSpan& span : parse_furigana_spans(chars, segmenter ? &segmenter->get_dictionary() : nullptr)) {
+        if (span.type == SegmentType::FURIGANA_HINT) {
+            segments.push_back(TextSegment(substr(span.text_begin, span.text_end),
+                                           substr(span.reading_begin, span.reading_end),
+                                           byte_positions[span.origin]));
+        } else {
+            segments.push_back(TextSegment(substr(span.reading_begin, span.reading_end) +
+                                           substr(span.text_begin, span.text_end),
+                                           byte_positions[span.origin]));
+        }
+    }
+    
+    return segments;
+}
+
+/**
+ * Helper functions for PhonemeConverter with word segmentation
+ * Defined here after WordSegmenter class is complete
+ */
+namespace SegmentedConversion {
+    /**
+     * Reusable buffers of convert_with_segmentation()
+     * Kept between calls (see ConversionContext), so steady-state
+     * conversion does not allocate.
+     */
+    struct Scratch {
+        std::vector<uint32_t> chars;        // Decoded input
+        std::vector<SegmentSpan> spans;     // Furigana parse
+        std::vector<uint32_t> compound;     // Reading + suffix of a compound word
+        MatchLattice lattice;               // Per-span dictionary matches
+        std::vector<std::pair<size_t, size_t>> words;  // Word boundaries (instrumented runs only)
+    };
+    
+    /**
+     * Convert with word segmentation support
+     * Fused single-pass pipeline over pre-decoded text:
+     * 1) Decode UTF-8 once and parse furigana hints into code point spans
+     * 2) Segment each span into words (one dictionary walk per position)
+     * 3) Append each word's phonemes straight into the result
+     * Writes phonemes with spaces between words to result (replacing its contents)
+     * 
+     * BLAZING FAST: No per-word strings and no re-decoding; the phoneme
+     * matched at the start of a word is reused from the segmentation walk
+     * 
+     * @param stats Counters to record into, or NULL. Recording splits each span
+     *              into a boundary pass and an emission pass so the two stages
+     *              can be timed separately (same output, slightly slower).
+     * @param spans Recorder for the alignment of the output to data, or NULL
+     */
+    void convert_with_segmentation(PhonemeConverter& converter, WordSegmenter& segmenter,
+                                   const char* data, size_t length, Scratch& scratch, std::string& result,
+                                   ConversionStats* stats = nullptr, SpanRecorder* spans = nullptr) {
+        using Clock = ConversionStats::Clock;
+        Clock::time_point parse_start = stats ? Clock::now() : Clock::time_point();
+        
+        // 🔥 STEP 1: Parse furigana hints into structured segments
+        // 健太「けんた」はバカ → [furigana(健太, けんた), normal(はバカ)]
+        // 見「み」て → [normal(みて)] (compound word detected)
+        std::vector<uint32_t>& chars = scratch.chars;
+        decode_utf8(data, length, chars, spans ? &spans->byte_positions : nullptr);
+        parse_furigana_spans(chars, &converter, scratch.spans);
+        if (spans) {
+            spans->clear();
+        }
+        if (stats) {
+            stats->add_time(STAT_PARSE_NS, parse_start, Clock::now());
+        }
+        
+        result.clear();
+        result.reserve(length * 2);
+        bool first_word = true;
+        
+        // STEP 3 (per word): Convert to phonemes with particle handling
+        MatchLattice& lattice = scratch.lattice;
+        lattice.bind(converter);
+        lattice.record_stats(stats);
+        lattice.record_spans(spans);
+        auto emit_word = [&](size_t begin, size_t end) {
+            if (!first_word) result += ' ';  // Add space between words
+            first_word = false;
+            if (spans) {
+                spans->begin_word();
+            }
+            
+            // Particles read differently on their own (は → "wa")
+            std::string_view reading = end - begin == 1 ? Kana::word_reading(lattice.text()[begin])
+                                                        : std::string_view();
+            if (!reading.empty()) {
+                size_t out_begin = result.size();
+                result += reading;
+                if (spans) {
+                    spans->add(begin, end, out_begin, result.size(), SPAN_MATCHED);
+                }
+            } else {
+                lattice.append_phonemes(begin, end, result);
+            }
+        };
+        
+        auto segment_span = [&]() {
+            if (!stats) {
+                segmenter.for_each_word(lattice, emit_word);
+                return;
+            }
+            Clock::time_point segment_start = Clock::now();
+            scratch.words.clear();
+            segmenter.for_each_word(lattice, [&](size_t begin, size_t end) {
+                scratch.words.emplace_back(begin, end);
+            });
+            Clock::time_point emit_start = Clock::now();
+            for (const auto& word : scratch.words) {
+                emit_word(word.first, word.second);
+            }
+            stats->add_time(STAT_SEGMENTATION_NS, segment_start, emit_start);
+            stats->add_time(STAT_LOOKUP_NS, emit_start, Clock::now());
+        };
+        
+        // 🔥 STEP 2: Segment into words using structured segments with phoneme fallback
+        // Furigana segments are treated as atomic units
+        std::vector<uint32_t>& compound = scratch.compound;
+        for (const SegmentSpan& span : scratch.spans) {
+            if (span.type == SegmentType::FURIGANA_HINT) {
+                if (spans) {
+                    spans->map_reading(span.reading_begin, span.reading_end, span.origin, span.source_end, 0);
+                }
+                lattice.reset(chars, span.reading_begin, span.reading_end);
+                Clock::time_point emit_start = stats ? Clock::now() : Clock::time_point();
+                emit_word(span.reading_begin, span.reading_end);
+                if (stats) {
+                    stats->add_time(STAT_LOOKUP_NS, emit_start, Clock::now());
+                }
+            } else if (span.reading_begin == span.reading_end) {
+                if (spans) {
+                    spans->map_source();
+                }
+                lattice.reset(chars, span.text_begin, span.text_end);
+                segment_span();
+            } else {
+                // Compound word: furigana reading + following text
+                compound.assign(chars.begin() + span.reading_begin, chars.begin() + span.reading_end);
+                compound.insert(compound.end(), chars.begin() + span.text_begin, chars.begin() + span.text_end);
+                if (spans) {
+                    size_t reading_length = span.reading_end - span.reading_begin;
+                    spans->map_reading(0, reading_length, span.origin, span.text_begin,
+                                       span.text_begin - reading_length);
+                }
+                lattice.reset(compound, 0, compound.size());
+                segment_span();
+            }
+        }
+        lattice.record_stats(nullptr);
+        lattice.record_spans(nullptr);
+    }
+    
+    /**
+     * Convert with word segmentation support (one-shot form, see above)
+     * Returns phonemes with spaces between words
+     */
+    std::string convert_with_segmentation(PhonemeConverter& converter, const std::string& japanese_text, WordSegmenter& segmenter) {
+        Scratch scratch;
+        std::string result;
+        convert_with_segmentation(converter, segmenter, japanese_text.data(), japanese_text.size(), scratch, result);
+        return result;
+    }
+    
+    /**
+     * Convert with word segmentation and detailed information
+     * Includes furigana hint processing for proper name handling
+     * BLAZING FAST: Uses pre-decoded UTF-8 and structured segments
+     */
+    ConversionResult convert_detailed_with_segmentation(PhonemeConverter& converter, const std::string& japanese_text, WordSegmenter& segmenter) {
+        // 🔥 STEP 1: Parse furigana hints into structured segments
+        auto segments = parse_furigana_segments(japanese_text, &segmenter);
+        
+        // 🔥 STEP 2: Segment into words using structured segments with phoneme fallback
+        auto words = segmenter.segment_from_segments(segments);
+        
+        // 🔥 STEP 3: Convert each word to phonemes with particle handling
+        ConversionResult result;
+        size_t byte_offset = 0;
+        std::vector<uint32_t> word_chars;
+        
+        for (size_t i = 0; i < words.size(); i++) {
+            if (i > 0) result.phonemes += " ";  // Add space between words
+            
+            // Particles read differently on their own (は → "wa")
+            decode_utf8(words[i], word_chars, nullptr);
+            std::string_view reading = word_chars.size() == 1 ? Kana::word_reading(word_chars[0])
+                                                              : std::string_view();
+            if (!reading.empty()) {
+                result.phonemes += reading;
+                // Add to matches for consistency
+                Match match;
+                match.original = words[i];
+                match.phoneme = std::string(reading);
+                match.start_index = byte_offset;
+                result.matches.push_back(match);
+            } else {
+                auto word_result = converter.convert_detailed(words[i]);
+                
+                // Adjust match positions to account for original text position
+                for (auto& match : word_result.matches) {
+                    match.start_index += byte_offset;
+                    result.matches.push_back(match);
+                }
+                
+                result.phonemes += word_result.phonemes;
+                result.unmatched.insert(result.unmatched.end(), 
+                                       word_result.unmatched.begin(), 
+                                       word_result.unmatched.end());
+            }
+            
+            byte_offset += words[i].length();
+        }
+        
+        return result;
+    }
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CONVERSION CONTEXT
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Reusable state for converting many texts
+ * 
+ * Owns every buffer a conversion needs (decoded text, furigana spans,
+ * match lattice, output). They only grow, so once a context has seen an
+ * input of a given size, converting another one performs no heap
+ * allocation - dictionary matches are views into the trie and the output
+ * is written in place. One context per thread; it is not thread-safe.
+ */
+class ConversionContext {
+private:
+    SegmentedConversion::Scratch scratch;
+    std::string output;
+    SpanRecorder recorder;
+    
+public:
+    /**
+     * Convert data[0, length) into the context's output buffer
+     * 
+     * @param segmenter Word segmenter to use, or NULL for plain longest-match
+     * @return The phonemes (valid until the next call on this context)
+     */
+    const std::string& convert(PhonemeConverter& converter, WordSegmenter* segmenter,
+                               const char* data, size_t length) {
+        if (Stats::active()) {
+            return convert_recorded(converter, segmenter, data, length);
+        }
+        if (segmenter) {
+            SegmentedConversion::convert_with_segmentation(converter, *segmenter, data, length, scratch, output);
+        } else {
+            decode_utf8(data, length, scratch.chars, nullptr);
+            output.clear();
+            converter.append_phonemes(scratch.chars, 0, scratch.chars.size(), output);
+        }
+        return output;
+    }
+    
+    /**
+     * convert() with every stage recorded into the calling thread's statistics
+     * Plain longest-match runs through the lattice too, so its walks are counted.
+     */
+    const std::string& convert_recorded(PhonemeConverter& converter, WordSegmenter* segmenter,
+                                        const char* data, size_t length) {
+        using Clock = ConversionStats::Clock;
+        ConversionStats stats;
+        
+        if (segmenter) {
+            SegmentedConversion::convert_with_segmentation(converter, *segmenter, data, length, scratch, output,
+                                                           &stats);
+        } else {
+            Clock::time_point parse_start = Clock::now();
+            decode_utf8(data, length, scratch.chars, nullptr);
+            Clock::time_point lookup_start = Clock::now();
+            
+            MatchLattice& lattice = scratch.lattice;
+            lattice.bind(converter);
+            lattice.record_stats(&stats);
+            lattice.reset(scratch.chars, 0, scratch.chars.size());
+            output.clear();
+            lattice.append_phonemes(0, scratch.chars.size(), output);
+            lattice.record_stats(nullptr);
+            
+            stats.add_time(STAT_PARSE_NS, parse_start, lookup_start);
+            stats.add_time(STAT_LOOKUP_NS, lookup_start, Clock::now());
+        }
+        
+        stats[STAT_CONVERSIONS] = 1;
+        stats[STAT_INPUT_BYTES] = length;
+        stats[STAT_OUTPUT_BYTES] = output.size();
+        Stats::publish(stats);
+        return output;
+    }
+    
+    /**
+     * convert() that also aligns the output to the input (see spans())
+     * Plain longest-match runs through the lattice so every match is seen.
+     */
+    const std::string& convert_spans(PhonemeConverter& converter, WordSegmenter* segmenter,
+                                     const char* data, size_t length) {
+        ConversionStats stats;
+        ConversionStats* recorded = Stats::active() ? &stats : nullptr;
+        
+        if (segmenter) {
+            SegmentedConversion::convert_with_segmentation(converter, *segmenter, data, length, scratch, output,
+                                                           recorded, &recorder);
+        } else {
+            decode_utf8(data, length, scratch.chars, &recorder.byte_positions);
+            recorder.clear();
+            
+            MatchLattice& lattice = scratch.lattice;
+            lattice.bind(converter);
+            lattice.record_stats(recorded);
+            lattice.record_spans(&recorder);
+            lattice.reset(scratch.chars, 0, scratch.chars.size());
+            output.clear();
+            lattice.append_phonemes(0, scratch.chars.size(), output);
+            lattice.record_stats(nullptr);
+            lattice.record_spans(nullptr);
+        }
+        
+        if (recorded) {
+            stats[STAT_CONVERSIONS] = 1;
+            stats[STAT_INPUT_BYTES] = length;
+            stats[STAT_OUTPUT_BYTES] = output.size();
+            Stats::publish(stats);
+        }
+        return output;
+    }
+    
+    /**
+     * Alignment of the last convert_spans() call, in output order
+     */
+    const std::vector<MatchSpan>& spans() const {
+        return recorder.spans;
+    }
+    
+    /**
+     * Result of the last convert() call
+     */
+    const std::string& result() const {
+        return output;
+    }
+    
+    /**
+     * Replace the result with phonemes converted earlier (cache hit)
+     */
+    const std::string& set_result(std::string_view phonemes) {
+        output.assign(phonemes.data(), phonemes.size());
+        return output;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// INTERLEAVED BATCH CONVERSION
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Plain longest-match conversion of many texts with their walks interleaved
+ * 
+ * PhonemeConverter::append_phonemes() for a whole batch at once: every
+ * text keeps its own greedy position, and its next walk goes to the
+ * interleaved kernel (PhonemeConverter::match_interleaved()) as soon as
+ * its previous match is known. With a few dozen texts the kernel always
+ * has independent walks to overlap. The outputs are byte-identical to
+ * converting each text alone; the win is throughput, not latency, since
+ * a text finishes only when the walks around it let it.
+ * 
+ * Like ConversionContext, the buffers only grow: reuse one object per thread.
+ */
+class InterleavedBatch {
+private:
+    struct Text {
+        std::vector<uint32_t> chars;
+        size_t pos = 0;
+        std::string output;
+    };
+    
+    std::vector<Text> texts;     // [0, count) are in use
+    size_t count = 0;
+    std::vector<uint32_t> ready;  // Texts whose next walk can start
+    const PhonemeConverter* converter = nullptr;
+    
+    Text& next_text() {
+        if (count == texts.size()) texts.emplace_back();
+        Text& text = texts[count++];
+        text.pos = 0;
+        text.output.clear();
+        return text;
+    }
+
+public:
+    /**
+     * Drop the texts of the previous batch (storage is kept)
+     */
+    void clear() {
+        count = 0;
+    }
+    
+    /**
+     * Queue data[0, length) for conversion
+     */
+    void add(const char* data, size_t length) {
+        Text& text = next_text();
+        decode_utf8(data, length, text.chars, nullptr);
+    }
+    
+    /**
+     * Queue a text whose phonemes are known already (cache hit)
+     */
+    void add_result(std::string_view phonemes) {
+        Text& text = next_text();
+        text.chars.clear();
+        text.output.assign(phonemes.data(), phonemes.size());
+    }
+    
+    /**
+     * Convert every queued text
+     */
+    void convert(const PhonemeConverter& dictionary) {
+        converter = &dictionary;
+        ready.clear();
+        for (size_t i = count; i-- > 0;) {
+            if (!texts[i].chars.empty()) ready.push_back(static_cast<uint32_t>(i));
+        }
+        dictionary.match_interleaved(*this);
+    }
+    
+    size_t size() const { return count; }
+    
+    /**
+     * Phonemes of the index-th queued text (valid until the next clear())
+     */
+    const std::string& result(size_t index) const {
+        return texts[index].output;
+    }
+    
+    // Source interface of PhonemeConverter::match_interleaved()
+    bool next(MatchQuery& query) {
+        if (ready.empty()) return false;
+        uint32_t index = ready.back();
+        ready.pop_back();
+        Text& text = texts[index];
+        query = {&text.chars, text.pos, text.chars.size(), index};
+        return true;
+    }
+    
+    void done(const MatchQuery& query, const DictionaryMatch& found) {
+        Text& text = texts[query.tag];
+        if (found.phoneme_length > 0) {
+            converter->append_match(text.chars, text.pos, found.phoneme_length, found.phoneme, text.output);
+            text.pos += found.phoneme_length;
+        } else {
+            append_utf8(text.output, text.chars[text.pos]);
+            text.pos++;
+        }
+        if (text.pos < text.chars.size()) ready.push_back(query.tag);
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// RESULT CACHE
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Bounded LRU cache of whole conversion results, keyed by input text
+ * 
+ * Chat lines, UI strings and names repeat constantly; a hit replaces the
+ * whole pipeline by one hash lookup and a copy. The cache is split into
+ * SHARD_COUNT independently locked LRU lists (chosen by the hash of the
+ * input), so threads converting different texts rarely contend.
+ * 
+ * Entries remember the dictionary generation and segmentation setting they
+ * were converted with; a hit on a stale entry counts as a miss. Disabled
+ * (capacity 0) by default - then lookup() costs a single atomic load.
+ */
+class ResultCache {
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+    
+    /** @brief Longer inputs are not cached (they rarely repeat verbatim) */
+    static constexpr size_t MAX_INPUT_BYTES = 1024;
+    
+private:
+    struct Entry {
+        std::string input;
+        std::string output;
+        uint64_t generation;
+        bool segmentation;
+    };
+    
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;   // Most recently used first
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;  // Keys view Entry::input
+    };
+    
+    Shard shards[SHARD_COUNT];
+    std::atomic<size_t> capacity{0};
+    std::atomic<size_t> shard_capacity{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    
+    Shard& shard_for(std::string_view input) {
+        return shards[std::hash<std::string_view>()(input) % SHARD_COUNT];
+    }
+    
+    static void trim(Shard& shard, size_t limit) {
+        while (shard.entries.size() > limit) {
+            shard.index.erase(shard.entries.back().input);
+            shard.entries.pop_back();
+        }
+    }
+    
+public:
+    /**
+     * Set the maximum number of cached results (0 disables and empties the cache)
+     * Rounded up to a multiple of SHARD_COUNT; shrinking evicts the oldest entries.
+     */
+    void set_capacity(size_t entries) {
+        size_t per_shard = (entries + SHARD_COUNT - 1) / SHARD_COUNT;
+        capacity = entries;
+        shard_capacity = per_shard;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            trim(shard, per_shard);
+        }
+    }
+    
+    /**
+     * Copy the cached result for input into context
+     * @return true on a hit
+     */
+    bool lookup(std::string_view input, uint64_t generation, bool segmentation, ConversionContext& context) {
+        if (shard_capacity.load(std::memory_order_relaxed) == 0 || input.size() > MAX_INPUT_BYTES) {
+            return false;
+        }
+        
+        Shard& shard = shard_for(input);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.index.find(input);
+            if (found != shard.index.end() && found->second->generation == generation &&
+                found->second->segmentation == segmentation) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+                context.set_result(found->second->output);
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    /**
+     * Remember a result (replaces a stale entry for the same input)
+     */
+    void store(std::string_view input, uint64_t generation, bool segmentation, const std::string& output) {
+        size_t limit = shard_capacity.load(std::memory_order_relaxed);
+        if (limit == 0 || input.size() > MAX_INPUT_BYTES) {
+            return;
+        }
+        
+        Shard& shard = shard_for(input);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(input);
+        if (found != shard.index.end()) {
+            Entry& entry = *found->second;
+            entry.output = output;
+            entry.generation = generation;
+            entry.segmentation = segmentation;
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return;
+        }
+        
+        shard.entries.push_front({std::string(input), output, generation, segmentation});
+        shard.index.emplace(shard.entries.front().input, shard.entries.begin());
+        trim(shard, limit);
+    }
+    
+    /**
+     * Drop all entries (counters are kept)
+     */
+    void clear() {
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.index.clear();
+            shard.entries.clear();
+        }
+    }
+    
+    size_t get_capacity() const { return capacity; }
+    uint64_t get_hits() const { return hits.load(std::memory_order_relaxed); }
+    uint64_t get_misses() const { return misses.load(std::memory_order_relaxed); }
+    
+    /**
+     * Number of cached results
+     */
+    size_t size() {
+        size_t total = 0;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// PACKED TRIE WRITER (v2 "JPNT" compiler)
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Serialises a finalized FlatTrie into the packed v2 node graph read by BinaryTrie
+ * 
+ * - The flat trie already holds phonemes and words in one graph (HAS_VALUE / IS_WORD)
+ * - Nodes keep the flat trie's breadth-first order, so the hot upper levels sit together
+ * - Identical phoneme strings share a single value pool entry
+ * - Output is deterministic: children are sorted and the pool is ordered
+ *   by first use in the breadth-first walk
+ * 
+ * See TRIE_FORMAT.md for the byte layout.
+ */
+class PackedTrieWriter {
+private:
+    static void append_varint(std::string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+    
+    static size_t varint_size(uint32_t value) {
+        size_t size = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            size++;
+        }
+        return size;
+    }
+    
+    /**
+     * Length of text without a trailing incomplete UTF-8 sequence (so that
+     * no character is split between two automaton outputs)
+     */
+    static size_t utf8_boundary(std::string_view text) {
+        size_t lead = text.size();
+        while (lead > 0 && (static_cast<uint8_t>(text[lead - 1]) & 0xC0) == 0x80) lead--;
+        if (lead == 0) return 0;
+        uint8_t byte = static_cast<uint8_t>(text[lead - 1]);
+        size_t sequence = byte < 0x80 ? 1 : byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+        return lead - 1 + sequence > text.size() ? lead - 1 : text.size();
+    }
+    
+    /**
+     * Bytes of a node with count children of entry_size bytes
+     */
+    static uint64_t node_size(uint32_t count, bool has_value, uint32_t value_ref, size_t entry_size) {
+        uint64_t size = 1;
+        if (count > BinaryTrieFlags::COUNT_MASK) size += varint_size(count);
+        if (has_value) size += varint_size(value_ref);
+        return size + static_cast<uint64_t>(count) * entry_size;
+    }
+    
+    /**
+     * Append a node's flags, children count and value reference
+     */
+    static void append_node_header(std::string& data, uint32_t count, bool has_value, bool is_word,
+                                   uint32_t value_ref) {
+        uint8_t flags = 0;
+        if (has_value) flags |= BinaryTrieFlags::HAS_VALUE;
+        if (is_word) flags |= BinaryTrieFlags::IS_WORD;
+        if (count > BinaryTrieFlags::COUNT_MASK) {
+            flags |= BinaryTrieFlags::VARINT_COUNT;
+        } else {
+            flags |= static_cast<uint8_t>(count << BinaryTrieFlags::COUNT_SHIFT);
+        }
+        
+        data += static_cast<char>(flags);
+        if (flags & BinaryTrieFlags::VARINT_COUNT) append_varint(data, count);
+        if (has_value) append_varint(data, value_ref);
+    }
+    
+    /**
+     * Append one children table entry (3-byte code point + 4-byte relative
+     * offset, then the 3-byte output reference of an automaton entry)
+     */
+    static void append_child_entry(std::string& data, uint32_t cp, uint64_t target_offset,
+                                   size_t entry_size, uint32_t output_ref) {
+        char child_entry[BinaryTrieFlags::OUTPUT_ENTRY];
+        child_entry[0] = static_cast<char>(cp & 0xFF);
+        child_entry[1] = static_cast<char>((cp >> 8) & 0xFF);
+        child_entry[2] = static_cast<char>((cp >> 16) & 0xFF);
+        
+        // Offset is relative to the END of this entry
+        int64_t entry_end = static_cast<int64_t>(data.size() + entry_size);
+        int32_t relative = static_cast<int32_t>(static_cast<int64_t>(target_offset) - entry_end);
+        std::memcpy(child_entry + 3, &relative, sizeof(relative));
+        
+        child_entry[7] = static_cast<char>(output_ref & 0xFF);
+        child_entry[8] = static_cast<char>((output_ref >> 8) & 0xFF);
+        child_entry[9] = static_cast<char>((output_ref >> 16) & 0xFF);
+        data.append(child_entry, entry_size);
+    }
+    
+    /**
+     * Fill in the header, append the value pool and write the file
+     */
+    static void write_file(std::string& data, const std::string& pool, uint16_t version,
+                           const FlatTrie& trie, const std::string& output_path, size_t& file_size) {
+        size_t phoneme_count = 0;
+        size_t word_count = 0;
+        for (uint32_t node = 0; node < trie.node_count(); node++) {
+            if (trie.has_value(node)) phoneme_count++;
+            if (trie.is_word(node)) word_count++;
+        }
+        
+        BinaryTrieHeader header;
+        std::memcpy(header.magic, "JPNT", 4);
+        header.version_major = version;
+        header.version_minor = BinaryTrieFlags::FORMAT_MINOR;
+        header.phoneme_count = static_cast<uint32_t>(phoneme_count);
+        header.word_count = static_cast<uint32_t>(word_count);
+        header.root_offset = sizeof(BinaryTrieHeader);
+        header.values_offset = data.size();
+        std::memcpy(&data[0], &header, sizeof(header));
+        
+        data += pool;
+        file_size = data.size();
+        
+        std::ofstream out(output_path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Failed to open output file: " + output_path);
+        }
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write output file: " + output_path);
+        }
+    }
+
+public:
+    /** Statistics about the last written file */
+    struct Stats {
+        size_t node_count = 0;
+        size_t phoneme_count = 0;
+        size_t word_count = 0;
+        size_t unique_values = 0;
+        size_t file_size = 0;
+    };
+    
+    /**
+     * Serialise a finalized flat trie to a packed v2 file
+     * Throws std::runtime_error on I/O failure
+     */
+    static Stats write(const FlatTrie& trie, const std::string& output_path) {
+        Stats stats;
+        const uint32_t node_count = static_cast<uint32_t>(trie.node_count());
+        
+        // Value pool in first-use order (the trie's values are interned, so ids identify them)
+        std::vector<uint32_t> value_refs(node_count, 0);
+        std::unordered_map<uint64_t, uint32_t> pool_ids;
+        std::string pool;
+        for (uint32_t node = 0; node < node_count; node++) {
+            if (!trie.has_value(node)) continue;
+            std::string_view value = trie.value(node);
+            auto it = pool_ids.find(trie.value_id(node));
+            if (it == pool_ids.end()) {
+                it = pool_ids.emplace(trie.value_id(node), static_cast<uint32_t>(pool.size())).first;
+                append_varint(pool, static_cast<uint32_t>(value.size()));
+                pool.append(value.data(), value.size());
+                stats.unique_values++;
+            }
+            value_refs[node] = it->second;
+        }
+        
+        // Node offsets (entries are fixed size, so sizes are known up front)
+        std::vector<uint64_t> offsets(node_count);
+        uint64_t offset = sizeof(BinaryTrieHeader);
+        for (uint32_t node = 0; node < node_count; node++) {
+            uint32_t count = static_cast<uint32_t>(trie.edges_end(node) - trie.edges_begin(node));
+            offsets[node] = offset;
+            offset += node_size(count, trie.has_value(node), value_refs[node], BinaryTrieFlags::CHILD_ENTRY);
+        }
+        
+        if (offset + pool.size() > static_cast<uint64_t>(INT32_MAX)) {
+            throw std::runtime_error("Dictionary too large for 32-bit relative offsets");
+        }
+        
+        // Emit nodes
+        std::string data;
+        data.reserve(static_cast<size_t>(offset) + pool.size());
+        data.resize(sizeof(BinaryTrieHeader));
+        
+        for (uint32_t node = 0; node < node_count; node++) {
+            uint32_t count = static_cast<uint32_t>(trie.edges_end(node) - trie.edges_begin(node));
+            bool has_value = trie.has_value(node);
+            bool is_word = trie.is_word(node);
+            
+            append_node_header(data, count, has_value, is_word, value_refs[node]);
+            uint32_t word_below = trie.has_word_below(node) ? BinaryTrieFlags::WORD_BELOW : 0;
+            for (const FlatTrie::Edge* e = trie.edges_begin(node); e != trie.edges_end(node); ++e) {
+                append_child_entry(data, e->code_point | word_below, offsets[e->target],
+                                   BinaryTrieFlags::CHILD_ENTRY, 0);
+                word_below = 0;  // Only the first entry carries it
+            }
+            
+            stats.node_count++;
+            if (has_value) stats.phoneme_count++;
+            if (is_word) stats.word_count++;
+        }
+        
+        write_file(data, pool, BinaryTrieFlags::TRIE_VERSION, trie, output_path, stats.file_size);
+        return stats;
+    }
+    
+    /**
+     * Serialise a finalized flat trie to a v3 minimised automaton
+     * 
+     * Tails shared by many keys (conjugations, katakana loanwords) are
+     * stored once. A phoneme is split over the path of its key: each
+     * transition outputs the part that every entry below it has in common,
+     * a node's value is the rest of its own phoneme. Nodes whose flags,
+     * value and transitions (code point, output, target) are equal are
+     * then one state. Throws std::runtime_error on I/O failure.
+     */
+    static Stats write_automaton(const FlatTrie& trie, const std::string& output_path) {
+        Stats stats;
+        const uint32_t node_count = static_cast<uint32_t>(trie.node_count());
+        
+        // Common prefix of every phoneme at or below each node (children
+        // come later in breadth-first order, so a backward pass sees them first)
+        std::vector<std::string_view> common(node_count);
+        std::vector<uint8_t> has_phonemes(node_count, 0);
+        for (uint32_t node = node_count; node-- > 0;) {
+            bool found = trie.has_value(node);
+            std::string_view prefix = found ? trie.value(node) : std::string_view();
+            for (const FlatTrie::Edge* e = trie.edges_begin(node); e != trie.edges_end(node); ++e) {
+                if (!has_phonemes[e->target]) continue;
+                std::string_view other = common[e->target];
+                if (!found) {
+                    prefix = other;
+                    found = true;
+                    continue;
+                }
+                size_t length = 0;
+                size_t limit = std::min(prefix.size(), other.size());
+                while (length < limit && prefix[length] == other[length]) length++;
+                prefix = prefix.substr(0, length);
+            }
+            common[node] = prefix.substr(0, utf8_boundary(prefix));
+            has_phonemes[node] = found;
+        }
+        common[FlatTrie::ROOT] = std::string_view();  // The root has no incoming output
+        
+        auto edge_output = [&](uint32_t node, uint32_t target) {
+            return has_phonemes[target] ? common[target].substr(common[node].size()) : std::string_view();
+        };
+        auto residual = [&](uint32_t node) {
+            return trie.has_value(node) ? trie.value(node).substr(common[node].size()) : std::string_view();
+        };
+        
+        // Minimise bottom-up: a node's signature names its children by their state
+        std::vector<uint32_t> state_of(node_count);
+        std::vector<uint32_t> representative;  // First node (breadth-first) of each state
+        std::unordered_map<std::string, uint32_t> states;
+        std::string signature;
+        for (uint32_t node = node_count; node-- > 0;) {
+            signature.clear();
+            signature += static_cast<char>((trie.has_value(node) ? 1 : 0) | (trie.is_word(node) ? 2 : 0));
+            std::string_view value = residual(node);
+            append_varint(signature, static_cast<uint32_t>(value.size()));
+            signature.append(value.data(), value.size());
+            for (const FlatTrie::Edge* e = trie.edges_begin(node); e != trie.edges_end(node); ++e) {
+                std::string_view output = edge_output(node, e->target);
+                append_varint(signature, e->code_point);
+                append_varint(signature, state_of[e->target]);
+                append_varint(signature, static_cast<uint32_t>(output.size()));
+                signature.append(output.data(), output.size());
+            }
+            auto state = states.emplace(signature, static_cast<uint32_t>(representative.size()));
+            if (state.second) {
+                representative.push_back(node);
+            } else {
+                representative[state.first->second] = node;
+            }
+            state_of[node] = state.first->second;
+        }
+        std::unordered_map<std::string, uint32_t>().swap(states);
+        
+        // States in breadth-first order of their first node (the root is state 0 of the file)
+        std::vector<uint32_t> order(representative.size());
+        for (uint32_t s = 0; s < order.size(); s++) order[s] = s;
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return representative[a] < representative[b];
+        });
+        
+        // Output pool: offset 0 is the empty output, then first-use order
+        std::string pool(1, '\0');
+        std::unordered_map<std::string_view, uint32_t> pool_ids;  // Views into the trie's values
+        pool_ids.emplace(std::string_view(), 0);
+        auto intern = [&](std::string_view output) {
+            auto it = pool_ids.emplace(output, static_cast<uint32_t>(pool.size()));
+            if (it.second) {
+                append_varint(pool, static_cast<uint32_t>(output.size()));
+                pool.append(output.data(), output.size());
+            }
+            return it.first->second;
+        };
+        std::vector<uint32_t> value_refs(representative.size(), 0);
+        std::vector<uint32_t> output_refs;  // Per child entry, in emission order
+        for (uint32_t s : order) {
+            uint32_t node = representative[s];
+            if (trie.has_value(node)) value_refs[s] = intern(residual(node));
+            for (const FlatTrie::Edge* e = trie.edges_begin(node); e != trie.edges_end(node); ++e) {
+                output_refs.push_back(intern(edge_output(node, e->target)));
+            }
+        }
+        if (pool.size() > 0xFFFFFF) {
+            throw std::runtime_error("Dictionary outputs too large for 24-bit references");
+        }
+        stats.unique_values = pool_ids.size();
+        
+        // State offsets
+        std::vector<uint64_t> offsets(representative.size());
+        uint64_t offset = sizeof(BinaryTrieHeader);
+        for (uint32_t s : order) {
+            uint32_t node = representative[s];
+            uint32_t count = static_cast<uint32_t>(trie.edges_end(node) - trie.edges_begin(node));
+            offsets[s] = offset;
+            offset += node_size(count, trie.has_value(node), value_refs[s], BinaryTrieFlags::OUTPUT_ENTRY);
+        }
+        if (offset + pool.size() > static_cast<uint64_t>(INT32_MAX)) {
+            throw std::runtime_error("Dictionary too large for 32-bit relative offsets");
+        }
+        
+        // Emit states
+        std::string data;
+        data.reserve(static_cast<size_t>(offset) + pool.size());
+        data.resize(sizeof(BinaryTrieHeader));
+        size_t entry = 0;
+        for (uint32_t s : order) {
+            uint32_t node = representative[s];
+            uint32_t count = static_cast<uint32_t>(trie.edges_end(node) - trie.edges_begin(node));
+            append_node_header(data, count, trie.has_value(node), trie.is_word(node), value_refs[s]);
+            uint32_t word_below = trie.has_word_below(node) ? BinaryTrieFlags::WORD_BELOW : 0;
+            for (const FlatTrie::Edge* e = trie.edges_begin(node); e != trie.edges_end(node); ++e) {
+                append_child_entry(data, e->code_point | word_below, offsets[state_of[e->target]],
+                                   BinaryTrieFlags::OUTPUT_ENTRY, output_refs[entry++]);
+                word_below = 0;
+            }
+        }
+        
+        for (uint32_t node = 0; node < node_count; node++) {
+            if (trie.has_value(node)) stats.phoneme_count++;
+            if (trie.is_word(node)) stats.word_count++;
+        }
+        stats.node_count = representative.size();
+        write_file(data, pool, BinaryTrieFlags::AUTOMATON_VERSION, trie, output_path, stats.file_size);
+        return stats;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// WORD LIST WRITER ("JPNW" compiler)
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Compiles a text word list into the front-coded "JPNW" format
+ * 
+ * Words are decoded once, sorted by code point and deduplicated; each one
+ * stores only the code points that differ from its predecessor. Loading
+ * then skips line splitting, trimming, UTF-8 decoding and the key sort
+ * (WordSegmenter::load_from_buffer()). See TRIE_FORMAT.md for the layout.
+ */
+class WordListWriter {
+private:
+    static void append_varint(std::string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+public:
+    /** Statistics about the last written file */
+    struct Stats {
+        size_t word_count = 0;
+        size_t file_size = 0;
+    };
+    
+    /**
+     * Compile word_file_path (one word per line) to output_path
+     * Throws std::runtime_error on I/O failure
+     */
+    static Stats write(const std::string& word_file_path, const std::string& output_path) {
+        std::ifstream file(word_file_path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open word file: " + word_file_path);
+        }
+        
+        // Same line rules as WordSegmenter::load_from_file()
+        std::vector<std::vector<uint32_t>> words;
+        std::string line;
+        while (std::getline(file, line)) {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                words.emplace_back();
+                decode_utf8(line, words.back(), nullptr);
+            }
+        }
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        
+        Stats stats;
+        std::string data(sizeof(WordListHeader), '\0');
+        const std::vector<uint32_t>* previous = nullptr;
+        for (const std::vector<uint32_t>& word : words) {
+            size_t shared = 0;
+            if (previous) {
+                size_t limit = std::min(previous->size(), word.size());
+                while (shared < limit && (*previous)[shared] == word[shared]) shared++;
+            }
+            append_varint(data, static_cast<uint32_t>(shared));
+            append_varint(data, static_cast<uint32_t>(word.size() - shared));
+            for (size_t i = shared; i < word.size(); i++) {
+                append_varint(data, word[i]);
+            }
+            previous = &word;
+            stats.word_count++;
+        }
+        
+        WordListHeader header;
+        std::memcpy(header.magic, "JPNW", 4);
+        header.version_major = 1;
+        header.version_minor = 0;
+        header.word_count = static_cast<uint32_t>(stats.word_count);
+        header.reserved = 0;
+        std::memcpy(&data[0], &header, sizeof(header));
+        stats.file_size = data.size();
+        
+        std::ofstream out(output_path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Failed to open output file: " + output_path);
+        }
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write output file: " + output_path);
+        }
+        
+        return stats;
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// DICTIONARY SNAPSHOT CACHE
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Packed v2 snapshots of built dictionaries, keyed by what they were built from
+ * 
+ * JSON dictionaries, v1 tries and word lists are inserted entry by entry on
+ * every load. With a cache directory (jpn_phoneme_set_snapshot_cache()) the
+ * finished flat trie is also written there as a v2 trie named after a hash
+ * of its sources, and later loads of the same sources map that file
+ * instead: a second launch pages the dictionary in rather than rebuilding
+ * it. A word list's key includes the key of the dictionary it was added to.
+ * 
+ * Snapshots are written under a temporary name and renamed into place, so
+ * a crashed writer never leaves a partial file. The cache directory is not
+ * ours, though (apps clear it, disks damage it), so each snapshot ends
+ * with a trailer holding the size and a checksum of the trie before it. A
+ * snapshot that fails those checks is deleted and rebuilt; one that cannot
+ * be written is skipped and the dictionary is built as usual.
+ * 
+ * Hashing the whole file would cost more than mapping it, so the checksum
+ * is only compared once: a snapshot whose checksum matched gets the
+ * modification time recorded in its trailer, and a later load whose file
+ * still has that time and size skips the hash. Damage that keeps the time
+ * (a restored backup, bit rot) is not ruled out by that, so such a load
+ * runs the structural validation of untrusted tries instead, which fails a
+ * snapshot whose nodes no longer hold together. Only a freshly hashed
+ * snapshot is mapped without it.
+ */
+class SnapshotCache {
+private:
+    #pragma pack(push, 1)
+    struct Trailer {
+        char magic[4];          // "JPNS"
+        uint32_t reserved;      // 0
+        uint64_t payload_size;  // Bytes of the v2 trie before the trailer
+        uint64_t checksum;      // key(0, trie bytes)
+        int64_t verified_time;  // Modification time (seconds) given to the file once the checksum matched
+    };
+    #pragma pack(pop)
+    
+    // Changes every key when the writer's format does ("JPNT" + version + minor)
+    static constexpr uint64_t FORMAT_SEED = 0x4A504E5400000000ULL | (BinaryTrieFlags::FORMAT_MINOR << 16) |
+                                            BinaryTrieFlags::TRIE_VERSION;
+    
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+    
+    static std::string path_of(const std::string& directory, uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.trie", static_cast<unsigned long long>(key));
+        return directory + "/" + name;
+    }
+    
+    /**
+     * Size and modification time (seconds) of a file
+     */
+    static bool file_time(const std::string& path, uint64_t& size, int64_t& time) {
+    #ifdef _WIN32
+        struct _stat64 info;
+        if (_stat64(path.c_str(), &info) != 0) return false;
+    #else
+        struct stat info;
+        if (::stat(path.c_str(), &info) != 0) return false;
+    #endif
+        size = static_cast<uint64_t>(info.st_size);
+        time = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+    
+    /**
+     * Set a file's access and modification time (seconds)
+     */
+    static bool set_file_time(const std::string& path, int64_t time) {
+    #ifdef _WIN32
+        struct __utimbuf64 times = {time, time};
+        return _utime64(path.c_str(), &times) == 0;
+    #else
+        struct utimbuf times = {static_cast<time_t>(time), static_cast<time_t>(time)};
+        return ::utime(path.c_str(), &times) == 0;
+    #endif
+    }
+
+public:
+    /**
+     * Key of a source, 64-bit hash of its bytes (never 0)
+     * @param parent Key of the dictionary the source is added to, 0 for a dictionary
+     */
+    static uint64_t key(uint64_t parent, const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t h = mix(FORMAT_SEED ^ mix(parent) ^ size);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            h = mix(h ^ word);
+        }
+        uint64_t tail = 0;
+        if (i < size) std::memcpy(&tail, bytes + i, size - i);
+        h = mix(h ^ tail);
+        return h ? h : 1;
+    }
+    
+    /**
+     * Key of a source file (see key()), 0 if it cannot be read
+     */
+    static uint64_t file_key(const std::string& path, uint64_t parent) {
+        MemoryMappedFile mapping;
+        if (mapping.open(path)) {
+            return key(parent, mapping.data(), mapping.size());
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return 0;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string data = buffer.str();
+        return key(parent, data.data(), data.size());
+    }
+    
+    /**
+     * Map the snapshot stored under key
+     * @return The converter, or NULL if there is none (a damaged one is deleted)
+     */
+    static std::unique_ptr<PhonemeConverter> load(const std::string& directory, uint64_t key) {
+        std::string path = path_of(directory, key);
+        if (!std::ifstream(path, std::ios::binary).is_open()) {
+            return nullptr;
+        }
+        auto converter = std::make_unique<PhonemeConverter>();
+        bool hashed = false;
+        if (!verify(path, hashed) || !converter->try_load_binary_format(path, hashed) || !converter->is_packed()) {
+            std::cerr << "⚠️  Discarding damaged dictionary snapshot: " << path << std::endl;
+            std::remove(path.c_str());
+            return nullptr;
+        }
+        return converter;
+    }
+    
+    /**
+     * Write a finalized flat trie as the snapshot of key (failures are only logged)
+     */
+    static void store(const std::string& directory, uint64_t key, const FlatTrie& trie) {
+        std::string path = path_of(directory, key);
+        
+        // Unique per writer, so concurrent processes never share a temporary file
+        std::ostringstream temporary;
+        temporary << path << ".tmp" << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id())
+                  << std::chrono::steady_clock::now().time_since_epoch().count();
+        try {
+            PackedTrieWriter::write(trie, temporary.str());
+            append_trailer(temporary.str());
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️  Dictionary snapshot not cached: " << e.what() << std::endl;
+            std::remove(temporary.str().c_str());
+            return;
+        }
+        if (std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+            std::remove(temporary.str().c_str());  // Windows: another writer got there first
+            return;
+        }
+        std::cout << "💾 Cached dictionary snapshot: " << path << std::endl;
+    }
+
+private:
+    /**
+     * Check a snapshot's trailer against the trie bytes before it
+     * The bytes are only hashed when the file's time and size no longer
+     * show an earlier match; a match stamps the file again. The stamp is
+     * no proof that the bytes are intact (a copy or restore can keep the
+     * time), so a snapshot that was not hashed still gets the structural
+     * check of PackedTrie::attach().
+     * @param hashed Set when the checksum was checked (the trie can be trusted)
+     */
+    static bool verify(const std::string& path, bool& hashed) {
+        MemoryMappedFile mapping;
+        if (!mapping.open(path) || mapping.size() < sizeof(Trailer)) {
+            return false;
+        }
+        const uint8_t* data = static_cast<const uint8_t*>(mapping.data());
+        size_t payload_size = mapping.size() - sizeof(Trailer);
+        Trailer trailer;
+        std::memcpy(&trailer, data + payload_size, sizeof(trailer));
+        if (std::memcmp(trailer.magic, "JPNS", 4) != 0 || trailer.payload_size != payload_size) {
+            return false;
+        }
+        
+        uint64_t size;
+        int64_t time;
+        if (file_time(path, size, time) && size == mapping.size() && time == trailer.verified_time) {
+            hashed = false;
+            return true;
+        }
+        if (trailer.checksum != SnapshotCache::key(0, data, payload_size)) {
+            return false;
+        }
+        set_file_time(path, trailer.verified_time);
+        hashed = true;
+        return true;
+    }
+    
+    /**
+     * Append the trailer to a freshly written v2 trie and stamp the file
+     * (its checksum is taken from the bytes just written)
+     * Throws std::runtime_error on I/O failure
+     */
+    static void append_trailer(const std::string& path) {
+        Trailer trailer;
+        std::memcpy(trailer.magic, "JPNS", 4);
+        trailer.reserved = 0;
+        // A second in the past: a write after the stamp, even within the same
+        // second, leaves a later time than this
+        trailer.verified_time = static_cast<int64_t>(std::time(nullptr)) - 1;
+        {
+            MemoryMappedFile mapping;
+            if (!mapping.open(path)) {
+                throw std::runtime_error("Failed to read back snapshot: " + path);
+            }
+            trailer.payload_size = mapping.size();
+            trailer.checksum = SnapshotCache::key(0, mapping.data(), mapping.size());
+        }
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write snapshot trailer: " + path);
+        }
+        set_file_time(path, trailer.verified_time);  // Kept by the rename; if it fails, the first load hashes
+    }
+};
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CORPUS BATCH MODE (command line)
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * Non-interactive conversion of a corpus, one text per line (--batch)
+ * 
+ * The reader cuts the input into chunks of whole lines, a pool of worker
+ * threads converts them (each with its own ConversionContext, sharing the
+ * read-only dictionary) and a writer thread emits the chunks in input
+ * order. Each chunk is formatted in memory and written with one fwrite,
+ * so the output is never flushed per line, and only a few chunks per
+ * worker are in flight, so inputs of any size stream through in constant
+ * memory. Records:
+ * 
+ * - NDJSON: {"input":"...","phonemes":"..."} (JSON string escapes)
+ * - TSV:    input<TAB>phonemes (tab, CR, LF and backslash escaped as \t \r \n \\)
+ * 
+ * Aggregate throughput goes to stderr at the end.
+ */
+class CorpusBatch {
+public:
+    enum class Format { NDJSON, TSV };
+    
+    struct Options {
+        std::string input_path = "-";   // "-" = stdin
+        std::string output_path = "-";  // "-" = stdout
+        Format format = Format::NDJSON;
+        unsigned threads = 0;           // 0 = one per hardware thread
+        bool segmentation = true;       // Use the word list if one is loaded
+    };
+    
+    static constexpr const char* USAGE =
+        "Usage: jpn_to_phoneme --batch [--input FILE|-] [--output FILE|-] [--format ndjson|tsv]\n"
+        "                      [--threads N] [--no-segmentation]";
+    
+    /**
+     * Parse the options that follow --batch
+     * @return false (message in error) on an unknown option or a bad value
+     */
+    static bool parse_options(const std::vector<std::string>& args, Options& options, std::string& error) {
+        for (size_t i = 0; i < args.size(); i++) {
+            const std::string& arg = args[i];
+            if (arg == "--no-segmentation") {
+                options.segmentation = false;
+                continue;
+            }
+            if (i + 1 == args.size() ||
+                (arg != "--input" && arg != "--output" && arg != "--format" && arg != "--threads")) {
+                error = i + 1 == args.size() && arg.rfind("--", 0) == 0 ? "Missing value for " + arg
+                                                                        : "Unknown option: " + arg;
+                return false;
+            }
+            const std::string& value = args[++i];
+            if (arg == "--input") {
+                options.input_path = value;
+            } else if (arg == "--output") {
+                options.output_path = value;
+            } else if (arg == "--format") {
+                if (value != "ndjson" && value != "tsv") {
+                    error = "Unknown format: " + value + " (ndjson or tsv)";
+                    return false;
+                }
+                options.format = value == "tsv" ? Format::TSV : Format::NDJSON;
+            } else {
+                char* end = nullptr;
+                unsigned long threads = std::strtoul(value.c_str(), &end, 10);
+                if (value.empty() || *end != '\0' || threads > 1024) {
+                    error = "Invalid thread count: " + value;
+                    return false;
+                }
+                options.threads = static_cast<unsigned>(threads);
+            }
+        }
+        return true;
+    }
+    
+    /**
+     * Convert the input to the output
+     * @return Process exit code (0 on success, 1 on an I/O error)
+     */
+    static int run(PhonemeConverter& converter, WordSegmenter* segmenter, const Options& options) {
+        FILE* in = stdin;
+        FILE* out = stdout;
+        if (options.input_path != "-" && !(in = std::fopen(options.input_path.c_str(), "rb"))) {
+            std::cerr << "❌ Failed to open input: " << options.input_path << std::endl;
+            return 1;
+        }
+        if (options.output_path != "-" && !(out = std::fopen(options.output_path.c_str(), "wb"))) {
+            std::cerr << "❌ Failed to open output: " << options.output_path << std::endl;
+            if (in != stdin) std::fclose(in);
+            return 1;
+        }
+        #ifdef _WIN32
+            // Lines are bytes: no CRLF translation
+            if (in == stdin) _setmode(_fileno(stdin), _O_BINARY);
+            if (out == stdout) _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+        std::setvbuf(out, nullptr, _IOFBF, OUTPUT_BUFFER);
+        
+        unsigned threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        WordSegmenter* active = options.segmentation ? segmenter : nullptr;
+        std::cerr << "🔥 Batch: " << threads << (threads == 1 ? " thread, " : " threads, ")
+                  << (options.format == Format::TSV ? "TSV" : "NDJSON")
+                  << (active ? ", word segmentation" : "") << std::endl;
+        
+        Pipeline pipeline(threads * 2 + 2);
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&] {
+                ConversionContext context;
+                while (std::unique_ptr<Chunk> chunk = pipeline.next_pending()) {
+                    convert_chunk(converter, active, options.format, context, *chunk);
+                    pipeline.finish(std::move(chunk));
+                }
+            });
+        }
+        std::thread writer([&] {
+            while (std::unique_ptr<Chunk> chunk = pipeline.next_finished()) {
+                if (!pipeline.write_failed &&
+                    std::fwrite(chunk->output.data(), 1, chunk->output.size(), out) != chunk->output.size()) {
+                    pipeline.write_failed = true;
+                }
+                pipeline.output_bytes += chunk->output.size();
+                pipeline.lines += chunk->line_count;
+                pipeline.release();
+            }
+        });
+        
+        // Read on this thread
+        bool read_failed = false;
+        std::string carry;  // Start of a line that continues in the next read
+        size_t input_bytes = 0;
+        while (!pipeline.write_failed) {
+            auto chunk = std::make_unique<Chunk>();
+            chunk->text = std::move(carry);
+            carry.clear();
+            bool end_of_input = read_lines(in, *chunk, carry);
+            if (std::ferror(in)) read_failed = true;
+            input_bytes += chunk->text.size();
+            if (!chunk->text.empty()) pipeline.submit(std::move(chunk));
+            if (end_of_input) break;
+        }
+        pipeline.close();
+        
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        writer.join();
+        if (std::fflush(out) != 0) pipeline.write_failed = true;
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        if (in != stdin) std::fclose(in);
+        if (out != stdout && std::fclose(out) != 0) pipeline.write_failed = true;
+        
+        std::cerr << "✅ Converted " << pipeline.lines << " lines (" << std::fixed << std::setprecision(1)
+                  << input_bytes / 1048576.0 << " MB in, " << pipeline.output_bytes / 1048576.0
+                  << " MB out) in " << std::setprecision(3) << seconds << "s" << std::endl;
+        std::cerr << "   Throughput: " << std::setprecision(0) << pipeline.lines / std::max(seconds, 1e-9)
+                  << " lines/s, " << std::setprecision(1) << input_bytes / 1048576.0 / std::max(seconds, 1e-9)
+                  << " MB/s" << std::endl;
+        if (read_failed) {
+            std::cerr << "❌ Failed to read input: " << options.input_path << std::endl;
+        }
+        if (pipeline.write_failed) {
+            std::cerr << "❌ Failed to write output: " << options.output_path << std::endl;
+        }
+        return read_failed || pipeline.write_failed ? 1 : 0;
+    }
+
+private:
+    static constexpr size_t CHUNK_BYTES = 256 * 1024;    // Input read per chunk (whole lines)
+    static constexpr size_t OUTPUT_BUFFER = 1024 * 1024;
+    
+    /** A run of whole input lines and, once converted, their records */
+    struct Chunk {
+        uint64_t sequence = 0;
+        std::string text;
+        std::string output;
+        size_t line_count = 0;
+    };
+    
+    /**
+     * Chunks between the reader, the workers and the writer
+     * 
+     * At most `capacity` chunks are read but not yet written, which bounds
+     * memory and lets a slow output hold the reader back.
+     */
+    class Pipeline {
+    private:
+        std::mutex mutex;
+        std::condition_variable pending_ready;   // Workers: a chunk to convert (or closed)
+        std::condition_variable finished_ready;  // Writer: the next chunk in order (or done)
+        std::condition_variable slot_free;       // Reader: below capacity
+        std::deque<std::unique_ptr<Chunk>> pending;
+        std::map<uint64_t, std::unique_ptr<Chunk>> finished;
+        size_t capacity;
+        size_t in_flight = 0;
+        uint64_t submitted = 0;
+        uint64_t next_write = 0;
+        bool closed = false;
+        
+    public:
+        // Written by the writer thread only (read after it is joined)
+        std::atomic<bool> write_failed{false};
+        size_t output_bytes = 0;
+        size_t lines = 0;
+        
+        explicit Pipeline(size_t capacity) : capacity(capacity) {}
+        
+        /** Queue a chunk for conversion (blocks while the pipeline is full) */
+        void submit(std::unique_ptr<Chunk> chunk) {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_free.wait(lock, [&] { return in_flight < capacity; });
+            chunk->sequence = submitted++;
+            in_flight++;
+            pending.push_back(std::move(chunk));
+            pending_ready.notify_one();
+        }
+        
+        /** No more chunks will be submitted */
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            pending_ready.notify_all();
+            finished_ready.notify_all();
+        }
+        
+        /** Next chunk to convert, NULL once closed and drained */
+        std::unique_ptr<Chunk> next_pending() {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending_ready.wait(lock, [&] { return !pending.empty() || closed; });
+            if (pending.empty()) return nullptr;
+            std::unique_ptr<Chunk> chunk = std::move(pending.front());
+            pending.pop_front();
+            return chunk;
+        }
+        
+        /** Hand a converted chunk to the writer */
+        void finish(std::unique_ptr<Chunk> chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool next = chunk->sequence == next_write;
+            finished.emplace(chunk->sequence, std::move(chunk));
+            if (next) finished_ready.notify_one();
+        }
+        
+        /** Next chunk in input order, NULL once everything is written */
+        std::unique_ptr<Chunk> next_finished() {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished_ready.wait(lock, [&] {
+                return finished.count(next_write) || (closed && next_write == submitted);
+            });
+            auto it = finished.find(next_write);
+            if (it == finished.end()) return nullptr;
+            std::unique_ptr<Chunk> chunk = std::move(it->second);
+            finished.erase(it);
+            next_write++;
+            return chunk;
+        }
+        
+        /** The writer is done with a chunk */
+        void release() {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight--;
+            slot_free.notify_one();
+        }
+    };
+    
+    /**
+     * Append reads to chunk.text until it holds at least CHUNK_BYTES; the
+     * part after the last newline moves to carry
+     * @return true at the end of the input (chunk then ends with the last line)
+     */
+    static bool read_lines(FILE* in, Chunk& chunk, std::string& carry) {
+        std::string& text = chunk.text;
+        bool end_of_input = false;
+        size_t last_newline = text.rfind('\n');  // Carried text has none, but stays general
+        while (!end_of_input) {
+            size_t old_size = text.size();
+            text.resize(old_size + CHUNK_BYTES);
+            size_t read = std::fread(&text[old_size], 1, CHUNK_BYTES, in);
+            text.resize(old_size + read);
+            end_of_input = read == 0;
+            
+            // Only the new bytes can hold a later newline
+            const char* found = static_cast<const char*>(memrchr_portable(text.data() + old_size, '\n', read));
+            if (found) last_newline = found - text.data();
+            if (last_newline != std::string::npos && text.size() >= CHUNK_BYTES) break;
+        }
+        if (!end_of_input) {
+            carry.assign(text, last_newline + 1, std::string::npos);
+            text.resize(last_newline + 1);
+        }
+        return end_of_input;
+    }
+    
+    /** Last occurrence of c in [data, data + length) (memrchr is a GNU extension) */
+    static const void* memrchr_portable(const char* data, char c, size_t length) {
+        for (size_t i = length; i > 0; i--) {
+            if (data[i - 1] == c) return data + i - 1;
+        }
+        return nullptr;
+    }
+    
+    /**
+     * Convert every line of chunk.text into chunk.output
+     */
+    static void convert_chunk(PhonemeConverter& converter, WordSegmenter* segmenter, Format format,
+                              ConversionContext& context, Chunk& chunk) {
+        const char* data = chunk.text.data();
+        const char* end = data + chunk.text.size();
+        std::string& out = chunk.output;
+        out.reserve(chunk.text.size() * 3);
+        
+        for (const char* line = data; line < end;) {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            const char* line_end = newline ? newline : end;
+            size_t length = line_end - line;
+            if (length > 0 && line[length - 1] == '\r') length--;
+            
+            const std::string& phonemes = context.convert(converter, segmenter, line, length);
+            if (format == Format::NDJSON) {
+                out += "{\"input\":";
+                append_json_string(out, line, length);
+                out += ",\"phonemes\":";
+                append_json_string(out, phonemes.data(), phonemes.size());
+                out += "}\n";
+            } else {
+                append_tsv_field(out, line, length);
+                out += '\t';
+                append_tsv_field(out, phonemes.data(), phonemes.size());
+                out += '\n';
+            }
+            chunk.line_count++;
+            line = line_end + 1;
+        }
+    }
+    
+    /**
+     * Append text as a JSON string literal (runs without escapes are copied at once)
+     */
+    static void append_json_string(std::string& out, const char* text, size_t length) {
+        out += '"';
+        size_t run = 0;
+        for (size_t i = 0; i < length; i++) {
+            uint8_t c = static_cast<uint8_t>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out.append(text + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                }
+            }
+        }
+        out.append(text + run, length - run);
+        out += '"';
+    }
+    
+    /**
+     * Append text as a TSV field (tab, CR, LF and backslash escaped)
+     */
+    static void append_tsv_field(std::string& out, const char* text, size_t length) {
+        size_t run = 0;
+        for (size_t i = 0; i < length; i++) {
+            char c = text[i];
+            if (c != '\t' && c != '\n' && c != '\r' && c != '\\') continue;
+            out.append(text + run, i - run);
+            run = i + 1;
+            out += c == '\t' ? "\\t" : c == '\n' ? "\\n" : c == '\r' ? "\\r" : "\\\\";
+        }
+        out.append(text + run, length - run);
+    }
+};
+
+// Helper function to get UTF-8 command line arguments on Windows
+#ifdef _WIN32
+std::vector<std::string> get_utf8_args() {
+    std::vector<std::string> args;
+    int nArgs;
+    LPWSTR* szArglist = CommandLineToArgvW(GetCommandLineW(), &nArgs);
+    
+    if (szArglist != NULL) {
+        for (int i = 0; i < nArgs; i++) {
+            int size_needed = WideCharToMultiByte(CP_UTF8, 0, szArglist[i], -1, NULL, 0, NULL, NULL);
+            std::string utf8_arg(size_needed - 1, 0);
+            WideCharToMultiByte(CP_UTF8, 0, szArglist[i], -1, &utf8_arg[0], size_needed, NULL, NULL);
+            args.push_back(utf8_arg);
+        }
+        LocalFree(szArglist);
+    }
+    return args;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    // Enable UTF-8 support for Windows console
+    #ifdef _WIN32
+        SetConsoleOutputCP(CP_UTF8);
+        SetConsoleCP(CP_UTF8);
+        setvbuf(stdout, nullptr, _IOFBF, 1000);
+    #endif
+    
+    // Get UTF-8 arguments on Windows
+    #ifdef _WIN32
+        auto utf8_args = get_utf8_args();
+        int arg_count = utf8_args.size();
+    #else
+        std::vector<std::string> utf8_args(argv, argv + argc);
+        int arg_count = argc;
+    #endif
+    
+    // Corpus mode: stdout carries only the records, everything else goes to stderr
+    bool batch = arg_count >= 2 && utf8_args[1] == "--batch";
+    CorpusBatch::Options batch_options;
+    if (batch) {
+        std::string error;
+        if (!CorpusBatch::parse_options(std::vector<std::string>(utf8_args.begin() + 2, utf8_args.end()),
+                                        batch_options, error)) {
+            std::cerr << "❌ " << error << "\n" << CorpusBatch::USAGE << std::endl;
+            return 2;
+        }
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    
+    std::cout << "╔══════════════════════════════════════════════════════════╗" << std::endl;
+    std::cout << "║  Japanese → Phoneme Converter (C++)                     ║" << std::endl;
+    std::cout << "║  Blazing fast IPA phoneme conversion                    ║" << std::endl;
+    std::cout << "╚══════════════════════════════════════════════════════════╝\n" << std::endl;
+    
+    // Check if JSON file exists
+    std::ifstream test_file("ja_phonemes.json");
+    if (!test_file.good()) {
+        std::cerr << "❌ Error: ja_phonemes.json not found in current directory" << std::endl;
+        std::cerr << "   Please ensure the phoneme dictionary is present." << std::endl;
+        return 1;
+    }
+    test_file.close();
+    
+    // Initialize converter and load dictionary
+    // 🚀 Try binary trie first (100x faster!), fallback to JSON
+    PhonemeConverter converter;
+    bool loaded_binary = false;
+    
+    // Try binary format (packed v2 is mapped, v1 is loaded into the flat trie)
+    if (converter.try_load_binary_format("japanese.trie")) {
+        loaded_binary = true;
+        if (converter.is_packed()) {
+            std::cout << "   💡 Packed trie mapped - lookups run against the mapping" << std::endl;
+        } else {
+            std::cout << "   💡 Binary format loaded directly into flat trie" << std::endl;
+        }
+    } else {
+        // Fallback to JSON
+        std::cout << "   ⚠️  Binary trie not found, loading JSON..." << std::endl;
+        try {
+            converter.load_from_json("ja_phonemes.json");
+        } catch (const std::exception& e) {
+            std::cerr << "❌ Error loading dictionary: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    // Initialize word segmenter if enabled
+    std::unique_ptr<WordSegmenter> segmenter;
+    if (USE_WORD_SEGMENTATION) {
+        // If using binary format, words are already loaded in converter's trie!
+        // The WordSegmenter walks that same trie
+        if (loaded_binary && converter.get_word_count() > 0) {
+            std::cout << "   💡 Word segmentation: Words already in converter trie from binary format" << std::endl;
+            segmenter = std::make_unique<WordSegmenter>(converter);
+            // Don't load ja_words.txt - words are already in converter's trie
+        } else {
+            // Flag the words of the separate word file in the converter's trie
+            std::ifstream test_word_file("ja_words.txt");
+            if (test_word_file.good()) {
+                test_word_file.close();
+                segmenter = std::make_unique<WordSegmenter>(converter);
+                try {
+                    segmenter->load_from_file("ja_words.txt");
+                    std::cout << "   💡 Word segmentation: ENABLED (spaces will separate words)" << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "⚠️  Warning: Could not load word dictionary: " << e.what() << std::endl;
+                    std::cerr << "   Continuing without word segmentation..." << std::endl;
+                    segmenter.reset();
+                }
+            } else {
+                std::cout << "   💡 Word segmentation: DISABLED (ja_words.txt not found)" << std::endl;
+            }
+        }
+    }
+    
+    std::cout << "\n━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::endl;
+    
+    if (batch) {
+        return CorpusBatch::run(converter, batch_options.segmentation ? segmenter.get() : nullptr, batch_options);
+    }
+    
+    if (arg_count < 2) {
+        // Interactive mode
+        std::cout << "💡 Usage: ./jpn_to_phoneme \"日本語テキスト\"" << std::endl;
+        std::cout << "   Corpora (one text per line): ./jpn_to_phoneme --batch --input FILE > out.ndjson" << std::endl;
+        std::cout << "   Or enter Japanese text interactively:\n" << std::endl;
+        
+        std::string input;
+        while (true) {
+            std::cout << "Japanese text (or \"quit\" to exit): ";
+            std::getline(std::cin, input);
+            
+            if (input.empty()) continue;
+            
+            if (input == "quit" || input == "exit") {
+                std::cout << "\n👋 Goodbye!" << std::endl;
+                break;
+            }
+            
+            // Perform conversion with timing
+            auto start_time = std::chrono::high_resolution_clock::now();
+            ConversionResult result;
+            if (segmenter) {
+                result = SegmentedConversion::convert_detailed_with_segmentation(converter, input, *segmenter);
+            } else {
+                result = converter.convert_detailed(input);
+            }
+            auto end_time = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+            
+            // Display results
+            std::cout << "\n┌─────────────────────────────────────────" << std::endl;
+            std::cout << "│ Input:    " << input << std::endl;
+            std::cout << "│ Phonemes: " << result.phonemes << std::endl;
+            std::cout << "│ Time:     " << elapsed << "μs" << std::endl;
+            std::cout << "└─────────────────────────────────────────" << std::endl;
+            
+            if (!result.matches.empty()) {
+                std::cout << "\n  Matches (" << result.matches.size() << "):" << std::endl;
+                for (const auto& match : result.matches) {
+                    std::cout << "    • " << match.to_string() << std::endl;
+                }
+            }
+            
+            if (!result.unmatched.empty()) {
+                std::cout << "\n  ⚠️  Unmatched characters: ";
+                for (size_t i = 0; i < result.unmatched.size(); i++) {
+                    if (i > 0) std::cout << ", ";
+                    std::cout << result.unmatched[i];
+                }
+                std::cout << std::endl;
+            }
+            
+            std::cout << std::endl;
+        }
+    } else {
+        // Batch mode - convert all arguments
+        for (int i = 1; i < arg_count; i++) {
+            std::string text = utf8_args[i];
+            
+            // Perform conversion with timing
+            auto start_time = std::chrono::high_resolution_clock::now();
+            ConversionResult result;
+            if (segmenter) {
+                result = SegmentedConversion::convert_detailed_with_segmentation(converter, text, *segmenter);
+            } else {
+                result = converter.convert_detailed(text);
+            }
+            auto end_time = std::chrono::high_resolution_clock::now();
+            auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+            auto elapsed_ms = elapsed_us / 1000.0;
+            
+            // Display results
+            std::cout << "┌─────────────────────────────────────────" << std::endl;
+            std::cout << "│ Input:    " << text << std::endl;
+            std::cout << "│ Phonemes: " << result.phonemes << std::endl;
+            std::cout << "│ Time:     " << elapsed_us << "μs (" << elapsed_ms << "ms)" << std::endl;
+            std::cout << "└─────────────────────────────────────────" << std::endl;
+            
+            if (!result.matches.empty()) {
+                std::cout << "\n  ✅ Matches (" << result.matches.size() << "):" << std::endl;
+                for (const auto& match : result.matches) {
+                    std::cout << "    • " << match.to_string() << std::endl;
+                }
+            }
+            
+            if (!result.unmatched.empty()) {
+                std::cout << "\n  ⚠️  Unmatched characters: ";
+                for (size_t i = 0; i < result.unmatched.size(); i++) {
+                    if (i > 0) std::cout << ", ";
+                    std::cout << result.unmatched[i];
+                }
+                std::cout << std::endl;
+            }
+            
+            std::cout << std::endl;
+        }
+        
+        std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::endl;
+        std::cout << "✨ Conversion complete!" << std::endl;
+    }
+    
+    return 0;
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// DART FFI EXPORTS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @file jpn_to_phoneme_ffi.cpp
+ * @brief Dart FFI interface for the Japanese Phoneme Converter
+ * 
+ * This file provides C-compatible exports for use with Dart FFI.
+ * The exports maintain thread-safe global state and provide error handling.
+ * 
+ * @author Japanese Phoneme Converter Contributors
+ * @version 2.0.0
+ * @date 2024
+ */
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// GLOBAL STATE MANAGEMENT
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Conversion context handed out by jpn_phoneme_context_create()
+ * 
+ * Reusable conversion buffers plus the result of the last call that did
+ * not fit its output buffer, so that the re-call with a buffer of the
+ * reported size is a copy instead of a second conversion. Every thread
+ * also has an implicit one behind jpn_phoneme_convert_sized().
+ */
+struct JpnPhonemeContext {
+    ConversionContext conversion;
+    
+    bool pending_valid = false;         // conversion.result() is kept for pending_input
+    uint64_t pending_generation = 0;    // Dictionary snapshot it was converted with
+    bool pending_segmentation = false;  // Segmentation setting it was converted with
+    bool pending_spans = false;         // Converted by jpn_phoneme_convert_spans() (spans are kept too)
+    std::string pending_input;
+    int64_t pending_time_us = 0;
+};
+
+/**
+ * @brief One loaded dictionary: the phoneme trie and its word segmenter
+ * 
+ * Never modified once published. Every conversion holds a shared_ptr to
+ * the snapshot it started with, so replacing a handle's dictionary
+ * (reload, word list, cleanup) is an RCU-style swap: new conversions see
+ * the new snapshot at once, running ones finish on the old one, and the
+ * old one is freed by whichever of them finishes last.
+ */
+struct DictionarySnapshot {
+    std::shared_ptr<PhonemeConverter> converter;
+    std::unique_ptr<WordSegmenter> segmenter;   // NULL without a word list
+    std::shared_ptr<const UserDictionary> user; // NULL without user entries
+    uint64_t generation = 0;                    // Unique per snapshot (invalidates pending outputs)
+    uint64_t source_key = 0;                    // Snapshot cache key of a built dictionary (0 = none)
+    
+    /**
+     * @brief The loaded dictionary, without the user overlay
+     */
+    const std::shared_ptr<PhonemeConverter>& base_converter() const {
+        return converter->layer_base() ? converter->layer_base() : converter;
+    }
+    
+    /**
+     * @brief Segmenter to convert with, or NULL for plain longest-match
+     */
+    WordSegmenter* active_segmenter(bool use_segmentation) const {
+        return use_segmentation ? segmenter.get() : nullptr;
+    }
+    
+    /**
+     * @brief Convert data[0, length) into a reusable context
+     * @return The phonemes (valid until the next conversion on this context)
+     */
+    const std::string& convert(ConversionContext& context, bool use_segmentation,
+                               const char* data, size_t length) const {
+        return context.convert(*converter, active_segmenter(use_segmentation), data, length);
+    }
+};
+
+/**
+ * @brief Converter handle handed out by jpn_phoneme_handle_create()
+ * 
+ * A handle publishes one dictionary snapshot. Readers take a reference
+ * with acquire() and never block on writers; writers (init, reload, word
+ * list) build the replacement off to the side and publish() it. Separate
+ * handles share nothing, so several dictionaries can serve threads at once.
+ */
+struct JpnPhonemeHandle {
+    std::atomic<bool> use_segmentation{true};
+    
+    /** @brief Results of recent conversions (disabled unless a capacity is set) */
+    ResultCache cache;
+    
+    /** @brief Serialises writers of this handle (readers never take it) */
+    std::mutex update_mutex;
+    
+    /** @brief Number of publish() calls so far (hold update_mutex) */
+    uint64_t publish_count = 0;
+    
+    /** @brief Current dictionary, or NULL before init/after cleanup */
+    std::shared_ptr<const DictionarySnapshot> acquire() const {
+        return std::atomic_load(&dictionary);
+    }
+    
+    /** @brief Replace the dictionary (hold update_mutex) */
+    void publish(std::shared_ptr<const DictionarySnapshot> next) {
+        publish_count++;
+        publish_update(std::move(next));
+    }
+    
+    /**
+     * @brief Publish the same dictionary with other user entries (hold update_mutex)
+     * Not counted in publish_count: a background load that started earlier
+     * still goes in, and takes the user entries along.
+     */
+    void publish_update(std::shared_ptr<const DictionarySnapshot> next) {
+        std::atomic_store(&dictionary, std::move(next));
+        cache.clear();  // Results stored late from the old snapshot never hit (generation differs)
+    }
+    
+    /**
+     * @brief Convert through the result cache
+     * @return The phonemes (valid until the next conversion on this context)
+     */
+    const std::string& convert(const DictionarySnapshot& snapshot, bool segmentation,
+                               ConversionContext& context, const char* data, size_t length) {
+        std::string_view input(data, length);
+        if (cache.lookup(input, snapshot.generation, segmentation, context)) {
+            if (Stats::active()) {
+                Stats::add(STAT_CACHE_HITS, 1);
+            }
+            return context.result();
+        }
+        const std::string& result = snapshot.convert(context, segmentation, data, length);
+        cache.store(input, snapshot.generation, segmentation, result);
+        return result;
+    }
+    
+private:
+    std::shared_ptr<const DictionarySnapshot> dictionary;  // Only through acquire()/publish()
+};
+
+/**
+ * @brief Called once a jpn_phoneme_init_async() load has finished
+ * 
+ * Runs on the loader thread; error is NULL on success.
+ */
+typedef void (*JpnPhonemeInitCallback)(int success, const char* error, void* user_data);
+
+/**
+ * @brief Thread-safe global state for the FFI interface
+ * 
+ * The jpn_phoneme_* functions without a handle argument work on one
+ * global handle. Errors are reported per thread.
+ */
+namespace FFIState {
+    /** @brief Handle behind jpn_phoneme_init() and the other handle-less functions */
+    JpnPhonemeHandle global_handle;
+    
+    /** @brief Last error message of the calling thread */
+    thread_local std::string last_error;
+    
+    /** @brief Version string */
+    const char* VERSION = "2.0.0";
+    
+    /** @brief Source of snapshot generations (unique across handles) */
+    std::atomic<uint64_t> dictionary_generation{0};
+    
+    /** @brief Implicit context of jpn_phoneme_convert_sized() and batches, one per thread */
+    thread_local JpnPhonemeContext thread_context;
+    
+    /** @brief Trie levels warmed before a loaded dictionary is published (jpn_phoneme_set_warm_levels()) */
+    std::atomic<int> warm_levels{0};
+    
+    /** @brief Batches without segmentation go through the interleaved walker (jpn_phoneme_set_batch_interleaving()) */
+    std::atomic<bool> interleaved_batches{false};
+    
+    /** @brief Interleaved batch buffers of the calling thread */
+    thread_local InterleavedBatch thread_batch;
+    
+    /** @brief Guards snapshot_cache_directory */
+    std::mutex snapshot_cache_mutex;
+    
+    /** @brief Directory of the dictionary snapshot cache, empty when off (jpn_phoneme_set_snapshot_cache()) */
+    std::string snapshot_cache_directory;
+    
+    /** @brief Current snapshot cache directory (empty when off) */
+    std::string snapshot_cache() {
+        std::lock_guard<std::mutex> lock(snapshot_cache_mutex);
+        return snapshot_cache_directory;
+    }
+    
+    /**
+     * @brief Build a converter, or map its cached snapshot
+     * 
+     * With a cache directory and a key, the snapshot stored under key is
+     * mapped if there is one; otherwise build() runs and its flat trie is
+     * stored. Without either, this is just build().
+     * 
+     * @param build Returns the built (finalized) converter, or NULL if its sources are invalid
+     */
+    template <typename Builder>
+    std::unique_ptr<PhonemeConverter> build_cached(const std::string& cache, uint64_t key, Builder&& build) {
+        if (cache.empty() || key == 0) {
+            return build();
+        }
+        if (auto cached = SnapshotCache::load(cache, key)) {
+            return cached;
+        }
+        std::unique_ptr<PhonemeConverter> converter = build();
+        if (converter) {
+            SnapshotCache::store(cache, key, converter->get_trie());
+        }
+        return converter;
+    }
+    
+    /**
+     * @brief Snapshot cache key of a dictionary that word lists are keyed under
+     * 
+     * A built dictionary has its source key; a mapped packed trie is keyed
+     * by its bytes. 0 for anything else (the kana core).
+     */
+    uint64_t dictionary_key(const PhonemeConverter& converter, uint64_t source_key) {
+        if (source_key) {
+            return source_key;
+        }
+        std::string_view packed = converter.packed_data();
+        return packed.empty() ? 0 : SnapshotCache::key(0, packed.data(), packed.size());
+    }
+    
+    /**
+     * @brief Wrap a loaded converter into a snapshot
+     * 
+     * Binary tries carry the word list, so the segmenter can walk the
+     * converter's trie without jpn_phoneme_init_word_dict().
+     * 
+     * @param source_key Snapshot cache key the converter was built under (0 = none)
+     */
+    std::shared_ptr<const DictionarySnapshot> make_snapshot(std::shared_ptr<PhonemeConverter> converter,
+                                                            uint64_t source_key = 0) {
+        auto snapshot = std::make_shared<DictionarySnapshot>();
+        snapshot->converter = std::move(converter);
+        snapshot->source_key = source_key;
+        if (int levels = warm_levels.load(std::memory_order_relaxed)) {
+            snapshot->converter->warm(static_cast<size_t>(levels));
+        }
+        if (snapshot->converter->get_word_count() > 0) {
+            snapshot->segmenter = std::make_unique<WordSegmenter>(*snapshot->converter);
+        }
+        snapshot->generation = ++dictionary_generation;
+        return snapshot;
+    }
+    
+    /**
+     * @brief Load a dictionary from JSON (or the .trie file next to it)
+     * 
+     * A v1 .trie or the JSON is built through the snapshot cache.
+     * 
+     * @param source_key Receives the snapshot cache key it was built under (0 = none)
+     * @throws std::runtime_error if loading fails
+     */
+    std::unique_ptr<PhonemeConverter> load_file_converter(const char* json_file_path, uint64_t& source_key,
+                                                          const LoadProgress& progress = LoadProgress()) {
+        if (!json_file_path) {
+            throw std::runtime_error("Dictionary path must not be NULL");
+        }
+        source_key = 0;
+        std::string cache = snapshot_cache();
+        
+        // Try binary format first (100x faster!)
+        std::string path(json_file_path);
+        size_t dot_pos = path.rfind('.');
+        std::string trie_path = dot_pos != std::string::npos ? path.substr(0, dot_pos) + ".trie" : "";
+        if (!trie_path.empty()) {
+            MemoryMappedFile trie_file;
+            if (!cache.empty() && trie_file.open(trie_path) &&
+                !BinaryTrie::is_packed_format(static_cast<const uint8_t*>(trie_file.data()), trie_file.size())) {
+                // A v1 trie is parsed entry by entry, like JSON
+                const uint8_t* data = static_cast<const uint8_t*>(trie_file.data());
+                uint64_t key = SnapshotCache::key(0, data, trie_file.size());
+                auto converter = build_cached(cache, key, [&]() -> std::unique_ptr<PhonemeConverter> {
+                    auto built = std::make_unique<PhonemeConverter>();
+                    return built->try_load_binary_buffer(data, trie_file.size()) ? std::move(built) : nullptr;
+                });
+                if (converter) {
+                    source_key = key;
+                    progress.report(1, 1);
+                    return converter;
+                }
+            } else {
+                auto converter = std::make_unique<PhonemeConverter>();
+                if (converter->try_load_binary_format(trie_path)) {
+                    progress.report(1, 1);
+                    return converter;
+                }
+            }
+        }
+        
+        // Fallback to JSON
+        uint64_t key = cache.empty() ? 0 : SnapshotCache::file_key(path, 0);
+        auto converter = build_cached(cache, key, [&] {
+            auto built = std::make_unique<PhonemeConverter>();
+            built->load_from_json(path, progress);
+            return built;
+        });
+        source_key = key;
+        progress.report(1, 1);
+        return converter;
+    }
+    
+    /** @brief load_file_converter() wrapped into a snapshot */
+    std::shared_ptr<const DictionarySnapshot> load_file_snapshot(const char* json_file_path) {
+        uint64_t source_key = 0;
+        auto converter = load_file_converter(json_file_path, source_key);
+        return make_snapshot(std::move(converter), source_key);
+    }
+    
+    /**
+     * @brief Snapshot of the kana-only bootstrap dictionary (see KanaCore)
+     */
+    std::shared_ptr<const DictionarySnapshot> kana_core_snapshot() {
+        auto converter = std::make_unique<PhonemeConverter>();
+        converter->load_kana_core();
+        return make_snapshot(std::move(converter));
+    }
+    
+    /**
+     * @brief Load a dictionary from .trie data in memory
+     * 
+     * A v2/v3 buffer is copied, or borrowed when borrow holds trie_data:
+     * the converter keeps that reference, so the buffer is released when
+     * the last snapshot (and conversion) using it is gone.
+     * 
+     * @throws std::runtime_error if loading fails
+     */
+    std::shared_ptr<const DictionarySnapshot> load_buffer_snapshot(const uint8_t* trie_data, int data_size,
+                                                                   std::shared_ptr<const uint8_t> borrow = nullptr) {
+        if (!trie_data || data_size <= 0) {
+            throw std::runtime_error("Invalid trie data");
+        }
+        size_t size = static_cast<size_t>(data_size);
+        std::string cache = snapshot_cache();
+        
+        // Parse (v1) or reference (v2) the buffer directly - no temp file;
+        // a v1 buffer is built through the snapshot cache
+        uint64_t key = cache.empty() || BinaryTrie::is_packed_format(trie_data, size)
+                     ? 0 : SnapshotCache::key(0, trie_data, size);
+        auto converter = build_cached(cache, key, [&]() -> std::unique_ptr<PhonemeConverter> {
+            auto built = std::make_unique<PhonemeConverter>();
+            return built->try_load_binary_buffer(trie_data, size, std::move(borrow)) ? std::move(built) : nullptr;
+        });
+        if (!converter) {
+            if (BinaryTrie::is_outdated(trie_data, size)) {
+                throw std::runtime_error("Outdated binary trie format: recompile it with jpn_trie_compiler");
+            }
+            throw std::runtime_error("Failed to load binary trie format");
+        }
+        return make_snapshot(std::move(converter), key);
+    }
+    
+    /**
+     * @brief Copy of a snapshot with the words of a word list added
+     * 
+     * Words are flagged in the converter's trie, so the copy gets its own
+     * converter and the published snapshot is left untouched.
+     * 
+     * @throws std::runtime_error if the word file cannot be read
+     */
+    std::shared_ptr<const DictionarySnapshot> add_word_list(const DictionarySnapshot& current, const char* word_file_path) {
+        if (!word_file_path) {
+            throw std::runtime_error("Word file path must not be NULL");
+        }
+        std::ifstream probe(word_file_path);
+        if (!probe.is_open()) {
+            throw std::runtime_error(std::string("Failed to open word file: ") + word_file_path);
+        }
+        
+        std::string cache = snapshot_cache();
+        uint64_t base_key = cache.empty() ? 0 : dictionary_key(*current.base_converter(), current.source_key);
+        uint64_t key = base_key ? SnapshotCache::file_key(word_file_path, base_key) : 0;
+        
+        auto snapshot = std::make_shared<DictionarySnapshot>();
+        snapshot->converter = build_cached(cache, key, [&] {
+            auto built = current.base_converter()->clone_mutable(false);  // Finalized with the words
+            WordSegmenter(*built).load_from_file(word_file_path);
+            return built;
+        });
+        snapshot->segmenter = std::make_unique<WordSegmenter>(*snapshot->converter);
+        snapshot->generation = ++dictionary_generation;
+        snapshot->source_key = key;
+        return snapshot;
+    }
+    
+    /**
+     * @brief Copy of a snapshot with the words of an in-memory word list added
+     * @throws std::runtime_error if the data is invalid
+     */
+    std::shared_ptr<const DictionarySnapshot> add_word_buffer(const DictionarySnapshot& current,
+                                                              const uint8_t* data, int data_size) {
+        if (!data || data_size <= 0) {
+            throw std::runtime_error("Invalid word list data");
+        }
+        
+        std::string cache = snapshot_cache();
+        uint64_t base_key = cache.empty() ? 0 : dictionary_key(*current.base_converter(), current.source_key);
+        uint64_t key = base_key ? SnapshotCache::key(base_key, data, static_cast<size_t>(data_size)) : 0;
+        
+        auto snapshot = std::make_shared<DictionarySnapshot>();
+        snapshot->converter = build_cached(cache, key, [&]() -> std::unique_ptr<PhonemeConverter> {
+            auto built = current.base_converter()->clone_mutable(false);  // Finalized with the words
+            return WordSegmenter(*built).load_from_buffer(data, static_cast<size_t>(data_size)) ? std::move(built)
+                                                                                              : nullptr;
+        });
+        if (!snapshot->converter) {
+            throw std::runtime_error("Failed to load word list data");
+        }
+        snapshot->segmenter = std::make_unique<WordSegmenter>(*snapshot->converter);
+        snapshot->generation = ++dictionary_generation;
+        snapshot->source_key = key;
+        return snapshot;
+    }
+    
+    /**
+     * @brief Snapshot of current's dictionary under another user dictionary
+     * 
+     * The base converter is shared with current; only the overlay of the
+     * user entries is built (none for an empty user dictionary).
+     */
+    std::shared_ptr<const DictionarySnapshot> with_user_dictionary(const DictionarySnapshot& current,
+                                                                   std::shared_ptr<const UserDictionary> user) {
+        auto snapshot = std::make_shared<DictionarySnapshot>();
+        if (user && user->size() > 0) {
+            snapshot->converter = PhonemeConverter::layered(current.base_converter(), *user);
+            snapshot->user = std::move(user);
+        } else {
+            snapshot->converter = current.base_converter();
+        }
+        if (snapshot->converter->get_word_count() > 0) {
+            snapshot->segmenter = std::make_unique<WordSegmenter>(*snapshot->converter);
+        }
+        snapshot->generation = ++dictionary_generation;
+        snapshot->source_key = current.source_key;
+        return snapshot;
+    }
+    
+    /**
+     * @brief Carry the handle's user dictionary over to a replacement snapshot
+     * 
+     * User entries belong to the handle, not to the file they were added
+     * on top of: a reload or word list keeps them (hold update_mutex).
+     */
+    std::shared_ptr<const DictionarySnapshot> keep_user_dictionary(const JpnPhonemeHandle& handle,
+                                                                   std::shared_ptr<const DictionarySnapshot> next) {
+        std::shared_ptr<const DictionarySnapshot> current = handle.acquire();
+        if (!next || !current || !current->user) {
+            return next;
+        }
+        return with_user_dictionary(*next, current->user);
+    }
+    
+    /**
+     * @brief Publish the result of load() on a handle (shared body of init/reload)
+     * 
+     * @param keep_on_failure Keep the current dictionary if load() throws
+     *        (otherwise the handle is left uninitialized)
+     * @return 1 on success, 0 on failure (message in last_error)
+     */
+    template <typename Loader>
+    int replace_dictionary(JpnPhonemeHandle& handle, bool keep_on_failure, Loader&& load) {
+        std::lock_guard<std::mutex> lock(handle.update_mutex);
+        
+        try {
+            // Clear any previous error
+            last_error.clear();
+            handle.publish(keep_user_dictionary(handle, load()));
+            return 1;
+        } catch (const std::exception& e) {
+            last_error = e.what();
+            if (!keep_on_failure) {
+                handle.publish(nullptr);
+            }
+            return 0;
+        }
+    }
+    
+    /**
+     * @brief Add words to a handle's dictionary (shared body of the word dict functions)
+     * 
+     * @param add Called as add(current_snapshot), returns the snapshot to publish
+     * @return 1 on success, 0 on failure (the dictionary is unchanged)
+     */
+    template <typename Adder>
+    int load_word_list(JpnPhonemeHandle& handle, Adder&& add) {
+        std::lock_guard<std::mutex> lock(handle.update_mutex);
+        
+        try {
+            last_error.clear();
+            std::shared_ptr<const DictionarySnapshot> current = handle.acquire();
+            if (!current) {
+                last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+                return 0;
+            }
+            handle.publish(keep_user_dictionary(handle, add(*current)));
+            return 1;
+        } catch (const std::exception& e) {
+            last_error = e.what();
+            return 0;
+        }
+    }
+    
+    /**
+     * @brief Apply user dictionary changes to a handle (shared body of the user functions)
+     * 
+     * The changes are published together as one snapshot, so converters
+     * see all of them or none; they never wait for the update.
+     * 
+     * @param phonemes NULL entries (or phonemes == NULL) remove their word
+     * @param replace Discard the current user entries first
+     * @return 1 on success, 0 on failure (the dictionary is unchanged)
+     */
+    int update_user_dictionary(JpnPhonemeHandle& handle, const char* const* words,
+                               const char* const* phonemes, int count, bool replace) {
+        std::lock_guard<std::mutex> lock(handle.update_mutex);
+        
+        try {
+            last_error.clear();
+            if (count < 0 || (count > 0 && !words)) {
+                throw std::runtime_error("Invalid user dictionary update");
+            }
+            std::shared_ptr<const DictionarySnapshot> current = handle.acquire();
+            if (!current) {
+                last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+                return 0;
+            }
+            
+            std::vector<UserDictionary::Change> changes(static_cast<size_t>(count));
+            for (int i = 0; i < count; i++) {
+                if (!words[i]) {
+                    throw std::runtime_error("User dictionary words must not be NULL");
+                }
+                const char* phoneme = phonemes ? phonemes[i] : nullptr;
+                changes[i] = {words[i], phoneme ? std::string_view(phoneme) : std::string_view(), !phoneme};
+            }
+            
+            const UserDictionary empty;
+            const UserDictionary& user = current->user ? *current->user : empty;
+            handle.publish_update(with_user_dictionary(*current, user.with_changes(changes.data(), changes.size(), replace)));
+            return 1;
+        } catch (const std::exception& e) {
+            last_error = e.what();
+            return 0;
+        }
+    }
+    
+    /** @brief Values of jpn_phoneme_get_init_state() */
+    enum InitState {
+        INIT_IDLE = 0,      // No background load started
+        INIT_LOADING = 1,   // Loading; the kana core (or the previous dictionary) serves meanwhile
+        INIT_READY = 2,     // The loaded dictionary is published
+        INIT_FAILED = 3     // Load failed or was superseded (see jpn_phoneme_get_init_error())
+    };
+    
+    /**
+     * @brief The background load behind jpn_phoneme_init_async()
+     * 
+     * At most one runs at a time. Declared after global_handle so that it
+     * is destroyed (and its thread joined) first at exit.
+     */
+    struct AsyncLoad {
+        std::mutex mutex;                  // Guards worker and error, and state changes
+        std::condition_variable finished;  // Signalled when state leaves INIT_LOADING
+        std::thread worker;
+        std::atomic<int> state{INIT_IDLE};
+        std::atomic<int> progress{0};      // Percent, 0-100
+        std::string error;                 // Message of the last failed load
+        
+        ~AsyncLoad() {
+            if (worker.joinable()) worker.join();
+        }
+    };
+    AsyncLoad async_load;
+    
+    /**
+     * @brief Body of the background loader thread
+     * 
+     * The dictionary and word list are loaded into a converter nobody else
+     * sees and published in one step. It is dropped if anything else was
+     * published on the global handle since the load started (ticket), so a
+     * later jpn_phoneme_init*() or cleanup always wins over a slower load.
+     * 
+     * @param bootstrapped The kana core was published for this load (it is
+     *        withdrawn again if the load fails, like a failed jpn_phoneme_init())
+     */
+    void run_async_load(std::string dictionary_path, std::string word_path, uint64_t ticket,
+                        bool bootstrapped, JpnPhonemeInitCallback callback, void* user_data) {
+        std::string error;
+        try {
+            LoadProgress progress{&async_load.progress, 0, word_path.empty() ? 100 : 70};
+            uint64_t source_key = 0;
+            auto converter = load_file_converter(dictionary_path.c_str(), source_key, progress);
+            if (!word_path.empty()) {
+                std::string cache = snapshot_cache();
+                uint64_t base_key = cache.empty() ? 0 : dictionary_key(*converter, source_key);
+                source_key = base_key ? SnapshotCache::file_key(word_path, base_key) : 0;
+                converter = build_cached(cache, source_key, [&] {
+                    // Not shared yet, so the words go into the converter itself
+                    WordSegmenter(*converter).load_from_file(word_path);
+                    return std::move(converter);
+                });
+                async_load.progress.store(100, std::memory_order_relaxed);
+            }
+            auto snapshot = make_snapshot(std::move(converter), source_key);
+            
+            std::lock_guard<std::mutex> lock(global_handle.update_mutex);
+            if (global_handle.publish_count == ticket) {
+                global_handle.publish(keep_user_dictionary(global_handle, std::move(snapshot)));
+            } else {
+                error = "Superseded by a later initialization or cleanup";
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+            std::lock_guard<std::mutex> lock(global_handle.update_mutex);
+            if (bootstrapped && global_handle.publish_count == ticket) {
+                global_handle.publish(nullptr);
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(async_load.mutex);
+            async_load.error = error;
+            async_load.state.store(error.empty() ? INIT_READY : INIT_FAILED);
+        }
+        async_load.finished.notify_all();
+        
+        if (callback) {
+            callback(error.empty() ? 1 : 0, error.empty() ? nullptr : error.c_str(), user_data);
+        }
+    }
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// FFI EXPORT MACROS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Export macro for C-compatible functions
+ * 
+ * Ensures proper visibility and C linkage for FFI exports
+ */
+#ifdef _WIN32
+    #define FFI_EXPORT extern "C" __declspec(dllexport)
+#else
+    #define FFI_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// INITIALIZATION FUNCTIONS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Initialize the phoneme converter with a JSON dictionary file
+ * 
+ * This function loads the phoneme dictionary from a JSON file and initializes
+ * the converter. It also attempts to load a binary .trie file for faster loading.
+ * 
+ * @param json_file_path Path to the ja_phonemes.json file (UTF-8 encoded)
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Thread-safe: Can be called from any thread, also while other threads
+ *       convert (they finish on the previous dictionary)
+ * 
+ * @code
+ * if (jpn_phoneme_init("assets/ja_phonemes.json") != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_init(const char* json_file_path) {
+    return FFIState::replace_dictionary(FFIState::global_handle, false, [&] {
+        return FFIState::load_file_snapshot(json_file_path);
+    });
+}
+
+/**
+ * @brief Initialize the phoneme converter from memory-mapped .trie data
+ * 
+ * This function loads a pre-compiled binary trie directly from memory,
+ * providing the fastest initialization method (100x faster than JSON).
+ * The buffer is parsed in place - nothing is written to disk. Every node
+ * of a packed v2/v3 buffer is checked once, so damaged data fails here
+ * instead of in a later conversion.
+ * 
+ * @param trie_data Pointer to the binary .trie data in memory
+ * @param data_size Size of the trie data in bytes
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note The trie data is copied internally, so the caller can free it after this call
+ *       (use jpn_phoneme_init_from_memory_borrowed() to avoid the copy)
+ * @note Thread-safe: Can be called from any thread
+ * 
+ * @code
+ * // Load from Flutter asset
+ * uint8_t* data = load_asset("japanese.trie");
+ * int size = get_asset_size("japanese.trie");
+ * if (jpn_phoneme_init_from_memory(data, size) != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_init_from_memory(const uint8_t* trie_data, int data_size) {
+    return FFIState::replace_dictionary(FFIState::global_handle, false, [&] {
+        return FFIState::load_buffer_snapshot(trie_data, data_size);
+    });
+}
+
+/**
+ * @brief Frees a buffer handed over to jpn_phoneme_init_from_memory_owned()
+ */
+typedef void (*JpnPhonemeReleaseCallback)(void* data);
+
+/**
+ * @brief Initialize the phoneme converter from .trie data it takes over
+ * 
+ * Like jpn_phoneme_init_from_memory() without the copy (see
+ * jpn_phoneme_init_from_memory_borrowed()), but the library releases
+ * the buffer itself once nothing reads it anymore: right after the call
+ * for v1 data or on failure, otherwise when the last dictionary snapshot
+ * using it is gone - after a later init or cleanup, once the conversions
+ * still running on it have returned.
+ * 
+ * @param trie_data Pointer to the binary .trie data in memory
+ * @param data_size Size of the trie data in bytes
+ * @param release Called once with trie_data to free it (on whichever thread
+ *        drops the last reference), or NULL to never release it
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note The buffer must stay unchanged until it is released
+ * @note Thread-safe: Can be called from any thread
+ * 
+ * @code
+ * uint8_t* data = malloc(asset_size);
+ * memcpy(data, asset_data, asset_size);
+ * if (jpn_phoneme_init_from_memory_owned(data, asset_size, free) != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());  // data is already freed
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_init_from_memory_owned(const uint8_t* trie_data, int data_size,
+                                                  JpnPhonemeReleaseCallback release) {
+    std::shared_ptr<const uint8_t> borrow;
+    try {
+        if (trie_data) {
+            borrow = std::shared_ptr<const uint8_t>(trie_data, [release](const uint8_t* data) {
+                if (release) release(const_cast<uint8_t*>(data));
+            });
+        }
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();  // The deleter has run already
+        return 0;
+    }
+    return FFIState::replace_dictionary(FFIState::global_handle, false, [&] {
+        return FFIState::load_buffer_snapshot(trie_data, data_size, std::move(borrow));
+    });
+}
+
+/**
+ * @brief Initialize the phoneme converter from .trie data without copying it
+ * 
+ * Like jpn_phoneme_init_from_memory(), but a packed v2/v3 ("JPNT") buffer
+ * is borrowed: lookups walk the caller's memory directly, so init costs the
+ * one validation pass over its nodes (reading the buffer once) and no
+ * copy. v1 ("JPHO") data is parsed into the flat trie as usual and is not
+ * referenced after the call.
+ * 
+ * @param trie_data Pointer to the binary .trie data in memory
+ * @param data_size Size of the trie data in bytes
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note The buffer must stay valid and unchanged as long as the dictionary
+ *       can be read: a later jpn_phoneme_init*() or jpn_phoneme_cleanup()
+ *       call does not wait for conversions (or stream feeds) still running
+ *       on it, on any thread. Use jpn_phoneme_init_from_memory_owned() to
+ *       learn when the buffer can go, or keep it for the life of the process.
+ * @note Thread-safe: Can be called from any thread
+ * 
+ * @code
+ * // Asset kept mapped by the host for the lifetime of the app
+ * if (jpn_phoneme_init_from_memory_borrowed(asset_data, asset_size) != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_init_from_memory_borrowed(const uint8_t* trie_data, int data_size) {
+    return jpn_phoneme_init_from_memory_owned(trie_data, data_size, nullptr);
+}
+
+/**
+ * @brief Start loading the dictionary on a background thread
+ * 
+ * Returns at once. Until the load finishes, conversions are served by the
+ * dictionary already loaded or - on a first init - by a built-in kana
+ * core: kana are read one by one as the full dictionary reads them, kanji
+ * pass through unchanged. The loaded dictionary (with the word list, if given)
+ * then replaces it in one step, like jpn_phoneme_init() followed by
+ * jpn_phoneme_init_word_dict().
+ * 
+ * Poll jpn_phoneme_get_init_state()/jpn_phoneme_get_init_progress(),
+ * block in jpn_phoneme_wait_init(), or pass a callback.
+ * 
+ * @param json_file_path Path to the ja_phonemes.json file (a .trie next to it is preferred)
+ * @param word_file_path Word list to load with it, or NULL
+ * @param callback Called on the loader thread when the load ends, or NULL
+ * @param user_data Passed to callback
+ * @return 1 if the load was started, 0 on failure (check jpn_phoneme_get_error())
+ * 
+ * @note One load at a time: fails while a previous one is running
+ * @note A jpn_phoneme_init*() or jpn_phoneme_cleanup() call made while the
+ *       load runs takes precedence; the load then ends as failed
+ * 
+ * @code
+ * void on_ready(int success, const char* error, void* user_data) {
+ *     if (!success) printf("Error: %s\n", error);
+ * }
+ * jpn_phoneme_init_async("assets/ja_phonemes.json", "assets/ja_words.txt", on_ready, NULL);
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_init_async(
+    const char* json_file_path,
+    const char* word_file_path,
+    JpnPhonemeInitCallback callback,
+    void* user_data
+) {
+    FFIState::last_error.clear();
+    if (!json_file_path) {
+        FFIState::last_error = "Dictionary path must not be NULL";
+        return 0;
+    }
+    
+    FFIState::AsyncLoad& load = FFIState::async_load;
+    std::thread previous;
+    {
+        std::lock_guard<std::mutex> lock(load.mutex);
+        if (load.state.load() == FFIState::INIT_LOADING) {
+            FFIState::last_error = "A background dictionary load is already running";
+            return 0;
+        }
+        
+        try {
+            JpnPhonemeHandle& handle = FFIState::global_handle;
+            std::lock_guard<std::mutex> update_lock(handle.update_mutex);
+            bool bootstrapped = !handle.acquire();
+            if (bootstrapped) {
+                handle.publish(FFIState::kana_core_snapshot());
+            }
+            uint64_t ticket = handle.publish_count;
+            
+            // Cannot finish before we release load.mutex, which it takes to report
+            std::thread next(FFIState::run_async_load, std::string(json_file_path),
+                             std::string(word_file_path ? word_file_path : ""),
+                             ticket, bootstrapped, callback, user_data);
+            previous = std::move(load.worker);
+            load.worker = std::move(next);
+        } catch (const std::exception& e) {
+            FFIState::last_error = e.what();
+            return 0;
+        }
+        load.error.clear();
+        load.progress.store(0);
+        load.state.store(FFIState::INIT_LOADING);
+    }
+    
+    // The previous loader has already finished (it may still be in its callback)
+    if (previous.joinable()) {
+        if (previous.get_id() == std::this_thread::get_id()) {
+            previous.detach();
+        } else {
+            previous.join();
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief State of the jpn_phoneme_init_async() load
+ * @return 0 idle (never started), 1 loading, 2 ready, 3 failed
+ */
+FFI_EXPORT int jpn_phoneme_get_init_state() {
+    return FFIState::async_load.state.load();
+}
+
+/**
+ * @brief Progress of the jpn_phoneme_init_async() load in percent (0-100)
+ * 
+ * Advances with the share of the JSON parsed; a .trie or word list
+ * completes its stage in one step.
+ */
+FFI_EXPORT int jpn_phoneme_get_init_progress() {
+    return FFIState::async_load.progress.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Block until the jpn_phoneme_init_async() load has finished
+ * 
+ * @param timeout_ms Maximum wait in milliseconds, negative to wait without limit
+ * @return The state afterwards (see jpn_phoneme_get_init_state(), 1 = timed out)
+ * 
+ * @note Must not be called from the init callback
+ */
+FFI_EXPORT int jpn_phoneme_wait_init(int timeout_ms) {
+    FFIState::AsyncLoad& load = FFIState::async_load;
+    std::unique_lock<std::mutex> lock(load.mutex);
+    auto done = [&] { return load.state.load() != FFIState::INIT_LOADING; };
+    if (timeout_ms < 0) {
+        load.finished.wait(lock, done);
+    } else {
+        load.finished.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+    }
+    return load.state.load();
+}
+
+/**
+ * @brief Error message of a failed jpn_phoneme_init_async() load
+ * @return The message, empty unless the state is 3 (valid until the next jpn_phoneme_init_async())
+ */
+FFI_EXPORT const char* jpn_phoneme_get_init_error() {
+    std::lock_guard<std::mutex> lock(FFIState::async_load.mutex);
+    return FFIState::async_load.error.c_str();
+}
+
+/**
+ * @brief Load the dictionaries and write them as a v2 trie or a v3 automaton
+ * (see jpn_phoneme_compile_trie())
+ */
+static int compile_dictionary(const char* json_file_path, const char* word_file_path, const char* output_path,
+                              bool automaton) {
+    try {
+        FFIState::last_error.clear();
+        
+        PhonemeConverter converter;
+        converter.load_from_json(json_file_path);
+        
+        if (word_file_path != nullptr) {
+            WordSegmenter segmenter(converter);
+            segmenter.load_from_file(word_file_path);
+        }
+        
+        auto start_time = std::chrono::high_resolution_clock::now();
+        PackedTrieWriter::Stats stats = automaton
+            ? PackedTrieWriter::write_automaton(converter.get_trie(), output_path)
+            : PackedTrieWriter::write(converter.get_trie(), output_path);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        
+        std::cout << "✅ Wrote " << output_path << " in " << elapsed << "ms" << std::endl;
+        std::cout << "   " << (automaton ? "States:   " : "Nodes:    ") << stats.node_count
+                  << (automaton ? " (" + std::to_string(converter.get_trie().node_count()) + " trie nodes)"
+                                : std::string()) << std::endl;
+        std::cout << "   Phonemes: " << stats.phoneme_count 
+                  << " (" << stats.unique_values << (automaton ? " unique outputs)" : " unique values)")
+                  << std::endl;
+        std::cout << "   Words:    " << stats.word_count << std::endl;
+        std::cout << "   Size:     " << stats.file_size << " bytes" << std::endl;
+        return 1;
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return 0;
+    }
+}
+
+/**
+ * @brief Compile dictionaries into a packed v2 (.trie) file
+ * 
+ * Reads the phoneme JSON and (optionally) the word list, merges them into a
+ * single node graph and writes the packed format that jpn_phoneme_init()
+ * memory-maps. This is what the jpn_trie_compiler build tool calls.
+ * 
+ * @param json_file_path Path to ja_phonemes.json (UTF-8 encoded)
+ * @param word_file_path Path to ja_words.txt, or NULL to compile phonemes only
+ * @param output_path Path of the .trie file to write
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Does not touch the global converter state
+ * 
+ * @code
+ * if (jpn_phoneme_compile_trie("ja_phonemes.json", "ja_words.txt", "japanese.trie") != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_compile_trie(
+    const char* json_file_path,
+    const char* word_file_path,
+    const char* output_path
+) {
+    return compile_dictionary(json_file_path, word_file_path, output_path, false);
+}
+
+/**
+ * @brief Compile dictionaries into a v3 minimised automaton (.trie) file
+ * 
+ * Same inputs as jpn_phoneme_compile_trie(), but identical tails of the
+ * node graph are stored once, with the phonemes split over the
+ * transitions. The file is several times smaller than a v2 trie, and so is
+ * the resident dictionary when it is loaded (memory-capped targets).
+ * Lookups walk it in place like v2; emitting a phoneme walks its key once
+ * more to collect the outputs, which costs a little conversion speed.
+ * 
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Does not touch the global converter state
+ */
+FFI_EXPORT int jpn_phoneme_compile_automaton(
+    const char* json_file_path,
+    const char* word_file_path,
+    const char* output_path
+) {
+    return compile_dictionary(json_file_path, word_file_path, output_path, true);
+}
+
+/**
+ * @brief Warm the top levels of every dictionary loaded from now on
+ * 
+ * Init, reload, background init and handle creation then read the first
+ * levels of the trie before the dictionary is published, so the page
+ * faults of a mapped file and the first cache misses are paid by the load
+ * instead of the first conversions. Meant for servers with a latency
+ * budget; each level costs roughly ten times the one above it.
+ * 
+ * @param levels Levels below the root to read (0 = off, the default; 2-3 is typical)
+ * 
+ * @see jpn_phoneme_warm_dictionary() to warm the dictionary that is loaded already
+ */
+FFI_EXPORT void jpn_phoneme_set_warm_levels(int levels) {
+    FFIState::warm_levels.store(std::max(levels, 0), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Read the top levels of the current dictionary now
+ * 
+ * @param levels Levels below the root to read
+ * @return Number of trie nodes visited, or -1 if the converter is not initialized
+ */
+FFI_EXPORT int jpn_phoneme_warm_dictionary(int levels) {
+    std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+    if (!dictionary) {
+        FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+        return -1;
+    }
+    size_t visited = dictionary->converter->warm(static_cast<size_t>(std::max(levels, 0)));
+    return static_cast<int>(std::min<size_t>(visited, INT32_MAX));
+}
+
+/**
+ * @brief Cache built dictionaries as mapped snapshots in a directory
+ * 
+ * A JSON dictionary, a v1 trie or a word list is built entry by entry at
+ * every init. With a cache directory, the built dictionary is also saved
+ * there as a packed v2 trie, keyed by a hash of the files it was built
+ * from. Later inits from the same files (in this or a later run, on any
+ * handle) memory-map the snapshot, so a second launch pages the
+ * dictionary in instead of rebuilding it. Applies to jpn_phoneme_init(),
+ * jpn_phoneme_init_from_memory(), jpn_phoneme_init_async() and the
+ * jpn_phoneme_init_word_dict*() functions; packed v2/v3 dictionaries are
+ * mapped already and are not copied.
+ * 
+ * @param directory Existing writable directory (e.g. the app's cache
+ *        directory), or NULL / "" to turn the cache off (the default)
+ * 
+ * @note Changed files get a new key; stale snapshots are never read again
+ *       and the directory can be cleared at any time
+ * @note Snapshots that cannot be written or read are skipped (logged)
+ * 
+ * @code
+ * jpn_phoneme_set_snapshot_cache("/data/user/0/com.example.app/cache");
+ * jpn_phoneme_init("assets/ja_phonemes.json");  // Built once, mapped on later launches
+ * @endcode
+ */
+FFI_EXPORT void jpn_phoneme_set_snapshot_cache(const char* directory) {
+    std::lock_guard<std::mutex> lock(FFIState::snapshot_cache_mutex);
+    FFIState::snapshot_cache_directory = directory ? directory : "";
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CONVERSION FUNCTIONS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Result code of jpn_phoneme_convert_sized() when the output does not fit
+ * (mirrored as JPN_PHONEME_BUFFER_TOO_SMALL in jpn_to_phoneme_ffi.h)
+ */
+constexpr int CONVERT_BUFFER_TOO_SMALL = -2;
+
+/**
+ * @brief Convert into a caller-provided buffer using a context (see jpn_phoneme_convert_sized())
+ */
+static int convert_with_context(
+    JpnPhonemeContext& context,
+    JpnPhonemeHandle& handle,
+    const DictionarySnapshot& dictionary,
+    bool use_segmentation,
+    const char* text,
+    size_t length,
+    uint8_t* output_buffer,
+    int buffer_size,
+    int32_t* required_size,
+    int64_t* processing_time_us
+) {
+    // Reuse the result a previous call could not return
+    std::string_view input(text, length);
+    int64_t elapsed = context.pending_time_us;
+    if (!context.pending_valid || context.pending_generation != dictionary.generation ||
+        context.pending_segmentation != use_segmentation || context.pending_input != input) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        handle.convert(dictionary, use_segmentation, context.conversion, text, length);
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            end_time - start_time
+        ).count();
+    }
+    context.pending_valid = false;
+    
+    if (processing_time_us) {
+        *processing_time_us = elapsed;
+    }
+    
+    const std::string& result = context.conversion.result();
+    size_t result_len = result.length();
+    if (result_len >= static_cast<size_t>(INT32_MAX)) {
+        FFIState::last_error = "Output too large";
+        return -1;
+    }
+    if (required_size) {
+        *required_size = static_cast<int32_t>(result_len + 1);
+    }
+    
+    // Keep the result for the re-call with a large enough buffer
+    if (result_len >= static_cast<size_t>(buffer_size)) {
+        context.pending_valid = true;
+        context.pending_generation = dictionary.generation;
+        context.pending_segmentation = use_segmentation;
+        context.pending_spans = false;
+        context.pending_input.assign(input.data(), input.size());
+        context.pending_time_us = elapsed;
+        FFIState::last_error = "Output buffer too small";
+        return CONVERT_BUFFER_TOO_SMALL;
+    }
+    
+    if (Stats::active()) {
+        auto copy_start = ConversionStats::Clock::now();
+        std::memcpy(output_buffer, result.data(), result_len);
+        output_buffer[result_len] = '\0';
+        ConversionStats copy;
+        copy.add_time(STAT_OUTPUT_COPY_NS, copy_start, ConversionStats::Clock::now());
+        Stats::publish(copy);
+    } else {
+        std::memcpy(output_buffer, result.data(), result_len);
+        output_buffer[result_len] = '\0';
+    }
+    
+    return static_cast<int>(result_len);
+}
+
+/**
+ * @brief Convert Japanese text to IPA phonemes, reporting the required size
+ * 
+ * Two-phase variant of jpn_phoneme_convert(). If the output does not fit,
+ * the required buffer size is stored in required_size and the converted
+ * text is kept for the calling thread: calling again with the same text and
+ * a buffer of that size copies the kept result instead of converting again.
+ * Passing a NULL buffer with buffer_size 0 is a pure size query.
+ * 
+ * @param japanese_text Input Japanese text (UTF-8 encoded, null-terminated)
+ * @param output_buffer Buffer to store the resulting phonemes (can be NULL if buffer_size is 0)
+ * @param buffer_size Size of the output buffer in bytes
+ * @param required_size Pointer to store the buffer size needed for the output,
+ *        including the null terminator (can be NULL)
+ * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
+ * @return Number of bytes written to output_buffer (excluding null terminator),
+ *         JPN_PHONEME_BUFFER_TOO_SMALL (-2) if the buffer is too small,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Thread-safe: Can be called concurrently from multiple threads
+ * @note Only the last result that did not fit is kept (one per thread)
+ * 
+ * @code
+ * int32_t required;
+ * jpn_phoneme_convert_sized(long_text, NULL, 0, &required, NULL);
+ * uint8_t* buffer = malloc(required);
+ * int len = jpn_phoneme_convert_sized(long_text, buffer, required, NULL, NULL);  // Copy only
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_convert_sized(
+    const char* japanese_text,
+    uint8_t* output_buffer,
+    int buffer_size,
+    int32_t* required_size,
+    int64_t* processing_time_us
+) {
+    try {
+        // Check initialization (the snapshot stays valid for the whole call)
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
+        }
+        if (!japanese_text || buffer_size < 0 || (buffer_size > 0 && !output_buffer)) {
+            FFIState::last_error = "Invalid conversion arguments";
+            return -1;
+        }
+        
+        return convert_with_context(FFIState::thread_context, FFIState::global_handle, *dictionary,
+                                    FFIState::global_handle.use_segmentation,
+                                    japanese_text, std::strlen(japanese_text),
+                                    output_buffer, buffer_size, required_size, processing_time_us);
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
+    }
+}
+
+/**
+ * @brief Convert Japanese text to IPA phonemes
+ * 
+ * This function performs the actual conversion from Japanese text to phonemes.
+ * It supports word segmentation, furigana hints, and provides timing information.
+ * 
+ * @param japanese_text Input Japanese text (UTF-8 encoded, null-terminated)
+ * @param output_buffer Buffer to store the resulting phonemes (UTF-8 encoded)
+ * @param buffer_size Size of the output buffer in bytes
+ * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
+ * @return Number of bytes written to output_buffer (excluding null terminator),
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Thread-safe: Can be called concurrently from multiple threads
+ * @note The output is null-terminated if buffer has space
+ * @note If the buffer is too small the result is kept, so retrying with a
+ *       larger buffer does not convert again (see jpn_phoneme_convert_sized())
+ * 
+ * @code
+ * char buffer[1024];
+ * int64_t time_us;
+ * int len = jpn_phoneme_convert("こんにちは", buffer, sizeof(buffer), &time_us);
+ * if (len >= 0) {
+ *     printf("Phonemes: %s (%lld μs)\n", buffer, time_us);
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_convert(
+    const char* japanese_text,
+    uint8_t* output_buffer,
+    int buffer_size,
+    int64_t* processing_time_us
+) {
+    int result = jpn_phoneme_convert_sized(japanese_text, output_buffer, buffer_size,
+                                           nullptr, processing_time_us);
+    return result == CONVERT_BUFFER_TOO_SMALL ? -1 : result;
+}
+
+/**
+ * @brief Create a reusable conversion context
+ * 
+ * A context owns the buffers a conversion needs. They grow to the largest
+ * input seen and are then reused, so converting through a warm context
+ * performs no heap allocation. Keep one context per worker thread.
+ * 
+ * @return Context handle, or NULL on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @note A context must not be used from several threads at once
+ */
+FFI_EXPORT JpnPhonemeContext* jpn_phoneme_context_create() {
+    try {
+        return new JpnPhonemeContext();
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Convert text using a context
+ * 
+ * Same results as jpn_phoneme_convert_sized(), including the two-phase
+ * protocol (the result that did not fit is kept in the context).
+ * 
+ * @param context Context from jpn_phoneme_context_create()
+ * @param text Input Japanese text (UTF-8 encoded)
+ * @param length Length of text in bytes, or -1 if it is null-terminated
+ * @param output_buffer Buffer to store the resulting phonemes (can be NULL if buffer_size is 0)
+ * @param buffer_size Size of the output buffer in bytes
+ * @param required_size Pointer to store the buffer size needed for the output,
+ *        including the null terminator (can be NULL)
+ * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
+ * @return Number of bytes written to output_buffer (excluding null terminator),
+ *         JPN_PHONEME_BUFFER_TOO_SMALL (-2) if the buffer is too small,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @code
+ * JpnPhonemeContext* ctx = jpn_phoneme_context_create();
+ * for (int i = 0; i < line_count; i++) {
+ *     int len = jpn_phoneme_context_convert(ctx, lines[i], -1, buffer, sizeof(buffer), NULL, NULL);
+ * }
+ * jpn_phoneme_context_destroy(ctx);
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_context_convert(
+    JpnPhonemeContext* context,
+    const char* text,
+    int length,
+    uint8_t* output_buffer,
+    int buffer_size,
+    int32_t* required_size,
+    int64_t* processing_time_us
+) {
+    try {
+        // Check initialization
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
+        }
+        if (!context || !text || buffer_size < 0 || (buffer_size > 0 && !output_buffer)) {
+            FFIState::last_error = "Invalid conversion arguments";
+            return -1;
+        }
+        
+        size_t text_length = length < 0 ? std::strlen(text) : static_cast<size_t>(length);
+        return convert_with_context(*context, FFIState::global_handle, *dictionary,
+                                    FFIState::global_handle.use_segmentation,
+                                    text, text_length,
+                                    output_buffer, buffer_size, required_size, processing_time_us);
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
+    }
+}
+
+/**
+ * @brief Convert text and report which part of the input each part of the output came from
+ * 
+ * Fills spans with one record per piece of the output, in output order: a
+ * dictionary match, a run of characters copied through unchanged, or the
+ * reading of a furigana-hinted word. Offsets are in bytes of text and of
+ * the output; the spaces between segmented words belong to no span. No
+ * strings are built per match, so this is cheap enough for lip-sync or
+ * highlighting on every line. The result cache is bypassed.
+ * 
+ * Uses the two-phase protocol of jpn_phoneme_convert_sized() for both
+ * buffers: if the output or the spans do not fit, both sizes are reported
+ * and the result is kept in the context for the re-call.
+ * 
+ * @param context Context from jpn_phoneme_context_create(), or NULL for the calling thread's
+ * @param text Input Japanese text (UTF-8 encoded)
+ * @param length Length of text in bytes, or -1 if it is null-terminated
+ * @param output_buffer Buffer to store the resulting phonemes (can be NULL if buffer_size is 0)
+ * @param buffer_size Size of the output buffer in bytes
+ * @param spans Array to store the spans in (can be NULL if span_capacity is 0)
+ * @param span_capacity Number of records spans can hold
+ * @param required_size Pointer to store the buffer size needed for the output,
+ *        including the null terminator (can be NULL)
+ * @param span_count Pointer to store the number of spans (can be NULL)
+ * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
+ * @return Number of bytes written to output_buffer (excluding null terminator),
+ *         JPN_PHONEME_BUFFER_TOO_SMALL (-2) if the output or the spans do not fit,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @code
+ * JpnPhonemeSpan spans[64];
+ * int32_t count;
+ * int len = jpn_phoneme_convert_spans(NULL, "健太「けんた」は", -1, buffer, sizeof(buffer),
+ *                                     spans, 64, NULL, &count, NULL);
+ * // spans[0]: 健太「けんた」 → "keɴta" (FURIGANA), spans[1]: は → "wa" (MATCHED)
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_convert_spans(
+    JpnPhonemeContext* context,
+    const char* text,
+    int length,
+    uint8_t* output_buffer,
+    int buffer_size,
+    MatchSpan* spans,
+    int span_capacity,
+    int32_t* required_size,
+    int32_t* span_count,
+    int64_t* processing_time_us
+) {
+    try {
+        // Check initialization (the snapshot stays valid for the whole call)
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
+        }
+        if (!text || buffer_size < 0 || (buffer_size > 0 && !output_buffer) ||
+            span_capacity < 0 || (span_capacity > 0 && !spans)) {
+            FFIState::last_error = "Invalid conversion arguments";
+            return -1;
+        }
+        if (!context) {
+            context = &FFIState::thread_context;
+        }
+        
+        // Reuse the result a previous call could not return
+        size_t text_length = length < 0 ? std::strlen(text) : static_cast<size_t>(length);
+        std::string_view input(text, text_length);
+        bool use_segmentation = FFIState::global_handle.use_segmentation;
+        int64_t elapsed = context->pending_time_us;
+        if (!context->pending_valid || !context->pending_spans ||
+            context->pending_generation != dictionary->generation ||
+            context->pending_segmentation != use_segmentation || context->pending_input != input) {
+            if (text_length >= static_cast<size_t>(UINT32_MAX)) {
+                FFIState::last_error = "Input too large";
+                return -1;
+            }
+            auto start_time = std::chrono::high_resolution_clock::now();
+            
+            context->conversion.convert_spans(*dictionary->converter, dictionary->active_segmenter(use_segmentation),
+                                              text, text_length);
+            
+            auto end_time = std::chrono::high_resolution_clock::now();
+            elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                end_time - start_time
+            ).count();
+        }
+        context->pending_valid = false;
+        
+        if (processing_time_us) {
+            *processing_time_us = elapsed;
+        }
+        
+        const std::string& result = context->conversion.result();
+        const std::vector<MatchSpan>& matched = context->conversion.spans();
+        size_t result_len = result.length();
+        if (result_len >= static_cast<size_t>(INT32_MAX) || matched.size() >= static_cast<size_t>(INT32_MAX)) {
+            FFIState::last_error = "Output too large";
+            return -1;
+        }
+        if (required_size) {
+            *required_size = static_cast<int32_t>(result_len + 1);
+        }
+        if (span_count) {
+            *span_count = static_cast<int32_t>(matched.size());
+        }
+        
+        // Keep the result for the re-call with large enough buffers
+        if (result_len >= static_cast<size_t>(buffer_size) || matched.size() > static_cast<size_t>(span_capacity)) {
+            context->pending_valid = true;
+            context->pending_generation = dictionary->generation;
+            context->pending_segmentation = use_segmentation;
+            context->pending_spans = true;
+            context->pending_input.assign(input.data(), input.size());
+            context->pending_time_us = elapsed;
+            FFIState::last_error = "Output buffer too small";
+            return CONVERT_BUFFER_TOO_SMALL;
+        }
+        
+        std::memcpy(output_buffer, result.data(), result_len);
+        output_buffer[result_len] = '\0';
+        if (!matched.empty()) {
+            std::memcpy(spans, matched.data(), matched.size() * sizeof(MatchSpan));
+        }
+        return static_cast<int>(result_len);
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
+    }
+}
+
+/**
+ * @brief Destroy a context and free its buffers (NULL is ignored)
+ */
+FFI_EXPORT void jpn_phoneme_context_destroy(JpnPhonemeContext* context) {
+    delete context;
+}
+
+/**
+ * @brief Per-item status codes of jpn_phoneme_convert_batch()
+ * (mirrored as JPN_PHONEME_BATCH_* in jpn_to_phoneme_ffi.h)
+ */
+enum BatchItemStatus : int32_t {
+    BATCH_ITEM_OK = 0,          // Converted, output is in the arena
+    BATCH_ITEM_ERROR = 1,       // Conversion failed (invalid input)
+    BATCH_ITEM_ARENA_FULL = 2   // Output did not fit in the remaining arena
+};
+
+/**
+ * @brief Batch conversion helpers (sequential and multithreaded)
+ */
+namespace BatchConversion {
+    /** @brief One batch input (view into caller memory) */
+    struct Item {
+        const char* text;
+        size_t length;
+        bool valid;
+    };
+    
+    const std::string INVALID_ITEM = "Invalid batch item";
+    
+    /**
+     * @brief Convert one item with the current settings
+     * @return BATCH_ITEM_OK or BATCH_ITEM_ERROR (message in error)
+     */
+    int32_t convert_item(const Item& item, JpnPhonemeHandle& handle, const DictionarySnapshot& dictionary,
+                         bool use_segmentation, ConversionContext& context, std::string& error) {
+        if (!item.valid) {
+            error = INVALID_ITEM;
+            return BATCH_ITEM_ERROR;
+        }
+        try {
+            handle.convert(dictionary, use_segmentation, context, item.text, item.length);
+            return BATCH_ITEM_OK;
+        } catch (const std::exception& e) {
+            error = e.what();
+            return BATCH_ITEM_ERROR;
+        }
+    }
+    
+    /**
+     * @brief Convert items[begin, end) without segmentation as one interleaved batch
+     * 
+     * Same results as convert_item() for each of them: cache hits are
+     * taken as they are, the other valid items are converted together
+     * (InterleavedBatch) and stored in the cache. Afterwards
+     * batch.result(i - begin) is the output of item i when status[i] is
+     * BATCH_ITEM_OK; failed items are marked BATCH_ITEM_ERROR (INVALID_ITEM).
+     */
+    void convert_interleaved(JpnPhonemeHandle& handle, const DictionarySnapshot& dictionary,
+                             const std::vector<Item>& items, size_t begin, size_t end,
+                             ConversionContext& context, InterleavedBatch& batch, int32_t* status) {
+        std::vector<uint8_t> cached(end - begin, 0);
+        batch.clear();
+        for (size_t i = begin; i < end; i++) {
+            const Item& item = items[i];
+            if (!item.valid) {
+                status[i] = BATCH_ITEM_ERROR;
+                batch.add_result(std::string_view());
+                continue;
+            }
+            status[i] = BATCH_ITEM_OK;
+            std::string_view input(item.text, item.length);
+            if (handle.cache.lookup(input, dictionary.generation, false, context)) {
+                cached[i - begin] = 1;
+                batch.add_result(context.result());
             } else {
-                result = converter.convert_detailed(text);
+                batch.add(item.text, item.length);
             }
-            auto end_time = std::chrono::high_resolution_clock::now();
-            auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
-            auto elapsed_ms = elapsed_us / 1000.0;
-            
-            // Display results
-            std::cout << "┌─────────────────────────────────────────" << std::endl;
-            std::cout << "│ Input:    " << text << std::endl;
-            std::cout << "│ Phonemes: " << result.phonemes << std::endl;
-            std::cout << "│ Time:     " << elapsed_us << "μs (" << elapsed_ms << "ms)" << std::endl;
-            std::cout << "└─────────────────────────────────────────" << std::endl;
-            
-            if (!result.matches.empty()) {
-                std::cout << "\n  ✅ Matches (" << result.matches.size() << "):" << std::endl;
-                for (const auto& match : result.matches) {
-                    std::cout << "    • " << match.to_string() << std::endl;
+        }
+        
+        batch.convert(*dictionary.converter);
+        
+        for (size_t i = begin; i < end; i++) {
+            if (status[i] == BATCH_ITEM_OK && !cached[i - begin]) {
+                handle.cache.store(std::string_view(items[i].text, items[i].length), dictionary.generation, false,
+                                   batch.result(i - begin));
+            }
+        }
+    }
+    
+    /** @brief Prefetch hint for the item converted next (see PhonemeConverter::prefetch()) */
+    inline void prefetch_item(const Item& item, const DictionarySnapshot& dictionary) {
+        if (item.valid) {
+            dictionary.converter->prefetch(item.text, item.length);
+        }
+    }
+    
+    /** @brief Contiguous range of items, the unit of work of the pool */
+    struct Chunk {
+        size_t begin;
+        size_t end;
+    };
+    
+    /** @brief Per-worker chunk deque (owner pops the front, thieves take the back) */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+    
+    /**
+     * @brief Convert all items on a work-stealing thread pool
+     * 
+     * Items are grouped into contiguous chunks of roughly equal byte length
+     * (not item count), dealt round-robin to the workers. A worker takes
+     * chunks from the front of its own deque and, once that is empty,
+     * steals from the back of the others - so a few long inputs cannot
+     * leave the remaining threads idle. Every item is written to its own
+     * slot, so the result does not depend on the schedule.
+     */
+    void convert_parallel(JpnPhonemeHandle& handle, const DictionarySnapshot& dictionary, bool use_segmentation,
+                          bool interleaved, const std::vector<Item>& items, std::vector<std::string>& outputs,
+                          std::vector<int32_t>& status, std::vector<std::string>& errors,
+                          unsigned thread_count) {
+        size_t total_bytes = 0;
+        for (const Item& item : items) {
+            total_bytes += item.length + 1;  // +1 so empty items still count
+        }
+        
+        // ~16 chunks per worker leaves enough slack for stealing
+        size_t target_bytes = std::max<size_t>(total_bytes / (thread_count * 16), 1024);
+        std::vector<Chunk> chunks;
+        size_t chunk_begin = 0;
+        size_t chunk_bytes = 0;
+        for (size_t i = 0; i < items.size(); i++) {
+            chunk_bytes += items[i].length + 1;
+            if (chunk_bytes >= target_bytes) {
+                chunks.push_back({chunk_begin, i + 1});
+                chunk_begin = i + 1;
+                chunk_bytes = 0;
+            }
+        }
+        if (chunk_begin < items.size()) {
+            chunks.push_back({chunk_begin, items.size()});
+        }
+        
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, chunks.size()));
+        std::vector<WorkQueue> queues(thread_count);
+        for (size_t c = 0; c < chunks.size(); c++) {
+            queues[c % thread_count].chunks.push_back(chunks[c]);
+        }
+        
+        auto next_chunk = [&](unsigned self, Chunk& chunk) {
+            {
+                std::lock_guard<std::mutex> lock(queues[self].mutex);
+                if (!queues[self].chunks.empty()) {
+                    chunk = queues[self].chunks.front();
+                    queues[self].chunks.pop_front();
+                    return true;
+                }
+            }
+            // Own deque is empty: steal from the back of another worker's
+            for (unsigned k = 1; k < thread_count; k++) {
+                WorkQueue& victim = queues[(self + k) % thread_count];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.chunks.empty()) {
+                    chunk = victim.chunks.back();
+                    victim.chunks.pop_back();
+                    return true;
+                }
+            }
+            return false;  // Nothing left anywhere (no work is added later)
+        };
+        
+        auto worker = [&](unsigned self) {
+            ConversionContext context;
+            InterleavedBatch batch;
+            Chunk chunk;
+            while (next_chunk(self, chunk)) {
+                if (interleaved) {
+                    convert_interleaved(handle, dictionary, items, chunk.begin, chunk.end, context, batch,
+                                        status.data());
+                    for (size_t i = chunk.begin; i < chunk.end; i++) {
+                        if (status[i] == BATCH_ITEM_OK) outputs[i] = batch.result(i - chunk.begin);
+                        else errors[i] = INVALID_ITEM;
+                    }
+                    continue;
+                }
+                for (size_t i = chunk.begin; i < chunk.end; i++) {
+                    if (i + 1 < chunk.end) prefetch_item(items[i + 1], dictionary);
+                    status[i] = convert_item(items[i], handle, dictionary, use_segmentation, context, errors[i]);
+                    if (status[i] == BATCH_ITEM_OK) outputs[i] = context.result();
+                }
+            }
+        };
+        
+        // The calling thread is worker 0
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (unsigned t = 1; t < thread_count; t++) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+/**
+ * @brief Multithreaded variant of jpn_phoneme_convert_batch()
+ * 
+ * Same arguments and results as jpn_phoneme_convert_batch(), plus the number
+ * of worker threads. The items are spread over a work-stealing pool
+ * balanced by input byte length; the dictionary snapshot is immutable,
+ * so workers share it without locking. The arena layout, statuses and
+ * offsets are identical to the single-threaded call for any thread count.
+ * 
+ * @param thread_count Number of worker threads (including the caller),
+ *        0 = one per hardware thread, 1 = convert on the calling thread
+ * 
+ * @note A concurrent jpn_phoneme_init()/jpn_phoneme_cleanup() does not affect a
+ *       running batch: all items use the dictionary the batch started with
+ * 
+ * @code
+ * int ok = jpn_phoneme_convert_batch_mt(texts, lengths, count, arena, arena_size,
+ *                                       offsets, status, NULL, 0);
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_convert_batch_mt(
+    const char* const* texts,
+    const int32_t* text_lengths,
+    int count,
+    uint8_t* output_arena,
+    int arena_size,
+    int32_t* output_offsets,
+    int32_t* item_status,
+    int64_t* processing_time_us,
+    int thread_count
+) {
+    try {
+        // Check initialization (one snapshot for the whole batch)
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        bool use_segmentation = FFIState::global_handle.use_segmentation;
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
+        }
+        if (count < 0 || arena_size < 0 || thread_count < 0 || !output_offsets || (count > 0 && !texts) ||
+            (arena_size > 0 && !output_arena)) {
+            FFIState::last_error = "Invalid batch arguments";
+            return -1;
+        }
+        
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        std::vector<BatchConversion::Item> items(count);
+        for (int i = 0; i < count; i++) {
+            BatchConversion::Item& item = items[i];
+            item.text = texts[i];
+            item.valid = texts[i] != nullptr && !(text_lengths && text_lengths[i] < 0);
+            item.length = !item.valid ? 0
+                        : text_lengths ? static_cast<size_t>(text_lengths[i])
+                        : std::strlen(texts[i]);
+        }
+        
+        unsigned threads = thread_count > 0 ? static_cast<unsigned>(thread_count)
+                                            : std::max(1u, std::thread::hardware_concurrency());
+        
+        // Statistics count the walks of the scalar path, so recording keeps it
+        bool interleaved = !use_segmentation && !Stats::active() &&
+                           FFIState::interleaved_batches.load(std::memory_order_relaxed);
+        
+        size_t used = 0;
+        int converted = 0;
+        std::string last_item_error;
+        output_offsets[0] = 0;
+        
+        // Place one converted item in the arena (in input order)
+        auto place = [&](int i, int32_t status, const std::string& output, const std::string& error) {
+            if (status == BATCH_ITEM_OK) {
+                if (output.length() > static_cast<size_t>(arena_size) - used) {
+                    status = BATCH_ITEM_ARENA_FULL;
+                } else if (Stats::active()) {
+                    auto copy_start = ConversionStats::Clock::now();
+                    std::memcpy(output_arena + used, output.data(), output.length());
+                    ConversionStats copy;
+                    copy.add_time(STAT_OUTPUT_COPY_NS, copy_start, ConversionStats::Clock::now());
+                    Stats::publish(copy);
+                    used += output.length();
+                    converted++;
+                } else {
+                    std::memcpy(output_arena + used, output.data(), output.length());
+                    used += output.length();
+                    converted++;
                 }
+            } else {
+                last_item_error = error;
             }
             
-            if (!result.unmatched.empty()) {
-                std::cout << "\n  ⚠️  Unmatched characters: ";
-                for (size_t i = 0; i < result.unmatched.size(); i++) {
-                    if (i > 0) std::cout << ", ";
-                    std::cout << result.unmatched[i];
+            output_offsets[i + 1] = static_cast<int32_t>(used);
+            if (item_status) item_status[i] = status;
+        };
+        
+        if ((threads <= 1 || count <= 1) && interleaved) {
+            InterleavedBatch& batch = FFIState::thread_batch;
+            std::vector<int32_t> status(count);
+            BatchConversion::convert_interleaved(FFIState::global_handle, *dictionary, items, 0, count,
+                                                 FFIState::thread_context.conversion, batch, status.data());
+            FFIState::thread_context.pending_valid = false;
+            for (int i = 0; i < count; i++) {
+                place(i, status[i], batch.result(i), BatchConversion::INVALID_ITEM);
+            }
+        } else if (threads <= 1 || count <= 1) {
+            // Converted straight from the thread's context into the arena
+            ConversionContext& context = FFIState::thread_context.conversion;
+            FFIState::thread_context.pending_valid = false;
+            std::string error;
+            for (int i = 0; i < count; i++) {
+                if (i + 1 < count) BatchConversion::prefetch_item(items[i + 1], *dictionary);
+                int32_t status = BatchConversion::convert_item(items[i], FFIState::global_handle, *dictionary,
+                                                               use_segmentation, context, error);
+                place(i, status, context.result(), error);
+            }
+        } else {
+            std::vector<std::string> outputs(count);
+            std::vector<std::string> errors(count);
+            std::vector<int32_t> status(count, BATCH_ITEM_ERROR);
+            BatchConversion::convert_parallel(FFIState::global_handle, *dictionary, use_segmentation, interleaved,
+                                              items, outputs, status, errors, threads);
+            for (int i = 0; i < count; i++) {
+                place(i, status[i], outputs[i], errors[i]);
+            }
+        }
+        
+        if (!last_item_error.empty()) {
+            FFIState::last_error = last_item_error;
+        }
+        
+        if (processing_time_us) {
+            auto end_time = std::chrono::high_resolution_clock::now();
+            *processing_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                end_time - start_time
+            ).count();
+        }
+        
+        return converted;
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
+    }
+}
+
+/**
+ * @brief Convert many texts in one call into a caller-supplied arena
+ * 
+ * Converts every input with the current settings (segmentation on/off) and
+ * writes the outputs back to back into output_arena. One FFI transition and
+ * no per-item allocation on the caller side, which makes it the preferred
+ * entry point for bulk jobs (subtitles, TTS preprocessing, ...).
+ * 
+ * @param texts Array of count UTF-8 input pointers
+ * @param text_lengths Byte length of each input, or NULL if all inputs are null-terminated
+ * @param count Number of inputs
+ * @param output_arena Buffer receiving all outputs (not null-terminated)
+ * @param arena_size Size of output_arena in bytes
+ * @param output_offsets Array of count + 1 entries: output i is
+ *        output_arena[output_offsets[i], output_offsets[i + 1])
+ * @param item_status Array of count entries receiving a BatchItemStatus (can be NULL)
+ * @param processing_time_us Pointer to store total processing time in microseconds (can be NULL)
+ * @return Number of items converted successfully, or -1 on error
+ *         (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Failed items get an empty output range. Items that did not fit are
+ *       marked BATCH_ITEM_ARENA_FULL and can be retried with a larger arena;
+ *       later items that still fit are converted.
+ * @note Thread-safe: Can be called concurrently from multiple threads
+ * @see jpn_phoneme_convert_batch_mt() to spread a large batch over several cores
+ * 
+ * @code
+ * const char* texts[] = {"こんにちは", "ありがとう"};
+ * uint8_t arena[4096];
+ * int32_t offsets[3];
+ * int32_t status[2];
+ * int ok = jpn_phoneme_convert_batch(texts, NULL, 2, arena, sizeof(arena), offsets, status, NULL);
+ * for (int i = 0; i < 2; i++) {
+ *     printf("%.*s\n", offsets[i + 1] - offsets[i], arena + offsets[i]);
+ * }
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_convert_batch(
+    const char* const* texts,
+    const int32_t* text_lengths,
+    int count,
+    uint8_t* output_arena,
+    int arena_size,
+    int32_t* output_offsets,
+    int32_t* item_status,
+    int64_t* processing_time_us
+) {
+    return jpn_phoneme_convert_batch_mt(texts, text_lengths, count, output_arena, arena_size,
+                                        output_offsets, item_status, processing_time_us, 1);
+}
+
+/**
+ * @brief Convert batches through the interleaved trie walker (throughput mode)
+ * 
+ * With segmentation off, jpn_phoneme_convert_batch() and
+ * jpn_phoneme_convert_batch_mt() then walk the dictionary for up to 16
+ * inputs in lock-step, prefetching each walk's next node while the others
+ * advance, so their memory latencies overlap. Outputs are byte-identical
+ * to the default path. Worth it for large batches on servers where the
+ * dictionary does not fit in cache; single conversions, segmented batches
+ * and batches with statistics enabled are not affected.
+ * 
+ * @param enabled true to interleave, false for one walk at a time (default)
+ */
+FFI_EXPORT void jpn_phoneme_set_batch_interleaving(bool enabled) {
+    FFIState::interleaved_batches.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Check whether batches use the interleaved trie walker
+ */
+FFI_EXPORT bool jpn_phoneme_get_batch_interleaving(void) {
+    return FFIState::interleaved_batches.load(std::memory_order_relaxed);
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// STREAMING CONVERSION FUNCTIONS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Receives converted phonemes from a stream (UTF-8, not null-terminated)
+ */
+typedef void (*JpnPhonemeStreamCallback)(const uint8_t* data, int32_t length, void* user_data);
+
+/**
+ * @brief Incremental converter behind the jpn_phoneme_stream_* functions
+ * 
+ * Input is buffered until a line break outside of a furigana hint: no
+ * dictionary entry contains a line break, and an open 「 keeps the line
+ * pending until its 」 arrives, so the line is converted and emitted right
+ * away, with its hints resolved within the line. Memory use is bounded by
+ * the longest line instead of the whole document.
+ * 
+ * A line longer than MAX_PENDING is cut before its end instead, as soon as
+ * LOOKAHEAD more of it has been scanned (whatever the chunk sizes, see
+ * forced_cut()): at a match or word boundary that is at least the longest
+ * dictionary key and LOOKAHEAD before that point, where no hint looks back
+ * across it, after punctuation or a space if there is one, so the matches
+ * and hints on both sides are those of the whole line. Only a line without
+ * such a boundary (one unmatched run, or a hint whose word search looks
+ * back over LOOKAHEAD) is cut where it differs.
+ */
+struct JpnPhonemeStream {
+    /** @brief Force a cut when this much input is pending without a line break */
+    static constexpr size_t MAX_PENDING = 64 * 1024;
+    /** @brief Input a forced cut looks at past MAX_PENDING, and keeps pending at least */
+    static constexpr size_t LOOKAHEAD = 4 * 1024;
+    
+    JpnPhonemeStreamCallback callback;
+    void* user_data;
+    
+    std::string pending;        // Input not converted yet
+    size_t scan_pos = 0;        // Bytes of pending already scanned for cuts
+    bool in_hint = false;       // Scanned up to an unclosed 「
+    size_t hint_open = 0;       // Offset of that 「 in pending
+    std::vector<uint32_t> cut_scratch;  // Decode buffer of forced_cut()
+    std::vector<size_t> cut_positions;  // ... its byte offsets
+    std::vector<SegmentSpan> cut_hints; // ... its furigana segments
+    std::vector<std::pair<size_t, size_t>> cut_ranges;  // ... where a cut keeps hints intact
+    bool emitted_words = false; // Output since the last flush (for the word separator)
+    std::string output;         // Reused emit buffer
+    ConversionContext context;  // Reused conversion buffers
+    
+    JpnPhonemeStream(JpnPhonemeStreamCallback callback, void* user_data)
+        : callback(callback), user_data(user_data) {}
+    
+    /**
+     * @brief Convert pending[begin, end) and pass it to the callback
+     * @return Bytes emitted
+     */
+    size_t emit(const DictionarySnapshot& dictionary, bool use_segmentation, size_t begin, size_t end) {
+        const std::string& result = dictionary.convert(context, use_segmentation, pending.data() + begin, end - begin);
+        if (result.empty()) return 0;
+        
+        // Segmented output joins all words with spaces, also across units
+        output.clear();
+        if (dictionary.active_segmenter(use_segmentation) && emitted_words) {
+            output += ' ';
+        }
+        output += result;
+        emitted_words = true;
+        
+        callback(reinterpret_cast<const uint8_t*>(output.data()), static_cast<int32_t>(output.size()), user_data);
+        return output.size();
+    }
+    
+    /**
+     * @brief Append input and emit every unit that is complete
+     * @return Bytes emitted
+     */
+    size_t feed(const DictionarySnapshot& dictionary, bool use_segmentation, const char* data, size_t length) {
+        pending.append(data, length);
+        
+        size_t emitted = 0;
+        size_t unit_begin = 0;
+        size_t pos = scan_pos;
+        while (pos < pending.size()) {
+            unsigned char c = static_cast<unsigned char>(pending[pos]);
+            if (pos - unit_begin >= MAX_PENDING + LOOKAHEAD && (c & 0xC0) != 0x80) {
+                // A line this long is not worth holding back. Cutting at a fixed
+                // length (not at the end of whatever chunk was fed) keeps the
+                // output independent of how the input was split.
+                size_t cut = forced_cut(dictionary, use_segmentation, unit_begin, pos);
+                emitted += emit(dictionary, use_segmentation, unit_begin, cut);
+                unit_begin = cut;
+                if (in_hint && hint_open < cut) in_hint = false;  // Gave up on a hint longer than MAX_PENDING
+            }
+            if (c == '\n' && !in_hint) {
+                emitted += emit(dictionary, use_segmentation, unit_begin, pos + 1);
+                unit_begin = pos + 1;
+            } else if (c == 0xE3) {
+                // 「 (E3 80 8C) and 」 (E3 80 8D); wait for the rest of a split sequence
+                if (pos + 2 >= pending.size()) break;
+                if (static_cast<unsigned char>(pending[pos + 1]) == 0x80) {
+                    unsigned char c3 = static_cast<unsigned char>(pending[pos + 2]);
+                    if (c3 == 0x8C && !in_hint) {
+                        in_hint = true;
+                        hint_open = pos;
+                    } else if (c3 == 0x8D) {
+                        in_hint = false;
+                    }
                 }
-                std::cout << std::endl;
+                pos += 3;
+                continue;
             }
+            pos++;
+        }
+        
+        pending.erase(0, unit_begin);
+        scan_pos = pos - unit_begin;
+        hint_open -= std::min(hint_open, unit_begin);
+        return emitted;
+    }
+    
+    /**
+     * @brief Where to cut pending[begin, end), a line without a break
+     * 
+     * What follows end can only change the matches that start within the
+     * longest dictionary key before it, and the hints, whose word search
+     * can look back past punctuation (see collect_hint_ranges()). So the cut is the
+     * start of a match (a word, with segmentation) in the conversion of
+     * pending[begin, end), at least that far and LOOKAHEAD before end and
+     * before an open hint, preferably right after punctuation or a space.
+     * Without any, it falls back to that limit, and to LOOKAHEAD before end
+     * if an open hint fills the whole line. feed() calls this at a fixed
+     * length past begin, so the cut only depends on the text.
+     * 
+     * @return Cut offset in pending, a character boundary in (begin, end]
+     */
+    size_t forced_cut(const DictionarySnapshot& dictionary, bool use_segmentation, size_t begin, size_t end) {
+        const char* text = pending.data();
+        auto previous_boundary = [&](size_t offset) {
+            do {
+                offset--;
+            } while (offset > begin && (static_cast<unsigned char>(text[offset]) & 0xC0) == 0x80);
+            return offset;
+        };
+        
+        size_t keep = dictionary.converter->longest_key();
+        size_t limit = end;
+        for (size_t kept = 0; kept < keep && limit > begin; kept++) {
+            limit = previous_boundary(limit);
+        }
+        limit = std::min(limit, end - LOOKAHEAD);
+        if (in_hint) limit = std::min(limit, hint_open);
+        if (limit > begin && (static_cast<unsigned char>(text[limit]) & 0xC0) == 0x80) {
+            limit = previous_boundary(limit);
+        }
+        
+        if (limit > begin) {
+            context.convert_spans(*dictionary.converter, dictionary.active_segmenter(use_segmentation),
+                                  text + begin, end - begin);
+            bool words = dictionary.active_segmenter(use_segmentation) != nullptr;
+            decode_utf8(text + begin, end - begin, cut_scratch, &cut_positions);
+            if (words) collect_hint_ranges(dictionary, begin);
             
-            std::cout << std::endl;
+            size_t boundary = begin;     // Last match start up to limit
+            size_t punctuated = begin;   // ... of those, the last after punctuation or a space
+            for (const MatchSpan& span : context.spans()) {
+                size_t start = begin + span.src_offset;
+                if (start == begin || start > limit || (words && !(span.flags & SPAN_WORD_START))) {
+                    continue;
+                }
+                if (words && !keeps_hints(start)) continue;
+                boundary = std::max(boundary, start);
+                size_t index = std::lower_bound(cut_positions.begin(), cut_positions.end(), start - begin) -
+                               cut_positions.begin();
+                if (ends_hinted_word(cut_scratch[index - 1])) {
+                    punctuated = std::max(punctuated, start);
+                }
+            }
+            if (punctuated > begin) return punctuated;
+            if (boundary > begin) return boundary;
+            return limit;
+        }
+        
+        // An open hint covers the whole line: only keep the lookahead
+        limit = previous_boundary(end - LOOKAHEAD + 1);
+        return limit > begin ? limit : previous_boundary(end);
+    }
+    
+    /**
+     * @brief Fill cut_ranges from the furigana hints of the decoded cut_scratch
+     * 
+     * Segmented conversion resolves hints first, so a cut inside a hinted
+     * word or a compound, or anywhere the okurigana check of the next hint
+     * looks back to, would change them. Cuts are kept to the splits
+     * parse_furigana_spans() reports. An open hint is closed at the end so
+     * that its word is found too.
+     */
+    void collect_hint_ranges(const DictionarySnapshot& dictionary, size_t begin) {
+        if (in_hint) {
+            cut_scratch.push_back(0x300D);
+            cut_positions.push_back(cut_positions.back());
+        }
+        parse_furigana_spans(cut_scratch, dictionary.converter.get(), cut_hints, &cut_ranges);
+        
+        for (std::pair<size_t, size_t>& range : cut_ranges) {
+            range.first = begin + cut_positions[range.first];
+            range.second = begin + cut_positions[range.second];
+        }
+    }
+    
+    /**
+     * @brief Whether a cut at this offset leaves the hints of cut_ranges as they are
+     */
+    bool keeps_hints(size_t offset) const {
+        auto next = std::upper_bound(cut_ranges.begin(), cut_ranges.end(), offset,
+                                     [](size_t value, const std::pair<size_t, size_t>& range) {
+                                         return value < range.first;
+                                     });
+        return next != cut_ranges.begin() && offset <= std::prev(next)->second;
+    }
+    
+    /**
+     * @brief Emit everything that is still pending and start a new document
+     * @return Bytes emitted
+     */
+    size_t flush(const DictionarySnapshot& dictionary, bool use_segmentation) {
+        size_t emitted = pending.empty() ? 0 : emit(dictionary, use_segmentation, 0, pending.size());
+        pending.clear();
+        scan_pos = 0;
+        in_hint = false;
+        emitted_words = false;
+        return emitted;
+    }
+};
+
+/**
+ * @brief Create a streaming converter
+ * 
+ * A stream accepts UTF-8 text in chunks of any size (split anywhere, even
+ * inside a character) and emits phonemes through the callback as soon as a
+ * line is complete. The concatenated output is the same as converting the
+ * whole text with jpn_phoneme_convert(), with furigana hints resolved per
+ * line (a hint whose 」 is on a later line holds its lines back until then).
+ * 
+ * @param callback Called with each piece of output, on the thread that feeds the stream
+ * @param user_data Passed through to the callback
+ * @return Stream handle, or NULL on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @note A stream must not be used from several threads at once; separate
+ *       streams can run concurrently
+ * @note Lines longer than 64 KiB are converted in parts, cut once 4 KiB
+ *       more has arrived at a match (or word) boundary that no furigana
+ *       hint looks back across and that keeps the longest dictionary key
+ *       and any open hint pending, preferably after punctuation or a space;
+ *       the parts do not depend on the chunk sizes, and output only differs
+ *       if no such boundary exists (see JpnPhonemeStream)
+ * 
+ * @code
+ * void on_phonemes(const uint8_t* data, int32_t length, void* user_data) {
+ *     fwrite(data, 1, length, (FILE*)user_data);
+ * }
+ * 
+ * JpnPhonemeStream* stream = jpn_phoneme_stream_create(on_phonemes, stdout);
+ * while ((n = fread(chunk, 1, sizeof(chunk), book)) > 0) {
+ *     jpn_phoneme_stream_feed(stream, chunk, n);
+ * }
+ * jpn_phoneme_stream_flush(stream);
+ * jpn_phoneme_stream_destroy(stream);
+ * @endcode
+ */
+FFI_EXPORT JpnPhonemeStream* jpn_phoneme_stream_create(JpnPhonemeStreamCallback callback, void* user_data) {
+    try {
+        if (!callback) {
+            FFIState::last_error = "Stream callback must not be NULL";
+            return nullptr;
+        }
+        return new JpnPhonemeStream(callback, user_data);
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Feed the next chunk of input to a stream
+ * 
+ * @param stream Stream from jpn_phoneme_stream_create()
+ * @param data UTF-8 bytes (need not end on a character boundary)
+ * @param length Number of bytes in data
+ * @return Number of output bytes passed to the callback during this call,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_stream_feed(JpnPhonemeStream* stream, const char* data, int length) {
+    try {
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
+        }
+        if (!stream || length < 0 || (length > 0 && !data)) {
+            FFIState::last_error = "Invalid stream arguments";
+            return -1;
+        }
+        return static_cast<int>(stream->feed(*dictionary, FFIState::global_handle.use_segmentation,
+                                              data, static_cast<size_t>(length)));
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
+    }
+}
+
+/**
+ * @brief Convert and emit all pending input of a stream
+ * 
+ * Call at the end of the input. The stream can be reused afterwards for
+ * a new, independent text.
+ * 
+ * @param stream Stream from jpn_phoneme_stream_create()
+ * @return Number of output bytes passed to the callback during this call,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_stream_flush(JpnPhonemeStream* stream) {
+    try {
+        std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
+            return -1;
         }
-        
-        std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << std::endl;
-        std::cout << "✨ Conversion complete!" << std::endl;
+        if (!stream) {
+            FFIState::last_error = "Invalid stream arguments";
+            return -1;
+        }
+        return static_cast<int>(stream->flush(*dictionary, FFIState::global_handle.use_segmentation));
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return -1;
     }
-    
-    return 0;
+}
+
+/**
+ * @brief Destroy a stream (pending input is discarded, flush first to keep it)
+ * 
+ * @param stream Stream from jpn_phoneme_stream_create(), or NULL
+ */
+FFI_EXPORT void jpn_phoneme_stream_destroy(JpnPhonemeStream* stream) {
+    delete stream;
 }
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// DART FFI EXPORTS
+// ERROR HANDLING FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @file jpn_to_phoneme_ffi.cpp
- * @brief Dart FFI interface for the Japanese Phoneme Converter
+ * @brief Get the last error message
  * 
- * This file provides C-compatible exports for use with Dart FFI.
- * The exports maintain thread-safe global state and provide error handling.
+ * Returns a human-readable error message for the last operation that failed.
+ * The returned string is valid until the next FFI call on the same thread.
  * 
- * @author Japanese Phoneme Converter Contributors
- * @version 2.0.0
- * @date 2024
+ * @return Error message string (never NULL, empty string if no error)
+ * 
+ * @note Thread-safe: Errors are kept per thread, so this reports the last
+ *       failure of a call made on the calling thread
+ * 
+ * @code
+ * if (jpn_phoneme_init("bad_file.json") != 1) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * }
+ * @endcode
  */
+FFI_EXPORT const char* jpn_phoneme_get_error() {
+    return FFIState::last_error.c_str();
+}
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// GLOBAL STATE MANAGEMENT
+// INFORMATION FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Thread-safe global state for the FFI interface
+ * @brief Get the number of entries in the phoneme dictionary
+ * 
+ * Returns the total number of Japanese text to phoneme mappings loaded.
+ * 
+ * @return Number of entries, or -1 if not initialized
+ * 
+ * @note Thread-safe: Can be called from any thread
  * 
- * This namespace encapsulates all global state required for the FFI,
- * ensuring thread-safety through mutex protection where needed.
+ * @code
+ * int count = jpn_phoneme_get_entry_count();
+ * printf("Dictionary has %d entries\n", count);
+ * @endcode
  */
-namespace FFIState {
-    /** @brief Global phoneme converter instance */
-    std::unique_ptr<PhonemeConverter> converter;
-    
-    /** @brief Global word segmenter instance */
-    std::unique_ptr<WordSegmenter> segmenter;
-    
-    /** @brief Whether word segmentation is enabled */
-    bool use_segmentation = true;
-    
-    /** @brief Last error message for error reporting */
-    std::string last_error;
-    
-    /** @brief Mutex for protecting initialization/cleanup operations */
-    std::mutex init_mutex;
-    
-    /** @brief Version string */
-    const char* VERSION = "2.0.0";
+FFI_EXPORT int jpn_phoneme_get_entry_count() {
+    std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+    if (!dictionary) {
+        return -1;
+    }
+    return static_cast<int>(dictionary->converter->get_entry_count());
 }
 
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// FFI EXPORT MACROS
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-
 /**
- * @brief Export macro for C-compatible functions
+ * @brief Get the library version string
  * 
- * Ensures proper visibility and C linkage for FFI exports
+ * Returns the version of the native library in semantic versioning format.
+ * 
+ * @return Version string (e.g., "2.0.0")
+ * 
+ * @note Thread-safe: Can be called from any thread
+ * 
+ * @code
+ * printf("Using Japanese Phoneme Converter v%s\n", jpn_phoneme_version());
+ * @endcode
  */
-#ifdef _WIN32
-    #define FFI_EXPORT extern "C" __declspec(dllexport)
-#else
-    #define FFI_EXPORT extern "C" __attribute__((visibility("default")))
-#endif
+FFI_EXPORT const char* jpn_phoneme_version() {
+    return FFIState::VERSION;
+}
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// INITIALIZATION FUNCTIONS
+// WORD SEGMENTATION FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Initialize the phoneme converter with a JSON dictionary file
+ * @brief Initialize the word dictionary for segmentation
  * 
- * This function loads the phoneme dictionary from a JSON file and initializes
- * the converter. It also attempts to load a binary .trie file for faster loading.
+ * Loads a word list file for improved phoneme output with word boundaries.
+ * The file should contain one Japanese word per line in UTF-8 encoding, or
+ * be a word list compiled with jpn_phoneme_compile_word_list() (faster).
  * 
- * @param json_file_path Path to the ja_phonemes.json file (UTF-8 encoded)
+ * @param word_file_path Path to the word list file (e.g., "ja_words.txt")
  * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
  * 
- * @note Thread-safe: Can be called from any thread, but only one initialization
- *       will occur at a time.
+ * @note Thread-safe: The dictionary is copied with the words added and then
+ *       swapped in; running conversions are not affected, and on failure
+ *       the dictionary is left unchanged
+ * @note This is optional - conversion works without it but may lack word spaces
  * 
  * @code
- * if (jpn_phoneme_init("assets/ja_phonemes.json") != 1) {
- *     printf("Error: %s\n", jpn_phoneme_get_error());
+ * if (jpn_phoneme_init_word_dict("ja_words.txt") == 1) {
+ *     printf("Word segmentation enabled!\n");
  * }
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_init(const char* json_file_path) {
-    std::lock_guard<std::mutex> lock(FFIState::init_mutex);
-    
-    try {
-        // Clear any previous error
-        FFIState::last_error.clear();
-        
-        // Create new converter instance
-        FFIState::converter = std::make_unique<PhonemeConverter>();
-        
-        // Try binary format first (100x faster!)
-        std::string path(json_file_path);
-        size_t dot_pos = path.rfind('.');
-        if (dot_pos != std::string::npos) {
-            std::string trie_path = path.substr(0, dot_pos) + ".trie";
-            if (FFIState::converter->try_load_binary_format(trie_path)) {
-                return 1; // Success with binary format
-            }
-        }
-        
-        // Fallback to JSON
-        FFIState::converter->load_from_json(json_file_path);
-        return 1; // Success
-        
-    } catch (const std::exception& e) {
-        FFIState::last_error = e.what();
-        FFIState::converter.reset();
-        return 0; // Failure
-    }
+FFI_EXPORT int jpn_phoneme_init_word_dict(const char* word_file_path) {
+    return FFIState::load_word_list(FFIState::global_handle, [&](const DictionarySnapshot& current) {
+        return FFIState::add_word_list(current, word_file_path);
+    });
 }
 
 /**
- * @brief Initialize the phoneme converter from memory-mapped .trie data
+ * @brief Initialize the word dictionary from memory
  * 
- * This function loads a pre-compiled binary trie directly from memory,
- * providing the fastest initialization method (100x faster than JSON).
+ * Same as jpn_phoneme_init_word_dict() for a word list already in memory
+ * (e.g. a bundled asset): either UTF-8 text with one word per line or a
+ * compiled "JPNW" list. Compiled lists are stored sorted and pre-decoded,
+ * so they are merged into the dictionary without parsing or sorting.
  * 
- * @param trie_data Pointer to the binary .trie data in memory
- * @param data_size Size of the trie data in bytes
+ * @param data Word list data (not referenced after the call)
+ * @param data_size Size of the data in bytes
  * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
  * 
- * @note The trie data is copied internally, so the caller can free it after this call
- * @note Thread-safe: Can be called from any thread
+ * @note A packed japanese.trie already contains the word list - no word
+ *       dictionary needs to be loaded for it
  * 
  * @code
- * // Load from Flutter asset
- * uint8_t* data = load_asset("japanese.trie");
- * int size = get_asset_size("japanese.trie");
- * if (jpn_phoneme_init_from_memory(data, size) != 1) {
+ * if (jpn_phoneme_init_word_dict_from_memory(words_asset, words_size) != 1) {
  *     printf("Error: %s\n", jpn_phoneme_get_error());
  * }
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_init_from_memory(const uint8_t* trie_data, int data_size) {
-    std::lock_guard<std::mutex> lock(FFIState::init_mutex);
-    
+FFI_EXPORT int jpn_phoneme_init_word_dict_from_memory(const uint8_t* data, int data_size) {
+    return FFIState::load_word_list(FFIState::global_handle, [&](const DictionarySnapshot& current) {
+        return FFIState::add_word_buffer(current, data, data_size);
+    });
+}
+
+/**
+ * @brief Compile a text word list into the "JPNW" format
+ * 
+ * @param word_file_path Path to ja_words.txt (one word per line)
+ * @param output_path Path of the compiled list to write
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Does not touch the global converter state
+ */
+FFI_EXPORT int jpn_phoneme_compile_word_list(const char* word_file_path, const char* output_path) {
     try {
-        // Clear any previous error
         FFIState::last_error.clear();
-        
-        // Create new converter instance
-        FFIState::converter = std::make_unique<PhonemeConverter>();
-        
-        // Create a temporary file in memory using the data
-        // For simplicity, we'll write to a temp file and load it
-        // (A more optimized version would parse directly from memory)
-        
-        #ifdef _WIN32
-            char temp_path[MAX_PATH];
-            char temp_file[MAX_PATH];
-            GetTempPathA(MAX_PATH, temp_path);
-            GetTempFileNameA(temp_path, "jpn", 0, temp_file);
-        #else
-            char temp_file[] = "/tmp/jpn_XXXXXX";
-            int fd = mkstemp(temp_file);
-            if (fd == -1) {
-                throw std::runtime_error("Failed to create temporary file");
-            }
-            close(fd);
-        #endif
-        
-        // Write data to temp file
-        std::ofstream out(temp_file, std::ios::binary);
-        if (!out) {
-            throw std::runtime_error("Failed to open temporary file for writing");
-        }
-        out.write(reinterpret_cast<const char*>(trie_data), data_size);
-        out.close();
-        
-        // Load from temp file
-        bool success = FFIState::converter->try_load_binary_format(temp_file);
-        
-        // Clean up temp file
-        std::remove(temp_file);
-        
-        if (!success) {
-            throw std::runtime_error("Failed to load binary trie format");
+        if (!word_file_path || !output_path) {
+            throw std::runtime_error("Paths must not be NULL");
         }
         
-        return 1; // Success
+        WordListWriter::Stats stats = WordListWriter::write(word_file_path, output_path);
+        std::cout << "✅ Wrote " << output_path << ": " << stats.word_count << " words, "
+                  << stats.file_size << " bytes" << std::endl;
+        return 1;
         
     } catch (const std::exception& e) {
         FFIState::last_error = e.what();
-        FFIState::converter.reset();
-        return 0; // Failure
+        return 0;
+    }
+}
+
+/**
+ * @brief Enable or disable word segmentation
+ * 
+ * Controls whether the converter adds spaces between words in the output.
+ * Word dictionary must be loaded first via jpn_phoneme_init_word_dict().
+ * 
+ * @param enabled true to enable segmentation, false to disable
+ * 
+ * @note Thread-safe: Atomic operation
+ * @note Default is true (enabled)
+ * 
+ * @code
+ * jpn_phoneme_set_use_segmentation(false); // Disable spaces
+ * jpn_phoneme_set_use_segmentation(true);  // Enable spaces
+ * @endcode
+ */
+FFI_EXPORT void jpn_phoneme_set_use_segmentation(bool enabled) {
+    FFIState::global_handle.use_segmentation = enabled;
+}
+
+/**
+ * @brief Check if word segmentation is enabled
+ * 
+ * @return true if segmentation is enabled, false otherwise
+ * 
+ * @note Thread-safe: Atomic read
+ * 
+ * @code
+ * if (jpn_phoneme_get_use_segmentation()) {
+ *     printf("Word boundaries will be marked with spaces\n");
+ * }
+ * @endcode
+ */
+FFI_EXPORT bool jpn_phoneme_get_use_segmentation() {
+    return FFIState::global_handle.use_segmentation;
+}
+
+/**
+ * @brief Get the number of words in the word dictionary
+ * 
+ * @return Number of words loaded, or -1 if no dictionary loaded
+ * 
+ * @note Thread-safe: Can be called from any thread
+ * 
+ * @code
+ * int words = jpn_phoneme_get_word_count();
+ * printf("Word dictionary contains %d words\n", words);
+ * @endcode
+ */
+FFI_EXPORT int jpn_phoneme_get_word_count() {
+    std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+    if (!dictionary || !dictionary->segmenter) {
+        return -1;
     }
+    return static_cast<int>(dictionary->segmenter->get_word_count());
 }
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// CONVERSION FUNCTIONS
+// USER DICTIONARY FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Convert Japanese text to IPA phonemes
+ * @brief Add a word, or change its phoneme, without reloading the dictionary
  * 
- * This function performs the actual conversion from Japanese text to phonemes.
- * It supports word segmentation, furigana hints, and provides timing information.
+ * User entries sit on top of the loaded dictionary: they win over its
+ * entries and are found by the same longest-match walk. They are kept
+ * across jpn_phoneme_init*() and word list calls until jpn_phoneme_cleanup().
  * 
- * @param japanese_text Input Japanese text (UTF-8 encoded, null-terminated)
- * @param output_buffer Buffer to store the resulting phonemes (UTF-8 encoded)
- * @param buffer_size Size of the output buffer in bytes
- * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
- * @return Number of bytes written to output_buffer (excluding null terminator),
- *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * @param word Japanese text (UTF-8)
+ * @param phoneme Its phoneme, or "" to hide the word (its dictionary entry too)
+ * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
  * 
- * @note Thread-safe: Can be called concurrently from multiple threads
- * @note The output is null-terminated if buffer has space
+ * @note Thread-safe: conversions keep running during an update and see it
+ *       as soon as it returns. Every update rebuilds the user entries only;
+ *       send many of them in one jpn_phoneme_user_update() call.
  * 
  * @code
- * char buffer[1024];
- * int64_t time_us;
- * int len = jpn_phoneme_convert("こんにちは", buffer, sizeof(buffer), &time_us);
- * if (len >= 0) {
- *     printf("Phonemes: %s (%lld μs)\n", buffer, time_us);
- * }
+ * jpn_phoneme_user_add("山田花子", "jamada hanako");
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_convert(
-    const char* japanese_text,
-    uint8_t* output_buffer,
-    int buffer_size,
-    int64_t* processing_time_us
-) {
-    try {
-        // Check initialization
-        if (!FFIState::converter) {
-            FFIState::last_error = "Converter not initialized. Call jpn_phoneme_init() first.";
-            return -1;
-        }
-        
-        // Start timing
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        // Perform conversion
-        std::string result;
-        if (FFIState::use_segmentation && FFIState::segmenter) {
-            result = SegmentedConversion::convert_with_segmentation(
-                *FFIState::converter, japanese_text, *FFIState::segmenter
-            );
-        } else {
-            result = FFIState::converter->convert(japanese_text);
-        }
-        
-        // Calculate processing time
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
-            end_time - start_time
-        ).count();
-        
-        if (processing_time_us) {
-            *processing_time_us = elapsed;
-        }
-        
-        // Copy result to output buffer
-        size_t result_len = result.length();
-        if (result_len >= static_cast<size_t>(buffer_size)) {
-            FFIState::last_error = "Output buffer too small";
-            return -1;
-        }
-        
-        std::memcpy(output_buffer, result.c_str(), result_len);
-        
-        // Null terminate if there's space
-        if (result_len < static_cast<size_t>(buffer_size)) {
-            output_buffer[result_len] = '\0';
-        }
-        
-        return static_cast<int>(result_len);
-        
-    } catch (const std::exception& e) {
-        FFIState::last_error = e.what();
+FFI_EXPORT int jpn_phoneme_user_add(const char* word, const char* phoneme) {
+    if (!phoneme) {
+        FFIState::last_error = "Phoneme must not be NULL (use jpn_phoneme_user_remove())";
+        return 0;
+    }
+    return FFIState::update_user_dictionary(FFIState::global_handle, &word, &phoneme, 1, false);
+}
+
+/**
+ * @brief Remove a word added with jpn_phoneme_user_add()
+ * 
+ * The dictionary's own entry of the word (if any) applies again.
+ * 
+ * @return 1 on success (also if the word was not a user entry), 0 on failure
+ */
+FFI_EXPORT int jpn_phoneme_user_remove(const char* word) {
+    const char* phoneme = nullptr;
+    return FFIState::update_user_dictionary(FFIState::global_handle, &word, &phoneme, 1, false);
+}
+
+/**
+ * @brief Apply many user entry changes at once
+ * 
+ * Conversions see either none or all of the changes.
+ * 
+ * @param words Japanese texts (UTF-8)
+ * @param phonemes Phoneme of each word as in jpn_phoneme_user_add(); a NULL
+ *        phoneme removes the word as in jpn_phoneme_user_remove()
+ * @param count Number of words
+ * @param replace Drop all current user entries first (push a whole list)
+ * @return 1 on success, 0 on failure - nothing is changed
+ *         (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_user_update(const char* const* words, const char* const* phonemes,
+                                       int count, bool replace) {
+    return FFIState::update_user_dictionary(FFIState::global_handle, words, phonemes, count, replace);
+}
+
+/**
+ * @brief Remove all user entries
+ * @return 1 on success, 0 if the converter is not initialized
+ */
+FFI_EXPORT int jpn_phoneme_user_clear() {
+    return FFIState::update_user_dictionary(FFIState::global_handle, nullptr, nullptr, 0, true);
+}
+
+/**
+ * @brief Number of user entries (hidden words included)
+ * @return Count, or -1 if the converter is not initialized
+ */
+FFI_EXPORT int jpn_phoneme_user_count() {
+    std::shared_ptr<const DictionarySnapshot> dictionary = FFIState::global_handle.acquire();
+    if (!dictionary) {
         return -1;
     }
+    return dictionary->user ? static_cast<int>(dictionary->user->size()) : 0;
 }
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// ERROR HANDLING FUNCTIONS
+// RESULT CACHE FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Get the last error message
+ * @brief Shared body of the set_cache_capacity functions
+ */
+static int set_cache_capacity(ResultCache& cache, int capacity) {
+    if (capacity < 0) {
+        FFIState::last_error = "Cache capacity must not be negative";
+        return 0;
+    }
+    cache.set_capacity(static_cast<size_t>(capacity));
+    return 1;
+}
+
+/**
+ * @brief Shared body of the get_cache_stats functions
+ */
+static void get_cache_stats(ResultCache& cache, int64_t* hits, int64_t* misses, int32_t* entries, int32_t* capacity) {
+    if (hits) *hits = static_cast<int64_t>(cache.get_hits());
+    if (misses) *misses = static_cast<int64_t>(cache.get_misses());
+    if (entries) *entries = static_cast<int32_t>(cache.size());
+    if (capacity) *capacity = static_cast<int32_t>(cache.get_capacity());
+}
+
+/**
+ * @brief Enable the result cache for repeated texts
  * 
- * Returns a human-readable error message for the last operation that failed.
- * The returned string is valid until the next FFI call.
+ * Caches the phonemes of recently converted inputs (up to 1 KiB each),
+ * so converting the same greeting, UI line or name again costs a hash
+ * lookup. Used by jpn_phoneme_convert*(), contexts and batches; the cache
+ * is emptied whenever the dictionary changes.
  * 
- * @return Error message string (never NULL, empty string if no error)
+ * @param capacity Maximum number of cached results (rounded up to a multiple
+ *        of 16), 0 = disable (default)
+ * @return 1 on success, 0 if capacity is negative
  * 
- * @note Thread-safe: Each thread may see different errors
+ * @note Thread-safe: The cache is sharded, concurrent conversions rarely contend
  * 
  * @code
- * if (jpn_phoneme_init("bad_file.json") != 1) {
- *     printf("Error: %s\n", jpn_phoneme_get_error());
- * }
+ * jpn_phoneme_set_cache_capacity(4096);
  * @endcode
  */
-FFI_EXPORT const char* jpn_phoneme_get_error() {
-    return FFIState::last_error.c_str();
+FFI_EXPORT int jpn_phoneme_set_cache_capacity(int capacity) {
+    return set_cache_capacity(FFIState::global_handle.cache, capacity);
+}
+
+/**
+ * @brief Get result cache counters
+ * 
+ * @param hits Conversions answered from the cache (can be NULL)
+ * @param misses Cacheable conversions that were not cached (can be NULL)
+ * @param entries Number of cached results (can be NULL)
+ * @param capacity Configured capacity (can be NULL)
+ * 
+ * @code
+ * int64_t hits, misses;
+ * jpn_phoneme_get_cache_stats(&hits, &misses, NULL, NULL);
+ * printf("Hit rate: %.1f%%\n", 100.0 * hits / (hits + misses));
+ * @endcode
+ */
+FFI_EXPORT void jpn_phoneme_get_cache_stats(int64_t* hits, int64_t* misses, int32_t* entries, int32_t* capacity) {
+    get_cache_stats(FFIState::global_handle.cache, hits, misses, entries, capacity);
+}
+
+/**
+ * @brief Drop all cached results (capacity and counters are kept)
+ */
+FFI_EXPORT void jpn_phoneme_clear_cache() {
+    FFIState::global_handle.cache.clear();
 }
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// INFORMATION FUNCTIONS
+// STATISTICS FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Get the number of entries in the phoneme dictionary
+ * @brief Enable or disable hot-path statistics
  * 
- * Returns the total number of Japanese text to phoneme mappings loaded.
+ * Off by default. While enabled, every conversion records stage times,
+ * trie walks and token kinds into counters owned by the converting thread
+ * (no locks, no shared cache lines); segmented conversions split their
+ * fused walk into a boundary pass and an emission pass to time them.
+ * Covers all conversion functions, contexts, batches, streams and handles.
  * 
- * @return Number of entries, or -1 if not initialized
+ * @param enabled true to start recording, false to stop (counters are kept)
+ */
+FFI_EXPORT void jpn_phoneme_set_stats_enabled(bool enabled) {
+    Stats::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Read the statistics counters, summed over all threads
  * 
- * @note Thread-safe: Can be called from any thread
+ * @param values Receives the counters in JPN_PHONEME_STAT_* order
+ * @param count Number of elements in values (more than JPN_PHONEME_STAT_COUNT is fine)
+ * @return Number of counters written, -1 if values is NULL or count is negative
  * 
  * @code
- * int count = jpn_phoneme_get_entry_count();
- * printf("Dictionary has %d entries\n", count);
+ * int64_t stats[JPN_PHONEME_STAT_COUNT];
+ * jpn_phoneme_get_stats(stats, JPN_PHONEME_STAT_COUNT);
+ * printf("Nodes per byte: %.2f\n",
+ *        (double)stats[JPN_PHONEME_STAT_TRIE_NODES] / stats[JPN_PHONEME_STAT_INPUT_BYTES]);
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_get_entry_count() {
-    if (!FFIState::converter) {
+FFI_EXPORT int jpn_phoneme_get_stats(int64_t* values, int count) {
+    if (!values || count < 0) {
+        FFIState::last_error = "Invalid stats buffer";
         return -1;
     }
-    // Note: PhonemeConverter doesn't expose entry_count publicly,
-    // so we'd need to add a getter method. For now, return a placeholder.
-    return 240000; // Approximate number from the JSON file
+    
+    uint64_t totals[STAT_COUNT];
+    Stats::read(totals);
+    int written = std::min(count, static_cast<int>(STAT_COUNT));
+    for (int i = 0; i < written; i++) {
+        values[i] = static_cast<int64_t>(totals[i]);
+    }
+    return written;
 }
 
 /**
- * @brief Get the library version string
- * 
- * Returns the version of the native library in semantic versioning format.
+ * @brief Reset all statistics counters to zero
+ */
+FFI_EXPORT void jpn_phoneme_reset_stats() {
+    Stats::reset();
+}
+
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+// CLEANUP FUNCTIONS
+// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+/**
+ * @brief Clean up all resources used by the converter
  * 
- * @return Version string (e.g., "2.0.0")
+ * Releases all memory and resources. After calling this, you must call
+ * jpn_phoneme_init() again before any conversions.
  * 
- * @note Thread-safe: Can be called from any thread
+ * @note Thread-safe: Conversions still running finish on the released
+ *       dictionary, which is freed when the last of them returns
  * 
  * @code
- * printf("Using Japanese Phoneme Converter v%s\n", jpn_phoneme_version());
+ * // Always clean up when done
+ * jpn_phoneme_cleanup();
  * @endcode
  */
-FFI_EXPORT const char* jpn_phoneme_version() {
-    return FFIState::VERSION;
+FFI_EXPORT void jpn_phoneme_cleanup() {
+    {
+        // A running background load is dropped when it finishes (see jpn_phoneme_init_async())
+        std::lock_guard<std::mutex> lock(FFIState::async_load.mutex);
+        if (FFIState::async_load.state.load() != FFIState::INIT_LOADING) {
+            FFIState::async_load.state.store(FFIState::INIT_IDLE);
+            FFIState::async_load.error.clear();
+        }
+    }
+    std::lock_guard<std::mutex> lock(FFIState::global_handle.update_mutex);
+    
+    FFIState::global_handle.publish(nullptr);
+    FFIState::last_error.clear();
 }
 
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// WORD SEGMENTATION FUNCTIONS
+// CONVERTER HANDLE FUNCTIONS
 // ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
 /**
- * @brief Initialize the word dictionary for segmentation
- * 
- * Loads a word list file for improved phoneme output with word boundaries.
- * The file should contain one Japanese word per line in UTF-8 encoding.
+ * @brief Create an independent converter from a dictionary file
  * 
- * @param word_file_path Path to the word list file (e.g., "ja_words.txt")
- * @return 1 on success, 0 on failure (check jpn_phoneme_get_error() for details)
+ * Handles are the thread-safe alternative to the global jpn_phoneme_init()
+ * state: each one has its own dictionary and segmentation setting, any
+ * number of threads can convert through one handle at the same time, and
+ * its dictionary can be reloaded while they do.
  * 
- * @note Thread-safe: Protected by mutex
- * @note This is optional - conversion works without it but may lack word spaces
+ * @param json_file_path Path to the ja_phonemes.json file (the .trie file next
+ *        to it is preferred, as in jpn_phoneme_init())
+ * @return Handle, or NULL on failure (check jpn_phoneme_get_error() for details)
  * 
  * @code
- * if (jpn_phoneme_init_word_dict("ja_words.txt") == 1) {
- *     printf("Word segmentation enabled!\n");
+ * JpnPhonemeHandle* ja = jpn_phoneme_handle_create("assets/ja_phonemes.json");
+ * if (!ja) {
+ *     printf("Error: %s\n", jpn_phoneme_get_error());
  * }
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_init_word_dict(const char* word_file_path) {
-    std::lock_guard<std::mutex> lock(FFIState::init_mutex);
-    
+FFI_EXPORT JpnPhonemeHandle* jpn_phoneme_handle_create(const char* json_file_path) {
     try {
-        FFIState::last_error.clear();
-        FFIState::segmenter = std::make_unique<WordSegmenter>();
-        FFIState::segmenter->load_from_file(word_file_path);
-        return 1;
+        auto handle = std::make_unique<JpnPhonemeHandle>();
+        if (FFIState::replace_dictionary(*handle, false, [&] {
+                return FFIState::load_file_snapshot(json_file_path);
+            }) != 1) {
+            return nullptr;
+        }
+        return handle.release();
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Create an independent converter from .trie data in memory
+ * 
+ * @param trie_data Pointer to the binary .trie data (copied, can be freed after the call)
+ * @param data_size Size of the trie data in bytes
+ * @return Handle, or NULL on failure (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT JpnPhonemeHandle* jpn_phoneme_handle_create_from_memory(const uint8_t* trie_data, int data_size) {
+    try {
+        auto handle = std::make_unique<JpnPhonemeHandle>();
+        if (FFIState::replace_dictionary(*handle, false, [&] {
+                return FFIState::load_buffer_snapshot(trie_data, data_size);
+            }) != 1) {
+            return nullptr;
+        }
+        return handle.release();
     } catch (const std::exception& e) {
         FFIState::last_error = e.what();
-        FFIState::segmenter.reset();
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Replace a handle's dictionary with a freshly loaded one (hot reload)
+ * 
+ * The new dictionary is loaded while the old one keeps serving, then
+ * swapped in atomically. Conversions that already started finish on the
+ * old dictionary, which is freed when the last of them returns.
+ * 
+ * @param handle Handle from jpn_phoneme_handle_create*()
+ * @param json_file_path Path to the ja_phonemes.json file (or its .trie sibling)
+ * @return 1 on success, 0 on failure - the old dictionary stays in use
+ *         (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_handle_reload(JpnPhonemeHandle* handle, const char* json_file_path) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
         return 0;
     }
+    return FFIState::replace_dictionary(*handle, true, [&] {
+        return FFIState::load_file_snapshot(json_file_path);
+    });
 }
 
 /**
- * @brief Enable or disable word segmentation
+ * @brief Hot-reload a handle's dictionary from .trie data in memory (copied)
  * 
- * Controls whether the converter adds spaces between words in the output.
- * Word dictionary must be loaded first via jpn_phoneme_init_word_dict().
+ * @return 1 on success, 0 on failure - the old dictionary stays in use
+ *         (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_handle_reload_from_memory(JpnPhonemeHandle* handle, const uint8_t* trie_data, int data_size) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    return FFIState::replace_dictionary(*handle, true, [&] {
+        return FFIState::load_buffer_snapshot(trie_data, data_size);
+    });
+}
+
+/**
+ * @brief Add a word list for segmentation to a handle's dictionary
  * 
- * @param enabled true to enable segmentation, false to disable
+ * Same as jpn_phoneme_init_word_dict(), for a handle.
  * 
- * @note Thread-safe: Atomic operation
- * @note Default is true (enabled)
+ * @return 1 on success, 0 on failure - the dictionary is unchanged
+ *         (check jpn_phoneme_get_error() for details)
+ */
+FFI_EXPORT int jpn_phoneme_handle_init_word_dict(JpnPhonemeHandle* handle, const char* word_file_path) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    return FFIState::load_word_list(*handle, [&](const DictionarySnapshot& current) {
+        return FFIState::add_word_list(current, word_file_path);
+    });
+}
+
+/**
+ * @brief Add an in-memory word list to a handle's dictionary
  * 
- * @code
- * jpn_phoneme_set_use_segmentation(false); // Disable spaces
- * jpn_phoneme_set_use_segmentation(true);  // Enable spaces
- * @endcode
+ * Same as jpn_phoneme_init_word_dict_from_memory(), for a handle.
  */
-FFI_EXPORT void jpn_phoneme_set_use_segmentation(bool enabled) {
-    FFIState::use_segmentation = enabled;
+FFI_EXPORT int jpn_phoneme_handle_init_word_dict_from_memory(JpnPhonemeHandle* handle,
+                                                             const uint8_t* data, int data_size) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    return FFIState::load_word_list(*handle, [&](const DictionarySnapshot& current) {
+        return FFIState::add_word_buffer(current, data, data_size);
+    });
 }
 
 /**
- * @brief Check if word segmentation is enabled
+ * @brief Apply user entry changes to a handle's dictionary
  * 
- * @return true if segmentation is enabled, false otherwise
+ * Same as jpn_phoneme_user_update(), for a handle.
+ */
+FFI_EXPORT int jpn_phoneme_handle_user_update(JpnPhonemeHandle* handle, const char* const* words,
+                                              const char* const* phonemes, int count, bool replace) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    return FFIState::update_user_dictionary(*handle, words, phonemes, count, replace);
+}
+
+/**
+ * @brief Number of user entries of a handle, or -1 if it has no dictionary
+ */
+FFI_EXPORT int jpn_phoneme_handle_user_count(JpnPhonemeHandle* handle) {
+    std::shared_ptr<const DictionarySnapshot> dictionary = handle ? handle->acquire() : nullptr;
+    if (!dictionary) {
+        return -1;
+    }
+    return dictionary->user ? static_cast<int>(dictionary->user->size()) : 0;
+}
+
+/**
+ * @brief Enable or disable word segmentation for a handle (default: enabled)
+ */
+FFI_EXPORT void jpn_phoneme_handle_set_use_segmentation(JpnPhonemeHandle* handle, bool enabled) {
+    if (handle) {
+        handle->use_segmentation = enabled;
+    }
+}
+
+/**
+ * @brief Enable a handle's result cache (see jpn_phoneme_set_cache_capacity())
  * 
- * @note Thread-safe: Atomic read
+ * @return 1 on success, 0 for an invalid handle or a negative capacity
+ */
+FFI_EXPORT int jpn_phoneme_handle_set_cache_capacity(JpnPhonemeHandle* handle, int capacity) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    return set_cache_capacity(handle->cache, capacity);
+}
+
+/**
+ * @brief Get a handle's result cache counters (see jpn_phoneme_get_cache_stats())
  * 
- * @code
- * if (jpn_phoneme_get_use_segmentation()) {
- *     printf("Word boundaries will be marked with spaces\n");
- * }
- * @endcode
+ * @return 1 on success, 0 for an invalid handle
  */
-FFI_EXPORT bool jpn_phoneme_get_use_segmentation() {
-    return FFIState::use_segmentation;
+FFI_EXPORT int jpn_phoneme_handle_get_cache_stats(JpnPhonemeHandle* handle, int64_t* hits, int64_t* misses,
+                                                  int32_t* entries, int32_t* capacity) {
+    if (!handle) {
+        FFIState::last_error = "Invalid handle";
+        return 0;
+    }
+    get_cache_stats(handle->cache, hits, misses, entries, capacity);
+    return 1;
 }
 
 /**
- * @brief Get the number of words in the word dictionary
+ * @brief Convert text with a handle's dictionary
  * 
- * @return Number of words loaded, or -1 if no dictionary loaded
+ * Same results and two-phase protocol as jpn_phoneme_context_convert().
  * 
- * @note Thread-safe: Can be called from any thread
+ * @param handle Handle from jpn_phoneme_handle_create*()
+ * @param context Context from jpn_phoneme_context_create(), or NULL to use
+ *        the calling thread's implicit one
+ * @param text Input Japanese text (UTF-8 encoded)
+ * @param length Length of text in bytes, or -1 if it is null-terminated
+ * @param output_buffer Buffer to store the resulting phonemes (can be NULL if buffer_size is 0)
+ * @param buffer_size Size of the output buffer in bytes
+ * @param required_size Pointer to store the buffer size needed for the output,
+ *        including the null terminator (can be NULL)
+ * @param processing_time_us Pointer to store processing time in microseconds (can be NULL)
+ * @return Number of bytes written to output_buffer (excluding null terminator),
+ *         JPN_PHONEME_BUFFER_TOO_SMALL (-2) if the buffer is too small,
+ *         or -1 on error (check jpn_phoneme_get_error() for details)
+ * 
+ * @note Thread-safe: Lock-free with respect to reloads of the same handle
  * 
  * @code
- * int words = jpn_phoneme_get_word_count();
- * printf("Word dictionary contains %d words\n", words);
+ * int len = jpn_phoneme_handle_convert(ja, NULL, "こんにちは", -1, buffer, sizeof(buffer), NULL, NULL);
  * @endcode
  */
-FFI_EXPORT int jpn_phoneme_get_word_count() {
-    if (!FFIState::segmenter) {
+FFI_EXPORT int jpn_phoneme_handle_convert(
+    JpnPhonemeHandle* handle,
+    JpnPhonemeContext* context,
+    const char* text,
+    int length,
+    uint8_t* output_buffer,
+    int buffer_size,
+    int32_t* required_size,
+    int64_t* processing_time_us
+) {
+    try {
+        if (!handle || !text || buffer_size < 0 || (buffer_size > 0 && !output_buffer)) {
+            FFIState::last_error = "Invalid conversion arguments";
+            return -1;
+        }
+        std::shared_ptr<const DictionarySnapshot> dictionary = handle->acquire();
+        if (!dictionary) {
+            FFIState::last_error = "Handle has no dictionary";
+            return -1;
+        }
+        
+        size_t text_length = length < 0 ? std::strlen(text) : static_cast<size_t>(length);
+        return convert_with_context(context ? *context : FFIState::thread_context, *handle, *dictionary,
+                                    handle->use_segmentation, text, text_length,
+                                    output_buffer, buffer_size, required_size, processing_time_us);
+        
+    } catch (const std::exception& e) {
+        FFIState::last_error = e.what();
         return -1;
     }
-    // Note: WordSegmenter doesn't expose word_count publicly,
-    // so we'd need to add a getter. For now, return a placeholder.
-    return 200000; // Approximate number from ja_words.txt
 }
 
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-// CLEANUP FUNCTIONS
-// ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+/**
+ * @brief Number of phoneme entries of a handle's dictionary, or -1 for an invalid handle
+ */
+FFI_EXPORT int jpn_phoneme_handle_get_entry_count(JpnPhonemeHandle* handle) {
+    std::shared_ptr<const DictionarySnapshot> dictionary = handle ? handle->acquire() : nullptr;
+    if (!dictionary) {
+        return -1;
+    }
+    return static_cast<int>(dictionary->converter->get_entry_count());
+}
 
 /**
- * @brief Clean up all resources used by the converter
- * 
- * Releases all memory and resources. After calling this, you must call
- * jpn_phoneme_init() again before any conversions.
- * 
- * @note Thread-safe: Will wait for ongoing operations to complete
+ * @brief Number of segmentation words of a handle's dictionary, or -1 if it has none
+ */
+FFI_EXPORT int jpn_phoneme_handle_get_word_count(JpnPhonemeHandle* handle) {
+    std::shared_ptr<const DictionarySnapshot> dictionary = handle ? handle->acquire() : nullptr;
+    if (!dictionary || !dictionary->segmenter) {
+        return -1;
+    }
+    return static_cast<int>(dictionary->segmenter->get_word_count());
+}
+
+/**
+ * @brief Destroy a handle (NULL is ignored)
  * 
- * @code
- * // Always clean up when done
- * jpn_phoneme_cleanup();
- * @endcode
+ * @note No other thread may use the handle during or after this call;
+ *       contexts used with it stay valid
  */
-FFI_EXPORT void jpn_phoneme_cleanup() {
-    std::lock_guard<std::mutex> lock(FFIState::init_mutex);
-    
-    FFIState::converter.reset();
-    FFIState::segmenter.reset();
-    FFIState::last_error.clear();
+FFI_EXPORT void jpn_phoneme_handle_destroy(JpnPhonemeHandle* handle) {
+    delete handle;
 }
 
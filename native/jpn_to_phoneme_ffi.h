@@ -0,0 +1,234 @@
+/**
+ * @file jpn_to_phoneme_ffi.h
+ * @brief C interface of the Japanese Phoneme Converter native library
+ * 
+ * Declarations of the functions exported by jpn_to_phoneme_ffi.cpp.
+ * See the implementation file for detailed documentation of each call.
+ */
+
+#ifndef JPN_TO_PHONEME_FFI_H
+#define JPN_TO_PHONEME_FFI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Initialization */
+int jpn_phoneme_init(const char* json_file_path);
+int jpn_phoneme_init_from_memory(const uint8_t* trie_data, int data_size);
+int jpn_phoneme_init_from_memory_borrowed(const uint8_t* trie_data, int data_size);
+typedef void (*JpnPhonemeReleaseCallback)(void* data);
+int jpn_phoneme_init_from_memory_owned(const uint8_t* trie_data, int data_size, JpnPhonemeReleaseCallback release);
+int jpn_phoneme_init_word_dict(const char* word_file_path);
+int jpn_phoneme_init_word_dict_from_memory(const uint8_t* data, int data_size);
+
+/* Background initialization (kana core serves until the dictionary is in) */
+#define JPN_PHONEME_INIT_IDLE    0
+#define JPN_PHONEME_INIT_LOADING 1
+#define JPN_PHONEME_INIT_READY   2
+#define JPN_PHONEME_INIT_FAILED  3
+
+typedef void (*JpnPhonemeInitCallback)(int success, const char* error, void* user_data);
+
+int jpn_phoneme_init_async(const char* json_file_path,
+                           const char* word_file_path,
+                           JpnPhonemeInitCallback callback,
+                           void* user_data);
+int jpn_phoneme_get_init_state(void);
+int jpn_phoneme_get_init_progress(void);
+int jpn_phoneme_wait_init(int timeout_ms);
+const char* jpn_phoneme_get_init_error(void);
+
+/* Dictionary compiler */
+int jpn_phoneme_compile_trie(const char* json_file_path,
+                             const char* word_file_path,
+                             const char* output_path);
+int jpn_phoneme_compile_automaton(const char* json_file_path,
+                                  const char* word_file_path,
+                                  const char* output_path);
+int jpn_phoneme_compile_word_list(const char* word_file_path, const char* output_path);
+
+/* Dictionary warm-up (touch the top trie levels at load, for servers) */
+void jpn_phoneme_set_warm_levels(int levels);
+int jpn_phoneme_warm_dictionary(int levels);
+
+/* Snapshot cache (built dictionaries are saved and mapped on later inits) */
+void jpn_phoneme_set_snapshot_cache(const char* directory);
+
+/* Conversion */
+int jpn_phoneme_convert(const char* japanese_text,
+                        uint8_t* output_buffer,
+                        int buffer_size,
+                        int64_t* processing_time_us);
+
+/* Two-phase conversion: returned when the output does not fit */
+#define JPN_PHONEME_BUFFER_TOO_SMALL (-2)
+
+int jpn_phoneme_convert_sized(const char* japanese_text,
+                              uint8_t* output_buffer,
+                              int buffer_size,
+                              int32_t* required_size,
+                              int64_t* processing_time_us);
+
+/* Reusable conversion contexts (no allocations once warm) */
+typedef struct JpnPhonemeContext JpnPhonemeContext;
+
+JpnPhonemeContext* jpn_phoneme_context_create(void);
+int jpn_phoneme_context_convert(JpnPhonemeContext* context,
+                                const char* text,
+                                int length,
+                                uint8_t* output_buffer,
+                                int buffer_size,
+                                int32_t* required_size,
+                                int64_t* processing_time_us);
+void jpn_phoneme_context_destroy(JpnPhonemeContext* context);
+
+/* Aligned conversion: where each piece of the output came from (byte offsets) */
+#define JPN_PHONEME_SPAN_MATCHED    0x01
+#define JPN_PHONEME_SPAN_WORD_START 0x02
+#define JPN_PHONEME_SPAN_FURIGANA   0x04
+
+typedef struct JpnPhonemeSpan {
+    uint32_t src_offset;
+    uint32_t src_length;
+    uint32_t out_offset;
+    uint32_t out_length;
+    uint32_t flags;
+} JpnPhonemeSpan;
+
+int jpn_phoneme_convert_spans(JpnPhonemeContext* context,
+                              const char* text,
+                              int length,
+                              uint8_t* output_buffer,
+                              int buffer_size,
+                              JpnPhonemeSpan* spans,
+                              int span_capacity,
+                              int32_t* required_size,
+                              int32_t* span_count,
+                              int64_t* processing_time_us);
+
+/* Batch conversion: per-item status codes */
+#define JPN_PHONEME_BATCH_OK         0
+#define JPN_PHONEME_BATCH_ERROR      1
+#define JPN_PHONEME_BATCH_ARENA_FULL 2
+
+int jpn_phoneme_convert_batch(const char* const* texts,
+                              const int32_t* text_lengths,
+                              int count,
+                              uint8_t* output_arena,
+                              int arena_size,
+                              int32_t* output_offsets,
+                              int32_t* item_status,
+                              int64_t* processing_time_us);
+int jpn_phoneme_convert_batch_mt(const char* const* texts,
+                                 const int32_t* text_lengths,
+                                 int count,
+                                 uint8_t* output_arena,
+                                 int arena_size,
+                                 int32_t* output_offsets,
+                                 int32_t* item_status,
+                                 int64_t* processing_time_us,
+                                 int thread_count);
+void jpn_phoneme_set_batch_interleaving(bool enabled);
+bool jpn_phoneme_get_batch_interleaving(void);
+
+/* Streaming conversion (lines over 64 KiB are cut at a match boundary, see jpn_phoneme_stream_create()) */
+typedef struct JpnPhonemeStream JpnPhonemeStream;
+typedef void (*JpnPhonemeStreamCallback)(const uint8_t* data, int32_t length, void* user_data);
+
+JpnPhonemeStream* jpn_phoneme_stream_create(JpnPhonemeStreamCallback callback, void* user_data);
+int jpn_phoneme_stream_feed(JpnPhonemeStream* stream, const char* data, int length);
+int jpn_phoneme_stream_flush(JpnPhonemeStream* stream);
+void jpn_phoneme_stream_destroy(JpnPhonemeStream* stream);
+
+/* Word segmentation */
+void jpn_phoneme_set_use_segmentation(bool enabled);
+bool jpn_phoneme_get_use_segmentation(void);
+int jpn_phoneme_get_word_count(void);
+
+/* User dictionary (live additions over the loaded dictionary, no reload) */
+int jpn_phoneme_user_add(const char* word, const char* phoneme);
+int jpn_phoneme_user_remove(const char* word);
+int jpn_phoneme_user_update(const char* const* words,
+                            const char* const* phonemes,
+                            int count,
+                            bool replace);
+int jpn_phoneme_user_clear(void);
+int jpn_phoneme_user_count(void);
+
+/* Result cache */
+int jpn_phoneme_set_cache_capacity(int capacity);
+void jpn_phoneme_get_cache_stats(int64_t* hits, int64_t* misses, int32_t* entries, int32_t* capacity);
+void jpn_phoneme_clear_cache(void);
+
+/* Hot-path statistics (opt-in, summed over all threads) */
+#define JPN_PHONEME_STAT_CONVERSIONS        0
+#define JPN_PHONEME_STAT_CACHE_HITS         1
+#define JPN_PHONEME_STAT_INPUT_BYTES        2
+#define JPN_PHONEME_STAT_OUTPUT_BYTES       3
+#define JPN_PHONEME_STAT_PARSE_NS           4
+#define JPN_PHONEME_STAT_SEGMENTATION_NS    5
+#define JPN_PHONEME_STAT_LOOKUP_NS          6
+#define JPN_PHONEME_STAT_OUTPUT_COPY_NS     7
+#define JPN_PHONEME_STAT_TRIE_NODES         8
+#define JPN_PHONEME_STAT_DICTIONARY_HITS    9
+#define JPN_PHONEME_STAT_DICTIONARY_MISSES  10
+#define JPN_PHONEME_STAT_WORD_TOKENS        11
+#define JPN_PHONEME_STAT_FALLBACK_TOKENS    12
+#define JPN_PHONEME_STAT_GRAMMAR_TOKENS     13
+#define JPN_PHONEME_STAT_COUNT              14
+
+void jpn_phoneme_set_stats_enabled(bool enabled);
+int jpn_phoneme_get_stats(int64_t* values, int count);
+void jpn_phoneme_reset_stats(void);
+
+/* Information and errors */
+const char* jpn_phoneme_get_error(void);
+int jpn_phoneme_get_entry_count(void);
+const char* jpn_phoneme_version(void);
+
+/* Cleanup */
+void jpn_phoneme_cleanup(void);
+
+/* Converter handles (independent dictionaries, hot reload) */
+typedef struct JpnPhonemeHandle JpnPhonemeHandle;
+
+JpnPhonemeHandle* jpn_phoneme_handle_create(const char* json_file_path);
+JpnPhonemeHandle* jpn_phoneme_handle_create_from_memory(const uint8_t* trie_data, int data_size);
+int jpn_phoneme_handle_reload(JpnPhonemeHandle* handle, const char* json_file_path);
+int jpn_phoneme_handle_reload_from_memory(JpnPhonemeHandle* handle, const uint8_t* trie_data, int data_size);
+int jpn_phoneme_handle_init_word_dict(JpnPhonemeHandle* handle, const char* word_file_path);
+int jpn_phoneme_handle_init_word_dict_from_memory(JpnPhonemeHandle* handle, const uint8_t* data, int data_size);
+int jpn_phoneme_handle_user_update(JpnPhonemeHandle* handle,
+                                   const char* const* words,
+                                   const char* const* phonemes,
+                                   int count,
+                                   bool replace);
+int jpn_phoneme_handle_user_count(JpnPhonemeHandle* handle);
+void jpn_phoneme_handle_set_use_segmentation(JpnPhonemeHandle* handle, bool enabled);
+int jpn_phoneme_handle_set_cache_capacity(JpnPhonemeHandle* handle, int capacity);
+int jpn_phoneme_handle_get_cache_stats(JpnPhonemeHandle* handle,
+                                       int64_t* hits,
+                                       int64_t* misses,
+                                       int32_t* entries,
+                                       int32_t* capacity);
+int jpn_phoneme_handle_convert(JpnPhonemeHandle* handle,
+                               JpnPhonemeContext* context,
+                               const char* text,
+                               int length,
+                               uint8_t* output_buffer,
+                               int buffer_size,
+                               int32_t* required_size,
+                               int64_t* processing_time_us);
+int jpn_phoneme_handle_get_entry_count(JpnPhonemeHandle* handle);
+int jpn_phoneme_handle_get_word_count(JpnPhonemeHandle* handle);
+void jpn_phoneme_handle_destroy(JpnPhonemeHandle* handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JPN_TO_PHONEME_FFI_H */
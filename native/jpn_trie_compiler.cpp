@@ -0,0 +1,54 @@
+// Japanese to Phoneme Converter - Trie Compiler
+// Compiles ja_phonemes.json + ja_words.txt into the packed v2 .trie format
+// (or the smaller v3 minimised automaton with --minimize),
+// or ja_words.txt alone into the compiled "JPNW" word list
+// Usage: ./jpn_trie_compiler [--minimize] ja_phonemes.json [ja_words.txt] japanese.trie
+//        ./jpn_trie_compiler --words ja_words.txt ja_words.bin
+
+#include <iostream>
+#include <cstring>
+
+#include "jpn_to_phoneme_ffi.h"
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && std::strcmp(argv[1], "--words") == 0) {
+        std::cout << "🔨 Compiling word list..." << std::endl;
+        
+        if (jpn_phoneme_compile_word_list(argv[2], argv[3]) != 1) {
+            std::cerr << "❌ Error: " << jpn_phoneme_get_error() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
+    bool minimize = argc > 1 && std::strcmp(argv[1], "--minimize") == 0;
+    int first = minimize ? 2 : 1;
+    int count = argc - first;
+    
+    if (count != 2 && count != 3) {
+        std::cerr << "Usage: " << argv[0] << " [--minimize] <ja_phonemes.json> [ja_words.txt] <output.trie>"
+                  << std::endl;
+        std::cerr << "       " << argv[0] << " --words <ja_words.txt> <output.bin>" << std::endl;
+        return 1;
+    }
+    
+    const char* json_path = argv[first];
+    const char* word_path = (count == 3) ? argv[first + 1] : nullptr;
+    const char* output_path = argv[argc - 1];
+    
+    int result;
+    if (minimize) {
+        std::cout << "🔨 Compiling minimised automaton v3..." << std::endl;
+        result = jpn_phoneme_compile_automaton(json_path, word_path, output_path);
+    } else {
+        std::cout << "🔨 Compiling packed trie v2..." << std::endl;
+        result = jpn_phoneme_compile_trie(json_path, word_path, output_path);
+    }
+    
+    if (result != 1) {
+        std::cerr << "❌ Error: " << jpn_phoneme_get_error() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
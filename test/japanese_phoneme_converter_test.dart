@@ -1,5 +1,12 @@
+import 'dart:convert';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:math';
+import 'dart:typed_data';
+
 import 'package:test/test.dart';
 import 'package:japanese_phoneme_converter/japanese_phoneme_converter.dart';
+import 'package:japanese_phoneme_converter/src/phoneme_worker_pool.dart' show workerIsolates;
 
 void main() {
   group('JapanesePhonemeConverter', () {
@@ -26,6 +33,90 @@ void main() {
       expect(converter.entryCount, greaterThan(0));
     });
 
+    test('should initialize in the background', () async {
+      final ready = converter.initAsync('assets/ja_phonemes.json');
+
+      // The kana core serves until the dictionary is loaded
+      expect(converter.isInitialized, isTrue);
+      expect(converter.convert('ありがとう'), isNotNull);
+
+      expect(await ready, isTrue);
+      expect(converter.initProgress, equals(100));
+      expect(converter.entryCount, greaterThan(1000));
+      expect(converter.convert('こんにちは')!.phonemes, isNotEmpty);
+    });
+
+    test('should map a cached snapshot on the next init', () {
+      final cache = Directory.systemTemp.createTempSync('jpn_snapshots');
+      addTearDown(() {
+        converter.setSnapshotCache(null);
+        cache.deleteSync(recursive: true);
+      });
+      converter.setSnapshotCache(cache.path);
+
+      expect(converter.init('assets/ja_phonemes.json'), isTrue);
+      final built = converter.convert('日本語を勉強しています')!.phonemes;
+      expect(cache.listSync(), isNotEmpty);
+
+      expect(converter.init('assets/ja_phonemes.json'), isTrue);
+      expect(converter.convert('日本語を勉強しています')!.phonemes, equals(built));
+    });
+
+    test('should rebuild a snapshot damaged in place with its time kept', () {
+      final cache = Directory.systemTemp.createTempSync('jpn_damaged');
+      addTearDown(() {
+        converter.setSnapshotCache(null);
+        cache.deleteSync(recursive: true);
+      });
+      converter.setSnapshotCache(cache.path);
+
+      expect(converter.init('assets/ja_phonemes.json'), isTrue);
+      final built = converter.convert('日本語を勉強しています')!.phonemes;
+      final snapshot = cache.listSync().whereType<File>().single;
+      final intact = snapshot.readAsBytesSync();
+      final stamp = snapshot.lastModifiedSync();
+
+      // Bit rot or a restored backup: other bytes, same size and time
+      final random = Random(1);
+      final damaged = Uint8List.fromList(intact);
+      for (var i = 0; i < 20000; i++) {
+        damaged[32 + random.nextInt(damaged.length - 72)] = random.nextInt(256);
+      }
+      snapshot
+        ..writeAsBytesSync(damaged)
+        ..setLastModifiedSync(stamp);
+
+      expect(converter.init('assets/ja_phonemes.json'), isTrue);
+      expect(converter.convert('日本語を勉強しています')!.phonemes, equals(built));
+      // Rebuilt: the same trie again (the trailer's time may differ)
+      final rebuilt = snapshot.readAsBytesSync();
+      expect(rebuilt.length, equals(intact.length));
+      expect(rebuilt.sublist(0, rebuilt.length - 32), equals(intact.sublist(0, intact.length - 32)));
+    });
+
+    test('should keep empty phonemes apart from others in a v2 snapshot', () {
+      final dir = Directory.systemTemp.createTempSync('jpn_empty_values');
+      addTearDown(() {
+        converter.setSnapshotCache(null);
+        dir.deleteSync(recursive: true);
+      });
+      final json = File('${dir.path}/dict.json')
+        ..writeAsStringSync('{"あ":"","い":"i","う":"u","かい":"","き":"ki"}');
+      converter.setSnapshotCache(dir.path);
+
+      // Built from the JSON, then mapped from the packed v2 snapshot
+      expect(converter.init(json.path), isTrue);
+      expect(converter.convert('あいうかいき')!.phonemes, equals('iuki'));
+      expect(converter.init(json.path), isTrue);
+      expect(converter.convert('あいうかいき')!.phonemes, equals('iuki'));
+    });
+
+    test('should report a failed background load', () async {
+      expect(await converter.initAsync('missing/ja_phonemes.json'), isFalse);
+      expect(converter.initError, isNotEmpty);
+      expect(converter.isInitialized, isFalse);
+    });
+
     test('should throw exception when converting without initialization', () {
       expect(
         () => converter.convertOrThrow('こんにちは'),
@@ -58,6 +149,227 @@ void main() {
       expect(result, isNotNull);
     });
 
+    test('should convert text longer than the output buffer', () {
+      converter.init('assets/ja_phonemes.json');
+
+      final text = List.filled(500, '今日は学校に行きました。').join();
+      final small = converter.convertOrThrow(text, bufferSize: 16);
+      final large = converter.convertOrThrow(text, bufferSize: 1 << 20);
+
+      expect(small.phonemes, isNotEmpty);
+      expect(small.phonemes, equals(large.phonemes));
+    });
+
+    test('should align phonemes to the input', () {
+      converter.init('assets/ja_phonemes.json');
+      converter.loadWordDictionary('assets/ja_words.txt');
+      converter.setUseSegmentation(true);
+
+      const text = '健太「けんた」はバカ!';
+      final result = converter.convertWithAlignment(text, bufferSize: 4)!;
+      expect(result.phonemes, equals(converter.convertOrThrow(text).phonemes));
+      expect(result.spans.map((s) => s.phonemes).join(' '), equals(result.phonemes));
+
+      final name = result.spans.first;
+      expect(name.source, equals('健太「けんた」'));
+      expect(name.furigana, isTrue);
+      expect(name.wordStart, isTrue);
+      for (final span in result.spans) {
+        expect(text.substring(span.sourceOffset, span.sourceOffset + span.sourceLength),
+            equals(span.source));
+      }
+    });
+
+    group('Batch Conversion', () {
+      test('should match single conversions', () {
+        converter.init('assets/ja_phonemes.json');
+
+        final texts = ['こんにちは', '日本語', '', 'ありがとう'];
+        final batch = converter.convertBatch(texts);
+
+        expect(batch.phonemes, hasLength(texts.length));
+        for (var i = 0; i < texts.length; i++) {
+          expect(batch.phonemes[i], equals(converter.convertOrThrow(texts[i]).phonemes));
+        }
+      });
+
+      test('should retry items that do not fit the arena', () {
+        converter.init('assets/ja_phonemes.json');
+
+        final texts = List.generate(50, (_) => '今日はいい天気ですね');
+        final batch = converter.convertBatch(texts, arenaSize: 16);
+
+        final expected = converter.convertOrThrow(texts.first).phonemes;
+        expect(batch.phonemes.every((p) => p == expected), isTrue);
+      });
+
+      test('should give the same result on multiple threads', () {
+        converter.init('assets/ja_phonemes.json');
+
+        final texts = List.generate(200, (i) => i.isEven ? '日本語を勉強しています' : 'こんにちは');
+        final sequential = converter.convertBatch(texts);
+
+        for (final threads in [2, 4, 0]) {
+          final parallel = converter.convertBatch(texts, threads: threads);
+          expect(parallel.phonemes, equals(sequential.phonemes));
+        }
+      });
+
+      test('should handle an empty batch', () {
+        converter.init('assets/ja_phonemes.json');
+
+        expect(converter.convertBatch([]).phonemes, isEmpty);
+      });
+
+      test('should throw when not initialized', () {
+        expect(
+          () => converter.convertBatch(['こんにちは']),
+          throwsA(isA<PhonemeException>()),
+        );
+      });
+    });
+
+    group('Streaming Conversion', () {
+      test('should match whole-text conversion for any chunking', () {
+        converter.init('assets/ja_phonemes.json');
+
+        const text = '健太「けんた」は学校に行きました。\n今日はいい天気ですね。\nありがとう';
+        final expected = converter.convertOrThrow(text).phonemes;
+
+        for (final size in [1, 2, 5, 100]) {
+          final stream = converter.openStream();
+          final output = StringBuffer();
+          for (var i = 0; i < text.length; i += size) {
+            output.write(stream.add(text.substring(i, i + size > text.length ? text.length : i + size)));
+          }
+          output.write(stream.close());
+          expect(output.toString(), equals(expected));
+        }
+      });
+
+      test('should resolve furigana hints per line for any chunking', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setUseSegmentation(true);
+
+        const text = '漢字です\nABC-defた兜虫123移し換えよう「」は\n漢字\nかな漢「よみ」です\nその男「おとこ」';
+        final expected = text.split('\n').map((line) => converter.convertOrThrow(line).phonemes).join(' ');
+
+        for (final size in [1, 2, 3, 7]) {
+          final stream = converter.openStream();
+          final output = StringBuffer();
+          for (var i = 0; i < text.length; i += size) {
+            output.write(stream.add(text.substring(i, i + size > text.length ? text.length : i + size)));
+          }
+          output.write(stream.close());
+          expect(output.toString(), equals(expected));
+        }
+      });
+
+      test('should cut long lines the same for any chunking', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setUseSegmentation(true);
+
+        const phrases = ['健太「けんた」は来「き」た', '「クとサイぉ」遊撃手', '見「み」て', 'ABC-def', '漢、かな漢「よみ」', '学校に行きました'];
+        final line = StringBuffer();
+        for (var i = 0; line.length < 100000; i++) {
+          line.write(phrases[i % phrases.length]);
+          line.write(i % 3 == 0 ? '、' : '');
+        }
+        final text = line.toString();
+        final expected = converter.convertOrThrow(text).phonemes;
+
+        for (final size in [7, 1000, 70000]) {
+          final stream = converter.openStream();
+          final output = StringBuffer();
+          for (var i = 0; i < text.length; i += size) {
+            output.write(stream.add(text.substring(i, i + size > text.length ? text.length : i + size)));
+          }
+          output.write(stream.close());
+          expect(output.toString(), equals(expected), reason: 'chunks of $size');
+        }
+      });
+
+      test('should emit completed lines before close', () {
+        converter.init('assets/ja_phonemes.json');
+
+        final stream = converter.openStream();
+        expect(stream.add('こんにちは\nあり'), isNotEmpty);
+        expect(stream.close(), isNotEmpty);
+        expect(stream.isClosed, isTrue);
+        expect(() => stream.add('test'), throwsA(isA<PhonemeException>()));
+      });
+
+      test('should convert a Dart stream', () async {
+        converter.init('assets/ja_phonemes.json');
+
+        final chunks = Stream.fromIterable(['日本', '語\nこん', 'にちは']);
+        final output = await converter.convertStream(chunks).join();
+        expect(output, equals(converter.convertOrThrow('日本語\nこんにちは').phonemes));
+      });
+    });
+
+    group('Worker Pool', () {
+      test('should match synchronous conversion', () async {
+        converter.init('assets/ja_phonemes.json');
+        final pool = await converter.spawnWorkerPool(workers: 2);
+        expect(pool.size, equals(2));
+
+        const texts = ['日本語', 'こんにちは', '健太は学校に行きました。'];
+        final results = await Future.wait(texts.map(pool.convertAsync));
+        for (var i = 0; i < texts.length; i++) {
+          expect(results[i], equals(converter.convert(texts[i])!.phonemes));
+        }
+
+        final bytes = await pool.convertBytesAsync(Uint8List.fromList(utf8.encode('日本語')));
+        expect(utf8.decode(bytes), equals(converter.convert('日本語')!.phonemes));
+        await pool.close();
+      });
+
+      test('should keep stream results in input order', () async {
+        converter.init('assets/ja_phonemes.json');
+        final pool = await converter.spawnWorkerPool(workers: 3);
+
+        final texts = List.generate(50, (i) => i.isEven ? '日本語$i' : 'ありがとう');
+        final output = await pool.convertStream(Stream.fromIterable(texts), maxInFlight: 4).toList();
+        expect(output, equals(texts.map((text) => converter.convert(text)!.phonemes).toList()));
+        await pool.close();
+      });
+
+      test('should reject work after close', () async {
+        converter.init('assets/ja_phonemes.json');
+        final pool = await converter.spawnWorkerPool(workers: 1);
+        await pool.close();
+
+        expect(pool.isClosed, isTrue);
+        expect(pool.convertAsync('日本'), throwsA(isA<PhonemeException>()));
+      });
+
+      test('should fail pending conversions when a worker dies', () async {
+        converter.init('assets/ja_phonemes.json');
+        final pool = await converter.spawnWorkerPool(workers: 1);
+
+        // Killed before it reads the requests below
+        workerIsolates(pool).single.kill(priority: Isolate.immediate);
+        final text = pool.convertAsync('日本語');
+        final bytes = pool.convertBytesAsync(Uint8List.fromList(utf8.encode('日本語')));
+        await expectLater(text, throwsA(isA<PhonemeException>()));
+        await expectLater(bytes, throwsA(isA<PhonemeException>()));
+
+        expect(pool.size, equals(0));
+        expect(pool.convertAsync('日本'), throwsA(isA<PhonemeException>()));
+        await pool.close();
+      });
+
+      test('should throw when a worker cannot load the library', () async {
+        await expectLater(
+          PhonemeWorkerPool.spawn(workers: 1, libraryPath: 'missing/jpn_to_phoneme_ffi.so'),
+          throwsA(isA<PhonemeException>()),
+        );
+      });
+    });
+
     test('should be thread-safe after initialization', () async {
       converter.init('assets/ja_phonemes.json');
 
@@ -107,6 +419,116 @@ void main() {
       expect(exception.toString(), contains('test error'));
     });
 
+    group('Result Cache', () {
+      tearDown(() {
+        if (!converter.isDisposed) converter.setCacheCapacity(0);
+      });
+
+      test('should return the same phonemes from the cache', () {
+        converter.init('assets/ja_phonemes.json');
+        final uncached = converter.convert('こんにちは')!.phonemes;
+
+        converter.setCacheCapacity(64);
+        final first = converter.convert('こんにちは')!.phonemes;
+        final second = converter.convert('こんにちは')!.phonemes;
+
+        expect(first, equals(uncached));
+        expect(second, equals(uncached));
+        final stats = converter.cacheStats;
+        expect(stats.hits, greaterThanOrEqualTo(1));
+        expect(stats.entries, greaterThanOrEqualTo(1));
+        expect(stats.capacity, equals(64));
+      });
+
+      test('should not return stale results after a settings change', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setCacheCapacity(64);
+
+        final segmented = converter.convert('私はリンゴがすきです')!.phonemes;
+        converter.setUseSegmentation(false);
+        final plain = converter.convert('私はリンゴがすきです')!.phonemes;
+        converter.setUseSegmentation(true);
+
+        expect(segmented, contains(' '));
+        expect(plain, isNot(equals(segmented)));
+      });
+
+      test('should reject a negative capacity', () {
+        converter.init('assets/ja_phonemes.json');
+        expect(() => converter.setCacheCapacity(-1), throwsArgumentError);
+      });
+    });
+
+    group('User Dictionary', () {
+      tearDown(() {
+        if (!converter.isDisposed && converter.userWordCount > 0) converter.clearUserDictionary();
+      });
+
+      test('should apply user words without a reload', () {
+        converter.init('assets/ja_phonemes.json');
+        final original = converter.convert('日本です')!.phonemes;
+
+        converter.addUserWord('日本', 'NIPPON');
+        expect(converter.convert('日本です')!.phonemes, contains('NIPPON'));
+        expect(converter.userWordCount, equals(1));
+
+        converter.removeUserWord('日本');
+        expect(converter.convert('日本です')!.phonemes, equals(original));
+        expect(converter.userWordCount, equals(0));
+      });
+
+      test('should replace the whole list in one update', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.updateUserDictionary({'山田花子': 'jamada hanako', '日本': 'NIPPON'});
+        converter.updateUserDictionary({'花子': 'HANAKO'}, replace: true);
+
+        expect(converter.userWordCount, equals(1));
+        expect(converter.convert('日本')!.phonemes, isNot(contains('NIPPON')));
+      });
+
+      test('should reject empty words', () {
+        converter.init('assets/ja_phonemes.json');
+        expect(() => converter.addUserWord('', 'x'), throwsA(isA<PhonemeException>()));
+      });
+    });
+
+    group('Pipeline Statistics', () {
+      tearDown(() {
+        if (!converter.isDisposed) converter.setStatsEnabled(false);
+      });
+
+      test('should count conversions only while enabled', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.resetStats();
+        converter.convert('こんにちは');
+        expect(converter.pipelineStats.conversions, equals(0));
+
+        converter.setStatsEnabled(true);
+        converter.convert('こんにちは');
+        final stats = converter.pipelineStats;
+        expect(stats.conversions, equals(1));
+        expect(stats.inputBytes, equals(15));
+        expect(stats.trieNodesVisited, greaterThan(0));
+        expect(stats.dictionaryHits, greaterThan(0));
+      });
+
+      test('should count word and grammar tokens with segmentation', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setStatsEnabled(true);
+        converter.resetStats();
+
+        final phonemes = converter.convert('私はリンゴがすきです')!.phonemes;
+        final stats = converter.pipelineStats;
+        expect(phonemes, contains(' '));
+        expect(stats.wordTokens + stats.fallbackTokens, greaterThan(0));
+
+        converter.resetStats();
+        expect(converter.pipelineStats.conversions, equals(0));
+      });
+    });
+
     group('Word Segmentation', () {
       test('should load word dictionary successfully', () {
         converter.init('assets/ja_phonemes.json');
@@ -117,6 +539,27 @@ void main() {
         expect(converter.wordCount, greaterThan(0));
       });
 
+      test('should load word dictionary from memory', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        final expected = converter.convert('私はリンゴがすきです')!.phonemes;
+
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionaryFromMemory(File('assets/ja_words.txt').readAsBytesSync());
+
+        expect(converter.wordCount, greaterThan(0));
+        expect(converter.convert('私はリンゴがすきです')!.phonemes, equals(expected));
+      });
+
+      test('should reject corrupt compiled word lists', () {
+        converter.init('assets/ja_phonemes.json');
+
+        expect(
+          () => converter.loadWordDictionaryFromMemory([0x4A, 0x50, 0x4E, 0x57, 1, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0]),
+          throwsA(isA<PhonemeException>()),
+        );
+      });
+
       test('should throw exception when word dictionary file not found', () {
         converter.init('assets/ja_phonemes.json');
         
@@ -160,6 +603,31 @@ void main() {
         expect(withoutSpaces!.phonemes, isNot(contains(' ')));
       });
 
+      test('should detect furigana compounds along word paths only', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setUseSegmentation(true);
+
+        // Output of the separate word trie: phoneme-only keys of the shared
+        // trie must not change where the kanji before a hint stop matching
+        expect(converter.convert('蕉門つりあげては気が動転すればおしすすめます「ピウシ」ハモった')!.phonemes,
+            equals('pi ɯɕi hamotːa'));
+        expect(converter.convert('繞を掛けました「でそガね」はじ')!.phonemes, equals('de so ga ne haʥi'));
+      });
+
+      test('should let a hinted word reach back over punctuation and line breaks', () {
+        converter.init('assets/ja_phonemes.json');
+        converter.loadWordDictionary('assets/ja_words.txt');
+        converter.setUseSegmentation(true);
+
+        // Whole-text conversion: kana after a kanji anywhere since the last
+        // hint count as okurigana, and a kana-only word takes the character
+        // before it
+        expect(converter.convert('漢字\nその男「おとこ」')!.phonemes, equals('kaɴʥi otoko'));
+        expect(converter.convert('漢字です\nABC-defた兜虫123移し換えよう「」は')!.phonemes, equals('kaɴʥi desɯ ABC- wa'));
+        expect(converter.convert('漢字\nかな漢「よみ」です')!.phonemes, equals('kaɴʥi jomi de sɯ'));
+      });
+
       test('should work without word dictionary loaded', () {
         converter.init('assets/ja_phonemes.json');
         